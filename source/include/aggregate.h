@@ -0,0 +1,111 @@
+#ifndef _AGGREGATE_H_
+#define _AGGREGATE_H_
+
+#include <cstddef>  // std::size_t
+#include <iostream> // std::ostream
+#include <limits>   // std::numeric_limits
+#include <string>   // std::string
+
+#include "parser.h"
+
+/// Folds the results of many expressions into a few numbers.
+/*!
+ * Instead of writing each value, the values of the OK results are summed,
+ * counted, and kept as their minimum, maximum and histogram, and the other
+ * results are counted by ResultType code. Each thread folds its own partial
+ * aggregate, without any synchronization; the partials are then merged. The
+ * order of the lines does not matter: merging partials gives the same
+ * aggregate as folding every line in one.
+ *
+ * The histogram has hist_bins bins of the same width, which cover every
+ * `required_int_type` value.
+ */
+class Aggregate {
+    public:
+        /// What is written by print(), one bit each.
+        enum what_t : unsigned {
+            SUM = 1,   //!< The sum of the values.
+            MIN = 2,   //!< The smallest value.
+            MAX = 4,   //!< The largest value.
+            COUNT = 8, //!< How many values there are.
+            HIST = 16  //!< How many values fall in each bin.
+        };
+
+        static constexpr long lowest = std::numeric_limits< Parser::required_int_type >::min();  //!< The smallest value.
+        static constexpr long highest = std::numeric_limits< Parser::required_int_type >::max(); //!< The largest value.
+        static constexpr std::size_t hist_bins = 16; //!< Bins of the histogram.
+        static constexpr long bin_width = ( highest - lowest + 1 ) / hist_bins; //!< Values per bin.
+
+        /**
+         * @brief Reads a list such as `sum,min,max,count,hist`.
+         * @param list the names, separated by commas.
+         * @param what receives the bits of the names.
+         * @return whether every name is known.
+         */
+        static bool parse_list( const std::string & list, unsigned & what );
+
+        /**
+         * @brief Folds the result of an expression.
+         * @param result what happened with the expression.
+         * @param value its value, used when the result is OK.
+         */
+        void add( const Parser::ResultType & result, Parser::required_int_type value ) {
+            m_codes[ result.type ]++;
+            if ( result.type != Parser::ResultType::OK ) return;
+            m_sum += value;
+            if ( value < m_min ) m_min = value;
+            if ( value > m_max ) m_max = value;
+            m_hist[ bin( value ) ]++;
+        }
+
+        /// Folds the results folded by another aggregate.
+        void merge( const Aggregate & other );
+
+        /// Writes the whole state in one line of numbers, to be read back by load().
+        void save( std::ostream & os ) const;
+
+        /**
+         * @brief Reads a state written by save(), replacing this one.
+         * @param is where the state is read from.
+         * @return whether a whole state was read.
+         */
+        bool load( std::istream & is );
+
+        /**
+         * @brief Writes the parts asked for, one per line, then the count of each error.
+         *
+         * The lines are `count: N`, `sum: S`, `min: V`, `max: V` and, for each
+         * bin that is not empty, `hist [FIRST, LAST]: N`; then `NAME: N` for
+         * each ResultType code, other than OK, that happened. Without values,
+         * the minimum and the maximum are written as `-`.
+         *
+         * @param os where the lines go.
+         * @param what the parts, from what_t.
+         */
+        void print( std::ostream & os, unsigned what ) const;
+
+        /// How many results had the code.
+        unsigned long long count( Parser::ResultType::code_t code ) const { return m_codes[ code ]; }
+        /// The sum of the values.
+        long long sum(void) const { return m_sum; }
+        /// The smallest value, meaningful when some result is OK.
+        Parser::required_int_type min(void) const { return m_min; }
+        /// The largest value, meaningful when some result is OK.
+        Parser::required_int_type max(void) const { return m_max; }
+        /// How many values fell in a bin.
+        unsigned long long hist( std::size_t bin ) const { return m_hist[ bin ]; }
+
+        /// The bin of a value.
+        static std::size_t bin( Parser::required_int_type value ) {
+            return static_cast< std::size_t >( ( long{ value } - lowest ) / bin_width );
+        }
+
+    private:
+        unsigned long long m_codes[ Parser::ResultType::n_codes ] = {}; //!< Results per code; OK ones are the values.
+        long long m_sum = 0; //!< Sum of the values; 2^48 values of a `short` fit.
+        Parser::required_int_type m_min = highest; //!< The smallest value so far.
+        Parser::required_int_type m_max = lowest; //!< The largest value so far.
+        unsigned long long m_hist[ hist_bins ] = {}; //!< Values per bin.
+};
+
+#endif
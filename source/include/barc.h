@@ -0,0 +1,144 @@
+#ifndef _BARC_H_
+#define _BARC_H_
+
+#include <cstddef>     // std::size_t
+#include <cstdint>     // std::uint32_t, std::uint64_t
+#include <iostream>    // std::istream, std::ostream
+#include <string>      // std::string
+#include <string_view> // std::string_view
+#include <vector>      // std::vector
+
+#include "program.h"
+
+/// The `.barc` file format: a batch of expressions, compiled once.
+/*!
+ * A `.barc` file is little-endian and made of five sections, each one aligned
+ * to 8 bytes and located by the header:
+ *
+ * | section  | contents                                                   |
+ * |----------|------------------------------------------------------------|
+ * | header   | barc::Header                                               |
+ * | records  | one barc::Record per expression, in input order            |
+ * | code     | the instructions of every program, one `uint32` each       |
+ * | literals | the pool of distinct literals, one `int32` each            |
+ * | source   | the text of every expression, back to back                 |
+ *
+ * An instruction keeps its Program::opcode_t in the low 8 bits and its
+ * operand in the high 24 bits: the index of its literal in the pool for a
+ * PUSH, the error code for a FAIL. A record holds the span of its program in
+ * the code, the span of its text in the source, and the outcome of parsing it:
+ * an expression with a syntax error has no code, and keeps its code and
+ * column so the error is reported exactly as when it is parsed from text.
+ *
+ * Any change in the layout must bump barc::version.
+ */
+namespace barc {
+    const char magic[4] = { 'B', 'A', 'R', 'C' }; //!< First bytes of every file.
+    const std::uint16_t version = 1;               //!< The layout described here.
+    const std::uint16_t optimized = 1;             //!< Flag: the programs were optimized.
+
+    /// The beginning of the file.
+    struct Header {
+        char magic[4];                  //!< barc::magic.
+        std::uint16_t version;          //!< barc::version.
+        std::uint16_t flags;            //!< barc::optimized, or 0.
+        std::uint32_t n_records;        //!< Number of expressions.
+        std::uint32_t n_instructions;   //!< Size of the code section, in instructions.
+        std::uint32_t n_literals;       //!< Size of the literal pool.
+        std::uint32_t max_depth;        //!< Deepest evaluation stack of the programs.
+        std::uint64_t records_offset;   //!< Where each section starts, from the beginning of the file.
+        std::uint64_t code_offset;
+        std::uint64_t literals_offset;
+        std::uint64_t source_offset;
+        std::uint64_t source_size;      //!< Size of the source section, in bytes.
+        std::uint64_t file_size;        //!< Size of the whole file, in bytes.
+    };
+
+    /// One expression.
+    struct Record {
+        std::uint64_t source_begin; //!< Its text in the source section.
+        std::uint32_t source_size;
+        std::uint32_t code_begin;   //!< Its program in the code section.
+        std::uint32_t code_size;
+        std::uint32_t status;       //!< Parser::ResultType::code_t of the parsing.
+        std::int64_t at_col;        //!< Column of a syntax error.
+    };
+
+    static_assert( sizeof( Header ) == 72 and sizeof( Record ) == 32, "the layout of the file" );
+
+    /**
+     * @brief Compiles every line of a text into a `.barc` image.
+     * @param in the expressions, one per line.
+     * @param optimize whether the programs are optimized (see optimize()).
+     * @return the bytes of the file.
+     */
+    std::vector< char > compile( std::istream & in, bool optimize );
+
+    /// A `.barc` file mapped into memory, evaluated in place.
+    /*!
+     * open() checks the whole file once: the header, every span, every
+     * opcode and literal index, and that every program leaves exactly one
+     * value on the stack. After that, evaluate() reads the programs straight
+     * from the mapping, with no copy and no allocation.
+     */
+    class File {
+        public:
+            File() = default;
+            ~File();
+            File( const File & ) = delete;
+            File & operator=( const File & ) = delete;
+
+            /**
+             * @brief Maps and checks a file, closing the current one.
+             * @param path the file.
+             * @param error why the file was rejected.
+             * @return true if the file can be evaluated.
+             */
+            bool open( const char * path, std::string & error );
+            /// Unmaps the file.
+            void close(void);
+
+            /// Number of expressions.
+            std::size_t size(void) const { return m_header ? m_header->n_records : 0; }
+            /// The text of an expression.
+            std::string_view source( std::size_t i ) const;
+
+            /**
+             * @brief Evaluates an expression, with the semantics of BaresManager::parse_and_compute().
+             * @param i the expression.
+             * @param value its value, when the result is OK.
+             * @return the syntax error stored in the file, or the result of the evaluation.
+             */
+            Parser::ResultType evaluate( std::size_t i, Parser::required_int_type & value );
+
+        private:
+            bool check( std::string & error );
+
+            const char * m_data = nullptr;              //!< The mapping.
+            std::size_t m_size = 0;                     //!< Its size.
+            const Header * m_header = nullptr;          //!< Views of the sections.
+            const Record * m_records = nullptr;
+            const std::uint32_t * m_code = nullptr;
+            const std::int32_t * m_literals = nullptr;
+            std::vector< Parser::input_int_type > m_stack; //!< Evaluation stack, sized by open().
+    };
+}
+
+/**
+ * @brief Compiles the expressions of a text file into a `.barc` file.
+ * @param in_path the expressions, one per line.
+ * @param out_path the file to write.
+ * @param optimize whether the programs are optimized.
+ * @return int the exit status of the program.
+ */
+int compile_mode( const char * in_path, const char * out_path, bool optimize );
+
+/**
+ * @brief Evaluates every expression of a `.barc` file, with the output of the default mode.
+ * @param path the file.
+ * @param os where the results are written.
+ * @return int the exit status of the program.
+ */
+int run_mode( const char * path, std::ostream & os );
+
+#endif
@@ -2,6 +2,13 @@
 #define _BARESMANAGER_H_
 
 #include "parser.h"
+#include "fork_join.h"
+#include "parallel_tokenizer.h"
+#include "program.h"
+#include "expression_dag.h"
+#include "jit.h"
+#include "threaded_vm.h"
+#include "symbol_table.h"
 
 class BaresManager {
     public:
@@ -9,21 +16,56 @@ class BaresManager {
          * @brief Send to the standard output the proper error messages.
          * @param result what happened in the operation.
          * @param str the expression that was analyzed.
+         * @param os where the message is written.
          */
-        void print_error_msg( const Parser::ResultType & result, const std::string &str );
+        void print_error_msg( const Parser::ResultType & result, const std::string &str, std::ostream &os = std::cout );
 
         /**
          * @brief Parse a line and compute a expression.
          * @param expr the expression that will be calculated.
+         * @param os where the result is written.
          */
-        void parse_and_compute(std::string expr);
+        void parse_and_compute(const std::string &expr, std::ostream &os = std::cout);
+
+        /**
+         * @brief Parse a line and compute a expression, without writing anything.
+         * @param expr the expression that will be calculated.
+         * @return const Parser::ResultType& what happened; the value is get_value() when it is OK.
+         */
+        const Parser::ResultType & compute(const std::string &expr);
+
+        /**
+         * @brief Parse and tokenize a line, keeping its tokens for the next stages.
+         * @param expr the expression that will be parsed.
+         * @return Parser::ResultType the result of the parsing stage.
+         */
+        Parser::ResultType parse(const std::string &expr);
+
+        /**
+         * @brief Send to the standard output the value or the error of the last expression.
+         * @param expr the expression that was computed.
+         * @param os where the result is written.
+         */
+        void print_result(const std::string &expr, std::ostream &os = std::cout);
+
+        /**
+         * @brief Get the value of the last expression, meaningful when its status is OK.
+         * @return Parser::required_int_type the value that was calculated.
+         */
+        Parser::required_int_type get_value(void) const { return final_value; }
+
+        /**
+         * @brief Get the status of the last expression processed.
+         * @return const Parser::ResultType& what happened with the expression.
+         */
+        const Parser::ResultType & get_status(void) const { return status; }
 
         /**
          * @brief Function to analyze the precedence of operators.
          * @param c the operator that will be analyzed.
          * @return int a number that represents its magnitude among the other operators.
          */
-        int prec(std::string c);
+        int prec(const std::string &c);
 
         /**
          * @brief Convert infix expression to postfix expression.
@@ -36,11 +78,125 @@ class BaresManager {
          * @brief Calculates the postfix expression.
          */
         void calculate(void);
+
+        /**
+         * @brief Calculates the postfix expression with a fork-join engine.
+         * @param engine the engine that evaluates the expression tree.
+         */
+        void calculate(ForkJoinEvaluator &engine);
+
+        /**
+         * @brief Calculates the postfix expression in a DAG shared with the other expressions of the batch.
+         * @param dag the DAG of the current batch.
+         */
+        void calculate(ExpressionDag &dag);
+
+        /**
+         * @brief Makes parse_and_compute() calculate expressions in a shared DAG.
+         * @param dag the DAG, or nullptr to calculate each expression on its own.
+         */
+        void use_dag(ExpressionDag *dag) { shared = dag; }
+
+        /**
+         * @brief Compiles the postfix expression into a program, which can be evaluated many times.
+         * @param program receives the instructions.
+         */
+        void compile(Program &program) const;
+
+        /**
+         * @brief Calculates a compiled program, on the threaded interpreter.
+         * @param program the program, possibly optimized.
+         */
+        void calculate(const Program &program);
+
+        /**
+         * @brief Calculates a program compiled by a JIT.
+         * @param jit the JIT, after its compile().
+         */
+        void calculate(JitProgram &jit);
+
+        /**
+         * @brief Makes parse_and_compute() compile each expression to native code before calculating it.
+         * @param engine the JIT, or nullptr to not use it.
+         */
+        void use_jit(JitProgram *engine) { jit = engine; }
+
+        /**
+         * @brief Makes parse_and_compute() compile and optimize each expression before calculating it.
+         * @param enable whether to use the optimizer.
+         */
+        void use_optimizer(bool enable) { optimizing = enable; }
+
+        /**
+         * @brief Sets the resources each expression may use; the ones over a limit become LIMIT_EXCEEDED.
+         *
+         * The length, tokens, nesting and memory are checked by the parser as it
+         * goes; the evaluation steps before any engine runs, so every engine
+         * gives the same result. While a token, depth or memory limit is set,
+         * the parallel tokenizer is not used, since only the parser counts them.
+         *
+         * @param limits the limits of each expression.
+         */
+        void set_limits(const Parser::Limits &limits) { parser.set_limits(limits); }
+
+        /**
+         * @brief Lets the expressions use variables, resolved to the slots of a symbol table.
+         *
+         * Each expression is then compiled and run (by the JIT, if any) against
+         * `values`, indexed by slot; the fork-join engine, the DAG and the
+         * parallel tokenizer, which know no variables, are not used.
+         *
+         * @param table the symbol table, or nullptr to not accept identifiers.
+         * @param values the value of each variable of the table.
+         */
+        void use_symbols(SymbolTable *table, const Parser::required_int_type *values) {
+            symbols = table;
+            slot_values = values;
+            parser.set_symbols(table);
+        }
+
+        /**
+         * @brief Hands huge expressions over to a fork-join engine in parse_and_compute().
+         * @param engine the engine, or nullptr to always use calculate().
+         * @param min_tokens expressions with fewer tokens still use calculate().
+         */
+        void use_fork_join(ForkJoinEvaluator *engine, std::size_t min_tokens) {
+            fork_join = engine;
+            fork_join_min_tokens = min_tokens;
+        }
+
+        /**
+         * @brief Hands huge lines over to a parallel tokenizer in parse().
+         * @param engine the tokenizer, or nullptr to always use the parser.
+         * @param min_bytes lines shorter than this still use the parser.
+         */
+        void use_parallel_tokenizer(ParallelTokenizer *engine, std::size_t min_bytes) {
+            tokenizer = engine;
+            tokenizer_min_bytes = min_bytes;
+        }
         
     private:
         Parser::ResultType status; //!< The status of the program, if has an error or no.
         sc::vector<Token> tokens;   //!< The tokens used during the program.
         Parser::required_int_type final_value; //!< The final value of the expression that was calculated.
+
+        //=== Scratch storage, kept between lines so the steady state does not allocate.
+        Parser parser;                               //!< The parser, reused for every line.
+        sc::vector<Token> pf_tk_list;                //!< The postfix tokens being built.
+        sta::stack<Token> op_stack;                  //!< The operators stack of infix_to_postfix().
+        sta::stack<Parser::input_int_type> operands; //!< The operands stack of calculate().
+
+        ForkJoinEvaluator *fork_join = nullptr; //!< Engine for huge expressions, if any.
+        std::size_t fork_join_min_tokens = 0;   //!< Size from which the engine is used.
+        Program program;                        //!< The compiled expression, when optimizing.
+        bool optimizing = false;                //!< Whether expressions are compiled and optimized.
+        JitProgram *jit = nullptr;              //!< JIT for the compiled expressions, if any.
+        ThreadedProgram vm;                     //!< Interpreter of the compiled expressions otherwise.
+        ExpressionDag *shared = nullptr;        //!< DAG of the current batch, if any.
+        ParallelTokenizer *tokenizer = nullptr; //!< Tokenizer for huge lines, if any.
+        std::size_t tokenizer_min_bytes = 0;    //!< Size from which the tokenizer is used.
+        SymbolTable *symbols = nullptr;         //!< The variables, if any.
+        const Parser::required_int_type *slot_values = nullptr; //!< Their values, by slot.
 };
 
 #endif
@@ -0,0 +1,49 @@
+#ifndef _CHECK_H_
+#define _CHECK_H_
+
+#include <cstddef>  // std::size_t
+#include <cstdint>  // std::uint64_t
+#include <iostream> // std::ostream
+
+#include "parser.h"
+
+/**
+ * @brief Marks the bytes that no valid expression contains, one bit per byte.
+ *
+ * A valid expression only has digits, the operators `+ - * / % ^`, the
+ * parentheses and white space; any other byte (a letter, a `.`, a control
+ * character) makes its line invalid. The bytes are classified 16 or 32 at a
+ * time with SIMD compares (SSE2, or AVX2 when the processor has it).
+ *
+ * @param data the bytes.
+ * @param size how many bytes there are.
+ * @param mask receives bit `i % 64` of word `i / 64` set for each invalid byte `i`;
+ *             it must have room for `(size + 63) / 64` words.
+ */
+void mark_invalid_bytes( const char * data, std::size_t size, std::uint64_t * mask );
+
+/**
+ * @brief Validates the input, without computing any value.
+ *
+ * The input is read in large blocks and the invalid bytes of each block are
+ * marked by mark_invalid_bytes(). Each line is then validated by
+ * Parser::validate(), which does not store tokens; no postfix conversion and
+ * no evaluation happen.
+ *
+ * With `summary` unset, a line is written for each input line: `OK`, or the
+ * name of the error and its column (counted from 1), as in
+ * `MISSING_TERM 5`; the recursive descent of a line with an invalid byte
+ * stops at the first one, where Parser fails if not before. With `summary` set, only the counts are written, per
+ * ResultType code; the lines with an invalid byte are then rejected by the
+ * pre-pass alone, without the recursive descent, and counted apart as
+ * `INVALID_BYTES`.
+ *
+ * @param in_fd where the expressions are read from.
+ * @param os where the report is written.
+ * @param summary whether to write only the counts.
+ * @param limits the limits of each expression.
+ * @return int the exit status of the program.
+ */
+int check_mode( int in_fd, std::ostream & os, bool summary, const Parser::Limits & limits );
+
+#endif
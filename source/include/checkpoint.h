@@ -0,0 +1,46 @@
+#ifndef _CHECKPOINT_H_
+#define _CHECKPOINT_H_
+
+#include <cstdint> // std::uint64_t
+#include <string>  // std::string
+
+#include "aggregate.h"
+
+/// How far a batch run went, so that it can go on from there after being stopped.
+/*!
+ * A checkpoint is only recorded for input that is completely done: every
+ * line before `offset` has its output written (and synced), and no line
+ * after it has. The file is replaced atomically: the new state is written to
+ * a temporary file next to it, synced, then renamed over the old one, so a
+ * run stopped at any moment leaves either the old or the new checkpoint.
+ */
+struct Checkpoint {
+    /// How a run records its checkpoints.
+    struct Options {
+        const char * path = nullptr; //!< The checkpoint file; no checkpoints without it.
+        bool resume = false;         //!< Whether the run goes on from the checkpoint in `path`.
+        unsigned long interval = 10; //!< Seconds between checkpoints; 0 records one after each batch.
+    };
+
+    std::uint64_t offset = 0; //!< Bytes of input done.
+    std::uint64_t lines = 0;  //!< Lines of input done.
+    std::uint64_t output = 0; //!< Size of the output (a regular file) once their results are written.
+    unsigned what = 0;        //!< The parts of the aggregate, or 0 when each result is written.
+    Aggregate aggregate;      //!< The results of the lines done, when aggregating.
+
+    /**
+     * @brief Replaces the checkpoint file atomically.
+     * @param path the checkpoint file.
+     * @return whether the checkpoint was recorded.
+     */
+    bool save( const std::string & path ) const;
+
+    /**
+     * @brief Reads a checkpoint file.
+     * @param path the checkpoint file.
+     * @return whether a whole checkpoint was read.
+     */
+    bool load( const std::string & path );
+};
+
+#endif
@@ -0,0 +1,85 @@
+#ifndef _COLUMNAR_H_
+#define _COLUMNAR_H_
+
+#include <cstddef> // std::size_t
+#include <cstdint> // std::uint8_t
+#include <vector>  // std::vector
+
+#include "program.h"
+
+/// A compiled program evaluated over columns of variable values, many rows at a time.
+/*!
+ * Instead of running the whole program for each row, evaluate() runs each
+ * instruction over a block of rows: the evaluation stack holds one column
+ * per slot, a LOAD stands for the slice of the caller's column of its
+ * variable and an operator combines two columns into one. The values stay
+ * 16-bit, so a SIMD register holds 16 of them (AVX2) or 8 (SSE2):
+ * - `+` and `-` compare the wrapping and the saturating result, which differ
+ *   exactly where the result does not fit in a `short`;
+ * - `*` compares the high half of the 32-bit product with the sign of its
+ *   low half, which differ in the same case.
+ * Those lanes become OVERFLOW_ERROR in the per-row status, unless the row
+ * had already failed: like in Program::run(), each row keeps the first error
+ * in postfix order. `/`, `%` and `^` have no SIMD instruction and run row by
+ * row through apply_operator(), skipping the rows that already failed; their
+ * divisions by zero become DIVISION_BY_ZERO.
+ *
+ * The operands are not copied: a LOAD reads the caller's column in place
+ * and a literal reads a column filled once, by compile(); only the results
+ * of the operations are written, into the stack of columns.
+ *
+ * The best kernels the processor supports are chosen at run time; the
+ * portable ones, also used on other architectures, give the same results.
+ */
+class ColumnarProgram {
+    public:
+        /// The kernels of `+ - *`.
+        enum isa_t {
+            SCALAR, //!< One row at a time, in portable C++.
+            SSE2,   //!< 8 rows per instruction (every x86-64).
+            AVX2    //!< 16 rows per instruction.
+        };
+
+        /// Rows evaluated by each instruction before the next instruction runs.
+        static constexpr std::size_t block_rows = 1024;
+
+        /// The best kernels of this processor.
+        static isa_t best_isa(void);
+
+        ColumnarProgram(void) : m_isa( best_isa() ) {}
+
+        /**
+         * @brief Prepares a program, replacing the previous one.
+         * @param program the program (optimized or not); its LOADs index the columns.
+         */
+        void compile( const Program & program );
+
+        /**
+         * @brief Evaluates the program for every row of the columns.
+         * @param columns one column of `rows` values per variable, indexed by slot (see Program::LOAD).
+         * @param rows how many rows the columns have.
+         * @param values receives, for each row, the value of the expression when its status is OK.
+         * @param status receives, for each row, its Parser::ResultType::code_t: OK, DIVISION_BY_ZERO or OVERFLOW_ERROR.
+         * @return how many rows failed.
+         */
+        std::size_t evaluate( const Parser::required_int_type * const * columns, std::size_t rows,
+                              Parser::required_int_type * values, std::uint8_t * status );
+
+        /// Chooses the kernels (for tests); one the processor does not support becomes SCALAR.
+        void use_isa( isa_t isa ) { m_isa = isa <= best_isa() ? isa : SCALAR; }
+        /// The kernels in use.
+        isa_t isa(void) const { return m_isa; }
+
+    private:
+        void run_block( const Parser::required_int_type * const * columns, std::size_t first, std::size_t n,
+                        Parser::required_int_type * values, std::uint8_t * status );
+
+        std::vector< Program::Instruction > m_code;       //!< The program.
+        std::vector< Parser::required_int_type > m_stack; //!< The results of the operations, `block_rows` values each.
+        std::vector< const Parser::required_int_type * > m_operands; //!< The column of each slot of the stack.
+        std::vector< Parser::required_int_type > m_constants; //!< A column for each distinct literal.
+        std::vector< std::size_t > m_literals;            //!< The column in m_constants of each PUSH (and FAIL).
+        isa_t m_isa;                                      //!< The kernels in use.
+};
+
+#endif
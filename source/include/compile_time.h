@@ -0,0 +1,182 @@
+#ifndef _COMPILE_TIME_H_
+#define _COMPILE_TIME_H_
+
+#include <cstddef>     // std::size_t, std::ptrdiff_t
+#include <cstdint>     // std::uint64_t
+#include <stdexcept>   // std::runtime_error
+#include <string_view> // std::string_view
+
+#include "lexeme_validator.h"
+#include "parser.h"
+#include "operators.h"
+
+/// Evaluation of BARES expressions in constant expressions.
+/*!
+ * `constexpr auto x = bares::eval("(2+3)*8");` is computed by the compiler. An
+ * expression that the program would reject (a syntax error, an integer out of
+ * range, a division by zero or an overflow) does not compile, and the error
+ * names its Parser::ResultType code, e.g.
+ *
+ *     error: call to non-'constexpr' function '... bares::expression_error(...)
+ *            [with Parser::ResultType::code_t Code = Parser::ResultType::OVERFLOW_ERROR]'
+ *
+ * Called at run time, eval() throws bares::eval_error instead.
+ *
+ * The line is validated by lexemes::Validator, the state machine the other
+ * parsers share, so the grammar and the error codes and columns are the ones
+ * of Parser. The order of evaluation is the one of BaresManager::calculate();
+ * the arithmetic is the shared apply_operator(). The stacks are arrays sized
+ * after the expression, since a constant expression cannot allocate.
+ */
+namespace bares {
+
+    /// The outcome of an expression evaluated by evaluate().
+    struct Result {
+        Parser::ResultType::code_t code = Parser::ResultType::OK; //!< OK or the error.
+        Parser::ResultType::size_type at_col = 0;                 //!< Column of a syntax error.
+        Parser::required_int_type value = 0;                      //!< The value, if OK.
+    };
+
+    /// The error thrown by eval() at run time.
+    class eval_error : public std::runtime_error {
+        public:
+            eval_error( Parser::ResultType::code_t code, Parser::ResultType::size_type col )
+                : std::runtime_error{ Parser::ResultType::code_name( code ) }
+                , m_result{ code, col }
+            { /* empty */ }
+            /// The code and column of the error.
+            const Parser::ResultType & result(void) const { return m_result; }
+        private:
+            Parser::ResultType m_result;
+    };
+
+    /// Reports an error. Not constexpr on purpose: reaching it in a constant
+    /// expression is a compile error, and the message shows `Code`.
+    template < Parser::ResultType::code_t Code >
+    [[noreturn]] void expression_error( Parser::ResultType::size_type col ) {
+        throw eval_error{ Code, col };
+    }
+
+    namespace detail {
+        using lexemes::prec;
+
+        /// Evaluates a line while lexemes::Validator accepts it, applying each operator when it would be emitted in postfix order.
+        /*!
+         * The arithmetic may fail before the validator finds a syntax error
+         * further on; the first such error is kept aside (the syntax error wins,
+         * as in BaresManager) and the stacks are still kept in shape.
+         */
+        template < std::size_t N >
+        struct Calculator {
+            Parser::input_int_type values[N + 1] = {};
+            char ops[N + 1] = {};
+            std::size_t n_values = 0, n_ops = 0;
+            Parser::ResultType::code_t code = Parser::ResultType::OK; //!< The first error of the arithmetic.
+
+            /// Pops an operator and applies it to the two values on top, unless the arithmetic already failed.
+            constexpr void reduce(void) {
+                char op = ops[ --n_ops ];
+                Parser::input_int_type b = values[ --n_values ];
+                Parser::input_int_type a = values[ n_values - 1 ];
+                Parser::input_int_type result{0};
+                if ( code == Parser::ResultType::OK ) code = apply_operator( op, a, b, result );
+                values[ n_values - 1 ] = result;
+            }
+
+            //=== The handler of lexemes::Validator.
+            constexpr void integer( const lexemes::Lexeme & digits, bool negative ) {
+                values[ n_values++ ] = negative ? -digits.value : digits.value;
+            }
+            constexpr void open( bool /* dropped_minus: Parser skips it */ ) { ops[ n_ops++ ] = '('; }
+            constexpr void close(void) {
+                while ( ops[ n_ops - 1 ] != '(' ) reduce();
+                n_ops--;
+            }
+            constexpr void operation( char op ) {
+                while ( n_ops > 0 and prec( op ) <= prec( ops[ n_ops - 1 ] ) ) reduce();
+                ops[ n_ops++ ] = op;
+            }
+
+            /// Applies the operators left, once the line is valid.
+            constexpr void finish(void) {
+                while ( n_ops > 0 ) reduce();
+            }
+        };
+
+        /// Reports an error, choosing the function that names its code.
+        constexpr void fail( const Result & r ) {
+            typedef Parser::ResultType RT;
+            switch ( r.code ) {
+                case RT::UNEXPECTED_END_OF_EXPRESSION: expression_error< RT::UNEXPECTED_END_OF_EXPRESSION >( r.at_col );
+                case RT::ILL_FORMED_INTEGER:           expression_error< RT::ILL_FORMED_INTEGER >( r.at_col );
+                case RT::MISSING_TERM:                 expression_error< RT::MISSING_TERM >( r.at_col );
+                case RT::EXTRANEOUS_SYMBOL:            expression_error< RT::EXTRANEOUS_SYMBOL >( r.at_col );
+                case RT::INTEGER_OUT_OF_RANGE:         expression_error< RT::INTEGER_OUT_OF_RANGE >( r.at_col );
+                case RT::MISSING_CLOSING:              expression_error< RT::MISSING_CLOSING >( r.at_col );
+                case RT::DIVISION_BY_ZERO:             expression_error< RT::DIVISION_BY_ZERO >( r.at_col );
+                case RT::OVERFLOW_ERROR:               expression_error< RT::OVERFLOW_ERROR >( r.at_col );
+                case RT::LIMIT_EXCEEDED:               expression_error< RT::LIMIT_EXCEEDED >( r.at_col );
+                default: break;
+            }
+        }
+    }
+
+    /**
+     * @brief Evaluates an expression of at most N characters, reporting errors in the result.
+     *
+     * The line is split into lexemes, as StreamingParser does, and fed to
+     * lexemes::Validator, which drives the evaluation.
+     *
+     * @param expr the expression.
+     * @return the code (and column, for syntax errors) and the value, like BaresManager;
+     * LIMIT_EXCEEDED at column N if the expression is longer than N characters.
+     */
+    template < std::size_t N >
+    constexpr Result evaluate( std::string_view expr ) {
+        using namespace lexemes;
+        typedef Parser::ResultType RT;
+        if ( expr.size() > N ) return Result{ RT::LIMIT_EXCEEDED, static_cast< RT::size_type >( N ) };
+
+        Validator validator;
+        detail::Calculator< N > calculator;
+        const std::uint64_t end = expr.size();
+        bool more{true};
+        for ( std::uint64_t p{0}; more and p < end; ) {
+            const char c = expr[p];
+            if ( is_space( c ) )
+                p++;
+            else if ( is_digit( c ) ) {
+                const std::uint64_t start{p};
+                while ( p < end and is_digit( expr[p] ) ) p++;
+                more = validator.feed( Lexeme{ DIGITS, start, c, p - start, value_of( expr.data() + start, p - start ) },
+                                       calculator );
+            }
+            else
+                more = validator.feed( Lexeme{ kind_of( c ), p++, c, 1, 0 }, calculator );
+        }
+        if ( more ) validator.feed( Lexeme{ END, end, 0, 0, 0 }, calculator );
+
+        if ( validator.result().type != RT::OK )
+            return Result{ validator.result().type, validator.result().at_col };
+        calculator.finish();
+        Result r;
+        r.code = calculator.code;
+        if ( r.code == RT::OK ) r.value = static_cast< Parser::required_int_type >( calculator.values[0] );
+        return r;
+    }
+
+    /**
+     * @brief Evaluates a string literal; in a constant expression, an error does not compile.
+     * @param expr the expression.
+     * @return its value.
+     */
+    template < std::size_t N >
+    constexpr Parser::required_int_type eval( const char ( &expr )[N] ) {
+        Result r = evaluate< N >( std::string_view{ expr, N - 1 } );
+        if ( r.code != Parser::ResultType::OK )
+            detail::fail( r );
+        return r.value;
+    }
+}
+
+#endif
@@ -0,0 +1,83 @@
+#ifndef _EXPRESSION_DAG_H_
+#define _EXPRESSION_DAG_H_
+
+#include <cstddef>       // std::size_t
+#include <cstdint>       // std::uint64_t
+#include <unordered_map> // std::unordered_map
+#include <vector>        // std::vector
+
+#include "parser.h"
+
+/// Evaluates a batch of expressions sharing their common subexpressions.
+/*!
+ * Every subexpression is interned into a hash-consed DAG: a literal is
+ * identified by its value and an operation by its operator and the nodes of
+ * its operands, so two structurally equal subexpressions, in the same line or
+ * in different lines of the batch, are the same node.
+ *
+ * The postfix order creates the operands before the operation, so a node is
+ * evaluated once, when it is created, and its outcome (value or error) is
+ * reused wherever the subexpression appears again. Reusing an outcome is
+ * exact: the first error of an operation is the first error of its left
+ * operand, else the first error of its right operand, else its own.
+ *
+ * The table grows with the batch; call clear() between batches.
+ */
+class ExpressionDag {
+    public:
+        /// How much was shared.
+        struct Stats {
+            std::size_t lookups = 0; //!< Subexpressions interned.
+            std::size_t nodes = 0;   //!< Distinct ones, each evaluated once.
+        };
+
+        /**
+         * @brief Evaluates a (valid) postfix token list, interning its subexpressions.
+         * @param postfix the tokens produced by BaresManager::infix_to_postfix().
+         * @param value the value of the expression, when the result is OK.
+         * @return Parser::ResultType OK, DIVISION_BY_ZERO or OVERFLOW_ERROR.
+         */
+        Parser::ResultType evaluate( const sc::vector< Token > & postfix, Parser::required_int_type & value );
+
+        /// Forgets every node (the storage is kept for the next batch).
+        void clear(void);
+
+        /// Counters of the current batch.
+        const Stats & stats(void) const { return m_stats; }
+
+    private:
+        /// What identifies a node: a literal, or an operator applied to two nodes.
+        struct Key {
+            char op;             //!< The operator, or 0 for a literal.
+            std::uint64_t left;  //!< The left operand node, or the literal value.
+            std::uint64_t right; //!< The right operand node.
+            bool operator==( const Key & other ) const {
+                return op == other.op and left == other.left and right == other.right;
+            }
+        };
+
+        /// Structural hash of a node, from the identities of its operands.
+        struct KeyHash {
+            std::size_t operator()( const Key & k ) const {
+                std::uint64_t h = k.left * 0x9E3779B97F4A7C15ull;
+                h ^= ( k.right + 0x632BE59BD9B4E019ull + ( h << 6 ) + ( h >> 2 ) ) * 0xBF58476D1CE4E5B9ull;
+                h ^= static_cast< unsigned char >( k.op );
+                return static_cast< std::size_t >( h ^ ( h >> 31 ) );
+            }
+        };
+
+        /// The memoized evaluation of a node.
+        struct Outcome {
+            Parser::ResultType::code_t code; //!< OK or the first error.
+            Parser::input_int_type value;    //!< The value, if OK.
+        };
+
+        std::size_t intern( const Key & key );
+
+        std::unordered_map< Key, std::size_t, KeyHash > m_table; //!< Node of each key.
+        std::vector< Outcome > m_outcomes;                       //!< Outcome of each node.
+        std::vector< std::size_t > m_stack;                      //!< Nodes of the pending operands.
+        Stats m_stats;                                           //!< Counters of the batch.
+};
+
+#endif
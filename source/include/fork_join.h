@@ -0,0 +1,110 @@
+#ifndef _FORK_JOIN_H_
+#define _FORK_JOIN_H_
+
+#include <atomic>  // std::atomic
+#include <cstddef> // std::size_t
+#include <vector>  // std::vector
+
+#include "parser.h"
+#include "../lib/work_stealing_pool.h"
+
+/// Evaluates huge expressions by computing independent subtrees in parallel.
+/*!
+ * The postfix token list is turned into an expression tree stored in postfix
+ * order: node `i` is the i-th token and, since a subtree always occupies a
+ * contiguous range of the postfix list, only the size of each subtree is
+ * needed to find the children (the right child of `i` is `i-1`, the left one
+ * comes right before the right subtree).
+ *
+ * Subtrees smaller than the cutoff are evaluated sequentially, with the same
+ * stack machine as BaresManager::calculate(). For larger ones, we walk down
+ * the left spine (left-associative operators make long left spines), spawn
+ * the large right children on a work-stealing pool and fold the spine
+ * bottom-up, in postfix order.
+ *
+ * A flat chain such as `1 + 2 + ... + n` has a spine as long as the
+ * expression and only one-token right children, so nothing would be
+ * spawned: a long run of `+` and `-` with small right children is cut into
+ * chunks whose sums (and lowest and highest partial sums) are computed on
+ * the pool, then scanned in order, so an overflow is still found at the
+ * operator where the sequential evaluation finds it. The spine itself takes
+ * one index per operator.
+ *
+ * Errors are deterministic: the error reported is always the one the
+ * sequential evaluation would stop at, i.e. the failing operator that comes
+ * first in postfix order. Once an error is found, every task whose subtree
+ * starts after it is abandoned.
+ */
+class ForkJoinEvaluator {
+    public:
+        /**
+         * @brief Creates the evaluator and its pool.
+         * @param threads how many threads evaluate, counting the caller.
+         * @param cutoff subtrees with fewer tokens than this are evaluated sequentially.
+         */
+        ForkJoinEvaluator( unsigned threads, std::size_t cutoff );
+
+        /**
+         * @brief Evaluates a (valid) postfix token list.
+         * @param postfix the tokens produced by BaresManager::infix_to_postfix().
+         * @param value the value of the expression, when the result is OK.
+         * @return Parser::ResultType OK, DIVISION_BY_ZERO or OVERFLOW_ERROR.
+         */
+        Parser::ResultType evaluate( const sc::vector< Token > & postfix, Parser::required_int_type & value );
+
+        /// The number of tokens below which evaluation is sequential.
+        std::size_t cutoff(void) const { return m_cutoff; }
+
+    private:
+        /// The outcome of evaluating a subtree.
+        struct Outcome {
+            Parser::ResultType::code_t code = Parser::ResultType::OK; //!< OK or the error.
+            Parser::input_int_type value = 0;                         //!< The value, if OK.
+            std::size_t at = 0;                                       //!< Postfix position of the error.
+            bool abandoned = false;                                   //!< Skipped, an earlier error exists.
+        };
+
+        /// A right child evaluated by the pool.
+        struct Subtree : public ws::task {
+            ForkJoinEvaluator * self = nullptr;
+            std::size_t node = 0;
+            unsigned depth = 0;
+            Outcome out;
+            void run(void) override { out = self->eval_node( node, depth ); }
+        };
+
+        /// A piece of a run of additive spine operators, summed by the pool.
+        struct Chunk : public ws::task {
+            ForkJoinEvaluator * self = nullptr;
+            const std::size_t * spine = nullptr; //!< The spine, from the top down.
+            std::size_t top = 0;                 //!< The last operator folded (highest in the spine).
+            std::size_t bottom = 0;              //!< The first operator folded.
+            Parser::input_int_type sum = 0;      //!< The signed sum of the right children.
+            Parser::input_int_type low = 0;      //!< The lowest partial sum.
+            Parser::input_int_type high = 0;     //!< The highest partial sum.
+            Outcome stop;                        //!< The error of a right child, which ended the chunk.
+            void run(void) override { self->fold_chunk( *this ); }
+        };
+
+        Outcome eval_node( std::size_t node, unsigned depth );
+        Outcome apply_small( std::size_t op_node, const Outcome & acc );
+        void fold_chunk( Chunk & chunk );
+        Outcome fold_additive( const std::vector< std::size_t > & spine, std::size_t top, std::size_t bottom, Outcome acc );
+        Outcome eval_range( std::size_t first, std::size_t last );
+        Outcome fail( Parser::ResultType::code_t code, std::size_t at );
+        bool abandoned( std::size_t first ) const {
+            return first > m_first_error.load( std::memory_order_relaxed );
+        }
+
+        ws::pool m_pool;       //!< The threads.
+        std::size_t m_cutoff;  //!< Size under which subtrees are evaluated sequentially.
+
+        //=== The tree, in postfix order.
+        std::vector< char > m_op;                      //!< The operator, or 0 for an operand.
+        std::vector< Parser::input_int_type > m_value; //!< The value of an operand.
+        std::vector< std::size_t > m_size;             //!< Number of nodes of the subtree.
+
+        std::atomic< std::size_t > m_first_error;      //!< Earliest failing node found so far.
+};
+
+#endif
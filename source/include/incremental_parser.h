@@ -0,0 +1,108 @@
+#ifndef _INCREMENTAL_PARSER_H_
+#define _INCREMENTAL_PARSER_H_
+
+#include <cstddef> // std::size_t, std::ptrdiff_t
+#include <string>  // std::string
+#include <vector>  // std::vector
+
+#include "lexeme_validator.h"
+#include "parser.h"
+
+/// Parses and evaluates an expression that is edited a little at a time.
+/*!
+ * Keeps, between edits, the lexemes of the expression (with the matching
+ * parenthesis of each "(" and ")") and the outcome of every parenthesized
+ * group already evaluated. An edit then:
+ *
+ * 1. **re-lexes only the damaged window**: the lexemes that the edited range
+ *    touches, or is adjacent to, are replaced by the lexemes of the new text
+ *    there, and the ones after it are shifted;
+ * 2. **re-validates only the smallest enclosing group**: when the expression
+ *    was valid and the new contents of the innermost "( ... )" around the
+ *    window are a valid expression, so is the whole line. Otherwise (an edit
+ *    at the top level, one that breaks the group, or a line that was already
+ *    wrong) the lexemes of the whole line are validated, still without lexing
+ *    them again, to find the exact error;
+ * 3. **re-evaluates only the affected subtree**: the groups around the edit
+ *    forget their outcome, every other group reuses its own, so only the path
+ *    from the edit up to the top level is computed again.
+ *
+ * The result is always the one of a full parse, Parser::parse_and_tokenize(),
+ * followed by BaresManager::calculate(): the same syntax errors with the same
+ * columns, and the first division by zero or overflow in postfix order.
+ */
+class IncrementalParser {
+    public:
+        /// Work done by the last parse() or edit().
+        struct Stats {
+            std::size_t relexed = 0;   //!< Characters lexed.
+            std::size_t validated = 0; //!< Lexemes validated.
+            std::size_t evaluated = 0; //!< Lexemes visited by the evaluation.
+            bool full = false;         //!< Whether the whole line had to be validated.
+        };
+
+        /**
+         * @brief Parses and evaluates a whole expression, forgetting the previous one.
+         * @param expr the expression.
+         * @return the syntax error, or the result of the evaluation.
+         */
+        Parser::ResultType parse( const std::string & expr );
+
+        /**
+         * @brief Replaces a range of the expression and evaluates it again.
+         * @param pos where the range starts; at most the size of the expression.
+         * @param erased how many characters are replaced (clamped to the end of the expression).
+         * @param text what is put in their place.
+         * @return the syntax error, or the result of the evaluation, of the edited expression.
+         * @throw std::out_of_range if `pos` is past the end of the expression.
+         */
+        Parser::ResultType edit( std::size_t pos, std::size_t erased, const std::string & text );
+
+        /// The current expression.
+        const std::string & expression(void) const { return m_expr; }
+        /// The result of the last parse() or edit().
+        const Parser::ResultType & result(void) const { return m_result; }
+        /// The value of the expression, when the result is OK.
+        Parser::required_int_type value(void) const { return m_value; }
+        /// What the last parse() or edit() did.
+        const Stats & stats(void) const { return m_stats; }
+
+    private:
+        /// A piece of the expression.
+        struct Lexeme {
+            std::size_t pos;           //!< Column of the first character.
+            std::size_t len;           //!< Number of characters.
+            lexemes::kind_t kind;      //!< What the text is.
+            lexemes::kind_t role;      //!< What it is in the expression (valid lines only).
+            std::ptrdiff_t match;      //!< Offset to the matching parenthesis, or 0.
+            bool cached;               //!< A "(" whose group has its outcome below.
+            Parser::ResultType::code_t code; //!< Outcome of the group: OK or its first error.
+            Parser::input_int_type value;    //!< Value of the group, if OK.
+        };
+
+        /// A pending operator of the evaluation, or the "(" of a group being computed.
+        struct Pending {
+            char op;           //!< The operator, or "(".
+            std::size_t open;  //!< The lexeme of the "(".
+        };
+
+        void lex( std::size_t first, std::size_t last, std::vector< Lexeme > & out );
+        Parser::ResultType validate( std::size_t lo, std::size_t hi, std::size_t end );
+        void match_all(void);
+        Parser::ResultType evaluate(void);
+        Parser::ResultType finish( Parser::ResultType syntax );
+
+        std::string m_expr;                   //!< The current expression.
+        std::vector< Lexeme > m_lexemes;      //!< Its lexemes, in order.
+        std::vector< Lexeme > m_window;       //!< Lexemes of an edited window.
+        std::vector< std::size_t > m_opens;   //!< Open parentheses, while validating.
+        std::vector< std::size_t > m_around;  //!< Groups around an edited window.
+        std::vector< Parser::input_int_type > m_values; //!< Operands, while evaluating.
+        std::vector< Pending > m_pending;     //!< Operators, while evaluating.
+        bool m_valid = false;                 //!< Whether the expression has no syntax error.
+        Parser::ResultType m_result;          //!< The last result.
+        Parser::required_int_type m_value = 0; //!< The last value.
+        Stats m_stats;                        //!< Work of the last call.
+};
+
+#endif
@@ -0,0 +1,72 @@
+#ifndef _JIT_H_
+#define _JIT_H_
+
+#include <cstddef> // std::size_t
+#include <cstdint> // std::int64_t, std::uint8_t
+#include <vector>  // std::vector
+
+#include "program.h"
+#include "threaded_vm.h"
+
+/// A compiled program turned into native x86-64 code.
+/*!
+ * The evaluation stack is mapped onto the machine: its first five slots are
+ * the callee-saved registers `rbx`, `r12`-`r15` and the deeper ones live in
+ * the stack frame. Each operation loads its operands into `rax`/`rcx`,
+ * computes, and branches to the code that returns OVERFLOW_ERROR when the
+ * result does not fit in 16 bits, or DIVISION_BY_ZERO before a division by
+ * zero. The power operator calls apply_operator(), so every engine shares
+ * its definition. A variable is loaded from the array of values given to
+ * run(), whose address is kept in the frame.
+ *
+ * The code is written into an `mmap`'d area that is writable while it is
+ * generated and executable (not writable) while it runs. The area is reused
+ * by the next compile() when it is large enough.
+ *
+ * Where the JIT is not available (another architecture, or the system does
+ * not allow executable mappings) the program is run by the threaded
+ * interpreter, ThreadedProgram, with the same results.
+ */
+class JitProgram {
+    public:
+        JitProgram() = default;
+        ~JitProgram();
+        JitProgram( const JitProgram & ) = delete;
+        JitProgram & operator=( const JitProgram & ) = delete;
+
+        /// Whether this build can generate native code.
+        static bool available(void);
+
+        /**
+         * @brief Compiles a program, replacing the previous one.
+         * @param program the program (optimized or not).
+         * @return true if native code was generated, false if the interpreter will run it.
+         */
+        bool compile( const Program & program );
+
+        /**
+         * @brief Evaluates the compiled program.
+         * @param value the value of the expression, when the result is OK.
+         * @param values the value of each variable, indexed by slot (see Program::LOAD).
+         * @return Parser::ResultType OK, DIVISION_BY_ZERO or OVERFLOW_ERROR.
+         */
+        Parser::ResultType run( Parser::required_int_type & value, const Parser::required_int_type * values = nullptr );
+
+        /// Whether the last compile() generated native code.
+        bool native(void) const { return m_entry != nullptr; }
+
+    private:
+        /// The generated function: stores the value and returns OK, or returns the error code.
+        typedef int (*entry_t)( std::int64_t * value, const Parser::required_int_type * values );
+
+        bool generate( const Program & program );
+        bool install(void);
+
+        std::vector< std::uint8_t > m_code;           //!< Code being generated.
+        void * m_area = nullptr;                      //!< The executable mapping.
+        std::size_t m_area_size = 0;                  //!< Its size, in bytes.
+        entry_t m_entry = nullptr;                    //!< The native program, or nullptr.
+        ThreadedProgram m_fallback;                   //!< The program, for the interpreter.
+};
+
+#endif
@@ -0,0 +1,226 @@
+#ifndef _LEXEME_VALIDATOR_H_
+#define _LEXEME_VALIDATOR_H_
+
+#include <cstdint> // std::uint8_t, std::uint64_t
+#include <limits>  // std::numeric_limits
+
+#include "parser.h"
+#include "operators.h"
+
+/// The validation of lexemes shared by ParallelTokenizer, IncrementalParser and StreamingParser.
+/*!
+ * Those parsers split the line into context free lexemes (a run of digits, a
+ * single symbol, an invalid character), each in its own way, and then hand
+ * them, in order, to the same state machine, lexemes::Validator. It decides
+ * what the context dependent characters are (an unary "-" or an operator, the
+ * "0" that ends an integer) and reproduces the error codes and columns of
+ * Parser exactly, with no memory of the line: the depth of the parentheses
+ * and whether the outermost one follows an operator are enough.
+ */
+namespace lexemes {
+    constexpr bool is_digit( char c ) { return c >= '0' and c <= '9'; }
+
+    /// The characters Parser skips with std::isspace().
+    constexpr bool is_space( char c ) {
+        return c == ' ' or c == '\t' or c == '\n' or c == '\v' or c == '\f' or c == '\r';
+    }
+
+    constexpr bool is_operator( char c ) {
+        return c == '+' or c == '-' or c == '*' or c == '/' or c == '%' or c == '^';
+    }
+
+    /// The precedence of an operator, as in BaresManager::prec().
+    constexpr int prec( char c ) {
+        return c == '^' ? 3 : ( c == '*' or c == '/' or c == '%' ) ? 2 : ( c == '+' or c == '-' ) ? 1 : -1;
+    }
+
+    /// Digits are only counted past this value: the integer is out of range anyway.
+    constexpr Parser::input_int_type saturation = 1000000;
+
+    /// The value of a run of digits, saturated.
+    constexpr Parser::input_int_type value_of( const char * digits, std::uint64_t len ) {
+        Parser::input_int_type value{0};
+        for ( std::uint64_t i{0}; i < len and value <= saturation; i++ )
+            value = value * 10 + ( digits[i] - '0' );
+        return value;
+    }
+
+    /// Whether a run of `len` digits (not starting with 0), of saturated `value`, fits in Parser::required_int_type.
+    constexpr bool fits( Parser::input_int_type value, std::uint64_t len, bool negative ) {
+        return len <= std::numeric_limits< Parser::required_int_type >::digits10 + 1 and
+               in_required_range( negative ? -value : value );
+    }
+
+    /// What a lexeme is: its kind, from the text alone, and then its role in a valid line.
+    enum kind_t : std::uint8_t {
+        DIGITS,        //!< A run of digits.
+        OPEN,          //!< "(".
+        CLOSE,         //!< ")".
+        OPERATOR,      //!< One of "+ - * / % ^".
+        INVALID,       //!< Anything else that is not white space.
+        END,           //!< The end of the line.
+        //=== Roles.
+        UNARY_MINUS,   //!< A "-" that belongs to the integer after it.
+        DROPPED_MINUS, //!< A "-" right before "(", which Parser skips.
+        NEGATIVE       //!< Digits with an unary minus before them.
+    };
+
+    /// The kind of a character that is neither a digit nor white space.
+    constexpr kind_t kind_of( char c ) {
+        return c == '(' ? OPEN : c == ')' ? CLOSE : is_operator( c ) ? OPERATOR : INVALID;
+    }
+
+    /// A lexeme, as the validator sees it (for digits, a summary of the run).
+    struct Lexeme {
+        kind_t kind;
+        std::uint64_t pos;            //!< Column of the first character.
+        char symbol;                  //!< The character, or the first digit.
+        std::uint64_t len;            //!< Number of characters.
+        Parser::input_int_type value; //!< Value of the digits, saturated.
+    };
+
+    /// The state machine that validates the lexemes of a line like Parser does.
+    /*!
+     * The lexemes are fed one at a time, END last. What the validator makes of
+     * them is told to a handler, which builds tokens, pairs the parentheses or
+     * evaluates the line:
+     *
+     *     void integer( const Lexeme & digits, bool negative ); // With the "-" fed just before.
+     *     void open( bool dropped_minus );                       // Ditto, for a "-" that is dropped.
+     *     void close(void);
+     *     void operation( char op );
+     *
+     * It is a literal type, so bares::evaluate() drives it in constant expressions too.
+     */
+    class Validator {
+        public:
+            /// Starts a new line.
+            constexpr void reset(void) { *this = Validator{}; }
+
+            /**
+             * @brief Feeds the next lexeme.
+             * @return false once the result is known: a syntax error, or OK after END.
+             */
+            template < typename Handler >
+            constexpr bool feed( const Lexeme & l, Handler & handler );
+
+            /// Whether the result is known.
+            constexpr bool done(void) const { return m_done; }
+            /// The syntax error, or OK.
+            constexpr const Parser::ResultType & result(void) const { return m_result; }
+
+        private:
+            constexpr bool conclude( Parser::ResultType::code_t code, std::uint64_t col ) {
+                m_result = Parser::ResultType{ code, static_cast< Parser::ResultType::size_type >( col ) };
+                m_done = true;
+                return false;
+            }
+
+            /// Parser turns any error found inside parentheses into an ill formed integer at
+            /// the start of the last term it tried, or a missing term if the outermost "(" is
+            /// after an operator. At the top level, only an ill formed term after an operator
+            /// becomes a missing term.
+            constexpr bool term_error( Parser::ResultType::code_t code, std::uint64_t col, std::uint64_t begin ) {
+                typedef Parser::ResultType RT;
+                if ( m_depth == 0 )
+                    return conclude( m_after_op and code == RT::ILL_FORMED_INTEGER ? RT::MISSING_TERM : code, col );
+                return conclude( m_top_after_op ? RT::MISSING_TERM : RT::ILL_FORMED_INTEGER, begin );
+            }
+
+            bool m_done = false;            //!< The result is known.
+            Parser::ResultType m_result;    //!< The result.
+            bool m_empty = true;            //!< No lexeme yet: a blank line.
+            bool m_expect_term = true;
+            bool m_pending_minus = false;   //!< A "-" where a term is expected, waiting for the next lexeme.
+            std::uint64_t m_minus_at = 0;
+            std::uint64_t m_depth = 0;
+            bool m_after_op = false;        //!< The term being parsed follows an operator.
+            bool m_top_after_op = false;    //!< The outermost open "(" follows an operator.
+            bool m_zero = false;            //!< A "0" was followed by more digits...
+            std::uint64_t m_zero_at = 0;    //!< ... at this column.
+    };
+
+    template < typename Handler >
+    constexpr bool Validator::feed( const Lexeme & l, Handler & handler ) {
+        typedef Parser::ResultType RT;
+        if ( m_done ) return false;
+        if ( m_empty ) {
+            if ( l.kind == END )
+                return conclude( RT::UNEXPECTED_END_OF_EXPRESSION, l.pos );
+            m_empty = false;
+        }
+
+        if ( m_expect_term ) {
+            std::uint64_t begin{ l.pos };
+            bool dropped_minus{false};
+            if ( m_pending_minus ) {
+                m_pending_minus = false;
+                begin = m_minus_at;
+                bool adjacent = l.kind != END and l.pos == m_minus_at + 1;
+                if ( adjacent and l.kind == DIGITS and l.symbol != '0' ) {
+                    if ( not fits( l.value, l.len, true ) )
+                        return term_error( RT::INTEGER_OUT_OF_RANGE, begin, begin );
+                    handler.integer( l, true );
+                    m_expect_term = false;
+                    return true;
+                }
+                if ( not adjacent or l.kind != OPEN )
+                    return term_error( RT::ILL_FORMED_INTEGER, begin + 1, begin );
+                dropped_minus = true; // Parser accepts "(" right after a failed integer.
+            }
+            else if ( l.kind == OPERATOR and l.symbol == '-' ) {
+                m_pending_minus = true;
+                m_minus_at = l.pos;
+                return true;
+            }
+            switch ( l.kind ) {
+                case DIGITS:
+                    if ( l.symbol == '0' ) {
+                        if ( l.len > 1 ) {
+                            m_zero = true;
+                            m_zero_at = l.pos + 1;
+                        }
+                    }
+                    else if ( not fits( l.value, l.len, false ) )
+                        return term_error( RT::INTEGER_OUT_OF_RANGE, begin, begin );
+                    handler.integer( l, false );
+                    m_expect_term = false;
+                    return true;
+                case OPEN:
+                    if ( m_depth == 0 ) m_top_after_op = m_after_op;
+                    m_depth++;
+                    m_after_op = false;
+                    handler.open( dropped_minus );
+                    return true;
+                case END:
+                    return term_error( RT::ILL_FORMED_INTEGER, l.pos, l.pos );
+                default:
+                    return term_error( RT::ILL_FORMED_INTEGER, l.pos, begin );
+            }
+        }
+
+        if ( not m_zero and l.kind == OPERATOR ) {
+            m_after_op = true;
+            handler.operation( l.symbol );
+            m_expect_term = true;
+            return true;
+        }
+        // The expression ends here.
+        std::uint64_t at = m_zero ? m_zero_at : l.pos;
+        if ( m_depth == 0 ) {
+            if ( l.kind != END or m_zero )
+                return conclude( RT::EXTRANEOUS_SYMBOL, at );
+            return conclude( RT::OK, 0 );
+        }
+        if ( not m_zero and l.kind == CLOSE ) {
+            m_depth--;
+            handler.close();
+            return true;
+        }
+        // The "(" that is not closed is a term of the enclosing expression.
+        m_depth--;
+        return term_error( RT::MISSING_CLOSING, at, at );
+    }
+}
+
+#endif
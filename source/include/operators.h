@@ -0,0 +1,73 @@
+#ifndef _OPERATORS_H_
+#define _OPERATORS_H_
+
+#include <limits> // std::numeric_limits
+
+#include "parser.h"
+
+/// Checks whether a value fits in the integer type required by the BARES language.
+constexpr bool in_required_range( Parser::input_int_type value ) {
+    return value >= std::numeric_limits< Parser::required_int_type >::min() and
+           value <= std::numeric_limits< Parser::required_int_type >::max();
+}
+
+/**
+ * @brief Applies a binary operator of the BARES language to two operands.
+ *
+ * This is the arithmetic shared by every evaluation engine, so they all agree
+ * on the results and on the errors. Both operands must be within the range of
+ * Parser::required_int_type, which is always the case for literals and for
+ * the results of previous operations.
+ *
+ * The power operator follows the original definition: `x^0` is 1 and a
+ * negative exponent gives 0. The repeated multiplication stops as soon as the
+ * partial power leaves the valid range.
+ *
+ * @param op the operator: one of `+ - * / % ^`.
+ * @param a the first (left) operand.
+ * @param b the second (right) operand.
+ * @param result where the value is stored when the operation succeeds.
+ * @return OK, DIVISION_BY_ZERO (for `/` and `%` by zero) or OVERFLOW_ERROR
+ * (the result does not fit in Parser::required_int_type, or `op` is not an
+ * operator).
+ */
+constexpr Parser::ResultType::code_t apply_operator( char op, Parser::input_int_type a, Parser::input_int_type b,
+                                                     Parser::input_int_type & result ) {
+    switch ( op ) {
+        case '+': result = a + b; break;
+        case '-': result = a - b; break;
+        case '*': result = a * b; break;
+        case '/':
+            if ( b == 0 ) return Parser::ResultType::DIVISION_BY_ZERO;
+            result = a / b;
+            break;
+        case '%':
+            if ( b == 0 ) return Parser::ResultType::DIVISION_BY_ZERO;
+            result = a % b;
+            break;
+        case '^':
+            if ( b == 0 )
+                result = 1;
+            else if ( b < 0 )
+                result = 0;
+            else if ( a == 0 or a == 1 )
+                result = a;
+            else if ( a == -1 )
+                result = ( b % 2 == 0 ) ? 1 : -1;
+            else {
+                // |a| >= 2, so this overflows after a few steps at most.
+                result = a;
+                while ( --b > 0 ) {
+                    result *= a;
+                    if ( not in_required_range( result ) )
+                        return Parser::ResultType::OVERFLOW_ERROR;
+                }
+            }
+            break;
+        default: // Not an operator: `result` is left alone.
+            return Parser::ResultType::OVERFLOW_ERROR;
+    }
+    return in_required_range( result ) ? Parser::ResultType::OK : Parser::ResultType::OVERFLOW_ERROR;
+}
+
+#endif
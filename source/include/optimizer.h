@@ -0,0 +1,37 @@
+#ifndef _OPTIMIZER_H_
+#define _OPTIMIZER_H_
+
+#include <cstddef> // std::size_t
+
+#include "program.h"
+
+/// What the optimizer did to a program.
+struct OptimizerStats {
+    std::size_t folded = 0;     //!< Operations computed at compile time.
+    std::size_t simplified = 0; //!< Operations removed by an algebraic identity.
+    std::size_t failures = 0;   //!< Subtrees replaced by a FAIL instruction.
+};
+
+/**
+ * @brief Folds constants and applies safe algebraic identities to a program.
+ *
+ * An operation whose operands are both constant is computed once, with the
+ * same arithmetic as the evaluation (apply_operator()). When it fails, the
+ * whole computation that cannot get past it becomes a FAIL instruction with
+ * the same error code, placed so that the evaluation still stops at the
+ * first error in postfix order: folding never hides an OVERFLOW_ERROR or a
+ * DIVISION_BY_ZERO, nor reports one that the unfolded program would not.
+ *
+ * The identities `x*1`, `1*x`, `x/1`, `x^1`, `x+0`, `0+x` and `x-0` drop
+ * the operation and the constant, which is always safe since they can
+ * neither fail nor change `x`. Identities that would drop `x` itself (like
+ * `x*0`) are only applied when `x` is a variable (a LOAD), which cannot
+ * fail: `x*0`, `0*x`, `x%1`, `x%-1` and `x^0` become constants. When `x` is a
+ * computation, evaluating it could fail, so they are not applied.
+ *
+ * @param program the program, rewritten in place.
+ * @return what was done.
+ */
+OptimizerStats optimize( Program & program );
+
+#endif
@@ -0,0 +1,82 @@
+#ifndef _PARALLEL_TOKENIZER_H_
+#define _PARALLEL_TOKENIZER_H_
+
+#include <cstddef> // std::size_t
+#include <cstdint> // std::uint32_t
+#include <memory>  // std::unique_ptr
+#include <string>  // std::string
+#include <vector>  // std::vector
+
+#include "lexeme_validator.h"
+#include "parser.h"
+#include "../lib/work_stealing_pool.h"
+
+/// Validates and tokenizes huge single-line expressions with several threads.
+/*!
+ * Works in three passes over the line, which is cut into slices:
+ *
+ * 1. **Lexing, in parallel.** Each slice is turned into lexemes on its own.
+ *    The lexemes do not depend on the context: a run of digits, a single
+ *    symbol or an invalid character; white space only separates them.
+ * 2. **Validation, sequential.** Digit runs cut by a slice boundary are glued
+ *    back together. Then the lexemes (a few per token, much lighter than the
+ *    characters) go through lexemes::Validator, which reproduces the error
+ *    codes and columns of Parser exactly and marks the role of each minus.
+ * 3. **Tokens, in parallel.** Each slice writes its tokens directly into
+ *    their final positions, which come from a prefix sum of the number of
+ *    tokens per slice counted by the validation.
+ *
+ * The result, and the token list when it is OK, are the same as the ones of
+ * Parser::parse_and_tokenize().
+ */
+class ParallelTokenizer {
+    public:
+        /**
+         * @brief Creates the tokenizer and its pool.
+         * @param threads how many threads work, counting the caller.
+         * @param min_slice the smallest slice, in bytes, handed to a thread.
+         */
+        explicit ParallelTokenizer( unsigned threads, std::size_t min_slice = 64 * 1024 );
+
+        /**
+         * @brief Validates and tokenizes an expression.
+         * @param expr the expression.
+         * @param tokens receives the tokens (infix order) when the result is OK.
+         * @return the same result as Parser::parse_and_tokenize().
+         */
+        Parser::ResultType parse_and_tokenize( const std::string & expr, sc::vector< Token > & tokens );
+
+    private:
+        /// A piece of the line.
+        struct Lexeme {
+            std::size_t pos;      //!< Column of the first character.
+            std::uint32_t len;    //!< Number of characters (saturated, only digit runs are longer than 1).
+            lexemes::kind_t kind; //!< What it is, then its role.
+        };
+
+        /// A slice of the line, lexed and later tokenized by one task.
+        struct Slice : public ws::task {
+            ParallelTokenizer * self = nullptr;
+            std::size_t first = 0, last = 0;  //!< The characters [first, last).
+            std::vector< Lexeme > lexemes;    //!< Its lexemes, in order.
+            std::size_t skip = 0;             //!< Leading lexemes glued to the previous slice.
+            std::size_t first_token = 0;      //!< Index of its first token in the output.
+            std::size_t n_tokens = 0;         //!< How many tokens it produces.
+            bool tokenize = false;            //!< Pass 3 instead of pass 1.
+            void run(void) override { tokenize ? self->emit( *this ) : self->lex( *this ); }
+        };
+
+        void lex( Slice & s );
+        void emit( Slice & s );
+        void run_slices( bool tokenize );
+        Parser::ResultType validate(void);
+
+        ws::pool m_pool;                  //!< The threads.
+        std::size_t m_min_slice;          //!< Smallest slice, in bytes.
+        std::vector< std::unique_ptr< Slice > > m_slices; //!< The slices, kept with their storage between lines.
+        std::size_t m_n_slices = 0;       //!< How many of m_slices are in use.
+        const std::string * m_expr = nullptr; //!< The current line.
+        sc::vector< Token > * m_tokens = nullptr; //!< Where pass 3 writes.
+};
+
+#endif
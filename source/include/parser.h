@@ -5,6 +5,7 @@
 #include <iterator> // std::distance()
 #include <sstream>  // std::istringstream
 #include <cstddef>  // std::ptrdiff_t
+#include <cstdint>  // std::int64_t
 #include <limits>   // std::numeric_limits, para validar a faixa de um inteiro.
 #include <algorithm>// std::copy, para copiar substrings.
 #include <cctype>   // std::isspace()
@@ -12,28 +13,44 @@
 #include <algorithm>
 #include <cstdlib>
 #include <cstring>
+#include <string_view> // std::string_view, a view of the line being parsed.
 // #include <stack>
 
 #include "../lib/vector.h" // class vector
 #include "../lib/stack.h"  // class stack
 #include "token.h"         // struct Token.
 
+class SymbolTable;
+
 /// This class represents a parser that **validates** and **tokenizes** an expression.
 /*!
  * This class does two tasks:
  *
- * 1. It implements a recursive descendent parser that validates expressions according to a EBNF grammar.
+ * 1. It implements a descendent parser that validates expressions according to a EBNF grammar.
  * 2. While validating an expression, it also tokenizes the input expression into its components, creating a list of tokens.
  *
+ * The parser does not recurse: an expression inside parentheses is parsed by
+ * the same loop, and an explicit stack (on the heap) keeps one frame for each
+ * "(" still open, so any nesting depth fits. Errors are reported exactly as a
+ * recursive descent over the grammar would report them.
+ *
  * The grammar is:
  * ```
- *   <expr>            := <term>,{ ("+"|"-"),<term> };
- *   <term>            := <integer>;
+ *   <expr>            := <term>,{ ("+"|"-"|"*"|"/"|"%"|"^"),<term> };
+ *   <term>            := "(",<expr>,")" | <integer>;
  *   <integer>         := "0" | ["-"],<natural_number>;
  *   <natural_number>  := <digit_excl_zero>,{<digit>};
  *   <digit_excl_zero> := "1" | "2" | "3" | "4" | "5" | "6" | "7" | "8" | "9";
  *   <digit>           := "0"| <digit_excl_zero>;
  * ```
+ *
+ * With a symbol table (see set_symbols()), a term may also be a variable,
+ * which becomes a Token::token_t::VARIABLE:
+ * ```
+ *   <term>            := "(",<expr>,")" | <integer> | <identifier>;
+ *   <identifier>      := <letter>,{ <letter> | <digit> };
+ *   <letter>          := "a" | ... | "z" | "A" | ... | "Z" | "_";
+ * ```
  */
 class Parser
 {
@@ -42,7 +59,7 @@ class Parser
         struct ResultType
         {
             //=== Alias
-            typedef std::ptrdiff_t size_type; //!< Used for column location determination.
+            typedef std::int64_t size_type; //!< Used for column location determination (64 bits, for huge lines).
 
             /// List of possible syntax errors.
             enum code_t {
@@ -54,33 +71,72 @@ class Parser
                     INTEGER_OUT_OF_RANGE,
                     MISSING_CLOSING,
                     DIVISION_BY_ZERO,
-                    OVERFLOW_ERROR
+                    OVERFLOW_ERROR,
+                    LIMIT_EXCEEDED, //!< The expression needs more resources than its Limits allow.
+                    UNDEFINED_VARIABLE //!< An identifier that is not in the (closed) symbol table.
             };
 
+            /// Number of codes in code_t, handy to index per-code tables.
+            static constexpr int n_codes = UNDEFINED_VARIABLE + 1;
+
             //=== Members (public).
             code_t type;      //!< Error code.
             size_type at_col; //!< Stores the column number where the error happened.
 
             /// Default contructor.
-            explicit ResultType( code_t type_=OK , size_type col_=0u )
+            explicit constexpr ResultType( code_t type_=OK , size_type col_=0u )
                     : type{ type_ }
                     , at_col{ col_ }
             { /* empty */ }
+
+            /// Returns a short name for an error code, used in reports.
+            static const char * code_name( code_t code_ ) {
+                static const char * names[] = { "OK", "UNEXPECTED_END_OF_EXPRESSION", "ILL_FORMED_INTEGER",
+                                                "MISSING_TERM", "EXTRANEOUS_SYMBOL", "INTEGER_OUT_OF_RANGE",
+                                                "MISSING_CLOSING", "DIVISION_BY_ZERO", "OVERFLOW_ERROR",
+                                                "LIMIT_EXCEEDED", "UNDEFINED_VARIABLE" };
+                return names[ code_ ];
+            }
         };
 
         //==== Aliases
         typedef short int required_int_type; //!< The interger type we accept as valid for an expression.
         typedef long long int input_int_type; //!< The integer type that we read from the input, which should be larger than  he required integer range (so we can identify input errors).
 
+        /// Resources a single expression may use; the ones it exceeds make it a LIMIT_EXCEEDED.
+        /*!
+         * Every limit is checked by a counter in a loop that already exists,
+         * as soon as it is exceeded, so a hostile line costs at most its budget.
+         */
+        struct Limits {
+            static constexpr std::size_t unlimited = std::numeric_limits< std::size_t >::max();
+            std::size_t max_length = unlimited; //!< Characters of the line.
+            std::size_t max_tokens = unlimited; //!< Tokens of the line, parentheses included.
+            std::size_t max_depth = unlimited;  //!< Parentheses open at the same time.
+            std::size_t max_steps = unlimited;  //!< Instructions of the postfix expression, one per evaluation step.
+            std::size_t max_memory = unlimited; //!< Bytes of scratch storage: token lists and evaluation stacks.
+
+            /// Scratch bytes of each token: the infix and postfix lists, the operators stack and the operands stack.
+            static constexpr std::size_t bytes_per_token = 3 * sizeof( Token ) + sizeof( input_int_type );
+        };
+
         //==== Public interface
         /// Parses and tokenizes an input source expression.  Return the result as a struct.
-        ResultType parse_and_tokenize( std::string e_ );
+        ResultType parse_and_tokenize( const std::string & e_ );
+        /// Only validates an expression: the same result as parse_and_tokenize(), but no token is stored.
+        ResultType validate( const char * e_, std::size_t size_ );
         /// Retrieves the list of tokens created during the partins process.
-        sc::vector< Token > get_tokens( void ) const;
+        const sc::vector< Token > & get_tokens( void ) const;
+        /// Sets the resources each expression may use from now on.
+        void set_limits( const Limits & limits_ );
+        /// The resources each expression may use.
+        const Limits & get_limits( void ) const { return m_limits; }
+        /// Accepts variables, interned in `symbols_`; nullptr (the default) accepts integers only.
+        void set_symbols( SymbolTable * symbols_ ) { m_symbols = symbols_; }
 
         //==== Special methods
-        /// Default constructor
-        Parser() = default;
+        /// Default constructor, which preallocates the stack of open parentheses.
+        Parser();
         /// Default destructor
         ~Parser() = default;
         /// Turn off copy constructor. We do not need it.
@@ -101,6 +157,7 @@ class Parser
             TS_EXPO,	          //!< code for "^"
             TS_ZERO,              //!< code for "0"
             TS_NON_ZERO_DIGIT,    //!< code for digits, from "1" to "9"
+            TS_LETTER,            //!< code for letters and "_", which begin identifiers
             TS_WS,                //!< code for a white-space
             TS_TAB,               //!< code for tab
             TS_EOS,               //!< code for "End Of String"
@@ -108,16 +165,27 @@ class Parser
         };
 
         //==== Private members.
-        std::string m_expr;                     //!< The source expression to be parsed
-        std::string::iterator m_it_curr_symb;   //!< Pointer to the current char inside the expression.
-        std::string::iterator m_begin_token;    //!< Pointer to the beginning of the current candidate token.
+        std::string_view m_expr;                //!< The source expression to be parsed, owned by the caller.
+        std::string_view::const_iterator m_it_curr_symb; //!< Pointer to the current char inside the expression.
+        std::string_view::const_iterator m_begin_token;  //!< Pointer to the beginning of the current candidate token.
+        std::string m_name;                     //!< The last identifier, reusing its storage.
         sc::vector<Token> m_tk_list;           //!< Resulting list of tokens extracted from the expression.
         ResultType m_result;                    //!< The result for the current expression (either error of OK).
+        sta::stack<bool> m_frames;              //!< One frame per "(" still open: whether it came after an operator.
+        Limits m_limits;                        //!< The resources of each expression.
+        std::size_t m_max_tokens = Limits::unlimited; //!< Tokens allowed by both max_tokens and max_memory.
+        SymbolTable * m_symbols = nullptr;      //!< Where variables are interned, if they are accepted.
+        bool m_tokenize = true;                 //!< Whether the tokens are stored, or only counted (validate()).
+        std::size_t m_tokens = 0;               //!< Tokens of the expression so far.
+        std::size_t m_steps = 0;                //!< Operands and operators so far: the steps of its evaluation.
 
         //=== Support parser methods.
         void begin_token();                     //!< Begins the process of token formation, keeping track of the first character that makes up the token inside the input string.
         std::string complete_token();           //!< Ends the token formation, creating and returning the substring that started when we called begin_token().
         Parser::ResultType::size_type token_location();  //!< Returns the beginning of the token location inside the input string.
+        void emit( const char * value_, Token::token_t type_ ); //!< Stores a token of the expression, or only counts it.
+        input_int_type integer_value() const;   //!< The value of the integer token just accepted, saturated well out of range.
+        ResultType analyze( const char * e_, std::size_t size_ ); //!< Parses the expression, tokenizing it if m_tokenize.
 
         //=== Support parser methods.
         terminal_symbol_t lexer( char c_ ) const;// Get the corresponding code for a given input char.
@@ -128,10 +196,22 @@ class Parser
         void skip_ws( void );                    // Skips any WS/Tab ans stops at the next character.
         bool end_input( void ) const;            // Checks whether we reached the end of the expression string.
 
+        /// What happened when parsing a term.
+        enum class term_t {
+            INTEGER,  //!< An integer was tokenized.
+            VARIABLE, //!< A variable was tokenized.
+            OPEN,     //!< A "(" was accepted: a nested expression begins.
+            FAILED,   //!< Error, stored in m_result.
+            ABORTED   //!< Error stored in m_result, reported as it is whatever is open.
+        };
+
         //=== NTS methods.
+        bool within_limits();
         bool expression();
-        bool term();
+        term_t term();
+        bool unwind( bool after_operator );
         bool integer();
+        bool identifier();
         bool natural_number();
         bool digit_excl_zero();
         bool digit();
@@ -0,0 +1,89 @@
+#ifndef _PERFCOUNTERS_H_
+#define _PERFCOUNTERS_H_
+
+#include <cstdint>  // std::uint64_t
+#include <iostream> // std::istream, std::ostream
+
+/// Reads hardware performance counters of the calling thread.
+/*!
+ * The counters are opened as a single group with `perf_event_open(2)`, so
+ * one `read()` returns all of them at once and they are always scheduled
+ * together by the kernel. Counters that the CPU (or the hypervisor) does not
+ * provide are simply left out of the group; if the kernel denies access to
+ * all of them, available() returns false and only the wall clock time is
+ * measured.
+ *
+ * Each read() is a system call, which on short lines costs as much as the
+ * stages being measured; overhead() estimates that cost so that it can be
+ * taken out of the totals. When the kernel multiplexes the group with other
+ * events, the counts of each interval are scaled by the time enabled over the
+ * time running during that interval.
+ */
+class PerfCounters {
+    public:
+        /// The hardware events we are interested in.
+        enum event_t {
+            CYCLES = 0,    //!< CPU cycles.
+            INSTRUCTIONS,  //!< Retired instructions.
+            BRANCH_MISSES, //!< Mispredicted branches.
+            L1D_MISSES,    //!< L1 data cache read misses.
+            LLC_MISSES,    //!< Last level cache misses.
+            N_EVENTS
+        };
+
+        /// A snapshot (or a sum of differences between two snapshots) of all the counters.
+        struct Sample {
+            std::uint64_t values[N_EVENTS] = {}; //!< Counter values, indexed by event_t: raw in a snapshot, scaled in a sum.
+            std::uint64_t nanoseconds = 0;       //!< Wall clock time.
+            std::uint64_t enabled = 0;           //!< Time the group was enabled, from the kernel.
+            std::uint64_t running = 0;           //!< Time the group was counting, from the kernel.
+
+            /// Accumulates the difference between two snapshots, scaled up if the group was multiplexed between them.
+            void add_delta( const Sample & begin, const Sample & end );
+            /// Takes out `times` copies of `cost` (such as the cost of reading the counters), down to zero.
+            void subtract( const Sample & cost, std::uint64_t times );
+        };
+
+        /// Opens the counters. Returns false if none of them could be opened.
+        bool open(void);
+        /// Whether at least one hardware counter is being read.
+        bool available(void) const { return m_leader >= 0; }
+        /// Whether a given event is being counted.
+        bool counting( event_t event ) const { return m_index[event] >= 0; }
+        /// Why the counters could not be opened (an errno value), 0 if they were.
+        int error(void) const { return m_errno; }
+        /// Reads all the counters, their times enabled and running, and the wall clock into a snapshot.
+        void read( Sample & sample ) const;
+        /// The mean cost of one interval between two snapshots, from `reads` pairs of read().
+        Sample overhead( unsigned reads ) const;
+        /// Whether the kernel had to multiplex the group with other events.
+        bool multiplexed(void) const;
+
+        /// Returns a short name for an event, used in reports.
+        static const char * event_name( event_t event );
+
+        PerfCounters() = default;
+        /// Closes the counters.
+        ~PerfCounters();
+        PerfCounters( const PerfCounters & ) = delete;
+        PerfCounters & operator=( const PerfCounters & ) = delete;
+
+    private:
+        int m_fds[N_EVENTS] = { -1, -1, -1, -1, -1 };   //!< One file descriptor per event.
+        int m_index[N_EVENTS] = { -1, -1, -1, -1, -1 }; //!< Position of each event inside a group read.
+        int m_leader = -1; //!< File descriptor of the group leader.
+        int m_size = 0;    //!< Number of events in the group.
+        int m_errno = 0;   //!< Reason for failing to open the leader.
+};
+
+/**
+ * @brief Evaluates every line of the input, like the normal mode, and reports
+ * the hardware counters spent by each pipeline stage and by each class of
+ * expression (i.e. each ResultType code) to `report`.
+ * @param in the stream with one expression per line.
+ * @param report where the report is written.
+ * @return int the exit status of the program.
+ */
+int perf_counters_mode( std::istream & in, std::ostream & report );
+
+#endif
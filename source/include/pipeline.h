@@ -0,0 +1,62 @@
+#ifndef _PIPELINE_H_
+#define _PIPELINE_H_
+
+#include "parser.h"
+#include "checkpoint.h"
+
+/**
+ * @brief Evaluates the input with a reader/evaluators/writer pipeline.
+ *
+ * A reader thread reads large chunks of the input and splits them into
+ * batches of line views (no copy of the lines). The batches are evaluated by
+ * `evaluators` threads, each one with its own BaresManager, and a writer puts
+ * their outputs back in input order by sequence number. The stages are
+ * connected by bounded lock-free ring buffers, and the batches come from a
+ * fixed pool that is recycled by the writer: when the output is slow, the
+ * reader waits for a free batch, so memory use stays bounded.
+ *
+ * The output is exactly the one of the default mode.
+ *
+ * With a checkpoint file in `options`, the writer records how far the input
+ * is done (its byte offset and line number, and the size of the output)
+ * every `options.interval` seconds, right after writing and syncing the
+ * output of those lines. A run with `options.resume` set goes on from the
+ * recorded point: the input is moved there, and the output, which should be
+ * appended to, loses what was written after the checkpoint. The output of a
+ * run stopped and resumed is then the one of a run that was never stopped.
+ *
+ * @param in_fd the file descriptor the expressions are read from.
+ * @param out_fd the file descriptor the results are written to.
+ * @param evaluators how many evaluator threads.
+ * @param limits the resources each expression may use.
+ * @param options where and how often the checkpoints are recorded, if at all.
+ * @return int the exit status of the program.
+ */
+int pipeline_mode( int in_fd, int out_fd, unsigned evaluators, const Parser::Limits & limits = Parser::Limits{},
+                   const Checkpoint::Options & options = Checkpoint::Options{} );
+
+/**
+ * @brief Evaluates the input like pipeline_mode(), but writes only an aggregate of the results.
+ *
+ * Each evaluator folds the results of its batches into its own Aggregate,
+ * without sharing anything with the others; the partial aggregates are
+ * merged when the input ends, and only the merged one is written, in a few
+ * lines (see Aggregate::print()).
+ *
+ * With checkpoints (see pipeline_mode()), the results are folded by batch
+ * instead, and the writer merges them in input order, so that each
+ * checkpoint also holds the aggregate of exactly the lines done.
+ *
+ * @param in_fd the file descriptor the expressions are read from.
+ * @param out_fd the file descriptor the aggregate is written to.
+ * @param evaluators how many evaluator threads.
+ * @param what the parts of the aggregate that are written, from Aggregate::what_t.
+ * @param limits the resources each expression may use.
+ * @param options where and how often the checkpoints are recorded, if at all.
+ * @return int the exit status of the program.
+ */
+int aggregate_mode( int in_fd, int out_fd, unsigned evaluators, unsigned what,
+                    const Parser::Limits & limits = Parser::Limits{},
+                    const Checkpoint::Options & options = Checkpoint::Options{} );
+
+#endif
@@ -0,0 +1,72 @@
+#ifndef _PROGRAM_H_
+#define _PROGRAM_H_
+
+#include <cstdint> // std::uint8_t
+#include <vector>  // std::vector
+
+#include "parser.h"
+#include "symbol_table.h"
+
+/// A compiled expression: a flat list of instructions for a stack machine.
+/*!
+ * The instructions follow the postfix order of the tokens: a literal pushes
+ * a value, a binary operator pops two values and pushes its result. Unlike
+ * the token list, a program holds the values already converted, so it can be
+ * evaluated many times (and optimized, see optimize()) without going back to
+ * the text.
+ *
+ * The FAIL instruction stops the evaluation with an error code. It is put
+ * there by the optimizer in place of a computation known to fail, so that
+ * the program still reports the error at the same point of the evaluation.
+ *
+ * The LOAD instruction pushes the value of a variable, read from the array of
+ * values given to run() at the slot the symbol table gave its name. Names are
+ * resolved once, by compile(), so a program is evaluated against new values
+ * with no string work at all.
+ */
+struct Program {
+    /// The operation of an instruction.
+    enum opcode_t : std::uint8_t {
+        PUSH, //!< Pushes `value`.
+        ADD,  //!< "+"
+        SUB,  //!< "-"
+        MUL,  //!< "*"
+        DIV,  //!< "/"
+        MOD,  //!< "%"
+        POW,  //!< "^"
+        FAIL, //!< Stops with the error code in `value`.
+        LOAD  //!< Pushes the variable of slot `value`.
+    };
+
+    /// One step of the program.
+    struct Instruction {
+        opcode_t op;                  //!< What to do.
+        Parser::input_int_type value; //!< The literal of PUSH, the error code of FAIL or the slot of LOAD.
+    };
+
+    std::vector< Instruction > code; //!< The instructions, in evaluation order.
+
+    /// The opcode of an operator symbol (one of `+ - * / % ^`).
+    static opcode_t opcode( char symbol );
+    /// The operator symbol of a binary opcode.
+    static char symbol( opcode_t op );
+
+    /**
+     * @brief Compiles a (valid) postfix token list, replacing the current code.
+     * @param postfix the tokens produced by BaresManager::infix_to_postfix().
+     * @param symbols the table the variables of the tokens were interned in, if they have any.
+     */
+    void compile( const sc::vector< Token > & postfix, const SymbolTable * symbols = nullptr );
+
+    /**
+     * @brief Evaluates the program, with the semantics of BaresManager::calculate().
+     * @param value the value of the expression, when the result is OK.
+     * @param st scratch stack for the operands, reused between calls.
+     * @param values the value of each variable, indexed by slot (only read by LOAD).
+     * @return Parser::ResultType OK, DIVISION_BY_ZERO or OVERFLOW_ERROR.
+     */
+    Parser::ResultType run( Parser::required_int_type & value, sta::stack< Parser::input_int_type > & st,
+                            const Parser::required_int_type * values = nullptr ) const;
+};
+
+#endif
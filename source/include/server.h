@@ -0,0 +1,37 @@
+#ifndef _SERVER_H_
+#define _SERVER_H_
+
+#include "parser.h"
+
+/**
+ * @brief Serves expressions to local clients through a Unix domain socket.
+ *
+ * The protocol is newline framed, just like the standard input: a client
+ * writes one expression per line and reads back one line per expression (the
+ * value or the error message), in the same order. Clients may pipeline as
+ * many lines as they want without waiting for the replies.
+ *
+ * A single thread runs an `epoll` event loop that accepts clients, splits
+ * what they send into batches of lines and writes the replies back. The
+ * batches are evaluated by a fixed pool of workers, each one with its own
+ * BaresManager, whose storage is reused from batch to batch. Replies of a
+ * connection are put back in order before being written.
+ *
+ * Lines are always limited in length (by `limits.max_length`, or 16 MiB
+ * when it is not set): only the first bytes of a longer line are kept, and
+ * it gets a LIMIT_EXCEEDED reply, so a client that never sends a newline
+ * cannot make the server buffer without bound.
+ *
+ * The server stops on SIGINT or SIGTERM, removing the socket file. A socket
+ * file left by a server that is gone (a connection to it is refused) is
+ * replaced; while a server still listens on `path`, it is not touched and
+ * this one fails with EADDRINUSE.
+ *
+ * @param path where the socket is created.
+ * @param workers how many worker threads evaluate the expressions.
+ * @param limits the resources each expression may use, so a hostile line cannot hold a batch.
+ * @return int the exit status of the program.
+ */
+int serve_mode( const char * path, unsigned workers, const Parser::Limits & limits = Parser::Limits{} );
+
+#endif
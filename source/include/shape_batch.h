@@ -0,0 +1,91 @@
+#ifndef _SHAPE_BATCH_H_
+#define _SHAPE_BATCH_H_
+
+#include <cstddef>       // std::size_t
+#include <iostream>      // std::istream, std::ostream
+#include <string>        // std::string
+#include <unordered_map> // std::unordered_map
+#include <vector>        // std::vector
+
+#include "bares_manager.h"
+#include "columnar.h"
+
+/// A batch of lines evaluated one shape at a time.
+/*!
+ * Most lines of a file differ only in their literals: `12 + 3 * 4` and
+ * `7 + 9 * 2` compile to the same instructions, with other values in their
+ * PUSHes. add() parses and compiles each line and takes the sequence of its
+ * opcodes as its structural fingerprint (its shape). Lines with the same
+ * shape form a group, whose literals are kept as columns: the j-th literal
+ * of each line goes to the j-th column.
+ *
+ * evaluate() then turns each shape into one program whose j-th PUSH is a
+ * LOAD of the j-th column, and runs it once over all the lines of the group
+ * with the SIMD kernels of ColumnarProgram. The values and errors are
+ * scattered back to the lines, so print() writes them in the original order,
+ * exactly as parse_and_compute() would. Lines with a syntax error keep it.
+ */
+class ShapeBatch {
+    public:
+        /**
+         * @brief Parses and compiles a line, adding it to the group of its shape.
+         * @param expr the expression.
+         */
+        void add( const std::string & expr );
+
+        /// Evaluates every group; the results are then available, in the order of the lines.
+        void evaluate(void);
+
+        /**
+         * @brief Writes the result of each line, like BaresManager::print_result().
+         * @param os where the results are written.
+         */
+        void print( std::ostream & os );
+
+        /// Forgets the lines, keeping the storage for the next batch.
+        void clear(void);
+
+        /// How many lines the batch has.
+        std::size_t size(void) const { return m_status.size(); }
+        /// How many distinct shapes they have.
+        std::size_t shapes(void) const { return m_used; }
+
+        /// The result of a line, after evaluate().
+        const Parser::ResultType & status( std::size_t line ) const { return m_status[line]; }
+        /// The value of a line, meaningful when its status is OK.
+        Parser::required_int_type value( std::size_t line ) const { return m_values[line]; }
+
+    private:
+        /// The lines that have the same shape.
+        struct Group {
+            Program program;                                                //!< The shape, with LOADs for literals.
+            std::vector< std::vector< Parser::required_int_type > > columns; //!< The j-th literal of each line.
+            std::vector< std::size_t > lines;                               //!< The line of each row.
+        };
+
+        BaresManager m_bm;                                     //!< Parses and compiles the lines.
+        Program m_program;                                     //!< The program of the line being added.
+        std::string m_shape;                                   //!< Its fingerprint.
+        std::unordered_map< std::string, std::size_t > m_index; //!< The group of each shape.
+        std::vector< Group > m_groups;                         //!< The groups; the first `m_used` are in use.
+        std::size_t m_used = 0;                                //!< Groups of this batch.
+        std::vector< Parser::ResultType > m_status;            //!< The result of each line.
+        std::vector< Parser::required_int_type > m_values;     //!< The value of each line.
+
+        //=== Scratch storage of evaluate().
+        ColumnarProgram m_columnar;
+        std::vector< const Parser::required_int_type * > m_pointers;
+        std::vector< Parser::required_int_type > m_results;
+        std::vector< std::uint8_t > m_codes;
+};
+
+/**
+ * @brief Evaluates the input in batches of lines grouped by shape.
+ * @param is where the expressions are read from.
+ * @param os where the results are written, in the order of the lines.
+ * @param batch how many lines each batch has.
+ * @return int the exit status of the program.
+ */
+int shapes_mode( std::istream & is, std::ostream & os, std::size_t batch );
+
+#endif
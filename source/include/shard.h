@@ -0,0 +1,60 @@
+#ifndef _SHARD_H_
+#define _SHARD_H_
+
+#include <iostream> // std::ostream
+#include <string>   // std::string
+#include <vector>   // std::vector
+
+#include "parser.h"
+
+/**
+ * @brief Evaluates one of `count` shards of an input file, tagging each result with its line number.
+ *
+ * The file is cut into `count` byte ranges of about the same size, each
+ * moved forward to the beginning of a line: a line belongs to the shard
+ * whose range holds its first byte. The cuts depend only on the size and the
+ * bytes of the file, so processes that evaluate different shards of the same
+ * file never share a line nor miss one, without talking to each other.
+ *
+ * Each result is written as `LINE<TAB>RESULT`, where `LINE` is the number of
+ * the line in the whole file (counted from 1, from the newlines before the
+ * shard) and `RESULT` is what the default mode writes for it. The results are
+ * preceded by `#shard I/N FIRST`, the shard and the number of its first line,
+ * and followed by `#end END`, one past its last line (for shard `N-1`, the end
+ * of the file), so that merge_mode() can tell that every shard is there and
+ * finished when it puts their outputs back together.
+ *
+ * @param in_fd the input, which must be a regular file.
+ * @param os where the tagged results are written.
+ * @param index which shard, from 0 to `count - 1`.
+ * @param count how many shards.
+ * @param limits the resources each expression may use.
+ * @return int the exit status of the program.
+ */
+int shard_mode( int in_fd, std::ostream & os, unsigned long index, unsigned long count,
+                const Parser::Limits & limits = Parser::Limits{} );
+
+/**
+ * @brief Merges the outputs of shard_mode() back into the order of the input.
+ *
+ * The files are read together, and a heap keyed by line number picks the
+ * next line among their first unread ones (a k-way merge), so they may be
+ * given in any order. The tags are removed: the output is the one of the
+ * default mode over the whole input. Before anything is written, the first
+ * lines must name all the `N` shards of the same cut, each one once; at the
+ * end, each shard must have finished with all of its lines, and where a shard
+ * ends the next one must begin. Any other case (a shard left out, even the
+ * last one, given twice or cut short) is reported as an error.
+ *
+ * The output is streamed: the lines are written as they are merged, before
+ * the checks of the end. So a merge that fails on a shard cut short, a line
+ * missing or a malformed line may already have written part of the output;
+ * only the exit status tells whether it is whole.
+ *
+ * @param paths the outputs of the shards.
+ * @param os where the results are written.
+ * @return int the exit status of the program.
+ */
+int merge_mode( const std::vector< std::string > & paths, std::ostream & os );
+
+#endif
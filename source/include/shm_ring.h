@@ -0,0 +1,245 @@
+#ifndef _SHM_RING_H_
+#define _SHM_RING_H_
+
+#include <atomic>  // std::atomic
+#include <cstddef> // std::size_t
+#include <cstdint> // std::uint32_t, std::uint64_t
+#include <string>  // std::string
+
+#include "parser.h"
+
+/// The layout of the shared memory region, seen by `bares` and by the producers.
+/*!
+ * The region holds, one after the other:
+ *
+ * 1. a Header;
+ * 2. the request ring: `slots` request cells, each with a Request and
+ *    room for `slot_size` bytes of expression right after it;
+ * 3. one ResponseRing per producer, each with `slots` Response cells
+ *    right after it.
+ *
+ * Every ring is D. Vyukov's bounded queue (as rb::mpmc_ring), with the
+ * cells in place: each cell has a sequence number telling whether it may be
+ * written or read in the current lap, so the producers of a ring only
+ * compete for its write index with a compare-and-swap, and its consumers for
+ * its read index. The request ring has many producers (the producer
+ * processes) and many consumers (the workers of `bares`); each response ring
+ * has many producers (the workers) and one consumer (its producer process).
+ *
+ * The sequence numbers, positions and futex words are lock-free (so address
+ * free) `std::atomic`s; the rest of a cell is published by its sequence
+ * number, with release and acquire ordering. A side that has nothing to do sleeps on a futex word of the
+ * ring it waits for, after announcing it in a counter of sleepers; the other
+ * side bumps the futex word after each publish and only makes the
+ * `futex(FUTEX_WAKE)` system call when someone sleeps.
+ */
+namespace shm {
+    const std::uint32_t magic = 0x53455242;  //!< "BRES", first word of a region.
+    const std::uint32_t version = 2;         //!< Layout version.
+
+    /// The beginning of the region.
+    struct Header {
+        std::uint32_t magic;     //!< shm::magic once the region is ready.
+        std::uint32_t version;   //!< shm::version.
+        std::uint32_t producers; //!< Response rings, one per producer.
+        std::uint32_t slots;     //!< Cells of each ring, a power of two.
+        std::uint32_t slot_size; //!< Bytes of expression each request cell holds.
+        std::int32_t owner;      //!< Process of the server, to tell a region left behind from one in use.
+        alignas(64) std::atomic< std::uint32_t > stop;       //!< Set when `bares` stops serving.
+        alignas(64) std::atomic< std::uint64_t > write_pos;  //!< Next request cell to be claimed by a producer.
+        alignas(64) std::atomic< std::uint64_t > read_pos;   //!< Next request cell to be taken by a worker.
+        alignas(64) std::atomic< std::uint32_t > requests;   //!< Futex word, bumped after each request.
+        std::atomic< std::uint32_t > sleeping;               //!< Workers asleep on `requests`.
+    };
+
+    /// A request cell; the expression follows it.
+    struct Request {
+        std::atomic< std::uint64_t > seq; //!< Lap of the cell.
+        std::uint64_t tag;                //!< Chosen by the producer, copied to the response.
+        std::uint32_t producer;           //!< Which response ring gets the response.
+        std::uint32_t length;             //!< Bytes of the expression.
+        /// The expression, in place.
+        char * text(void) { return reinterpret_cast< char * >( this + 1 ); }
+    };
+
+    /// The response ring of a producer; its cells follow it.
+    struct ResponseRing {
+        alignas(64) std::atomic< std::uint32_t > attached;  //!< Whether a producer uses this ring.
+        alignas(64) std::atomic< std::uint64_t > write_pos; //!< Next cell to be claimed by a worker.
+        alignas(64) std::atomic< std::uint64_t > read_pos;  //!< Next cell to be read by the producer.
+        alignas(64) std::atomic< std::uint32_t > responses; //!< Futex word, bumped after each response.
+        std::atomic< std::uint32_t > sleeping;              //!< Whether the producer sleeps on `responses`.
+    };
+
+    /// A response cell.
+    struct alignas(64) Response {
+        std::atomic< std::uint64_t > seq;   //!< Lap of the cell.
+        std::uint64_t tag;                  //!< The tag of the request.
+        std::int64_t column;                //!< Where the error is, as in Parser::ResultType.
+        std::uint32_t code;                 //!< A Parser::ResultType::code_t.
+        Parser::required_int_type value;    //!< The value, when the code is OK.
+    };
+
+    static_assert( std::atomic< std::uint32_t >::is_always_lock_free and std::atomic< std::uint64_t >::is_always_lock_free,
+                   "the rings need address free atomics" );
+    static_assert( sizeof( std::atomic< std::uint32_t > ) == sizeof( std::uint32_t ), "a futex word is 32 bits" );
+
+    /// The sizes of a region and where its parts are: each side keeps its own copy.
+    struct Layout {
+        std::uint32_t producers;   //!< Response rings.
+        std::uint32_t slots;       //!< Cells of each ring, a power of two.
+        std::uint32_t slot_size;   //!< Bytes of expression each request cell holds.
+        std::size_t request_cell;  //!< Bytes of a request cell with its text.
+        std::size_t response_ring; //!< Bytes of a response ring with its cells.
+        std::size_t total;         //!< Bytes of the region.
+
+        Layout( std::uint32_t producers, std::uint32_t slots, std::uint32_t slot_size );
+    };
+}
+
+/// The side of `bares`: creates the region and evaluates the requests in it.
+/*!
+ * Each worker takes requests from the ring and evaluates their text where
+ * the producer wrote it, with its own StreamingParser, which needs no copy
+ * of the line; the cell goes back to the producers only afterwards. The
+ * result goes to the response ring of the producer of the request.
+ *
+ * The producers may write anywhere in the region, so the server never reads
+ * the sizes back from the Header, which it only writes: every address comes
+ * from its own Layout, and a request's length and producer are checked
+ * against it.
+ */
+class ShmServer {
+    public:
+        /**
+         * @brief Creates the region.
+         *
+         * It fails, with `errno` set to EEXIST, while a server that is still
+         * running uses the name; a region left by a server that is gone is
+         * replaced.
+         * @param name the POSIX shared memory name, such as "/bares".
+         * @param producers how many producers may be attached at the same time.
+         * @param slots cells of each ring; rounded up to a power of two.
+         * @param slot_size the longest expression a request may hold.
+         */
+        ShmServer( const std::string & name, std::uint32_t producers, std::uint32_t slots, std::uint32_t slot_size );
+        /// Unmaps and removes the region.
+        ~ShmServer();
+
+        ShmServer( const ShmServer & ) = delete;
+        ShmServer & operator=( const ShmServer & ) = delete;
+
+        /// Whether the region was created.
+        bool ready(void) const { return m_header != nullptr; }
+
+        /**
+         * @brief Evaluates requests with `workers` threads until stop() is called.
+         * @param workers how many worker threads.
+         */
+        void run( unsigned workers );
+
+        /// Makes run() return, waking up the workers that sleep.
+        void stop(void);
+
+    private:
+        void work(void);
+
+        std::string m_name;               //!< The shared memory name.
+        shm::Header * m_header = nullptr; //!< The mapped region.
+        shm::Layout m_layout;             //!< Where its parts are.
+};
+
+/// The side of a producer: writes requests in place and reads their responses.
+/*!
+ * A producer claims a free response ring when it attaches. It may have at
+ * most `slots` requests without a response read (in_flight()), so a worker
+ * always finds room for a response in its ring.
+ */
+class ShmClient {
+    public:
+        /// The response to a request.
+        struct Response {
+            std::uint64_t tag;               //!< The tag given to commit().
+            Parser::ResultType result;       //!< What happened with the expression.
+            Parser::required_int_type value; //!< Its value, when the result is OK.
+        };
+
+        ShmClient() : m_layout{ 0, 1, 0 } {}
+        /// Detaches, if attached.
+        ~ShmClient();
+
+        ShmClient( const ShmClient & ) = delete;
+        ShmClient & operator=( const ShmClient & ) = delete;
+
+        /**
+         * @brief Maps the region and claims a response ring.
+         * @param name the POSIX shared memory name given to `bares`.
+         * @return whether the region exists and a ring was free.
+         */
+        bool attach( const std::string & name );
+
+        /**
+         * @brief Releases the response ring and unmaps the region.
+         *
+         * The responses to the requests in flight are read and dropped first
+         * (unless `bares` stopped), so none of them reaches the next producer
+         * of the ring; a cell given by reserve() is sent empty, for no one.
+         */
+        void detach(void);
+
+        /// The longest expression a request holds.
+        std::size_t max_length(void) const { return m_layout.slot_size; }
+        /// Requests without a response read yet.
+        std::size_t in_flight(void) const { return m_in_flight; }
+
+        /**
+         * @brief Claims a request cell, waiting while the ring is full.
+         * @return where to write the expression (up to max_length() bytes), or nullptr when `slots`
+         *         requests are already in flight, or when `bares` stopped.
+         */
+        char * reserve(void);
+
+        /**
+         * @brief Hands the cell claimed by reserve() to the workers.
+         * @param length bytes written in the cell.
+         * @param tag any number, given back in the response.
+         */
+        void commit( std::size_t length, std::uint64_t tag );
+
+        /**
+         * @brief Copies an expression into a request cell and commits it.
+         * @return whether it was sent: false when it is too long, or when reserve() fails.
+         */
+        bool submit( const char * expr, std::size_t length, std::uint64_t tag );
+
+        /// Reads a response, if there is one.
+        bool try_receive( Response & response );
+
+        /**
+         * @brief Reads a response, sleeping until there is one.
+         * @return false when nothing is in flight, or when `bares` stopped.
+         */
+        bool receive( Response & response );
+
+    private:
+        shm::Header * m_header = nullptr;     //!< The mapped region.
+        shm::ResponseRing * m_ring = nullptr; //!< The response ring claimed.
+        std::uint32_t m_id = 0;                  //!< Its index.
+        shm::Layout m_layout;                    //!< Where the parts of the region are.
+        shm::Request * m_claimed = nullptr;   //!< The cell given by reserve().
+        std::uint64_t m_claimed_pos = 0;         //!< Its position in the ring.
+        std::size_t m_in_flight = 0;             //!< Requests without a response read.
+};
+
+/**
+ * @brief Serves producers through a shared memory region until SIGINT or SIGTERM.
+ * @param name the POSIX shared memory name.
+ * @param workers how many worker threads.
+ * @param producers how many producers may be attached at the same time.
+ * @param slots cells of each ring.
+ * @param slot_size the longest expression a request may hold.
+ * @return int the exit status of the program.
+ */
+int shm_mode( const char * name, unsigned workers, std::uint32_t producers, std::uint32_t slots, std::uint32_t slot_size );
+
+#endif
@@ -0,0 +1,92 @@
+#ifndef _STREAMING_PARSER_H_
+#define _STREAMING_PARSER_H_
+
+#include <cstddef>  // std::size_t
+#include <cstdint>  // std::uint64_t
+#include <iostream> // std::ostream
+#include <vector>   // std::vector
+
+#include "lexeme_validator.h"
+#include "parser.h"
+
+/// Validates and evaluates a line that arrives in pieces, without keeping it.
+/*!
+ * The line is fed in chunks of any size. Each character goes through a small
+ * lexer (only the run of digits being read is remembered) and each lexeme
+ * through lexemes::Validator, which needs no memory of the line to report
+ * the errors of Parser, with the same codes and columns. The columns are
+ * 64-bit offsets from the beginning of the line.
+ *
+ * While the line is valid, it is also evaluated on the fly by operator
+ * precedence, with the stacks of operands and pending operators. Those
+ * stacks only hold what is still open, so the memory depends on the nesting
+ * depth of the expression, not on the size of the line. The first division
+ * by zero or overflow stops the evaluation, but it is reported only if the
+ * rest of the line is valid, as BaresManager does.
+ */
+class StreamingParser {
+    public:
+        /// Starts a new line.
+        void reset(void);
+
+        /**
+         * @brief Feeds the next piece of the line.
+         * @param data the characters, without the end of line.
+         * @param size how many.
+         */
+        void feed( const char * data, std::size_t size );
+
+        /**
+         * @brief Ends the line.
+         * @param value the value of the expression, when the result is OK.
+         * @return the result of Parser::parse_and_tokenize() followed by BaresManager::calculate().
+         */
+        Parser::ResultType finish( Parser::required_int_type & value );
+
+        /// Characters fed since reset().
+        std::uint64_t size(void) const { return m_pos; }
+        /// Most entries the evaluation stacks held since reset(): the memory the line needed.
+        std::size_t peak(void) const { return m_peak; }
+
+    private:
+        typedef lexemes::Lexeme Lexeme;
+
+        void lexeme( const Lexeme & l );
+
+        //=== Evaluation.
+        void push_value( Parser::input_int_type value );
+        void push_operator( char op );
+        void open_group(void);
+        void close_group(void);
+        bool reduce(void);
+
+        //=== Lexer.
+        std::uint64_t m_pos = 0;  //!< Column of the next character.
+        bool m_in_digits = false; //!< Whether m_digits is being read.
+        Lexeme m_digits{};        //!< The run of digits being read.
+
+        //=== Validation.
+        lexemes::Validator m_validator; //!< Knows the syntax error, once there is one.
+
+        //=== Evaluation.
+        Parser::ResultType::code_t m_eval = Parser::ResultType::OK; //!< The first evaluation error.
+        std::vector< Parser::input_int_type > m_values; //!< Operands.
+        std::vector< char > m_ops;                      //!< Pending operators and "(".
+        std::size_t m_peak = 0;
+};
+
+/**
+ * @brief Evaluates the input line by line, reading it in chunks of a fixed size.
+ *
+ * No line is ever held in memory, so lines of any length are evaluated with
+ * memory proportional to their nesting depth. The output is the one of the
+ * default mode.
+ *
+ * @param in_fd the file descriptor the expressions are read from.
+ * @param os where the results are written.
+ * @param chunk the size of each read, in bytes.
+ * @return int the exit status of the program.
+ */
+int streaming_mode( int in_fd, std::ostream & os, std::size_t chunk );
+
+#endif
@@ -0,0 +1,57 @@
+#ifndef _SYMBOL_TABLE_H_
+#define _SYMBOL_TABLE_H_
+
+#include <cstddef>       // std::size_t
+#include <string>        // std::string
+#include <unordered_map> // std::unordered_map
+#include <vector>        // std::vector
+
+/// The variables of a set of expressions, each one with a dense slot.
+/*!
+ * The first name interned gets slot 0, the next one slot 1, and so on, so the
+ * values of the variables are a flat array indexed by slot: the bindings of a
+ * compiled expression. Names are only looked up when an expression is parsed
+ * and compiled; the evaluation just reads `values[slot]`.
+ *
+ * A closed table no longer grows: a name it does not have is an undefined
+ * variable. That is what callers that already know every variable want (the
+ * array of values has a fixed size); templates that declare their variables by
+ * using them leave it open.
+ */
+class SymbolTable {
+    public:
+        /// What find() and intern() return for a name without a slot.
+        static constexpr std::size_t npos = static_cast< std::size_t >( -1 );
+
+        /**
+         * @brief The slot of a name, given a new one if the table is open.
+         * @param name the identifier.
+         * @return its slot, or npos if the table is closed and does not have it.
+         */
+        std::size_t intern( const std::string & name );
+
+        /**
+         * @brief The slot of a name.
+         * @param name the identifier.
+         * @return its slot, or npos.
+         */
+        std::size_t find( const std::string & name ) const;
+
+        /// The name of a slot.
+        const std::string & name( std::size_t slot ) const { return m_names[ slot ]; }
+        /// Number of slots, which is the size the array of values needs.
+        std::size_t size(void) const { return m_names.size(); }
+        /// Stops (or, with false, resumes) giving slots to new names.
+        void close( bool closed = true ) { m_closed = closed; }
+        /// Whether new names are undefined variables.
+        bool closed(void) const { return m_closed; }
+        /// Forgets every name, and opens the table.
+        void clear(void);
+
+    private:
+        std::unordered_map< std::string, std::size_t > m_slots; //!< Slot of each name.
+        std::vector< std::string > m_names;                     //!< Name of each slot.
+        bool m_closed = false;                                  //!< Whether new names are refused.
+};
+
+#endif
@@ -0,0 +1,80 @@
+#ifndef _THREADED_VM_H_
+#define _THREADED_VM_H_
+
+#include <cstddef> // std::size_t
+#include <cstdint> // std::uint8_t
+#include <vector>  // std::vector
+
+#include "program.h"
+
+/// A compiled program pre-decoded for a direct-threaded interpreter.
+/*!
+ * compile() turns the instructions of a Program into an array of decoded
+ * instructions, each one holding the address of the code that executes it.
+ * With GCC and Clang that address is a label of the interpreter (labels as
+ * values), so each instruction ends jumping straight to the next one, with no
+ * central `switch`; other compilers get a `switch` over the same array.
+ *
+ * Common pairs of instructions are fused into superinstructions, saving one
+ * dispatch each:
+ * - a literal followed by an operator (`x 3 *` runs as `x *3`);
+ * - a `* / %` whose result feeds a `+ -` (`a b c * +` runs as `a b c *+`).
+ *
+ * The top of the stack is kept in a local variable, so most instructions
+ * touch memory only for their other operand. The rest of the stack is sized
+ * by compile(), so run() does not allocate.
+ *
+ * The results and the errors are the ones of Program::run(): the evaluation
+ * stops at the first division by zero or overflow, in postfix order.
+ */
+class ThreadedProgram {
+    public:
+        /// Whether the interpreter dispatches by computed goto (otherwise by `switch`).
+        static bool threaded(void);
+
+        /**
+         * @brief Decodes a program, replacing the previous one.
+         * @param program the program (optimized or not).
+         */
+        void compile( const Program & program );
+
+        /**
+         * @brief Evaluates the decoded program.
+         * @param value the value of the expression, when the result is OK.
+         * @param values the value of each variable, indexed by slot (see Program::LOAD).
+         * @return Parser::ResultType OK, DIVISION_BY_ZERO or OVERFLOW_ERROR.
+         */
+        Parser::ResultType run( Parser::required_int_type & value, const Parser::required_int_type * values = nullptr );
+
+        /// Number of decoded instructions (including the final HALT).
+        std::size_t size(void) const { return m_code.size(); }
+        /// How many of them are superinstructions.
+        std::size_t fused(void) const { return m_fused; }
+
+    private:
+        /// The operation of a decoded instruction.
+        enum kind_t : std::uint8_t {
+            PUSH, ADD, SUB, MUL, DIV, MOD, POW, LOAD,       //!< As in Program.
+            ADD_K, SUB_K, MUL_K, DIV_K, MOD_K, POW_K,       //!< Literal + operator: `top op value`.
+            MUL_ADD, MUL_SUB, DIV_ADD, DIV_SUB, MOD_ADD, MOD_SUB, //!< Operator + operator.
+            FAIL,                                           //!< Stops with the error code in `value`.
+            HALT,                                           //!< The top of the stack is the value.
+            N_KINDS
+        };
+
+        /// One decoded instruction.
+        struct Op {
+            const void * handler;         //!< Where its code is (computed goto only).
+            Parser::input_int_type value; //!< The literal, the error code of FAIL or the slot of LOAD.
+            kind_t kind;                  //!< What it does.
+        };
+
+        static Parser::ResultType execute( const Op * ip, Parser::input_int_type * sp, const Parser::required_int_type * values,
+                                           Parser::required_int_type & value, const void * const ** labels );
+
+        std::vector< Op > m_code;                      //!< The decoded program.
+        std::vector< Parser::input_int_type > m_stack; //!< The stack below the top, sized for the program.
+        std::size_t m_fused = 0;                       //!< Superinstructions in m_code.
+};
+
+#endif
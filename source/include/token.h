@@ -20,6 +20,7 @@ struct Token
             OPERATOR,              //!< A type representing  "+", "-", "*", "/", "%", "^"
             OPEN_PARENTHESES,      //!< A type representing a "("
             CLOSE_PARENTHESES,     //!< A type representing ")"
+            VARIABLE,              //!< A type representing an identifier, whose value is bound when evaluating.
         };
 
         std::string value; //!< The token value as a string.
@@ -34,7 +35,7 @@ struct Token
         /// Just to help us debug the code.
         friend std::ostream & operator<<( std::ostream& os_, const Token & t_ )
         {
-            std::string types[] = { "OPERAND", "OPERATOR", "OPEN_PARENTHESIS", "CLOSE_PARENTHESIS" };
+            std::string types[] = { "OPERAND", "OPERATOR", "OPEN_PARENTHESIS", "CLOSE_PARENTHESIS", "VARIABLE" };
 
             os_ << "<" << t_.value << "," << types[(int)(t_.type)] << ">";
 
@@ -0,0 +1,220 @@
+#ifndef _RING_BUFFER_H_
+#define _RING_BUFFER_H_
+
+#include <atomic>   // std::atomic
+#include <cstddef>  // std::size_t
+#include <memory>   // std::unique_ptr
+#include <thread>   // std::this_thread::yield
+#include <chrono>   // std::chrono::microseconds
+#include <stdexcept>// std::invalid_argument
+
+/// Bounded lock-free ring buffers namespace.
+namespace rb {
+
+    /// Waits a little longer each time it is called: spins, then yields, then sleeps.
+    /*!
+     * Used by the blocking operations, so an idle stage does not burn a whole
+     * core while the pipeline is blocked elsewhere (e.g. on a slow output pipe).
+     */
+    class backoff
+    {
+        public:
+            /// Waits for a while.
+            void pause(void)
+            {
+                if ( m_count < 64 ) { /* spin */ }
+                else if ( m_count < 1024 ) std::this_thread::yield();
+                else std::this_thread::sleep_for( std::chrono::microseconds(50) );
+                m_count++;
+            }
+        private:
+            unsigned m_count = 0; //!< How many times we have waited.
+    };
+
+    /// A ring buffer for exactly one producer thread and one consumer thread.
+    /**
+     * @brief The producer only writes the tail and the consumer only writes the
+     * head, so no read-modify-write atomic is needed. Each index lives in its
+     * own cache line.
+     *
+     * @tparam T the type of the elements, which should be cheap to copy (e.g. a pointer).
+     */
+    template <typename T>
+    class spsc_ring
+    {
+        public:
+            using size_type = std::size_t; //!< The size type.
+
+            /**
+             * @brief Creates a ring buffer.
+             * @param capacity how many elements it holds; must be a power of two.
+             */
+            explicit spsc_ring( size_type capacity )
+                : m_mask {capacity - 1},
+                  m_storage {new T[capacity]} {
+                if ( capacity == 0 or (capacity & m_mask) != 0 )
+                    throw std::invalid_argument("spsc_ring(): capacity must be a power of two");
+            }
+
+            /**
+             * @brief Adds an element, if there is room for it. Producer only.
+             * @return true if the element was added.
+             */
+            bool try_push( const T & element )
+            {
+                size_type tail = m_tail.load( std::memory_order_relaxed );
+                if ( tail - m_head.load( std::memory_order_acquire ) > m_mask )
+                    return false; // Full.
+                m_storage[tail & m_mask] = element;
+                m_tail.store( tail + 1, std::memory_order_release );
+                return true;
+            }
+
+            /**
+             * @brief Removes the oldest element, if there is one. Consumer only.
+             * @return true if an element was removed.
+             */
+            bool try_pop( T & element )
+            {
+                size_type head = m_head.load( std::memory_order_relaxed );
+                if ( head == m_tail.load( std::memory_order_acquire ) )
+                    return false; // Empty.
+                element = m_storage[head & m_mask];
+                m_head.store( head + 1, std::memory_order_release );
+                return true;
+            }
+
+            /// Adds an element, waiting while the ring is full.
+            void push( const T & element )
+            {
+                backoff wait;
+                while ( not try_push( element ) ) wait.pause();
+            }
+
+            /// Removes the oldest element, waiting while the ring is empty.
+            T pop(void)
+            {
+                T element;
+                backoff wait;
+                while ( not try_pop( element ) ) wait.pause();
+                return element;
+            }
+
+        private:
+            alignas(64) std::atomic<size_type> m_head {0}; //!< Next position to be read.
+            alignas(64) std::atomic<size_type> m_tail {0}; //!< Next position to be written.
+            alignas(64) size_type m_mask;                  //!< Capacity minus one.
+            std::unique_ptr<T[]> m_storage;                //!< The elements.
+    };
+
+    /// A ring buffer for any number of producer and consumer threads.
+    /**
+     * @brief Each cell carries a sequence number telling whether it is ready to
+     * be written or to be read in the current lap around the ring, so producers
+     * and consumers only compete for their own index with a compare-and-swap
+     * (D. Vyukov's bounded MPMC queue).
+     *
+     * @tparam T the type of the elements, which should be cheap to copy (e.g. a pointer).
+     */
+    template <typename T>
+    class mpmc_ring
+    {
+        public:
+            using size_type = std::size_t; //!< The size type.
+
+            /**
+             * @brief Creates a ring buffer.
+             * @param capacity how many elements it holds; must be a power of two.
+             */
+            explicit mpmc_ring( size_type capacity )
+                : m_mask {capacity - 1},
+                  m_cells {new cell[capacity]} {
+                if ( capacity == 0 or (capacity & m_mask) != 0 )
+                    throw std::invalid_argument("mpmc_ring(): capacity must be a power of two");
+                for ( size_type i {0}; i < capacity; i++ )
+                    m_cells[i].sequence.store( i, std::memory_order_relaxed );
+            }
+
+            /**
+             * @brief Adds an element, if there is room for it.
+             * @return true if the element was added.
+             */
+            bool try_push( const T & element )
+            {
+                size_type pos = m_tail.load( std::memory_order_relaxed );
+                for (;;) {
+                    cell & c = m_cells[pos & m_mask];
+                    size_type seq = c.sequence.load( std::memory_order_acquire );
+                    auto diff = static_cast<std::ptrdiff_t>( seq - pos );
+                    if ( diff == 0 ) {
+                        // The cell is free in this lap: try to claim it.
+                        if ( m_tail.compare_exchange_weak( pos, pos + 1, std::memory_order_relaxed ) ) {
+                            c.value = element;
+                            c.sequence.store( pos + 1, std::memory_order_release );
+                            return true;
+                        }
+                    }
+                    else if ( diff < 0 )
+                        return false; // Full.
+                    else
+                        pos = m_tail.load( std::memory_order_relaxed );
+                }
+            }
+
+            /**
+             * @brief Removes the oldest element, if there is one.
+             * @return true if an element was removed.
+             */
+            bool try_pop( T & element )
+            {
+                size_type pos = m_head.load( std::memory_order_relaxed );
+                for (;;) {
+                    cell & c = m_cells[pos & m_mask];
+                    size_type seq = c.sequence.load( std::memory_order_acquire );
+                    auto diff = static_cast<std::ptrdiff_t>( seq - (pos + 1) );
+                    if ( diff == 0 ) {
+                        // The cell was written in this lap: try to claim it.
+                        if ( m_head.compare_exchange_weak( pos, pos + 1, std::memory_order_relaxed ) ) {
+                            element = c.value;
+                            c.sequence.store( pos + m_mask + 1, std::memory_order_release );
+                            return true;
+                        }
+                    }
+                    else if ( diff < 0 )
+                        return false; // Empty.
+                    else
+                        pos = m_head.load( std::memory_order_relaxed );
+                }
+            }
+
+            /// Adds an element, waiting while the ring is full.
+            void push( const T & element )
+            {
+                backoff wait;
+                while ( not try_push( element ) ) wait.pause();
+            }
+
+            /// Removes the oldest element, waiting while the ring is empty.
+            T pop(void)
+            {
+                T element;
+                backoff wait;
+                while ( not try_pop( element ) ) wait.pause();
+                return element;
+            }
+
+        private:
+            /// A position of the ring.
+            struct cell {
+                std::atomic<size_type> sequence; //!< Lap stamp of the cell.
+                T value;                         //!< The element.
+            };
+
+            alignas(64) std::atomic<size_type> m_head {0}; //!< Next position to be read.
+            alignas(64) std::atomic<size_type> m_tail {0}; //!< Next position to be written.
+            alignas(64) size_type m_mask;                  //!< Capacity minus one.
+            std::unique_ptr<cell[]> m_cells;               //!< The cells.
+    };
+}
+
+#endif
@@ -174,6 +174,27 @@ namespace sta {
                 return m_end == 0;
             };
 
+            /**
+             * @brief Removes all the elements, keeping the storage for later use.
+             */
+            void clear(void)
+            {
+                m_end = 0;
+            };
+
+            /**
+             * @brief Makes room for at least new_capacity elements, so the next pushes do not allocate.
+             * @param new_capacity the number of elements the storage must hold.
+             */
+            void reserve(size_type new_capacity)
+            {
+                if (new_capacity <= m_capacity) return;
+                std::unique_ptr<T[]> new_storage {new T[new_capacity]};
+                std::copy(begin(), end(), new_storage.get());
+                m_storage = std::move(new_storage);
+                m_capacity = new_capacity;
+            };
+
             /**
              * @brief Get the stack size.
              * @return size_type the number of elements stored on the stack.
@@ -124,7 +124,7 @@ namespace sc {
             virtual ~vector( void ) {};
             vector( const vector & vec) 
                 : m_end {vec.m_end},
-                  m_capacity {vec.m_capacity},
+                  m_capacity {vec.m_end},
                   m_storage {new T[m_end]} {
                 std::copy(vec.cbegin(), vec.cend(), m_storage.get());
             };
@@ -169,14 +169,15 @@ namespace sc {
              */
             vector & operator=( const vector & vec ) {
                 if ( this != &vec ) {
-                    if ( m_capacity != vec.m_capacity ) {
+                    // Only reallocates when the current storage is not enough.
+                    if ( m_capacity < vec.m_end ) {
                         m_storage.reset();
-                        m_storage = std::unique_ptr<T[]>( new T[vec.m_capacity] );
+                        m_storage = std::unique_ptr<T[]>( new T[vec.m_end] );
+                        m_capacity = vec.m_end;
                     }
                     std::copy(vec.cbegin(), vec.cend(), m_storage.get());
 
                     m_end = vec.m_end;
-                    m_capacity = vec.m_capacity;
                 }
 
                 return *this;
@@ -0,0 +1,219 @@
+#ifndef _WORK_STEALING_POOL_H_
+#define _WORK_STEALING_POOL_H_
+
+#include <atomic>             // std::atomic
+#include <condition_variable> // std::condition_variable
+#include <deque>              // std::deque
+#include <memory>             // std::unique_ptr
+#include <mutex>              // std::mutex
+#include <thread>             // std::thread
+#include <vector>             // std::vector
+
+#include "ring_buffer.h"      // rb::backoff
+
+/// Fork-join thread pool namespace.
+namespace ws {
+
+    /// A piece of work that can be spawned in a pool and waited for.
+    class task
+    {
+        public:
+            virtual ~task() = default;
+            /// The work itself.
+            virtual void run(void) = 0;
+            /// Whether the task has finished.
+            bool done(void) const { return m_done.load( std::memory_order_acquire ); }
+
+        private:
+            friend class pool;
+            std::atomic<bool> m_done {false}; //!< Set after run() returns.
+    };
+
+    /// A fork-join pool where idle threads steal work from the busy ones.
+    /**
+     * @brief Each thread owns a deque of tasks: it pushes and pops its own
+     * tasks at the back (the most recent, still hot in cache, first) while
+     * the other threads steal from the front (the oldest, usually the largest
+     * pieces of work). A thread that waits for a task keeps running other
+     * tasks meanwhile, so waiting never blocks the pool.
+     *
+     * The thread that calls run() takes part in the work as thread 0; the
+     * other ones sleep when there is nothing to do.
+     */
+    class pool
+    {
+        public:
+            /**
+             * @brief Creates the pool.
+             * @param threads how many threads work, counting the one that calls run().
+             */
+            explicit pool( unsigned threads )
+            {
+                if ( threads == 0 ) threads = 1;
+                for ( unsigned i {0}; i < threads; i++ )
+                    m_queues.emplace_back( new queue );
+                for ( unsigned i {1}; i < threads; i++ )
+                    m_threads.emplace_back( &pool::loop, this, i );
+            }
+
+            /// Stops and joins the threads.
+            ~pool()
+            {
+                {
+                    std::lock_guard<std::mutex> lock {m_sleep_mutex};
+                    m_stop.store( true );
+                }
+                m_sleep_cv.notify_all();
+                for ( auto & t : m_threads ) t.join();
+            }
+
+            pool( const pool & ) = delete;
+            pool & operator=( const pool & ) = delete;
+
+            /// How many threads work, counting the caller of run().
+            unsigned size(void) const { return m_queues.size(); }
+
+            /**
+             * @brief Runs `f` in the calling thread, which works as thread 0 meanwhile.
+             * Only one thread may call run() at a time.
+             */
+            template <typename F>
+            void run( F && f )
+            {
+                current() = worker_id{ this, 0 };
+                f();
+                current() = worker_id{};
+            }
+
+            /**
+             * @brief Makes a task available to the pool. Must be called from
+             * inside run() or from a task, and the task must be waited for.
+             * A task may be spawned again once it was waited for.
+             */
+            void spawn( task & t )
+            {
+                t.m_done.store( false, std::memory_order_relaxed );
+                queue & q = *m_queues[ index() ];
+                {
+                    std::lock_guard<std::mutex> lock {q.mutex};
+                    q.tasks.push_back( &t );
+                }
+                {
+                    // Taking the lock makes sure a thread going to sleep sees the task.
+                    std::lock_guard<std::mutex> lock {m_sleep_mutex};
+                    m_pending.fetch_add( 1, std::memory_order_release );
+                }
+                m_sleep_cv.notify_one();
+            }
+
+            /// Waits for a task, running this or other tasks meanwhile.
+            void wait( task & t )
+            {
+                rb::backoff idle;
+                while ( not t.done() ) {
+                    task * other;
+                    if ( try_get( index(), other ) ) {
+                        execute( other );
+                        idle = rb::backoff{};
+                    }
+                    else idle.pause();
+                }
+            }
+
+        private:
+            /// The tasks of a thread.
+            struct queue {
+                std::mutex mutex;          //!< Protects the deque.
+                std::deque<task *> tasks;  //!< Owner uses the back, thieves the front.
+            };
+
+            /// Which pool a thread works for, and its position there.
+            struct worker_id {
+                pool * owner = nullptr;
+                unsigned index = 0;
+            };
+
+            /// The identity of the calling thread.
+            static worker_id & current(void)
+            {
+                static thread_local worker_id id;
+                return id;
+            }
+
+            /// The position of the calling thread in this pool.
+            unsigned index(void) const
+            {
+                return current().owner == this ? current().index : 0;
+            }
+
+            /// Takes a task: our own newest one, or else the oldest one of another thread.
+            bool try_get( unsigned self, task *& t )
+            {
+                if ( m_pending.load( std::memory_order_acquire ) <= 0 )
+                    return false;
+                {
+                    queue & q = *m_queues[self];
+                    std::lock_guard<std::mutex> lock {q.mutex};
+                    if ( not q.tasks.empty() ) {
+                        t = q.tasks.back();
+                        q.tasks.pop_back();
+                        m_pending.fetch_sub( 1, std::memory_order_relaxed );
+                        return true;
+                    }
+                }
+                for ( unsigned k {1}; k < m_queues.size(); k++ ) {
+                    queue & q = *m_queues[ (self + k) % m_queues.size() ];
+                    std::lock_guard<std::mutex> lock {q.mutex};
+                    if ( not q.tasks.empty() ) {
+                        t = q.tasks.front();
+                        q.tasks.pop_front();
+                        m_pending.fetch_sub( 1, std::memory_order_relaxed );
+                        return true;
+                    }
+                }
+                return false;
+            }
+
+            /// Runs a task and flags it as done.
+            void execute( task * t )
+            {
+                t->run();
+                t->m_done.store( true, std::memory_order_release );
+            }
+
+            /// What the background threads do.
+            void loop( unsigned self )
+            {
+                current() = worker_id{ this, self };
+                rb::backoff idle;
+                unsigned misses {0};
+                while ( not m_stop.load( std::memory_order_acquire ) ) {
+                    task * t;
+                    if ( try_get( self, t ) ) {
+                        execute( t );
+                        idle = rb::backoff{};
+                        misses = 0;
+                    }
+                    else if ( ++misses < 256 )
+                        idle.pause();
+                    else {
+                        // Nothing to do for a while: sleep until something is spawned.
+                        std::unique_lock<std::mutex> lock {m_sleep_mutex};
+                        m_sleep_cv.wait( lock, [this] {
+                            return m_stop.load() or m_pending.load() > 0;
+                        } );
+                        misses = 0;
+                    }
+                }
+            }
+
+            std::vector<std::unique_ptr<queue>> m_queues; //!< One deque per thread.
+            std::vector<std::thread> m_threads;           //!< The background threads.
+            std::atomic<long> m_pending {0};              //!< Tasks waiting in the deques.
+            std::atomic<bool> m_stop {false};             //!< Tells the threads to finish.
+            std::mutex m_sleep_mutex;                     //!< Used to sleep when idle.
+            std::condition_variable m_sleep_cv;           //!< Wakes up idle threads.
+    };
+}
+
+#endif
@@ -0,0 +1,78 @@
+#include <algorithm> // std::min, std::max
+
+#include "../include/aggregate.h"
+
+/// Reads the names between the commas, one at a time.
+bool Aggregate::parse_list( const std::string & list, unsigned & what ) {
+    static const struct { const char * name; what_t bit; } names[] = {
+        { "sum", SUM }, { "min", MIN }, { "max", MAX }, { "count", COUNT }, { "hist", HIST } };
+    what = 0;
+    std::size_t begin{0};
+    for ( ;; ) {
+        std::size_t end = std::min( list.find( ',', begin ), list.size() );
+        const std::string name = list.substr( begin, end - begin );
+        bool known{false};
+        for ( const auto & n : names )
+            if ( name == n.name ) {
+                what |= n.bit;
+                known = true;
+            }
+        if ( not known ) return false;
+        if ( end == list.size() ) return true;
+        begin = end + 1;
+    }
+}
+
+void Aggregate::merge( const Aggregate & other ) {
+    for ( int code{0}; code < Parser::ResultType::n_codes; code++ )
+        m_codes[ code ] += other.m_codes[ code ];
+    m_sum += other.m_sum;
+    m_min = std::min( m_min, other.m_min );
+    m_max = std::max( m_max, other.m_max );
+    for ( std::size_t b{0}; b < hist_bins; b++ )
+        m_hist[ b ] += other.m_hist[ b ];
+}
+
+void Aggregate::save( std::ostream & os ) const {
+    for ( auto count : m_codes ) os << count << ' ';
+    os << m_sum << ' ' << m_min << ' ' << m_max;
+    for ( auto count : m_hist ) os << ' ' << count;
+    os << '\n';
+}
+
+bool Aggregate::load( std::istream & is ) {
+    Aggregate state;
+    for ( auto & count : state.m_codes ) is >> count;
+    is >> state.m_sum >> state.m_min >> state.m_max;
+    for ( auto & count : state.m_hist ) is >> count;
+    if ( not is ) return false;
+    *this = state;
+    return true;
+}
+
+void Aggregate::print( std::ostream & os, unsigned what ) const {
+    const unsigned long long values = m_codes[ Parser::ResultType::OK ];
+    if ( what & COUNT )
+        os << "count: " << values << "\n";
+    if ( what & SUM )
+        os << "sum: " << m_sum << "\n";
+    if ( what & MIN ) {
+        os << "min: ";
+        if ( values > 0 ) os << m_min << "\n";
+        else os << "-\n";
+    }
+    if ( what & MAX ) {
+        os << "max: ";
+        if ( values > 0 ) os << m_max << "\n";
+        else os << "-\n";
+    }
+    if ( what & HIST )
+        for ( std::size_t b{0}; b < hist_bins; b++ )
+            if ( m_hist[ b ] > 0 )
+                os << "hist [" << lowest + long( b ) * bin_width << ", " << lowest + long( b + 1 ) * bin_width - 1
+                   << "]: " << m_hist[ b ] << "\n";
+    for ( int code{1}; code < Parser::ResultType::n_codes; code++ )
+        if ( m_codes[ code ] > 0 )
+            os << Parser::ResultType::code_name( static_cast< Parser::ResultType::code_t >( code ) ) << ": "
+               << m_codes[ code ] << "\n";
+}
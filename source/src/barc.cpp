@@ -0,0 +1,284 @@
+#include <cstring>       // std::memcpy, std::memcmp
+#include <fstream>       // std::ifstream, std::ofstream
+#include <limits>        // std::numeric_limits
+#include <stdexcept>     // std::length_error
+#include <unordered_map> // std::unordered_map
+
+#include <fcntl.h>    // ::open
+#include <sys/mman.h> // mmap, munmap
+#include <sys/stat.h> // fstat
+#include <unistd.h>   // ::close
+
+#include "../include/barc.h"
+#include "../include/bares_manager.h"
+#include "../include/operators.h"
+#include "../include/optimizer.h"
+
+namespace {
+    /// The next multiple of 8.
+    std::uint64_t align( std::uint64_t n ) { return ( n + 7 ) & ~std::uint64_t{7}; }
+
+    /// Appends a section to the image, at an aligned offset, returning the offset.
+    template < typename T >
+    std::uint64_t append( std::vector< char > & image, const T * data, std::size_t count ) {
+        image.resize( align( image.size() ) );
+        std::uint64_t offset = image.size();
+        image.resize( offset + count * sizeof( T ) );
+        if ( count > 0 ) std::memcpy( image.data() + offset, data, count * sizeof( T ) );
+        return offset;
+    }
+
+    /// Whether a section of `count` items of `size` bytes fits in the file at `offset`.
+    bool fits( std::uint64_t offset, std::uint64_t count, std::uint64_t size, std::uint64_t file_size ) {
+        return offset % 8 == 0 and offset <= file_size and count <= ( file_size - offset ) / size;
+    }
+}
+
+std::vector< char > barc::compile( std::istream & in, bool optimize_programs ) {
+    const std::uint32_t limit = std::numeric_limits< std::uint32_t >::max();
+    BaresManager bm;
+    Program program;
+    std::vector< Record > records;
+    std::vector< std::uint32_t > code;
+    std::vector< std::int32_t > literals;
+    std::unordered_map< std::int32_t, std::uint32_t > pool; // Index of each literal in `literals`.
+    std::string source;
+    std::uint32_t max_depth{0};
+
+    std::string line;
+    while ( std::getline( in, line ) ) {
+        if ( line.size() > limit or records.size() == limit )
+            throw std::length_error( "too many expressions for a .barc file" );
+        Record r{ source.size(), static_cast< std::uint32_t >( line.size() ), static_cast< std::uint32_t >( code.size() ),
+                  0, Parser::ResultType::OK, 0 };
+        source += line;
+        Parser::ResultType result = bm.parse( line );
+        if ( result.type != Parser::ResultType::OK ) {
+            r.status = result.type;
+            r.at_col = result.at_col;
+            records.push_back( r );
+            continue;
+        }
+        bm.infix_to_postfix();
+        bm.compile( program );
+        if ( optimize_programs )
+            optimize( program );
+        if ( program.code.size() > limit - code.size() )
+            throw std::length_error( "too many instructions for a .barc file" );
+
+        std::uint32_t depth{0};
+        for ( const Program::Instruction & ins : program.code ) {
+            std::uint32_t operand{0};
+            if ( ins.op == Program::PUSH ) {
+                auto it = pool.emplace( static_cast< std::int32_t >( ins.value ), literals.size() ).first;
+                if ( it->second == literals.size() )
+                    literals.push_back( it->first );
+                operand = it->second;
+            }
+            else if ( ins.op == Program::FAIL )
+                operand = static_cast< std::uint32_t >( ins.value );
+            depth += ( ins.op == Program::PUSH or ins.op == Program::FAIL ) ? 1 : -1;
+            if ( depth > max_depth ) max_depth = depth;
+            code.push_back( ins.op | ( operand << 8 ) );
+        }
+        r.code_size = static_cast< std::uint32_t >( program.code.size() );
+        records.push_back( r );
+    }
+
+    Header h{};
+    std::memcpy( h.magic, magic, sizeof( magic ) );
+    h.version = version;
+    h.flags = optimize_programs ? optimized : 0;
+    h.n_records = static_cast< std::uint32_t >( records.size() );
+    h.n_instructions = static_cast< std::uint32_t >( code.size() );
+    h.n_literals = static_cast< std::uint32_t >( literals.size() );
+    h.max_depth = max_depth;
+
+    std::vector< char > image( sizeof( Header ) );
+    h.records_offset = append( image, records.data(), records.size() );
+    h.code_offset = append( image, code.data(), code.size() );
+    h.literals_offset = append( image, literals.data(), literals.size() );
+    h.source_offset = append( image, source.data(), source.size() );
+    h.source_size = source.size();
+    h.file_size = image.size();
+    std::memcpy( image.data(), &h, sizeof( h ) );
+    return image;
+}
+
+barc::File::~File() {
+    close();
+}
+
+void barc::File::close(void) {
+    if ( m_data != nullptr )
+        munmap( const_cast< char * >( m_data ), m_size );
+    m_data = nullptr;
+    m_size = 0;
+    m_header = nullptr;
+}
+
+bool barc::File::open( const char * path, std::string & error ) {
+    close();
+    int fd = ::open( path, O_RDONLY );
+    if ( fd < 0 ) {
+        error = "cannot open the file";
+        return false;
+    }
+    struct stat st;
+    if ( fstat( fd, &st ) != 0 or st.st_size < static_cast< off_t >( sizeof( Header ) ) ) {
+        ::close( fd );
+        error = "not a .barc file (too short)";
+        return false;
+    }
+    void * data = mmap( nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0 );
+    ::close( fd ); // The mapping stays valid.
+    if ( data == MAP_FAILED ) {
+        error = "cannot map the file";
+        return false;
+    }
+    m_data = static_cast< const char * >( data );
+    m_size = st.st_size;
+    if ( not check( error ) ) {
+        close();
+        return false;
+    }
+    return true;
+}
+
+/// Checks everything evaluate() relies on, so that it never reads out of the mapping.
+bool barc::File::check( std::string & error ) {
+    const std::uint16_t one{1};
+    if ( *reinterpret_cast< const unsigned char * >( &one ) != 1 ) {
+        error = ".barc files are little-endian";
+        return false;
+    }
+    m_header = reinterpret_cast< const Header * >( m_data );
+    const Header & h = *m_header;
+    if ( std::memcmp( h.magic, magic, sizeof( magic ) ) != 0 ) {
+        error = "not a .barc file (bad magic)";
+        return false;
+    }
+    if ( h.version != version ) {
+        error = "unsupported .barc version " + std::to_string( h.version );
+        return false;
+    }
+    if ( h.file_size != m_size or not fits( h.records_offset, h.n_records, sizeof( Record ), m_size ) or
+         not fits( h.code_offset, h.n_instructions, sizeof( std::uint32_t ), m_size ) or
+         not fits( h.literals_offset, h.n_literals, sizeof( std::int32_t ), m_size ) or
+         not fits( h.source_offset, h.source_size, 1, m_size ) ) {
+        error = "truncated or corrupted .barc file (sections)";
+        return false;
+    }
+    m_records = reinterpret_cast< const Record * >( m_data + h.records_offset );
+    m_code = reinterpret_cast< const std::uint32_t * >( m_data + h.code_offset );
+    m_literals = reinterpret_cast< const std::int32_t * >( m_data + h.literals_offset );
+
+    for ( std::uint32_t i{0}; i < h.n_literals; i++ )
+        if ( not in_required_range( m_literals[i] ) ) {
+            error = "corrupted .barc file (literal out of range)";
+            return false;
+        }
+    std::uint32_t max_depth{0};
+    for ( std::uint32_t i{0}; i < h.n_records; i++ ) {
+        const Record & r = m_records[i];
+        const bool syntax_error = r.status != Parser::ResultType::OK;
+        if ( r.source_begin > h.source_size or r.source_size > h.source_size - r.source_begin or
+             r.code_begin > h.n_instructions or r.code_size > h.n_instructions - r.code_begin or
+             r.status > Parser::ResultType::MISSING_CLOSING or syntax_error != ( r.code_size == 0 ) ) {
+            error = "corrupted .barc file (record " + std::to_string( i ) + ")";
+            return false;
+        }
+        // The program must be a well formed postfix expression.
+        std::uint32_t depth{0};
+        for ( std::uint32_t k{ r.code_begin }; k < r.code_begin + r.code_size; k++ ) {
+            const std::uint32_t op = m_code[k] & 0xFF, operand = m_code[k] >> 8;
+            bool valid{true};
+            if ( op == Program::PUSH ) valid = operand < h.n_literals;
+            else if ( op == Program::FAIL )
+                valid = operand == Parser::ResultType::DIVISION_BY_ZERO or operand == Parser::ResultType::OVERFLOW_ERROR;
+            else valid = op <= Program::POW and depth >= 2;
+            if ( not valid ) {
+                error = "corrupted .barc file (program " + std::to_string( i ) + ")";
+                return false;
+            }
+            depth += ( op == Program::PUSH or op == Program::FAIL ) ? 1 : -1;
+            if ( depth > max_depth ) max_depth = depth;
+        }
+        if ( not syntax_error and depth != 1 ) {
+            error = "corrupted .barc file (program " + std::to_string( i ) + ")";
+            return false;
+        }
+    }
+    m_stack.assign( max_depth + 1, 0 );
+    return true;
+}
+
+std::string_view barc::File::source( std::size_t i ) const {
+    const Record & r = m_records[i];
+    return std::string_view{ m_data + m_header->source_offset + r.source_begin, r.source_size };
+}
+
+/// Runs a program from the mapping, like Program::run().
+Parser::ResultType barc::File::evaluate( std::size_t i, Parser::required_int_type & value ) {
+    const Record & r = m_records[i];
+    if ( r.status != Parser::ResultType::OK )
+        return Parser::ResultType{ static_cast< Parser::ResultType::code_t >( r.status ), r.at_col };
+    Parser::input_int_type * sp = m_stack.data();
+    for ( const std::uint32_t * ip = m_code + r.code_begin, * end = ip + r.code_size; ip != end; ip++ ) {
+        const Program::opcode_t op = static_cast< Program::opcode_t >( *ip & 0xFF );
+        if ( op == Program::PUSH ) {
+            *sp++ = m_literals[ *ip >> 8 ];
+            continue;
+        }
+        if ( op == Program::FAIL )
+            return Parser::ResultType{ static_cast< Parser::ResultType::code_t >( *ip >> 8 ) };
+        Parser::input_int_type second_operand = *--sp;
+        Parser::ResultType::code_t code = apply_operator( Program::symbol( op ), sp[-1], second_operand, sp[-1] );
+        if ( code != Parser::ResultType::OK )
+            return Parser::ResultType{ code };
+    }
+    value = static_cast< Parser::required_int_type >( sp[-1] );
+    return Parser::ResultType{ Parser::ResultType::OK };
+}
+
+int compile_mode( const char * in_path, const char * out_path, bool optimize ) {
+    std::ifstream in{ in_path };
+    if ( not in ) {
+        std::cerr << "Cannot open \"" << in_path << "\"\n";
+        return EXIT_FAILURE;
+    }
+    std::vector< char > image;
+    try {
+        image = barc::compile( in, optimize );
+    }
+    catch ( const std::length_error & e ) {
+        std::cerr << "Cannot compile \"" << in_path << "\": " << e.what() << "\n";
+        return EXIT_FAILURE;
+    }
+    std::ofstream out{ out_path, std::ios::binary | std::ios::trunc };
+    if ( not out.write( image.data(), image.size() ) ) {
+        std::cerr << "Cannot write \"" << out_path << "\"\n";
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
+
+int run_mode( const char * path, std::ostream & os ) {
+    barc::File file;
+    std::string error;
+    if ( not file.open( path, error ) ) {
+        std::cerr << "Cannot load \"" << path << "\": " << error << "\n";
+        return EXIT_FAILURE;
+    }
+    BaresManager bm; // Only for its error messages.
+    for ( std::size_t i{0}; i < file.size(); i++ ) {
+        Parser::required_int_type value{0};
+        Parser::ResultType result = file.evaluate( i, value );
+        if ( result.type == Parser::ResultType::OK )
+            os << value << '\n';
+        else
+            bm.print_error_msg( result, std::string{ file.source( i ) }, os );
+    }
+    os.flush();
+    return EXIT_SUCCESS;
+}
@@ -3,6 +3,8 @@
 
 #include "../lib/vector.h"
 #include "../include/bares_manager.h"
+#include "../include/operators.h"
+#include "../include/optimizer.h"
 
 /// List of expressions to evaluate and tokenize.
 sc::vector<std::string> expressions = {
@@ -26,47 +28,52 @@ sc::vector<std::string> expressions = {
 };
 
 /// Send to the standard output the proper error messages.
-void BaresManager::print_error_msg( const Parser::ResultType & result, const std::string &str ) {
-    std::string error_indicator( str.size()+1, ' ');
-
-    // Have we got a parsing error?
-    error_indicator[result.at_col] = '^';
+void BaresManager::print_error_msg( const Parser::ResultType & result, const std::string &str, std::ostream &os ) {
+    //? Have we got a parsing error?
+    // std::string error_indicator( str.size()+1, ' ');
+    // error_indicator[result.at_col] = '^';
     switch ( result.type ) {
         case Parser::ResultType::UNEXPECTED_END_OF_EXPRESSION:
-            std::cout << "Unexpected end of input at column (" << result.at_col+1 << ")!\n";
+            os << "Unexpected end of input at column (" << result.at_col+1 << ")!\n";
             break;
         case Parser::ResultType::ILL_FORMED_INTEGER:
-            std::cout << "Ill formed integer at column (" << result.at_col+1 << ")!\n";
+            os << "Ill formed integer at column (" << result.at_col+1 << ")!\n";
             break;
         case Parser::ResultType::MISSING_TERM:
-            std::cout << "Missing <term> at column (" << result.at_col+1 << ")!\n";
+            os << "Missing <term> at column (" << result.at_col+1 << ")!\n";
             break;
         case Parser::ResultType::EXTRANEOUS_SYMBOL:
-            std::cout << "Extraneous symbol after valid expression found at column (" << result.at_col+1 << ")!\n";
+            os << "Extraneous symbol after valid expression found at column (" << result.at_col+1 << ")!\n";
             break;
         case Parser::ResultType::INTEGER_OUT_OF_RANGE:
-            std::cout << "Integer constant out of range beginning at column (" << result.at_col+1 << ")!\n";
+            os << "Integer constant out of range beginning at column (" << result.at_col+1 << ")!\n";
             break;
         case Parser::ResultType::MISSING_CLOSING:
-            std::cout << "Missing closing \")\" at column (" << result.at_col+1 << ")!\n";
+            os << "Missing closing \")\" at column (" << result.at_col+1 << ")!\n";
             break;
         case Parser::ResultType::DIVISION_BY_ZERO:
-            std::cout << "Division by zero!\n";
+            os << "Division by zero!\n";
             break;
         case Parser::ResultType::OVERFLOW_ERROR:
-            std::cout << "Numeric overflow error!\n";
+            os << "Numeric overflow error!\n";
+            break;
+        case Parser::ResultType::LIMIT_EXCEEDED:
+            os << "Resource limit exceeded at column (" << result.at_col+1 << ")!\n";
+            break;
+        case Parser::ResultType::UNDEFINED_VARIABLE:
+            os << "Undefined variable at column (" << result.at_col+1 << ")!\n";
             break;
         default:
-            std::cout << "Unhandled error found!\n";
+            os << "Unhandled error found!\n";
             break;
     }
     //? Indicate the column of error.
-    // std::cout << "\"" << str << "\"\n";
-    // std::cout << " " << error_indicator << std::endl;
+    // os << "\"" << str << "\"\n";
+    // os << " " << error_indicator << std::endl;
 }
 
 /// Function to return precedence of operators
-int BaresManager::prec(std::string c) {
+int BaresManager::prec(const std::string &c) {
     if (c == "^")
         return 3;
     else if (c == "/" || c == "*" || c == "%")
@@ -80,15 +87,16 @@ int BaresManager::prec(std::string c) {
 /// The main function to convert infix expression
 /// to postfix expression
 void BaresManager::infix_to_postfix(void) {
-    sta::stack<Token> st; // For stack operations
-    sc::vector<Token> pf_tk_list;
+    sta::stack<Token> &st = op_stack; // For stack operations
+    st.clear();
+    pf_tk_list.clear();
 
     for (size_t i{0}; i < tokens.size(); i++) {
-        Token c = tokens[i];
+        const Token &c = tokens[i];
 
         // If the scanned character is
         // an operand, add it to output string.
-        if (c.type == Token::token_t::OPERAND)
+        if (c.type == Token::token_t::OPERAND or c.type == Token::token_t::VARIABLE)
             pf_tk_list.push_back(c);
 
         // If the scanned character is an
@@ -124,30 +132,24 @@ void BaresManager::infix_to_postfix(void) {
         st.pop();
     }
 
-    tokens = pf_tk_list;
+    // Exchange the storages instead of copying the tokens.
+    swap(tokens, pf_tk_list);
 }
 
 /// Function that calculates the postfix expression
 void BaresManager::calculate(void) {
-    sta::stack<Parser::input_int_type> st; // The stack to store the operands.
-    Parser::input_int_type result{0}; // The result of expression;
+    sta::stack<Parser::input_int_type> &st = operands; // The stack to store the operands.
+    st.clear();
+    Parser::input_int_type result{0}; // The result of each operation.
 
     // Travels the tokens to calculate the expression.
     for (size_t i{0}; i < tokens.size(); i++) {
-        Token c = tokens[i];
-        // transform std::string to char[]
-        // to use atoll and switch
-        size_t sz = c.value.length();
-        // declaring character array
-        char c_value[sz + 1];
-        // copying the contents of the
-        // string to char array
-        std::strcpy(c_value, c.value.c_str());
+        const Token &c = tokens[i];
 
         // If it is an operand, transform in int and push on the stack.
         if (c.type == Token::token_t::OPERAND) {
             // transform in int and push on the stack.
-            Parser::input_int_type value = std::atoll(c_value);
+            Parser::input_int_type value = std::atoll(c.value.c_str());
             st.push(value);
         }
         // If it is an operator, pop twice on stack and calculate the expression.
@@ -157,66 +159,86 @@ void BaresManager::calculate(void) {
             st.pop();
             Parser::input_int_type first_operand = st.top();
             st.pop();
-            // To avoid special cases of operations with 0.
-            if ( second_operand == 0 and (c_value[0] == '/' or c_value[0] == '%') ) {
-                status = Parser::ResultType{ Parser::ResultType::DIVISION_BY_ZERO };
-            }
-            else {
-                // Decide the operation that will be made.
-                switch (c_value[0]) {
-                    case '+':  result = first_operand + second_operand; break;
-                    case '-':  result = first_operand - second_operand; break;
-                    case '*':  result = first_operand * second_operand; break;
-                    case '/':  result = first_operand / second_operand; break;
-                    case '%':  result = first_operand % second_operand; break;
-                    case '^':
-                        // Calculate the exception of x^0 = 1
-                        if (second_operand == 0)
-                            result = 1;
-                        else if (second_operand < 0)
-                            result = 0;
-                        else {
-                            Parser::input_int_type expo = first_operand;
-                            while (second_operand != 1) {
-                                expo *= first_operand;
-                                second_operand--;
-                            }
-                            result = expo;
-                        }
-                }
-                // We did a calculation, did it generate an overflow?
-                if ( result < std::numeric_limits< Parser::required_int_type >::min() or
-                    result > std::numeric_limits< Parser::required_int_type >::max() ) {
-                    // Overflow occurred, stop the loop.
-                    break;
-                }
+            // Calculate; a division by zero or an overflow stops the calculation.
+            Parser::ResultType::code_t code = apply_operator( c.value[0], first_operand, second_operand, result );
+            if ( code != Parser::ResultType::OK ) {
+                status = Parser::ResultType{ code };
+                return;
             }
             // Insert the result on the top of stack.
             st.push(result);
         }
     }
-    // Case of one operand is passed.
-    if (st.size() == 1) {
-        result = st.top();
-        st.pop();
-    }
-    
-    // We calculate the result, just know if it is within the range (overflow occurred).
-    if ( result < std::numeric_limits< Parser::required_int_type >::min() or
-         result > std::numeric_limits< Parser::required_int_type >::max() ) {
-        // Overflow occurred, report error.
-        status = Parser::ResultType{ Parser::ResultType::OVERFLOW_ERROR };
-    }
-    else {
-        final_value = result;
-    }
+    // The value of the expression is the only one left on the stack.
+    final_value = st.top();
 }
 
-/// Reads a line and compute a expression.
-void BaresManager::parse_and_compute(std::string expr) {
-    Parser parser; // Instancia um parser.
+/// Calculates the postfix expression on the threads of a fork-join engine.
+void BaresManager::calculate(ForkJoinEvaluator &engine) {
+    status = engine.evaluate(tokens, final_value);
+}
+
+/// Calculates the postfix expression, reusing the subexpressions already in the DAG.
+void BaresManager::calculate(ExpressionDag &dag) {
+    status = dag.evaluate(tokens, final_value);
+}
+
+/// Compiles the postfix expression into a program.
+void BaresManager::compile(Program &program) const {
+    program.compile(tokens, symbols);
+}
+
+/// Calculates a compiled program on the threaded interpreter.
+void BaresManager::calculate(const Program &program) {
+    vm.compile(program);
+    status = vm.run(final_value, slot_values);
+}
+
+/// Calculates a program compiled by a JIT.
+void BaresManager::calculate(JitProgram &engine) {
+    status = engine.run(final_value, slot_values);
+}
+
+/// Parses a line and keeps its tokens for the next stages.
+Parser::ResultType BaresManager::parse(const std::string &expr) {
     final_value = 0;
 
+    //* [I] Linhas enormes são validadas e tokenizadas em paralelo, direto na lista de tokens.
+    const Parser::Limits &limits = parser.get_limits();
+    bool counted = limits.max_tokens != Parser::Limits::unlimited or limits.max_depth != Parser::Limits::unlimited or
+                   limits.max_steps != Parser::Limits::unlimited or limits.max_memory != Parser::Limits::unlimited;
+    if ( tokenizer != nullptr and symbols == nullptr and expr.size() >= tokenizer_min_bytes and expr.size() <= limits.max_length and
+         not counted ) {
+        status = tokenizer->parse_and_tokenize(expr, tokens);
+        return status;
+    }
+
+    //* [I] Fazer o parsing desta expressão.
+    status = parser.parse_and_tokenize(expr);
+    //* [II.1] Recuperar a lista de tokens no formato infixo.
+    if ( status.type == Parser::ResultType::OK )
+        tokens = parser.get_tokens();
+
+    return status;
+}
+
+/// Sends the value or the error message of the last expression to the standard output.
+void BaresManager::print_result(const std::string &expr, std::ostream &os) {
+    // Se deu pau, imprimir a mensagem adequada.
+    if ( status.type != Parser::ResultType::OK )
+        print_error_msg( status, expr, os );
+    else
+        os << final_value << std::endl;
+}
+
+/// Reads a line and compute a expression, printing its result.
+void BaresManager::parse_and_compute(const std::string &expr, std::ostream &os) {
+    compute(expr);
+    print_result(expr, os);
+}
+
+/// Reads a line and compute a expression.
+const Parser::ResultType & BaresManager::compute(const std::string &expr) {
     //======================================================================
     //== Códigos para ajudar na depuração
     //----------------------------------------------------------------------
@@ -241,26 +263,9 @@ void BaresManager::parse_and_compute(std::string expr) {
         std::cout << "}\n";
         std::cout << std::endl;
     }*/
-    
-    //* [I] Fazer o parsing desta expressão.
-    status = parser.parse_and_tokenize(expr);
-    //? Preparar cabeçalho da saida.
-    // std::cout << std::setfill('=') << std::setw(80) << "\n";
-    // std::cout << std::setfill(' ') << ">>> Parsing \"" << expr << "\"\n";
-
-    // Se deu pau, imprimir a mensagem adequada.
-    if ( status.type != Parser::ResultType::OK )
-        print_error_msg( status, expr );
-    else {
-        // std::cout << ">>> Expression SUCCESSFULLY parsed!\n"; //? Deu certo.
-        //* [II.1] Recuperar a lista de tokens no formato infixo.
-        tokens = parser.get_tokens();
-        // std::cout << ">>> Tokens: { ";
-        // std::copy( tokens.begin(), tokens.end(),
-        //         std::ostream_iterator< Token >(std::cout, " ") );
-        // std::cout << "}\n";
-        // std::cout << std::endl;
 
+    //* [I] Fazer o parsing desta expressão.
+    if ( parse(expr).type == Parser::ResultType::OK ) {
         //* [II.2] Transformar de infixo para posfixo.
         infix_to_postfix();
 
@@ -271,12 +276,27 @@ void BaresManager::parse_and_compute(std::string expr) {
         // std::cout << "}\n";
         // std::cout << std::endl;
 
-        //* [III] Calcular a expressão pos fixa.
-        calculate();
-        if ( status.type != Parser::ResultType::OK )
-            print_error_msg( status, expr );
+        //* [III] Calcular a expressão pos fixa (em paralelo, se for enorme).
+        if ( fork_join != nullptr and symbols == nullptr and tokens.size() >= fork_join_min_tokens )
+            calculate(*fork_join);
+        //* [III] Ou reaproveitar as subexpressões já calculadas no lote.
+        else if ( shared != nullptr and symbols == nullptr )
+            calculate(*shared);
+        //* [III] Ou compilar (e otimizar) o programa e calculá-lo, em código nativo se houver JIT.
+        //* Com variáveis, sempre: só o programa compilado as lê dos slots.
+        else if ( optimizing or jit != nullptr or symbols != nullptr ) {
+            compile(program);
+            if ( optimizing )
+                optimize(program);
+            if ( jit != nullptr ) {
+                jit->compile(program);
+                calculate(*jit);
+            }
+            else
+                calculate(program);
+        }
         else
-            std::cout << final_value << std::endl;
+            calculate();
     }
-    // std::cout << "\n>>> Normal exiting...\n";
-}
\ No newline at end of file
+    return status;
+}
@@ -0,0 +1,230 @@
+#include <algorithm> // std::min
+#include <cstring>   // std::memchr, std::memmove
+#include <string>    // std::string
+#include <vector>    // std::vector
+
+#include <unistd.h> // read
+
+#if defined( __x86_64__ ) and defined( __GNUC__ )
+#include <immintrin.h>
+#define BARES_CHECK_X86 1
+#else
+#define BARES_CHECK_X86 0
+#endif
+
+#include "../include/check.h"
+
+namespace {
+    /// Whether a byte may appear in a valid expression: white space, digits, operators or parentheses.
+    constexpr bool valid_byte( unsigned char c ) {
+        return ( c >= '\t' and c <= '\r' ) or c == ' ' or c == '%' or ( c >= '(' and c <= '+' ) or c == '-' or
+               ( c >= '/' and c <= '9' ) or c == '^';
+    }
+
+    /// Marks the invalid bytes of the last `size % 64` bytes, one at a time.
+    void mark_tail( const char * data, std::size_t size, std::uint64_t * mask ) {
+        const std::size_t first = size / 64 * 64;
+        if ( first == size ) return;
+        std::uint64_t bits{0};
+        for ( std::size_t i{first}; i < size; i++ )
+            if ( not valid_byte( static_cast< unsigned char >( data[i] ) ) )
+                bits |= std::uint64_t{1} << ( i - first );
+        mask[ size / 64 ] = bits;
+    }
+
+#if not BARES_CHECK_X86
+    void scalar_mark( const char * data, std::size_t words, std::uint64_t * mask ) {
+        for ( std::size_t w{0}; w < words; w++ ) {
+            std::uint64_t bits{0};
+            for ( std::size_t i{0}; i < 64; i++ )
+                if ( not valid_byte( static_cast< unsigned char >( data[ 64 * w + i ] ) ) )
+                    bits |= std::uint64_t{1} << i;
+            mask[w] = bits;
+        }
+    }
+#else
+    /// The bytes of `c` in `[lo, hi]`: `c - lo <= hi - lo`, unsigned.
+    inline __m128i sse2_in( __m128i c, char lo, char hi ) {
+        __m128i t = _mm_sub_epi8( c, _mm_set1_epi8( lo ) );
+        return _mm_cmpeq_epi8( _mm_min_epu8( t, _mm_set1_epi8( static_cast< char >( hi - lo ) ) ), t );
+    }
+
+    /// The valid bytes of 16 bytes, one bit each.
+    inline unsigned sse2_valid( __m128i c ) {
+        __m128i valid = _mm_or_si128( _mm_or_si128( _mm_or_si128( sse2_in( c, '\t', '\r' ), sse2_in( c, '(', '+' ) ),
+                                                    _mm_or_si128( sse2_in( c, '/', '9' ), sse2_in( c, ' ', ' ' ) ) ),
+                                      _mm_or_si128( _mm_or_si128( sse2_in( c, '%', '%' ), sse2_in( c, '-', '-' ) ),
+                                                    sse2_in( c, '^', '^' ) ) );
+        return static_cast< unsigned >( _mm_movemask_epi8( valid ) );
+    }
+
+    void sse2_mark( const char * data, std::size_t words, std::uint64_t * mask ) {
+        for ( std::size_t w{0}; w < words; w++ ) {
+            const __m128i * p = reinterpret_cast< const __m128i * >( data + 64 * w );
+            std::uint64_t valid = std::uint64_t{ sse2_valid( _mm_loadu_si128( p ) ) } |
+                                  std::uint64_t{ sse2_valid( _mm_loadu_si128( p + 1 ) ) } << 16 |
+                                  std::uint64_t{ sse2_valid( _mm_loadu_si128( p + 2 ) ) } << 32 |
+                                  std::uint64_t{ sse2_valid( _mm_loadu_si128( p + 3 ) ) } << 48;
+            mask[w] = ~valid;
+        }
+    }
+
+    /// Like sse2_in(), on 32 bytes.
+    __attribute__(( target( "avx2" ) )) inline __m256i avx2_in( __m256i c, char lo, char hi ) {
+        __m256i t = _mm256_sub_epi8( c, _mm256_set1_epi8( lo ) );
+        return _mm256_cmpeq_epi8( _mm256_min_epu8( t, _mm256_set1_epi8( static_cast< char >( hi - lo ) ) ), t );
+    }
+
+    /// The valid bytes of 32 bytes, like sse2_valid().
+    __attribute__(( target( "avx2" ) )) inline unsigned avx2_valid( __m256i c ) {
+        __m256i valid = _mm256_or_si256( _mm256_or_si256( _mm256_or_si256( avx2_in( c, '\t', '\r' ), avx2_in( c, '(', '+' ) ),
+                                                          _mm256_or_si256( avx2_in( c, '/', '9' ), avx2_in( c, ' ', ' ' ) ) ),
+                                         _mm256_or_si256( _mm256_or_si256( avx2_in( c, '%', '%' ), avx2_in( c, '-', '-' ) ),
+                                                          avx2_in( c, '^', '^' ) ) );
+        return static_cast< unsigned >( _mm256_movemask_epi8( valid ) );
+    }
+
+    __attribute__(( target( "avx2" ) )) void avx2_mark( const char * data, std::size_t words, std::uint64_t * mask ) {
+        for ( std::size_t w{0}; w < words; w++ ) {
+            const __m256i * p = reinterpret_cast< const __m256i * >( data + 64 * w );
+            std::uint64_t valid = std::uint64_t{ avx2_valid( _mm256_loadu_si256( p ) ) } |
+                                  std::uint64_t{ avx2_valid( _mm256_loadu_si256( p + 1 ) ) } << 32;
+            mask[w] = ~valid;
+        }
+    }
+#endif
+
+    typedef void (*mark_t)( const char * data, std::size_t words, std::uint64_t * mask );
+
+    /// The kernel for this processor.
+    mark_t best_mark(void) {
+#if BARES_CHECK_X86
+        return __builtin_cpu_supports( "avx2" ) ? avx2_mark : sse2_mark;
+#else
+        return scalar_mark;
+#endif
+    }
+
+    /// Whether any bit of `[first, last)` is set.
+    bool any_bit( const std::uint64_t * mask, std::size_t first, std::size_t last ) {
+        if ( first >= last ) return false;
+        const std::size_t fw = first / 64, lw = ( last - 1 ) / 64;
+        const std::uint64_t head = ~std::uint64_t{0} << ( first % 64 );
+        const std::uint64_t tail = ~std::uint64_t{0} >> ( 63 - ( last - 1 ) % 64 );
+        if ( fw == lw ) return ( mask[fw] & head & tail ) != 0;
+        if ( ( mask[fw] & head ) != 0 ) return true;
+        for ( std::size_t w{ fw + 1 }; w < lw; w++ )
+            if ( mask[w] != 0 ) return true;
+        return ( mask[lw] & tail ) != 0;
+    }
+
+    /// The first set bit of `[first, last)`, or `last` if there is none.
+    std::size_t first_bit( const std::uint64_t * mask, std::size_t first, std::size_t last ) {
+        if ( first >= last ) return last;
+        std::size_t w = first / 64;
+        std::uint64_t bits = mask[w] & ( ~std::uint64_t{0} << ( first % 64 ) );
+        while ( bits == 0 ) {
+            if ( ++w * 64 >= last ) return last;
+            bits = mask[w];
+        }
+        return std::min( last, 64 * w + static_cast< std::size_t >( __builtin_ctzll( bits ) ) );
+    }
+
+    /// Size of each read; a longer line makes the buffer grow.
+    const std::size_t read_size = 1 << 20;
+}
+
+void mark_invalid_bytes( const char * data, std::size_t size, std::uint64_t * mask ) {
+    static const mark_t mark = best_mark();
+    mark( data, size / 64, mask );
+    mark_tail( data, size, mask );
+}
+
+/// Reads the input in blocks, marks the invalid bytes of each block, then validates its lines.
+int check_mode( int in_fd, std::ostream & os, bool summary, const Parser::Limits & limits ) {
+    Parser parser;
+    parser.set_limits( limits );
+    std::vector< char > buffer( read_size );
+    std::vector< std::uint64_t > mask;
+    std::size_t filled{0};
+    std::size_t marked{0}; // Bytes of the buffer whose bits in `mask` are up to date.
+    unsigned long lines{0}, invalid_bytes{0};
+    unsigned long counts[ Parser::ResultType::n_codes ] = {};
+    std::string out;
+
+    auto check_line = [&]( std::size_t first, std::size_t last ) {
+        lines++;
+        if ( summary and any_bit( mask.data(), first, last ) ) {
+            invalid_bytes++;
+            return;
+        }
+        // The parser fails at the first invalid byte, if not before: the rest of the line is never looked at.
+        std::size_t end{ last };
+        if ( last - first <= limits.max_length ) {
+            const std::size_t bad = first_bit( mask.data(), first, last );
+            if ( bad < last ) end = bad + 1;
+        }
+        Parser::ResultType result = parser.validate( buffer.data() + first, end - first );
+        counts[ result.type ]++;
+        if ( summary ) return;
+        out += Parser::ResultType::code_name( result.type );
+        if ( result.type != Parser::ResultType::OK ) {
+            out += ' ';
+            out += std::to_string( result.at_col + 1 );
+        }
+        out += '\n';
+        if ( out.size() >= ( 1 << 16 ) ) {
+            os.write( out.data(), static_cast< std::streamsize >( out.size() ) );
+            out.clear();
+        }
+    };
+
+    for ( ;; ) {
+        if ( filled == buffer.size() )
+            buffer.resize( 2 * buffer.size() ); // A line longer than the buffer.
+        ssize_t n = read( in_fd, buffer.data() + filled, buffer.size() - filled );
+        if ( n < 0 ) {
+            std::cerr << "Cannot read the input\n";
+            return EXIT_FAILURE;
+        }
+        const std::size_t scanned = filled; // Bytes of a line already seen, but not complete.
+        filled += static_cast< std::size_t >( n );
+        const std::size_t word = marked / 64;
+        mask.resize( ( filled + 63 ) / 64 );
+        mark_invalid_bytes( buffer.data() + 64 * word, filled - 64 * word, mask.data() + word );
+        marked = filled;
+
+        // Every complete line of the buffer.
+        std::size_t begin{0};
+        const char * data = buffer.data();
+        const char * from = data + scanned;
+        while ( const char * nl = static_cast< const char * >( std::memchr( from, '\n', data + filled - from ) ) ) {
+            check_line( begin, nl - data );
+            begin = nl - data + 1;
+            from = nl + 1;
+        }
+        if ( n == 0 ) {
+            // Like std::getline(), a last line without "\n" still counts.
+            if ( begin < filled )
+                check_line( begin, filled );
+            break;
+        }
+        // The incomplete line goes to the beginning of the buffer.
+        std::memmove( buffer.data(), buffer.data() + begin, filled - begin );
+        filled -= begin;
+        if ( begin > 0 )
+            marked = 0; // Its bytes moved, so their bits are marked again.
+    }
+
+    if ( summary ) {
+        out += "lines: " + std::to_string( lines ) + "\n";
+        for ( int code{0}; code < Parser::ResultType::n_codes; code++ )
+            if ( counts[code] > 0 or code == Parser::ResultType::OK )
+                out += std::string( Parser::ResultType::code_name( static_cast< Parser::ResultType::code_t >( code ) ) ) +
+                       ": " + std::to_string( counts[code] ) + "\n";
+        out += "INVALID_BYTES: " + std::to_string( invalid_bytes ) + "\n";
+    }
+    os.write( out.data(), static_cast< std::streamsize >( out.size() ) );
+    os.flush();
+    return EXIT_SUCCESS;
+}
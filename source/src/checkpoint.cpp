@@ -0,0 +1,49 @@
+#include <cstdio>  // std::rename
+#include <fstream> // std::ifstream
+#include <sstream> // std::ostringstream
+
+#include <fcntl.h>  // open
+#include <unistd.h> // write, fsync, close
+
+#include "../include/checkpoint.h"
+
+namespace {
+    const char * const magic = "bares-checkpoint 1"; //!< First line of a checkpoint file.
+}
+
+bool Checkpoint::save( const std::string & path ) const {
+    std::ostringstream os;
+    os << magic << "\n" << offset << " " << lines << " " << output << " " << what << "\n";
+    aggregate.save( os );
+    const std::string text = os.str();
+
+    // The new state goes to a temporary file, which only replaces the old one once it is on disk.
+    const std::string temporary = path + ".tmp";
+    int fd = open( temporary.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644 );
+    if ( fd < 0 ) return false;
+    std::size_t written{0};
+    while ( written < text.size() ) {
+        ssize_t n = write( fd, text.data() + written, text.size() - written );
+        if ( n < 0 ) {
+            close( fd );
+            return false;
+        }
+        written += n;
+    }
+    bool synced = fsync( fd ) == 0;
+    synced = close( fd ) == 0 and synced;
+    return synced and std::rename( temporary.c_str(), path.c_str() ) == 0;
+}
+
+bool Checkpoint::load( const std::string & path ) {
+    std::ifstream file{ path };
+    std::string first;
+    if ( not std::getline( file, first ) or first != magic )
+        return false;
+    Checkpoint state;
+    file >> state.offset >> state.lines >> state.output >> state.what;
+    if ( not file or not state.aggregate.load( file ) )
+        return false;
+    *this = state;
+    return true;
+}
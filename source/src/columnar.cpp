@@ -0,0 +1,224 @@
+#include <algorithm> // std::copy_n, std::fill_n, std::count_if
+#include <map>       // std::map
+
+#if defined( __x86_64__ ) and defined( __GNUC__ )
+#include <immintrin.h>
+#define BARES_COLUMNAR_X86 1
+#else
+#define BARES_COLUMNAR_X86 0
+#endif
+
+#include "../include/columnar.h"
+#include "../include/operators.h"
+
+namespace {
+    typedef Parser::required_int_type value_t;
+    const std::uint8_t ok = Parser::ResultType::OK;
+    const std::uint8_t overflow = Parser::ResultType::OVERFLOW_ERROR;
+
+    /// `r = a op b` for `+ - *`, one row at a time; new overflows are marked in `status`.
+    template < char op >
+    void scalar_kernel( value_t * r, const value_t * a, const value_t * b, std::size_t n, std::uint8_t * status ) {
+        for ( std::size_t i{0}; i < n; i++ ) {
+            int v = op == '+' ? a[i] + b[i] : ( op == '-' ? a[i] - b[i] : a[i] * b[i] );
+            if ( not in_required_range( v ) and status[i] == ok )
+                status[i] = overflow;
+            r[i] = static_cast< value_t >( v ); // Wraps, like the SIMD kernels; the row failed anyway.
+        }
+    }
+
+    /// `r = a op b` for `/ % ^`, one row at a time; the rows that already failed are skipped.
+    void checked_kernel( char op, value_t * r, const value_t * a, const value_t * b, std::size_t n, std::uint8_t * status ) {
+        for ( std::size_t i{0}; i < n; i++ ) {
+            Parser::input_int_type v{0};
+            if ( status[i] == ok ) {
+                Parser::ResultType::code_t code = apply_operator( op, a[i], b[i], v );
+                if ( code != Parser::ResultType::OK ) {
+                    status[i] = static_cast< std::uint8_t >( code );
+                    v = 0;
+                }
+            }
+            r[i] = static_cast< value_t >( v );
+        }
+    }
+
+#if BARES_COLUMNAR_X86
+    /// `a op b` on 8 rows; `fits` gets all ones in the lanes whose result fits in 16 bits.
+    template < char op >
+    inline __m128i sse2_op( __m128i a, __m128i b, __m128i & fits ) {
+        if ( op == '+' ) {
+            __m128i r = _mm_add_epi16( a, b );
+            fits = _mm_cmpeq_epi16( r, _mm_adds_epi16( a, b ) );
+            return r;
+        }
+        if ( op == '-' ) {
+            __m128i r = _mm_sub_epi16( a, b );
+            fits = _mm_cmpeq_epi16( r, _mm_subs_epi16( a, b ) );
+            return r;
+        }
+        __m128i lo = _mm_mullo_epi16( a, b );
+        fits = _mm_cmpeq_epi16( _mm_mulhi_epi16( a, b ), _mm_srai_epi16( lo, 15 ) );
+        return lo;
+    }
+
+    template < char op >
+    void sse2_kernel( value_t * r, const value_t * a, const value_t * b, std::size_t n, std::uint8_t * status ) {
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i code = _mm_set1_epi8( static_cast< char >( overflow ) );
+        std::size_t i{0};
+        for ( ; i + 16 <= n; i += 16 ) {
+            __m128i f0, f1;
+            __m128i r0 = sse2_op< op >( _mm_loadu_si128( reinterpret_cast< const __m128i * >( a + i ) ),
+                                        _mm_loadu_si128( reinterpret_cast< const __m128i * >( b + i ) ), f0 );
+            __m128i r1 = sse2_op< op >( _mm_loadu_si128( reinterpret_cast< const __m128i * >( a + i + 8 ) ),
+                                        _mm_loadu_si128( reinterpret_cast< const __m128i * >( b + i + 8 ) ), f1 );
+            _mm_storeu_si128( reinterpret_cast< __m128i * >( r + i ), r0 );
+            _mm_storeu_si128( reinterpret_cast< __m128i * >( r + i + 8 ), r1 );
+            // One byte per row: overflowed and not failed before.
+            __m128i s = _mm_loadu_si128( reinterpret_cast< const __m128i * >( status + i ) );
+            __m128i fresh = _mm_andnot_si128( _mm_packs_epi16( f0, f1 ), _mm_cmpeq_epi8( s, zero ) );
+            _mm_storeu_si128( reinterpret_cast< __m128i * >( status + i ), _mm_or_si128( s, _mm_and_si128( fresh, code ) ) );
+        }
+        scalar_kernel< op >( r + i, a + i, b + i, n - i, status + i );
+    }
+
+    /// `a op b` on 16 rows; `fits` gets all ones in the lanes whose result fits in 16 bits.
+    template < char op >
+    __attribute__(( target( "avx2" ) )) inline __m256i avx2_op( __m256i a, __m256i b, __m256i & fits ) {
+        if ( op == '+' ) {
+            __m256i r = _mm256_add_epi16( a, b );
+            fits = _mm256_cmpeq_epi16( r, _mm256_adds_epi16( a, b ) );
+            return r;
+        }
+        if ( op == '-' ) {
+            __m256i r = _mm256_sub_epi16( a, b );
+            fits = _mm256_cmpeq_epi16( r, _mm256_subs_epi16( a, b ) );
+            return r;
+        }
+        __m256i lo = _mm256_mullo_epi16( a, b );
+        fits = _mm256_cmpeq_epi16( _mm256_mulhi_epi16( a, b ), _mm256_srai_epi16( lo, 15 ) );
+        return lo;
+    }
+
+    template < char op >
+    __attribute__(( target( "avx2" ) )) void avx2_kernel( value_t * r, const value_t * a, const value_t * b, std::size_t n,
+                                                          std::uint8_t * status ) {
+        const __m256i zero = _mm256_setzero_si256();
+        const __m256i code = _mm256_set1_epi8( static_cast< char >( overflow ) );
+        std::size_t i{0};
+        for ( ; i + 32 <= n; i += 32 ) {
+            __m256i f0, f1;
+            __m256i r0 = avx2_op< op >( _mm256_loadu_si256( reinterpret_cast< const __m256i * >( a + i ) ),
+                                        _mm256_loadu_si256( reinterpret_cast< const __m256i * >( b + i ) ), f0 );
+            __m256i r1 = avx2_op< op >( _mm256_loadu_si256( reinterpret_cast< const __m256i * >( a + i + 16 ) ),
+                                        _mm256_loadu_si256( reinterpret_cast< const __m256i * >( b + i + 16 ) ), f1 );
+            _mm256_storeu_si256( reinterpret_cast< __m256i * >( r + i ), r0 );
+            _mm256_storeu_si256( reinterpret_cast< __m256i * >( r + i + 16 ), r1 );
+            // The pack works within each 128-bit half; the permutation puts the rows back in order.
+            __m256i fits = _mm256_permute4x64_epi64( _mm256_packs_epi16( f0, f1 ), 0xD8 );
+            __m256i s = _mm256_loadu_si256( reinterpret_cast< const __m256i * >( status + i ) );
+            __m256i fresh = _mm256_andnot_si256( fits, _mm256_cmpeq_epi8( s, zero ) );
+            _mm256_storeu_si256( reinterpret_cast< __m256i * >( status + i ),
+                                 _mm256_or_si256( s, _mm256_and_si256( fresh, code ) ) );
+        }
+        scalar_kernel< op >( r + i, a + i, b + i, n - i, status + i );
+    }
+#endif
+
+    typedef void (*kernel_t)( value_t * r, const value_t * a, const value_t * b, std::size_t n, std::uint8_t * status );
+
+    /// The kernel of `+`, `-` or `*` (by the offset of its opcode from Program::ADD) for each isa_t.
+    kernel_t kernel( ColumnarProgram::isa_t isa, int which ) {
+        static const kernel_t table[][3] = {
+            { scalar_kernel< '+' >, scalar_kernel< '-' >, scalar_kernel< '*' > },
+#if BARES_COLUMNAR_X86
+            { sse2_kernel< '+' >, sse2_kernel< '-' >, sse2_kernel< '*' > },
+            { avx2_kernel< '+' >, avx2_kernel< '-' >, avx2_kernel< '*' > },
+#endif
+        };
+        return table[ isa ][ which ];
+    }
+}
+
+ColumnarProgram::isa_t ColumnarProgram::best_isa(void) {
+#if BARES_COLUMNAR_X86
+    static const isa_t best = __builtin_cpu_supports( "avx2" ) ? AVX2 : SSE2;
+    return best;
+#else
+    return SCALAR;
+#endif
+}
+
+/// Keeps the instructions, sizes the stack of columns for them and fills a column for each literal.
+void ColumnarProgram::compile( const Program & program ) {
+    m_code = program.code;
+    m_constants.clear();
+    std::map< Parser::input_int_type, std::size_t > columns; // The column of each distinct literal.
+    m_literals.assign( m_code.size(), 0 );
+    std::size_t depth{0}, max_depth{0};
+    for ( std::size_t pc{0}; pc < m_code.size(); pc++ ) {
+        const Program::Instruction & ins = m_code[pc];
+        if ( ins.op == Program::PUSH or ins.op == Program::FAIL ) {
+            // A FAIL stands for a value, never read, like in the other engines.
+            Parser::input_int_type literal = ins.op == Program::PUSH ? ins.value : 0;
+            auto found = columns.emplace( literal, columns.size() );
+            if ( found.second )
+                m_constants.insert( m_constants.end(), block_rows, static_cast< value_t >( literal ) );
+            m_literals[pc] = found.first->second;
+        }
+        if ( ins.op == Program::PUSH or ins.op == Program::LOAD or ins.op == Program::FAIL )
+            max_depth = std::max( max_depth, ++depth );
+        else
+            depth--;
+    }
+    if ( m_stack.size() < max_depth * block_rows )
+        m_stack.resize( max_depth * block_rows );
+    m_operands.resize( max_depth );
+}
+
+/// Runs every instruction over the rows `[first, first + n)`, at most `block_rows` of them.
+void ColumnarProgram::run_block( const Parser::required_int_type * const * columns, std::size_t first, std::size_t n,
+                                 Parser::required_int_type * values, std::uint8_t * status ) {
+    value_t * const base = m_stack.data();
+    const value_t ** const operands = m_operands.data();
+    std::size_t sp{0}; // Columns on the stack.
+    for ( std::size_t pc{0}; pc < m_code.size(); pc++ ) {
+        const Program::Instruction & ins = m_code[pc];
+        switch ( ins.op ) {
+            case Program::PUSH:
+                operands[ sp++ ] = m_constants.data() + m_literals[pc] * block_rows;
+                break;
+            case Program::LOAD:
+                operands[ sp++ ] = columns[ ins.value ] + first;
+                break;
+            case Program::FAIL:
+                // Every row stops here, unless it stopped before.
+                for ( std::size_t i{0}; i < n; i++ )
+                    if ( status[i] == ok ) status[i] = static_cast< std::uint8_t >( ins.value );
+                operands[ sp++ ] = m_constants.data() + m_literals[pc] * block_rows;
+                break;
+            default: {
+                sp--;
+                value_t * r = base + ( sp - 1 ) * block_rows;
+                if ( ins.op <= Program::MUL )
+                    kernel( m_isa, ins.op - Program::ADD )( r, operands[ sp - 1 ], operands[sp], n, status );
+                else
+                    checked_kernel( Program::symbol( ins.op ), r, operands[ sp - 1 ], operands[sp], n, status );
+                operands[ sp - 1 ] = r;
+                break;
+            }
+        }
+    }
+    std::copy_n( operands[0], n, values );
+}
+
+/// Evaluates the program, one block of rows at a time.
+std::size_t ColumnarProgram::evaluate( const Parser::required_int_type * const * columns, std::size_t rows,
+                                       Parser::required_int_type * values, std::uint8_t * status ) {
+    std::fill_n( status, rows, ok );
+    for ( std::size_t first{0}; first < rows; first += block_rows ) {
+        std::size_t n = std::min( block_rows, rows - first );
+        run_block( columns, first, n, values + first, status + first );
+    }
+    return static_cast< std::size_t >( std::count_if( status, status + rows, []( std::uint8_t s ) { return s != ok; } ) );
+}
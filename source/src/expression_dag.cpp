@@ -0,0 +1,58 @@
+#include <cstdlib> // std::atoll
+
+#include "../include/expression_dag.h"
+#include "../include/operators.h"
+
+/// Finds the node of a key, creating and evaluating it the first time.
+std::size_t ExpressionDag::intern( const Key & key ) {
+    m_stats.lookups++;
+    auto found = m_table.emplace( key, m_outcomes.size() );
+    if ( not found.second )
+        return found.first->second;
+
+    Outcome out{ Parser::ResultType::OK, 0 };
+    if ( key.op == 0 )
+        out.value = static_cast< Parser::input_int_type >( key.left );
+    else {
+        const Outcome & left = m_outcomes[ key.left ];
+        const Outcome & right = m_outcomes[ key.right ];
+        // The first error in postfix order: the left operand's, the right one's, then ours.
+        if ( left.code != Parser::ResultType::OK )
+            out = left;
+        else if ( right.code != Parser::ResultType::OK )
+            out = right;
+        else
+            out.code = apply_operator( key.op, left.value, right.value, out.value );
+    }
+    m_outcomes.push_back( out );
+    m_stats.nodes++;
+    return found.first->second;
+}
+
+/// Interns every subexpression of the postfix list; the last one is the whole expression.
+Parser::ResultType ExpressionDag::evaluate( const sc::vector< Token > & postfix, Parser::required_int_type & value ) {
+    m_stack.clear();
+    for ( std::size_t i{0}; i < postfix.size(); i++ ) {
+        const Token & t = postfix[i];
+        if ( t.type == Token::token_t::OPERAND ) {
+            m_stack.push_back( intern( Key{ 0, static_cast< std::uint64_t >( std::atoll( t.value.c_str() ) ), 0 } ) );
+            continue;
+        }
+        std::size_t right = m_stack.back();
+        m_stack.pop_back();
+        std::size_t left = m_stack.back();
+        m_stack.back() = intern( Key{ t.value[0], left, right } );
+    }
+
+    const Outcome & out = m_outcomes[ m_stack.back() ];
+    if ( out.code != Parser::ResultType::OK )
+        return Parser::ResultType{ out.code };
+    value = static_cast< Parser::required_int_type >( out.value );
+    return Parser::ResultType{ Parser::ResultType::OK };
+}
+
+void ExpressionDag::clear(void) {
+    m_table.clear();
+    m_outcomes.clear();
+    m_stats = Stats{};
+}
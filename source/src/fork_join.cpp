@@ -0,0 +1,244 @@
+#include <algorithm> // std::min, std::max
+#include <cstdlib> // std::atoll
+#include <limits>  // std::numeric_limits
+
+#include "../include/fork_join.h"
+#include "../include/operators.h"
+
+namespace {
+    /// Below this depth of nested spawns, large subtrees are still split; deeper ones are sequential.
+    const unsigned max_depth = 64;
+}
+
+ForkJoinEvaluator::ForkJoinEvaluator( unsigned threads, std::size_t cutoff )
+    : m_pool{ threads }
+    , m_cutoff{ cutoff < 2 ? 2 : cutoff }
+    , m_first_error{ std::numeric_limits< std::size_t >::max() }
+{ /* empty */ }
+
+/// Records an error, keeping the earliest one, and builds its outcome.
+ForkJoinEvaluator::Outcome ForkJoinEvaluator::fail( Parser::ResultType::code_t code, std::size_t at ) {
+    std::size_t current = m_first_error.load( std::memory_order_relaxed );
+    while ( at < current and not m_first_error.compare_exchange_weak( current, at ) ) /* retry */ ;
+    Outcome out;
+    out.code = code;
+    out.at = at;
+    return out;
+}
+
+/// Evaluates the postfix range [first, last], which is a whole subtree, with a stack machine.
+ForkJoinEvaluator::Outcome ForkJoinEvaluator::eval_range( std::size_t first, std::size_t last ) {
+    static thread_local std::vector< Parser::input_int_type > st;
+    st.clear();
+    for ( std::size_t i{first}; i <= last; i++ ) {
+        if ( m_op[i] == 0 ) {
+            st.push_back( m_value[i] );
+            continue;
+        }
+        Parser::input_int_type second_operand = st.back();
+        st.pop_back();
+        Parser::input_int_type & first_operand = st.back();
+        Parser::ResultType::code_t code = apply_operator( m_op[i], first_operand, second_operand, first_operand );
+        if ( code != Parser::ResultType::OK )
+            return fail( code, i );
+    }
+    Outcome out;
+    out.value = st.back();
+    return out;
+}
+
+/// Applies spine operator `op_node` to the accumulated value and its right child, a small subtree.
+ForkJoinEvaluator::Outcome ForkJoinEvaluator::apply_small( std::size_t op_node, const Outcome & acc ) {
+    std::size_t child = op_node - 1;
+    std::size_t child_first = child + 1 - m_size[child];
+    Outcome out;
+    if ( abandoned( child_first ) ) {
+        out.abandoned = true;
+        return out;
+    }
+    Outcome right = eval_range( child_first, child );
+    if ( right.code != Parser::ResultType::OK )
+        return right;
+    Parser::input_int_type result;
+    Parser::ResultType::code_t code = apply_operator( m_op[op_node], acc.value, right.value, result );
+    if ( code != Parser::ResultType::OK )
+        return fail( code, op_node );
+    out.value = result;
+    return out;
+}
+
+/// Sums the signed right children of spine[bottom] up to spine[top], keeping the extremes of the partial sums.
+void ForkJoinEvaluator::fold_chunk( Chunk & chunk ) {
+    for ( std::size_t j{chunk.bottom}; ; j-- ) {
+        std::size_t child = chunk.spine[j] - 1;
+        std::size_t child_first = child + 1 - m_size[child];
+        if ( abandoned( child_first ) ) {
+            chunk.stop.abandoned = true;
+            return;
+        }
+        Outcome right = eval_range( child_first, child );
+        if ( right.code != Parser::ResultType::OK ) {
+            chunk.stop = right;
+            return;
+        }
+        chunk.sum += m_op[ chunk.spine[j] ] == '+' ? right.value : -right.value;
+        chunk.low = std::min( chunk.low, chunk.sum );
+        chunk.high = std::max( chunk.high, chunk.sum );
+        if ( j == chunk.top ) return;
+    }
+}
+
+/**
+ * @brief Folds the additive spine operators spine[bottom] up to spine[top] (all with small right children) in parallel.
+ *
+ * The run is cut into chunks, each summing its right children on the pool
+ * with the lowest and highest partial sums it reached. A scan over the
+ * chunks, in postfix order, then adds each sum to the value accumulated so
+ * far: a chunk whose extremes take that value out of range overflows
+ * somewhere inside, and only that chunk is folded again, sequentially, to
+ * find the operator. So the result and the error are the sequential ones.
+ */
+ForkJoinEvaluator::Outcome ForkJoinEvaluator::fold_additive( const std::vector< std::size_t > & spine, std::size_t top,
+                                                             std::size_t bottom, Outcome acc ) {
+    const std::size_t ops = bottom + 1 - top;
+    const std::size_t per_chunk = std::max( m_cutoff, ops / ( 8 * m_pool.size() ) + 1 );
+    std::vector< Chunk > chunks( ( ops + per_chunk - 1 ) / per_chunk );
+    for ( std::size_t k{0}; k < chunks.size(); k++ ) {
+        chunks[k].self = this;
+        chunks[k].spine = spine.data();
+        chunks[k].bottom = bottom - k * per_chunk;
+        chunks[k].top = bottom + 1 - std::min( ops, ( k + 1 ) * per_chunk );
+        m_pool.spawn( chunks[k] );
+    }
+    for ( auto & chunk : chunks ) {
+        m_pool.wait( chunk ); // Always wait: the task lives in this frame.
+        if ( acc.code != Parser::ResultType::OK or acc.abandoned )
+            continue;
+        if ( not in_required_range( acc.value + chunk.low ) or not in_required_range( acc.value + chunk.high ) ) {
+            // The overflow comes before the error that stopped the chunk, if any.
+            for ( std::size_t j{chunk.bottom}; acc.code == Parser::ResultType::OK and not acc.abandoned; j-- ) {
+                acc = apply_small( spine[j], acc );
+                if ( j == chunk.top ) break;
+            }
+        }
+        else if ( chunk.stop.code != Parser::ResultType::OK or chunk.stop.abandoned )
+            acc = chunk.stop;
+        else
+            acc.value += chunk.sum;
+    }
+    return acc;
+}
+
+/// Evaluates the subtree rooted at `node`, splitting it if it is large.
+ForkJoinEvaluator::Outcome ForkJoinEvaluator::eval_node( std::size_t node, unsigned depth ) {
+    std::size_t first = node + 1 - m_size[node];
+    Outcome out;
+    if ( abandoned( first ) ) {
+        out.abandoned = true;
+        return out;
+    }
+    if ( m_size[node] < m_cutoff or depth > max_depth )
+        return eval_range( first, node );
+
+    // [I] Walk down the left spine while the left child is still large.
+    std::vector< std::size_t > spine; // Operators, from the top down.
+    std::size_t left;
+    for ( std::size_t n{node}; ; n = left ) {
+        spine.push_back( n );
+        std::size_t right = n - 1;
+        left = right - m_size[right];
+        if ( m_op[left] == 0 or m_size[left] < m_cutoff ) break;
+    }
+
+    // [II] Hand the large right children to the pool.
+    std::size_t large{0};
+    for ( std::size_t n : spine )
+        if ( m_size[n - 1] >= m_cutoff ) large++;
+    std::vector< Subtree > children( large ); // From the top down, like the spine.
+    for ( std::size_t j{0}, k{0}; j < spine.size(); j++ ) {
+        if ( m_size[ spine[j] - 1 ] < m_cutoff ) continue;
+        children[k].self = this;
+        children[k].node = spine[j] - 1;
+        children[k].depth = depth + 1;
+        m_pool.spawn( children[k++] );
+    }
+
+    // [III] Fold the spine bottom-up, which is the postfix order: the first error found is the earliest.
+    // A long run of + and - with small right children (as in `1 + 2 + ... + n`) is folded in parallel too.
+    out = eval_range( first, left );
+    std::size_t next_child = children.size();
+    std::size_t sequential_to = spine.size(); // Operators from here up are known not to start a long run.
+    auto additive = [this]( std::size_t n ) {
+        return ( m_op[n] == '+' or m_op[n] == '-' ) and m_size[n - 1] < m_cutoff;
+    };
+    for ( std::size_t j{spine.size()}; j-- > 0; ) {
+        if ( m_size[ spine[j] - 1 ] >= m_cutoff ) {
+            Subtree & child = children[ --next_child ];
+            m_pool.wait( child ); // Always wait: the task lives in this frame.
+            if ( out.code != Parser::ResultType::OK or out.abandoned )
+                continue;
+            if ( child.out.code != Parser::ResultType::OK or child.out.abandoned ) {
+                out = child.out;
+                continue;
+            }
+            Parser::input_int_type result;
+            Parser::ResultType::code_t code = apply_operator( m_op[ spine[j] ], out.value, child.out.value, result );
+            if ( code != Parser::ResultType::OK )
+                out = fail( code, spine[j] );
+            else
+                out.value = result;
+            continue;
+        }
+        if ( out.code != Parser::ResultType::OK or out.abandoned )
+            continue;
+        if ( j < sequential_to and additive( spine[j] ) ) {
+            std::size_t top{j};
+            while ( top > 0 and additive( spine[top - 1] ) ) top--;
+            if ( j + 1 - top >= m_cutoff ) {
+                out = fold_additive( spine, top, j, out );
+                j = top;
+                continue;
+            }
+            sequential_to = top;
+        }
+        out = apply_small( spine[j], out );
+    }
+    return out;
+}
+
+/// Builds the tree and evaluates it on the pool.
+Parser::ResultType ForkJoinEvaluator::evaluate( const sc::vector< Token > & postfix, Parser::required_int_type & value ) {
+    std::size_t n = postfix.size();
+    m_op.resize( n );
+    m_value.resize( n );
+    m_size.resize( n );
+
+    // The subtree sizes come from a stack of sizes, like the evaluation itself.
+    std::vector< std::size_t > sizes;
+    for ( std::size_t i{0}; i < n; i++ ) {
+        const Token & t = postfix[i];
+        if ( t.type == Token::token_t::OPERAND ) {
+            m_op[i] = 0;
+            m_value[i] = std::atoll( t.value.c_str() );
+            m_size[i] = 1;
+        }
+        else {
+            m_op[i] = t.value[0];
+            std::size_t right = sizes.back();
+            sizes.pop_back();
+            std::size_t left = sizes.back();
+            sizes.pop_back();
+            m_size[i] = left + right + 1;
+        }
+        sizes.push_back( m_size[i] );
+    }
+
+    m_first_error.store( std::numeric_limits< std::size_t >::max() );
+    Outcome out;
+    m_pool.run( [&] { out = eval_node( n - 1, 0 ); } );
+
+    if ( out.code != Parser::ResultType::OK )
+        return Parser::ResultType{ out.code };
+    value = static_cast< Parser::required_int_type >( out.value );
+    return Parser::ResultType{ Parser::ResultType::OK };
+}
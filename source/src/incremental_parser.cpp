@@ -0,0 +1,251 @@
+#include <algorithm> // std::lower_bound, std::upper_bound
+#include <stdexcept> // std::out_of_range
+
+#include "../include/incremental_parser.h"
+#include "../include/operators.h"
+
+using namespace lexemes;
+
+/// Splits the characters [first, last) into lexemes.
+void IncrementalParser::lex( std::size_t first, std::size_t last, std::vector< Lexeme > & out ) {
+    out.clear();
+    m_stats.relexed += last - first;
+    for ( std::size_t c{first}; c < last; ) {
+        Lexeme l{ c, 1, INVALID, INVALID, 0, false, Parser::ResultType::OK, 0 };
+        if ( is_digit( m_expr[c] ) ) {
+            while ( c < last and is_digit( m_expr[c] ) ) c++;
+            l.len = c - l.pos;
+            l.kind = l.role = DIGITS;
+            out.push_back( l );
+            continue;
+        }
+        if ( not is_space( m_expr[c] ) ) {
+            l.kind = l.role = kind_of( m_expr[c] );
+            out.push_back( l );
+        }
+        c++;
+    }
+}
+
+/**
+ * Validates the lexemes [lo, hi) as an expression, setting their roles and
+ * pairing their parentheses. `end` is the column right after the expression.
+ */
+Parser::ResultType IncrementalParser::validate( std::size_t lo, std::size_t hi, std::size_t end ) {
+    struct Roles {
+        IncrementalParser & self;
+        std::size_t current, previous;
+        void integer( const lexemes::Lexeme &, bool negative ) {
+            if ( negative ) {
+                self.m_lexemes[ previous ].role = UNARY_MINUS;
+                self.m_lexemes[ current ].role = NEGATIVE;
+            }
+        }
+        void open( bool dropped_minus ) {
+            if ( dropped_minus ) self.m_lexemes[ previous ].role = DROPPED_MINUS;
+            self.m_opens.push_back( current );
+        }
+        void close(void) {
+            std::size_t open = self.m_opens.back();
+            self.m_opens.pop_back();
+            self.m_lexemes[ open ].match = static_cast< std::ptrdiff_t >( current - open );
+            self.m_lexemes[ current ].match = -self.m_lexemes[ open ].match;
+        }
+        void operation( char ) { /* empty */ }
+    } roles{ *this, lo, lo };
+    m_opens.clear();
+    Validator validator;
+    for ( ; roles.current < hi; roles.current++ ) {
+        Lexeme & l = m_lexemes[ roles.current ];
+        l.role = l.kind;
+        m_stats.validated++;
+        const Parser::input_int_type value = l.kind == DIGITS ? value_of( m_expr.data() + l.pos, l.len ) : 0;
+        if ( not validator.feed( lexemes::Lexeme{ l.kind, l.pos, m_expr[ l.pos ], l.len, value }, roles ) )
+            return validator.result();
+        roles.previous = roles.current;
+    }
+    validator.feed( lexemes::Lexeme{ END, end, 0, 0, 0 }, roles );
+    return validator.result();
+}
+
+/// Pairs the parentheses of a line with a syntax error, as far as they pair.
+void IncrementalParser::match_all(void) {
+    m_opens.clear();
+    for ( std::size_t i{0}; i < m_lexemes.size(); i++ ) {
+        Lexeme & l = m_lexemes[i];
+        l.match = 0;
+        if ( l.kind == OPEN )
+            m_opens.push_back( i );
+        else if ( l.kind == CLOSE and not m_opens.empty() ) {
+            std::size_t open = m_opens.back();
+            m_opens.pop_back();
+            m_lexemes[ open ].match = static_cast< std::ptrdiff_t >( i - open );
+            l.match = -m_lexemes[ open ].match;
+        }
+    }
+}
+
+/// Evaluates the (valid) lexemes, reusing the outcome of the groups that have one.
+Parser::ResultType IncrementalParser::evaluate(void) {
+    m_values.clear();
+    m_pending.clear();
+    // An error stops the groups still open: it is the first error of each one.
+    auto fail = [&]( Parser::ResultType::code_t code ) {
+        for ( const Pending & p : m_pending )
+            if ( p.op == '(' ) {
+                m_lexemes[ p.open ].cached = true;
+                m_lexemes[ p.open ].code = code;
+            }
+        return Parser::ResultType{ code };
+    };
+    // Pops the last pending operator and applies it to the two operands on top.
+    auto reduce = [&] {
+        char op = m_pending.back().op;
+        m_pending.pop_back();
+        Parser::input_int_type second_operand = m_values.back();
+        m_values.pop_back();
+        return apply_operator( op, m_values.back(), second_operand, m_values.back() );
+    };
+
+    for ( std::size_t i{0}; i < m_lexemes.size(); i++ ) {
+        Lexeme & l = m_lexemes[i];
+        m_stats.evaluated++;
+        switch ( l.role ) {
+            case DIGITS:
+            case NEGATIVE: {
+                Parser::input_int_type value{0};
+                for ( std::size_t c{ l.pos }; c < l.pos + l.len; c++ )
+                    value = value * 10 + ( m_expr[c] - '0' );
+                m_values.push_back( l.role == NEGATIVE ? -value : value );
+                break;
+            }
+            case OPEN:
+                if ( not l.cached ) {
+                    m_pending.push_back( Pending{ '(', i } );
+                    break;
+                }
+                if ( l.code != Parser::ResultType::OK )
+                    return fail( l.code );
+                m_values.push_back( l.value );
+                i += l.match; // The whole group is one operand.
+                break;
+            case CLOSE:
+                while ( m_pending.back().op != '(' ) {
+                    Parser::ResultType::code_t code = reduce();
+                    if ( code != Parser::ResultType::OK ) return fail( code );
+                }
+                {
+                    Lexeme & open = m_lexemes[ m_pending.back().open ];
+                    open.cached = true;
+                    open.code = Parser::ResultType::OK;
+                    open.value = m_values.back();
+                }
+                m_pending.pop_back();
+                break;
+            case OPERATOR: {
+                char op = m_expr[ l.pos ];
+                while ( not m_pending.empty() and m_pending.back().op != '(' and prec( op ) <= prec( m_pending.back().op ) ) {
+                    Parser::ResultType::code_t code = reduce();
+                    if ( code != Parser::ResultType::OK ) return fail( code );
+                }
+                m_pending.push_back( Pending{ op, 0 } );
+                break;
+            }
+            default: // The minus signs belong to their integers, or are dropped.
+                break;
+        }
+    }
+    while ( not m_pending.empty() ) {
+        Parser::ResultType::code_t code = reduce();
+        if ( code != Parser::ResultType::OK ) return fail( code );
+    }
+    m_value = static_cast< Parser::required_int_type >( m_values.back() );
+    return Parser::ResultType{ Parser::ResultType::OK };
+}
+
+/// Evaluates the line if it is valid.
+Parser::ResultType IncrementalParser::finish( Parser::ResultType syntax ) {
+    m_valid = syntax.type == Parser::ResultType::OK;
+    if ( m_valid )
+        m_result = evaluate();
+    else {
+        match_all();
+        m_result = syntax;
+    }
+    return m_result;
+}
+
+Parser::ResultType IncrementalParser::parse( const std::string & expr ) {
+    m_stats = Stats{};
+    m_stats.full = true;
+    m_expr = expr;
+    lex( 0, m_expr.size(), m_lexemes );
+    return finish( validate( 0, m_lexemes.size(), m_expr.size() ) );
+}
+
+Parser::ResultType IncrementalParser::edit( std::size_t pos, std::size_t erased, const std::string & text ) {
+    if ( pos > m_expr.size() )
+        throw std::out_of_range( "IncrementalParser::edit: position past the end of the expression" );
+    erased = std::min( erased, m_expr.size() - pos );
+    m_stats = Stats{};
+
+    // [I] The window: the lexemes the edited range touches, and the runs of
+    // digits right next to it (new digits would join them).
+    std::size_t wf = std::lower_bound( m_lexemes.begin(), m_lexemes.end(), pos,
+        []( const Lexeme & l, std::size_t p ) { return l.pos + l.len < p; } ) - m_lexemes.begin();
+    if ( wf < m_lexemes.size() and m_lexemes[wf].pos + m_lexemes[wf].len == pos and m_lexemes[wf].kind != DIGITS )
+        wf++;
+    std::size_t wl = std::upper_bound( m_lexemes.begin(), m_lexemes.end(), pos + erased,
+        []( std::size_t p, const Lexeme & l ) { return p < l.pos; } ) - m_lexemes.begin();
+    if ( wl > wf and m_lexemes[wl - 1].pos == pos + erased and m_lexemes[wl - 1].kind != DIGITS )
+        wl--;
+    std::size_t first{pos}, last{ pos + erased };
+    if ( wf < wl ) {
+        first = std::min( first, m_lexemes[wf].pos );
+        last = std::max( last, m_lexemes[wl - 1].pos + m_lexemes[wl - 1].len );
+    }
+
+    // [II] The groups around the window forget their outcome. Going left, a
+    // ")" jumps to its "(", so only the groups around the window stop the walk.
+    const std::size_t none = m_lexemes.size();
+    std::size_t innermost{none};
+    m_around.clear();
+    for ( std::size_t j{wf}; j-- > 0; ) {
+        Lexeme & l = m_lexemes[j];
+        if ( l.kind == CLOSE and l.match < 0 ) {
+            j += l.match;
+            continue;
+        }
+        if ( l.kind != OPEN ) continue;
+        l.cached = false;
+        if ( l.match > 0 and j + l.match >= wl ) {
+            m_around.push_back( j );
+            if ( innermost == none ) innermost = j;
+        }
+    }
+
+    // [III] Re-lexes the window and shifts what comes after it.
+    m_expr.replace( pos, erased, text );
+    const std::ptrdiff_t shift = static_cast< std::ptrdiff_t >( text.size() ) - static_cast< std::ptrdiff_t >( erased );
+    lex( first, last + shift, m_window );
+    const std::ptrdiff_t delta = static_cast< std::ptrdiff_t >( m_window.size() ) - static_cast< std::ptrdiff_t >( wl - wf );
+    m_lexemes.erase( m_lexemes.begin() + wf, m_lexemes.begin() + wl );
+    m_lexemes.insert( m_lexemes.begin() + wf, m_window.begin(), m_window.end() );
+    for ( std::size_t j{ wf + m_window.size() }; j < m_lexemes.size(); j++ )
+        m_lexemes[j].pos += shift;
+    for ( std::size_t open : m_around ) {
+        m_lexemes[ open ].match += delta;
+        m_lexemes[ open + m_lexemes[ open ].match ].match = -m_lexemes[ open ].match;
+    }
+
+    // [IV] A valid line stays valid if the innermost group around the edit does.
+    if ( m_valid and innermost != none ) {
+        std::size_t close = innermost + m_lexemes[ innermost ].match;
+        if ( validate( innermost + 1, close, m_lexemes[ close ].pos ).type == Parser::ResultType::OK ) {
+            m_result = evaluate();
+            return m_result;
+        }
+    }
+    m_stats.full = true;
+    return finish( validate( 0, m_lexemes.size(), m_expr.size() ) );
+}
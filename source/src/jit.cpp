@@ -0,0 +1,266 @@
+#include <cstring> // std::memcpy
+
+#include <sys/mman.h> // mmap, mprotect, munmap
+#include <unistd.h>   // sysconf
+
+#include "../include/jit.h"
+#include "../include/operators.h"
+
+#if defined( __x86_64__ )
+namespace {
+    //=== Registers, by their x86-64 numbers.
+    const int RAX = 0, RCX = 1, RDX = 2, RBX = 3, RBP = 5, RSI = 6, RDI = 7;
+    const int R12 = 12, R13 = 13, R14 = 14, R15 = 15;
+
+    /// The stack slots kept in registers (all callee-saved, so they survive calls).
+    const int slot_registers[] = { RBX, R12, R13, R14, R15 };
+    const int n_slot_registers = 5;
+
+    //=== The frame, below the saved registers ([rbp-8] to [rbp-40]).
+    const std::int32_t out_disp = -48;    //!< The `value` argument.
+    const std::int32_t pow_disp = -56;    //!< Result of the power helper.
+    const std::int32_t values_disp = -64; //!< The `values` argument.
+    const std::int32_t spill_disp = -72;  //!< First slot that does not fit in registers.
+    /// Variables beyond this slot are left to the interpreter (the displacement is 32-bit).
+    const std::int64_t max_slot = 1 << 28;
+    static_assert( sizeof( Parser::required_int_type ) == 2, "LOAD reads the values with movsx from 16 bits" );
+    /// Deeper programs are left to the interpreter, whose stack is on the heap.
+    const std::size_t max_spills = 1 << 16;
+
+    /// Places the code jumps to.
+    enum label_t { EXIT, OVERFLOW, DIVISION, N_LABELS };
+
+    /// The power operator, called by the generated code.
+    int power( std::int64_t a, std::int64_t b, std::int64_t * result ) {
+        Parser::input_int_type r{0};
+        Parser::ResultType::code_t code = apply_operator( '^', a, b, r );
+        *result = r;
+        return code;
+    }
+
+    /// Writes x86-64 instructions.
+    class Assembler {
+        public:
+            explicit Assembler( std::vector< std::uint8_t > & out ) : m_out( out ) { m_out.clear(); }
+
+            void byte( std::uint8_t b ) { m_out.push_back( b ); }
+            void imm32( std::int32_t v ) { for ( int i{0}; i < 4; i++ ) byte( static_cast< std::uint8_t >( v >> ( 8 * i ) ) ); }
+            void imm64( std::uint64_t v ) { for ( int i{0}; i < 8; i++ ) byte( static_cast< std::uint8_t >( v >> ( 8 * i ) ) ); }
+            void rex( int reg, int rm ) { byte( 0x48 | ( ( reg >> 3 ) << 2 ) | ( rm >> 3 ) ); }
+            void modrm( int mod, int reg, int rm ) { byte( ( mod << 6 ) | ( ( reg & 7 ) << 3 ) | ( rm & 7 ) ); }
+
+            /// `op rm, reg` with a register operand (mov 89, add 01, sub 29, cmp 39, test 85).
+            void rr( std::uint8_t op, int rm, int reg ) { rex( reg, rm ); byte( op ); modrm( 3, reg, rm ); }
+            /// `op reg, rm` for the two-byte opcodes (imul 0F AF, movsx 0F BF).
+            void rr0f( std::uint8_t op, int reg, int rm ) { rex( reg, rm ); byte( 0x0F ); byte( op ); modrm( 3, reg, rm ); }
+            /// `op reg, [rbp+disp]` (mov 8B, lea 8D) or `op [rbp+disp], reg` (mov 89).
+            void mem( std::uint8_t op, int reg, std::int32_t disp ) { rex( reg, RBP ); byte( op ); modrm( 2, reg, RBP ); imm32( disp ); }
+
+            void mov_imm( int reg, std::int32_t v ) { rex( 0, reg ); byte( 0xC7 ); modrm( 3, 0, reg ); imm32( v ); }
+            void mov_mem_imm( std::int32_t disp, std::int32_t v ) { rex( 0, RBP ); byte( 0xC7 ); modrm( 2, 0, RBP ); imm32( disp ); imm32( v ); }
+            void mov_eax( std::int32_t v ) { byte( 0xB8 ); imm32( v ); }
+            void cqo(void) { byte( 0x48 ); byte( 0x99 ); }
+            void idiv( int reg ) { rex( 0, reg ); byte( 0xF7 ); modrm( 3, 7, reg ); }
+            void push( int reg ) { if ( reg >= 8 ) byte( 0x41 ); byte( 0x50 + ( reg & 7 ) ); }
+            void pop( int reg ) { if ( reg >= 8 ) byte( 0x41 ); byte( 0x58 + ( reg & 7 ) ); }
+            void call( const void * fn ) {
+                byte( 0x48 ); byte( 0xB8 ); imm64( reinterpret_cast< std::uint64_t >( fn ) ); // mov rax, fn
+                byte( 0xFF ); byte( 0xD0 );                                                  // call rax
+            }
+
+            /// A jump (`cc` < 0) or a conditional jump (je 4, jne 5) to a label.
+            void jump( int cc, label_t to ) {
+                if ( cc < 0 ) byte( 0xE9 );
+                else { byte( 0x0F ); byte( 0x80 | cc ); }
+                m_fixups.push_back( Fixup{ m_out.size(), to } );
+                imm32( 0 );
+            }
+            void bind( label_t l ) { m_labels[l] = m_out.size(); }
+            void resolve(void) {
+                for ( const Fixup & f : m_fixups ) {
+                    std::int32_t rel = static_cast< std::int32_t >( m_labels[ f.to ] - ( f.at + 4 ) );
+                    std::memcpy( &m_out[ f.at ], &rel, 4 );
+                }
+            }
+
+        private:
+            struct Fixup { std::size_t at; label_t to; };
+            std::vector< std::uint8_t > & m_out;
+            std::vector< Fixup > m_fixups;
+            std::size_t m_labels[N_LABELS] = {};
+    };
+}
+#endif
+
+bool JitProgram::available(void) {
+#if defined( __x86_64__ )
+    return true;
+#else
+    return false;
+#endif
+}
+
+JitProgram::~JitProgram() {
+    if ( m_area != nullptr )
+        munmap( m_area, m_area_size );
+}
+
+/// Generates the native code of a program into m_code.
+bool JitProgram::generate( const Program & program ) {
+#if defined( __x86_64__ )
+    // How deep the stack gets decides how many slots need the frame.
+    std::size_t depth{0}, max_depth{0};
+    for ( const Program::Instruction & ins : program.code ) {
+        if ( ins.op == Program::LOAD and ins.value >= max_slot ) return false;
+        depth += ( ins.op == Program::PUSH or ins.op == Program::FAIL or ins.op == Program::LOAD ) ? 1 : -1;
+        if ( depth > max_depth ) max_depth = depth;
+    }
+    std::size_t spills = max_depth > n_slot_registers ? max_depth - n_slot_registers : 0;
+    if ( spills > max_spills ) return false;
+    // Keeps rsp 16-byte aligned for the calls: 5 saved registers plus the frame.
+    std::int32_t frame = static_cast< std::int32_t >( 24 + 8 * spills );
+    if ( frame % 16 == 0 ) frame += 8;
+
+    Assembler a{ m_code };
+    auto load = [&]( int reg, std::size_t slot ) {
+        if ( slot < n_slot_registers ) a.rr( 0x89, reg, slot_registers[slot] );
+        else a.mem( 0x8B, reg, spill_disp - 8 * static_cast< std::int32_t >( slot - n_slot_registers ) );
+    };
+    auto store = [&]( std::size_t slot, int reg ) {
+        if ( slot < n_slot_registers ) a.rr( 0x89, slot_registers[slot], reg );
+        else a.mem( 0x89, reg, spill_disp - 8 * static_cast< std::int32_t >( slot - n_slot_registers ) );
+    };
+
+    // [I] Prologue.
+    a.push( RBP );
+    a.rr( 0x89, RBP, 0x04 ); // mov rbp, rsp
+    for ( int r : slot_registers ) a.push( r );
+    a.rex( 0, 0x04 ); a.byte( 0x81 ); a.modrm( 3, 5, 0x04 ); a.imm32( frame ); // sub rsp, frame
+    a.mem( 0x89, RDI, out_disp );
+    a.mem( 0x89, RSI, values_disp );
+
+    // [II] The instructions, with the stack depth known at each one.
+    depth = 0;
+    for ( const Program::Instruction & ins : program.code ) {
+        if ( ins.op == Program::PUSH ) {
+            std::int32_t v = static_cast< std::int32_t >( ins.value );
+            if ( depth < n_slot_registers ) a.mov_imm( slot_registers[depth], v );
+            else a.mov_mem_imm( spill_disp - 8 * static_cast< std::int32_t >( depth - n_slot_registers ), v );
+            depth++;
+            continue;
+        }
+        if ( ins.op == Program::LOAD ) {
+            a.mem( 0x8B, RAX, values_disp );
+            // movsx rcx, word [rax + 2*slot]
+            a.rex( RCX, RAX ); a.byte( 0x0F ); a.byte( 0xBF ); a.modrm( 2, RCX, RAX );
+            a.imm32( static_cast< std::int32_t >( 2 * ins.value ) );
+            store( depth, RCX );
+            depth++;
+            continue;
+        }
+        if ( ins.op == Program::FAIL ) {
+            a.mov_eax( static_cast< std::int32_t >( ins.value ) );
+            a.jump( -1, EXIT );
+            depth++; // Stands for the value it replaced; the code after it is never reached.
+            continue;
+        }
+        std::size_t left = depth - 2;
+        load( RAX, left );
+        load( RCX, depth - 1 );
+        switch ( ins.op ) {
+            case Program::ADD: a.rr( 0x01, RAX, RCX ); break;
+            case Program::SUB: a.rr( 0x29, RAX, RCX ); break;
+            case Program::MUL: a.rr0f( 0xAF, RAX, RCX ); break;
+            case Program::DIV:
+            case Program::MOD:
+                a.rr( 0x85, RCX, RCX ); // test rcx, rcx
+                a.jump( 4, DIVISION );
+                a.cqo();
+                a.idiv( RCX );
+                if ( ins.op == Program::MOD ) a.rr( 0x89, RAX, RDX );
+                break;
+            default: // POW
+                a.rr( 0x89, RDI, RAX );
+                a.rr( 0x89, RSI, RCX );
+                a.mem( 0x8D, RDX, pow_disp );
+                a.call( reinterpret_cast< const void * >( &power ) );
+                a.byte( 0x85 ); a.byte( 0xC0 ); // test eax, eax
+                a.jump( 5, EXIT );              // eax holds the error code.
+                a.mem( 0x8B, RAX, pow_disp );
+                break;
+        }
+        if ( ins.op != Program::POW ) {
+            // The result must fit in 16 bits: sign-extending its low word gives it back.
+            a.rr0f( 0xBF, RDX, RAX ); // movsx rdx, ax
+            a.rr( 0x39, RDX, RAX );   // cmp rdx, rax
+            a.jump( 5, OVERFLOW );
+        }
+        store( left, RAX );
+        depth--;
+    }
+
+    // [III] Epilogue: store the value and return OK, or return the code in eax.
+    load( RAX, 0 );
+    a.mem( 0x8B, RDI, out_disp );
+    a.byte( 0x48 ); a.byte( 0x89 ); a.byte( 0x07 ); // mov [rdi], rax
+    a.byte( 0x31 ); a.byte( 0xC0 );                 // xor eax, eax
+    a.bind( EXIT );
+    a.mem( 0x8D, 0x04, -40 ); // lea rsp, [rbp-40]
+    for ( int i{ n_slot_registers - 1 }; i >= 0; i-- ) a.pop( slot_registers[i] );
+    a.pop( RBP );
+    a.byte( 0xC3 );
+    a.bind( OVERFLOW );
+    a.mov_eax( Parser::ResultType::OVERFLOW_ERROR );
+    a.jump( -1, EXIT );
+    a.bind( DIVISION );
+    a.mov_eax( Parser::ResultType::DIVISION_BY_ZERO );
+    a.jump( -1, EXIT );
+    a.resolve();
+    return true;
+#else
+    (void) program;
+    return false;
+#endif
+}
+
+/// Copies m_code into the executable mapping, growing it if needed.
+bool JitProgram::install(void) {
+    long page = sysconf( _SC_PAGESIZE );
+    std::size_t size = ( m_code.size() + page - 1 ) / page * page;
+    if ( size > m_area_size ) {
+        if ( m_area != nullptr ) munmap( m_area, m_area_size );
+        m_area = mmap( nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0 );
+        if ( m_area == MAP_FAILED ) {
+            m_area = nullptr;
+            m_area_size = 0;
+            return false;
+        }
+        m_area_size = size;
+    }
+    else if ( mprotect( m_area, m_area_size, PROT_READ | PROT_WRITE ) != 0 )
+        return false;
+    std::memcpy( m_area, m_code.data(), m_code.size() );
+    // Never writable and executable at the same time.
+    return mprotect( m_area, m_area_size, PROT_READ | PROT_EXEC ) == 0;
+}
+
+bool JitProgram::compile( const Program & program ) {
+    m_entry = nullptr;
+    if ( generate( program ) and install() ) {
+        m_entry = reinterpret_cast< entry_t >( m_area );
+        return true;
+    }
+    m_fallback.compile( program );
+    return false;
+}
+
+Parser::ResultType JitProgram::run( Parser::required_int_type & value, const Parser::required_int_type * values ) {
+    if ( m_entry == nullptr )
+        return m_fallback.run( value, values );
+    std::int64_t result{0};
+    int code = m_entry( &result, values );
+    if ( code != Parser::ResultType::OK )
+        return Parser::ResultType{ static_cast< Parser::ResultType::code_t >( code ) };
+    value = static_cast< Parser::required_int_type >( result );
+    return Parser::ResultType{ Parser::ResultType::OK };
+}
@@ -10,16 +10,393 @@
  * @copyright Copyright (c) 2021
  */
 
+#include <cctype>  // std::isalpha, std::isalnum
+#include <cstring> // std::strcmp, std::strchr
+#include <istream> // std::istream, std::streambuf
+#include <memory>  // std::unique_ptr
+#include <string>  // std::stoul
+#include <thread>  // std::thread::hardware_concurrency
+#include <vector>  // std::vector
+
+#include <unistd.h> // STDIN_FILENO, STDOUT_FILENO
+
+#include "../include/aggregate.h"
+#include "../include/barc.h"
 #include "../include/bares_manager.h"
+#include "../include/check.h"
+#include "../include/operators.h"
+#include "../include/perf_counters.h"
+#include "../include/pipeline.h"
+#include "../include/server.h"
+#include "../include/shard.h"
+#include "../include/shm_ring.h"
+#include "../include/shape_batch.h"
+#include "../include/streaming_parser.h"
+
+/// Prints how to call the program.
+void usage( const char * program ) {
+    std::cerr << "Usage: " << program << " [options] < expressions\n"
+              << "       " << program << " --compile FILE -o OUT.barc [--optimize]\n"
+              << "       " << program << " --run FILE.barc\n"
+              << "       " << program << " --merge SHARD_OUTPUT...\n"
+              << "  --compile FILE     compile the expressions of FILE into a .barc file (see -o).\n"
+              << "  -o FILE            the .barc file written by --compile.\n"
+              << "  --run FILE         evaluate the expressions of a .barc file.\n"
+              << "  --perf-counters    report hardware counters per stage and per expression class.\n"
+              << "  --serve PATH       serve clients on the Unix domain socket PATH.\n"
+              << "  --shm NAME         serve producers on the same machine through the shared memory NAME.\n"
+              << "  --producers N      producers --shm may have attached at the same time (default: 8).\n"
+              << "  --slots N          cells of each --shm ring (default: 1024).\n"
+              << "  --slot-size N      longest expression a --shm request holds (default: 4096).\n"
+              << "  --pipeline         read, evaluate and write in separate threads.\n"
+              << "  --aggregate LIST   write only the sum, min, max, count and/or hist of the values, then the errors.\n"
+              << "  --checkpoint FILE  record in FILE how far the pipeline or --aggregate run went.\n"
+              << "  --checkpoint-every N  seconds between checkpoints (default: 10).\n"
+              << "  --resume           go on from the --checkpoint FILE, appending to the output.\n"
+              << "  --shard I/N        evaluate only shard I (0 to N-1) of the input file, tagging lines with their numbers.\n"
+              << "  --merge FILE...    merge the outputs of the shards back into input order, as it goes\n"
+              << "                     (on failure, part of the output may already be written).\n"
+              << "  --check            only validate each line, writing OK or its error and column.\n"
+              << "  --summary          with --check, write only the counts of each result.\n"
+              << "  --stream           evaluate lines of any length in bounded memory.\n"
+              << "  --chunk N          bytes read at a time by --stream (default: 65536).\n"
+              << "  --fork-join        evaluate huge expressions on all the workers (default mode only).\n"
+              << "  --cutoff N         tokens from which --fork-join splits an expression (default: 4096).\n"
+              << "  --optimize         compile each expression, folding constants, before evaluating it (default mode or --compile).\n"
+              << "  --jit              compile each expression to native code (x86-64) before evaluating it (default mode only).\n"
+              << "  --dag              evaluate each distinct subexpression once per batch of lines (default mode only).\n"
+              << "  --shapes           evaluate lines with the same shape together, over columns of literals.\n"
+              << "  --batch N          lines per --dag or --shapes batch (default: 4096).\n"
+              << "  --parallel-tokenizer  validate and tokenize huge lines on all the workers (default mode only).\n"
+              << "  --tokenizer-min N  bytes from which --parallel-tokenizer is used (default: 1048576).\n"
+              << "  --workers N        number of worker threads (default: one per CPU).\n"
+              << "  --max-length N     longest line evaluated; longer ones are a resource limit error.\n"
+              << "  --max-tokens N     most tokens of a line.\n"
+              << "  --max-depth N      most parentheses open at the same time in a line.\n"
+              << "  --max-steps N      most evaluation steps (postfix instructions) of a line.\n"
+              << "  --max-memory N     most bytes of scratch storage for a line.\n"
+              << "  --let NAME=VALUE   define a variable the expressions may use (repeatable; default mode only).\n";
+}
+
+/// Reads a positive count from a command line argument.
+bool read_count( const char * arg, unsigned long & count ) {
+    try {
+        std::size_t used;
+        count = std::stoul( arg, &used );
+        return used == std::strlen( arg ) and count > 0;
+    }
+    catch ( const std::exception & ) {
+        return false;
+    }
+}
+
+/// Reads an `I/N` shard from a command line argument.
+bool read_shard( const char * arg, unsigned long & index, unsigned long & count ) {
+    const char * slash = std::strchr( arg, '/' );
+    if ( slash == nullptr or slash == arg ) return false;
+    unsigned long first{0};
+    if ( std::string( arg, slash ) == "0" ) first = 0;
+    else if ( not read_count( std::string( arg, slash ).c_str(), first ) ) return false;
+    if ( not read_count( slash + 1, count ) ) return false;
+    index = first;
+    return index < count;
+}
+
+/// Reads a `NAME=VALUE` variable binding from a command line argument.
+bool read_binding( const char * arg, std::string & name, Parser::required_int_type & value ) {
+    std::string binding{ arg };
+    std::size_t equal = binding.find( '=' );
+    if ( equal == std::string::npos or equal == 0 )
+        return false;
+    name = binding.substr( 0, equal );
+    if ( not ( std::isalpha( static_cast< unsigned char >( name[0] ) ) or name[0] == '_' ) )
+        return false;
+    for ( char c : name )
+        if ( not ( std::isalnum( static_cast< unsigned char >( c ) ) or c == '_' ) )
+            return false;
+    try {
+        std::size_t used;
+        long number = std::stol( binding.substr( equal + 1 ), &used );
+        if ( used != binding.size() - equal - 1 or not in_required_range( number ) )
+            return false;
+        value = static_cast< Parser::required_int_type >( number );
+        return true;
+    }
+    catch ( const std::exception & ) {
+        return false;
+    }
+}
+
+/**
+ * @brief Reads a line like std::getline(), but keeps at most `cap` of its characters.
+ *
+ * The rest of a longer line is read and dropped, so a line without end cannot
+ * fill the memory; what is kept is still longer than the limit it breaks.
+ */
+bool read_line( std::istream & is, std::string & line, std::size_t cap ) {
+    if ( cap == Parser::Limits::unlimited )
+        return static_cast< bool >( std::getline( is, line ) );
+    line.clear();
+    std::streambuf * in = is.rdbuf();
+    bool any{false};
+    for ( int c; ( c = in->sbumpc() ) != std::streambuf::traits_type::eof(); any = true ) {
+        if ( c == '\n' ) return true;
+        if ( line.size() < cap ) line.push_back( static_cast< char >( c ) );
+    }
+    is.setstate( std::ios::eofbit );
+    return any; // As with std::getline(), a last line without newline is still a line.
+}
+
+int main( int argc, char * argv[] ) {
+    bool perf_counters{false};
+    bool pipeline{false};
+    unsigned aggregate{0};
+    bool shard{false};
+    unsigned long shard_index{0}, shard_count{1};
+    std::vector< std::string > merge_paths;
+    Checkpoint::Options checkpoint;
+    bool stream{false};
+    bool check{false};
+    bool summary{false};
+    unsigned long chunk{1 << 16};
+    bool fork_join{false};
+    unsigned long cutoff{4096};
+    bool optimize{false};
+    bool jit{false};
+    bool dag{false};
+    bool shapes{false};
+    unsigned long batch{4096};
+    bool parallel_tokenizer{false};
+    unsigned long tokenizer_min{1 << 20};
+    const char * serve_path{nullptr};
+    const char * shm_name{nullptr};
+    unsigned long producers{8}, slots{1024}, slot_size{4096};
+    const char * compile_path{nullptr};
+    const char * output_path{nullptr};
+    const char * run_path{nullptr};
+    unsigned long workers = std::thread::hardware_concurrency();
+    Parser::Limits limits;
+    SymbolTable symbols;
+    std::vector< Parser::required_int_type > values;
+    std::string name;
+    Parser::required_int_type value{0};
+
+    for ( int i{1}; i < argc; i++ ) {
+        std::string option{ argv[i] };
+        bool has_value = i + 1 < argc;
+        if ( option == "--perf-counters" )
+            perf_counters = true;
+        else if ( option == "--pipeline" )
+            pipeline = true;
+        else if ( option == "--aggregate" and has_value and Aggregate::parse_list( argv[i + 1], aggregate ) )
+            i++;
+        else if ( option == "--checkpoint" and has_value )
+            checkpoint.path = argv[++i];
+        else if ( option == "--checkpoint-every" and has_value and read_count( argv[i + 1], checkpoint.interval ) )
+            i++;
+        else if ( option == "--resume" )
+            checkpoint.resume = true;
+        else if ( option == "--shard" and has_value and read_shard( argv[i + 1], shard_index, shard_count ) ) {
+            shard = true;
+            i++;
+        }
+        else if ( option == "--merge" and has_value ) {
+            // Every argument after it is an output of a shard.
+            merge_paths.assign( argv + i + 1, argv + argc );
+            break;
+        }
+        else if ( option == "--check" )
+            check = true;
+        else if ( option == "--summary" )
+            summary = true;
+        else if ( option == "--stream" )
+            stream = true;
+        else if ( option == "--chunk" and has_value and read_count( argv[i + 1], chunk ) )
+            i++;
+        else if ( option == "--fork-join" )
+            fork_join = true;
+        else if ( option == "--cutoff" and has_value and read_count( argv[i + 1], cutoff ) )
+            i++;
+        else if ( option == "--optimize" )
+            optimize = true;
+        else if ( option == "--jit" )
+            jit = true;
+        else if ( option == "--dag" )
+            dag = true;
+        else if ( option == "--shapes" )
+            shapes = true;
+        else if ( option == "--batch" and has_value and read_count( argv[i + 1], batch ) )
+            i++;
+        else if ( option == "--parallel-tokenizer" )
+            parallel_tokenizer = true;
+        else if ( option == "--tokenizer-min" and has_value and read_count( argv[i + 1], tokenizer_min ) )
+            i++;
+        else if ( option == "--compile" and has_value )
+            compile_path = argv[++i];
+        else if ( option == "-o" and has_value )
+            output_path = argv[++i];
+        else if ( option == "--run" and has_value )
+            run_path = argv[++i];
+        else if ( option == "--serve" and has_value )
+            serve_path = argv[++i];
+        else if ( option == "--shm" and has_value )
+            shm_name = argv[++i];
+        else if ( option == "--producers" and has_value and read_count( argv[i + 1], producers ) )
+            i++;
+        else if ( option == "--slots" and has_value and read_count( argv[i + 1], slots ) )
+            i++;
+        else if ( option == "--slot-size" and has_value and read_count( argv[i + 1], slot_size ) )
+            i++;
+        else if ( option == "--workers" and has_value and read_count( argv[i + 1], workers ) )
+            i++;
+        else if ( option == "--max-length" and has_value and read_count( argv[i + 1], limits.max_length ) )
+            i++;
+        else if ( option == "--max-tokens" and has_value and read_count( argv[i + 1], limits.max_tokens ) )
+            i++;
+        else if ( option == "--max-depth" and has_value and read_count( argv[i + 1], limits.max_depth ) )
+            i++;
+        else if ( option == "--max-steps" and has_value and read_count( argv[i + 1], limits.max_steps ) )
+            i++;
+        else if ( option == "--max-memory" and has_value and read_count( argv[i + 1], limits.max_memory ) )
+            i++;
+        else if ( option == "--let" and has_value and read_binding( argv[i + 1], name, value ) ) {
+            // Defining a variable again changes its value.
+            std::size_t slot = symbols.intern( name );
+            if ( slot == values.size() )
+                values.push_back( value );
+            values[slot] = value;
+            i++;
+        }
+        else {
+            usage( argv[0] );
+            return EXIT_FAILURE;
+        }
+    }
+
+    // One mode at a time; --aggregate runs on the pipeline, so --pipeline goes with it.
+    const int modes = ( compile_path != nullptr ) + ( run_path != nullptr ) + not merge_paths.empty() + shard +
+                      ( serve_path != nullptr ) + ( shm_name != nullptr ) + ( pipeline or aggregate != 0 ) + check +
+                      stream + shapes + perf_counters;
+    if ( modes > 1 or ( summary and not check ) ) {
+        usage( argv[0] );
+        return EXIT_FAILURE;
+    }
+    // Precompiled expressions: written once, then evaluated straight from the file.
+    if ( ( compile_path != nullptr ) != ( output_path != nullptr ) ) {
+        usage( argv[0] );
+        return EXIT_FAILURE;
+    }
+    if ( checkpoint.resume and checkpoint.path == nullptr ) {
+        usage( argv[0] );
+        return EXIT_FAILURE;
+    }
+    // Only the pipeline's writer records checkpoints, with or without --aggregate.
+    if ( checkpoint.path != nullptr and ( shard or not merge_paths.empty() or check or stream or shapes or perf_counters or
+                                          serve_path != nullptr or shm_name != nullptr or compile_path != nullptr or
+                                          run_path != nullptr ) ) {
+        usage( argv[0] );
+        return EXIT_FAILURE;
+    }
+    // Only the modes that evaluate with a BaresManager, or validate with a Parser, have resource limits.
+    const bool limited = limits.max_length != Parser::Limits::unlimited or limits.max_tokens != Parser::Limits::unlimited or
+                         limits.max_depth != Parser::Limits::unlimited or limits.max_steps != Parser::Limits::unlimited or
+                         limits.max_memory != Parser::Limits::unlimited;
+    if ( limited and ( shapes or stream or shm_name != nullptr or perf_counters or compile_path != nullptr or
+                       run_path != nullptr or not merge_paths.empty() ) ) {
+        usage( argv[0] );
+        return EXIT_FAILURE;
+    }
+    // Variables are only bound by the BaresManager of the default mode.
+    const bool other_mode = pipeline or aggregate != 0 or checkpoint.path != nullptr or shard or not merge_paths.empty() or
+                            check or stream or shapes or perf_counters or serve_path != nullptr or shm_name != nullptr or
+                            compile_path != nullptr or run_path != nullptr;
+    if ( symbols.size() > 0 and other_mode ) {
+        usage( argv[0] );
+        return EXIT_FAILURE;
+    }
+    // So are the engines; --optimize also folds the constants of --compile.
+    const bool engines = jit or dag or fork_join or parallel_tokenizer;
+    if ( ( engines and other_mode ) or ( optimize and other_mode and compile_path == nullptr ) ) {
+        usage( argv[0] );
+        return EXIT_FAILURE;
+    }
+    // The sizes of the shared memory rings are 32 bit fields of its header.
+    if ( producers > ( 1ul << 16 ) or slots > ( 1ul << 24 ) or slot_size > ( 1ul << 30 ) ) {
+        usage( argv[0] );
+        return EXIT_FAILURE;
+    }
+    if ( compile_path != nullptr )
+        return compile_mode( compile_path, output_path, optimize );
+    if ( run_path != nullptr )
+        return run_mode( run_path, std::cout );
+    // Shards: each process evaluates a range of the input file; their outputs are merged at the end.
+    if ( not merge_paths.empty() )
+        return merge_mode( merge_paths, std::cout );
+    if ( shard )
+        return shard_mode( STDIN_FILENO, std::cout, shard_index, shard_count, limits );
+    // Daemon mode: expressions come from clients instead of the standard input.
+    if ( serve_path != nullptr )
+        return serve_mode( serve_path, workers, limits );
+    // Co-located producers: requests and responses go through shared memory rings.
+    if ( shm_name != nullptr )
+        return shm_mode( shm_name, workers, producers, slots, slot_size );
+    // The results are folded by the pipeline's evaluators instead of written.
+    if ( aggregate != 0 )
+        return aggregate_mode( STDIN_FILENO, STDOUT_FILENO, workers, aggregate, limits, checkpoint );
+    // Throughput mode: reader, evaluators and writer run concurrently; its writer records the checkpoints.
+    if ( pipeline or checkpoint.path != nullptr )
+        return pipeline_mode( STDIN_FILENO, STDOUT_FILENO, workers, limits, checkpoint );
+    // Validation only: no tokens, no values.
+    if ( check )
+        return check_mode( STDIN_FILENO, std::cout, summary, limits );
+    // Huge lines: evaluated as they are read, never held in memory.
+    if ( stream )
+        return streaming_mode( STDIN_FILENO, std::cout, chunk );
+    // Batches of lines grouped by shape, each group evaluated by the SIMD kernels.
+    if ( shapes )
+        return shapes_mode( std::cin, std::cout, batch );
+    // Diagnostic mode: evaluates normally and reports the counters to the error output.
+    if ( perf_counters )
+        return perf_counters_mode( std::cin, std::cerr );
 
-int main( void ) {
     BaresManager bm; // an instance of class BaresManager
+    bm.use_optimizer( optimize );
+    bm.set_limits( limits );
+    // Only the variables given on the command line exist.
+    if ( symbols.size() > 0 ) {
+        symbols.close();
+        bm.use_symbols( &symbols, values.data() );
+    }
+    JitProgram native;
+    if ( jit )
+        bm.use_jit( &native );
+    // Huge expressions are split among the workers.
+    std::unique_ptr< ForkJoinEvaluator > engine;
+    if ( fork_join ) {
+        engine.reset( new ForkJoinEvaluator( workers, cutoff ) );
+        bm.use_fork_join( engine.get(), cutoff );
+    }
+    // Huge lines are validated and tokenized by the workers.
+    std::unique_ptr< ParallelTokenizer > tokenizer;
+    if ( parallel_tokenizer ) {
+        tokenizer.reset( new ParallelTokenizer( workers ) );
+        bm.use_parallel_tokenizer( tokenizer.get(), tokenizer_min );
+    }
+
+    // Subexpressions are shared within each batch of lines.
+    ExpressionDag shared;
+    if ( dag )
+        bm.use_dag( &shared );
 
     std::string expr;
+    unsigned long lines{0};
     // evaluate an expression while has lines to read.
-    while (std::getline(std::cin, expr))
+    const std::size_t cap = limits.max_length == Parser::Limits::unlimited ? limits.max_length : limits.max_length + 1;
+    while ( read_line( std::cin, expr, cap ) )
     {
         bm.parse_and_compute(expr);
+        if ( dag and ++lines % batch == 0 )
+            shared.clear();
     }
 
     return EXIT_SUCCESS;
@@ -0,0 +1,130 @@
+#include <algorithm> // std::copy
+#include <vector>    // std::vector
+
+#include "../include/optimizer.h"
+#include "../include/operators.h"
+
+namespace {
+    /// What is known about the value of a subtree at compile time.
+    enum kind_t {
+        CONSTANT, //!< Its value is known.
+        VARIABLE, //!< Only known when the program runs, but it cannot fail: a LOAD.
+        DYNAMIC,  //!< Only known when the program runs.
+        FAILS     //!< Its evaluation always stops with an error (its code ends with FAIL).
+    };
+
+    /// A subtree of the rewritten program, on the stack of the optimizer.
+    struct Entry {
+        std::size_t start;            //!< Its first instruction.
+        kind_t kind;                  //!< What is known about it.
+        Parser::input_int_type value; //!< The value of a CONSTANT.
+    };
+
+    bool is_binary( Program::opcode_t op ) { return op >= Program::ADD and op <= Program::POW; }
+
+    /// Whether `x op b` is always `x`.
+    bool right_identity( char op, Parser::input_int_type b ) {
+        return ( b == 1 and ( op == '*' or op == '/' or op == '^' ) ) or ( b == 0 and ( op == '+' or op == '-' ) );
+    }
+
+    /// Whether `a op x` is always `x`.
+    bool left_identity( char op, Parser::input_int_type a ) {
+        return ( a == 1 and op == '*' ) or ( a == 0 and op == '+' );
+    }
+
+    /// Whether `x op b` is the same constant, stored in `result`, for every `x`.
+    bool right_absorbing( char op, Parser::input_int_type b, Parser::input_int_type & result ) {
+        result = op == '^' ? 1 : 0;
+        return ( b == 0 and ( op == '*' or op == '^' ) ) or ( op == '%' and ( b == 1 or b == -1 ) );
+    }
+}
+
+/// Rewrites the program in place, in a single pass that simulates the evaluation stack.
+OptimizerStats optimize( Program & program ) {
+    OptimizerStats stats;
+    static thread_local std::vector< Entry > st;
+    st.clear();
+    std::vector< Program::Instruction > & code = program.code;
+    std::size_t w{0}; // Where the next instruction is written; never ahead of the one being read.
+
+    for ( std::size_t r{0}; r < code.size(); r++ ) {
+        const Program::Instruction ins = code[r];
+        if ( not is_binary( ins.op ) ) {
+            kind_t kind = ins.op == Program::PUSH ? CONSTANT
+                        : ins.op == Program::FAIL ? FAILS
+                        : ins.op == Program::LOAD ? VARIABLE : DYNAMIC;
+            st.push_back( Entry{ w, kind, ins.value } );
+            code[w++] = ins;
+            continue;
+        }
+        Entry b = st.back();
+        st.pop_back();
+        Entry a = st.back();
+        st.pop_back();
+        char op = Program::symbol( ins.op );
+        Parser::input_int_type absorbed{0};
+
+        // [I] The left operand always fails: nothing after it runs.
+        if ( a.kind == FAILS ) {
+            w = b.start;
+            st.push_back( a );
+        }
+        // [II] The right operand always fails: the operation never runs, and a
+        // constant left operand cannot fail before it, so it goes away too.
+        else if ( b.kind == FAILS ) {
+            if ( a.kind == CONSTANT ) {
+                std::copy( code.begin() + b.start, code.begin() + w, code.begin() + a.start );
+                w -= b.start - a.start;
+            }
+            st.push_back( Entry{ a.start, FAILS, 0 } );
+        }
+        // [III] Both constant: computed now, failing the same way the evaluation would.
+        else if ( a.kind == CONSTANT and b.kind == CONSTANT ) {
+            Parser::input_int_type result{0};
+            Parser::ResultType::code_t status = apply_operator( op, a.value, b.value, result );
+            w = a.start;
+            if ( status == Parser::ResultType::OK ) {
+                code[w++] = Program::Instruction{ Program::PUSH, result };
+                st.push_back( Entry{ a.start, CONSTANT, result } );
+                stats.folded++;
+            }
+            else {
+                code[w++] = Program::Instruction{ Program::FAIL, status };
+                st.push_back( Entry{ a.start, FAILS, 0 } );
+                stats.failures++;
+            }
+        }
+        // [IV] Identities: drop the constant and the operation, keep `x`.
+        else if ( b.kind == CONSTANT and right_identity( op, b.value ) ) {
+            w = b.start;
+            st.push_back( a );
+            stats.simplified++;
+        }
+        else if ( a.kind == CONSTANT and left_identity( op, a.value ) ) {
+            std::copy( code.begin() + b.start, code.begin() + w, code.begin() + a.start );
+            w -= b.start - a.start;
+            st.push_back( Entry{ a.start, b.kind, b.value } );
+            stats.simplified++;
+        }
+        // [V] A variable cannot fail, so dropping it is safe: `x*0`, `0*x`, `x%1` and `x^0` are constants.
+        else if ( b.kind == CONSTANT and a.kind == VARIABLE and right_absorbing( op, b.value, absorbed ) ) {
+            w = a.start;
+            code[w++] = Program::Instruction{ Program::PUSH, absorbed };
+            st.push_back( Entry{ a.start, CONSTANT, absorbed } );
+            stats.simplified++;
+        }
+        else if ( a.kind == CONSTANT and b.kind == VARIABLE and a.value == 0 and op == '*' ) {
+            w = a.start;
+            code[w++] = Program::Instruction{ Program::PUSH, 0 };
+            st.push_back( Entry{ a.start, CONSTANT, 0 } );
+            stats.simplified++;
+        }
+        // [VI] Nothing known: the operation stays.
+        else {
+            code[w++] = ins;
+            st.push_back( Entry{ a.start, DYNAMIC, 0 } );
+        }
+    }
+    code.resize( w );
+    return stats;
+}
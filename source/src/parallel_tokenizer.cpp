@@ -0,0 +1,166 @@
+#include <algorithm> // std::min, std::max
+#include <limits>    // std::numeric_limits
+
+#include "../include/parallel_tokenizer.h"
+
+using namespace lexemes;
+
+namespace {
+    /// Number of slices per thread, so that the threads that finish first steal work.
+    const std::size_t slices_per_thread = 4;
+
+    /// Adds lengths, saturating: a run of digits that long is out of range anyway.
+    std::uint32_t add_len( std::uint32_t a, std::size_t b ) {
+        const std::size_t max = std::numeric_limits< std::uint32_t >::max();
+        return static_cast< std::uint32_t >( std::min( max, a + b ) );
+    }
+}
+
+ParallelTokenizer::ParallelTokenizer( unsigned threads, std::size_t min_slice )
+    : m_pool{ threads }
+    , m_min_slice{ min_slice == 0 ? 1 : min_slice }
+{ /* empty */ }
+
+/// Pass 1: splits a slice into lexemes.
+void ParallelTokenizer::lex( Slice & s ) {
+    const std::string & e = *m_expr;
+    s.lexemes.clear();
+    s.skip = 0;
+    s.n_tokens = 0;
+    for ( std::size_t c{s.first}; c < s.last; ) {
+        if ( is_digit( e[c] ) ) {
+            std::size_t start{c};
+            while ( c < s.last and is_digit( e[c] ) ) c++;
+            s.lexemes.push_back( Lexeme{ start, add_len( 0, c - start ), DIGITS } );
+            continue;
+        }
+        if ( not is_space( e[c] ) )
+            s.lexemes.push_back( Lexeme{ c, 1, kind_of( e[c] ) } );
+        c++;
+    }
+}
+
+/// Pass 3: writes the tokens of a slice into their final positions.
+void ParallelTokenizer::emit( Slice & s ) {
+    const std::string & e = *m_expr;
+    std::size_t out{ s.first_token };
+    for ( std::size_t i{s.skip}; i < s.lexemes.size(); i++ ) {
+        const Lexeme & l = s.lexemes[i];
+        Token::token_t type;
+        switch ( l.kind ) {
+            case DIGITS:   type = Token::token_t::OPERAND; break;
+            case NEGATIVE: type = Token::token_t::OPERAND; break;
+            case OPEN:     type = Token::token_t::OPEN_PARENTHESES; break;
+            case CLOSE:    type = Token::token_t::CLOSE_PARENTHESES; break;
+            case OPERATOR: type = Token::token_t::OPERATOR; break;
+            default: continue; // The minus signs belong to their integers, or are dropped.
+        }
+        Token & t = (*m_tokens)[ out++ ];
+        if ( l.kind == NEGATIVE )
+            t.value.assign( e, l.pos - 1, l.len + 1 );
+        else
+            t.value.assign( e, l.pos, l.len );
+        t.type = type;
+    }
+}
+
+/// Runs pass 1 or pass 3 on every slice.
+void ParallelTokenizer::run_slices( bool tokenize ) {
+    m_pool.run( [&] {
+        for ( std::size_t i{1}; i < m_n_slices; i++ ) {
+            m_slices[i]->tokenize = tokenize;
+            m_pool.spawn( *m_slices[i] );
+        }
+        m_slices[0]->tokenize = tokenize;
+        m_slices[0]->run();
+        for ( std::size_t i{1}; i < m_n_slices; i++ )
+            m_pool.wait( *m_slices[i] );
+    } );
+}
+
+/// Pass 2: glues the slices together and validates the lexemes like Parser does.
+Parser::ResultType ParallelTokenizer::validate(void) {
+    const std::string & e = *m_expr;
+    const std::size_t end = e.size();
+
+    // [I] Digit runs cut by a boundary belong to the slice where they begin.
+    Lexeme * tail = nullptr;
+    for ( std::size_t s{0}; s < m_n_slices; s++ ) {
+        Slice & slice = *m_slices[s];
+        if ( tail != nullptr and slice.first > 0 and slice.first < slice.last and
+             is_digit( e[ slice.first - 1 ] ) and is_digit( e[ slice.first ] ) ) {
+            tail->len = add_len( tail->len, slice.lexemes[0].len );
+            slice.skip = 1;
+        }
+        if ( slice.skip < slice.lexemes.size() )
+            tail = &slice.lexemes.back();
+    }
+
+    // [II] The grammar, which also counts the tokens of each slice.
+    struct Tokens {
+        Slice * slice;
+        Lexeme * current;
+        Lexeme * previous;
+        void integer( const lexemes::Lexeme &, bool negative ) {
+            if ( negative ) {
+                previous->kind = UNARY_MINUS;
+                current->kind = NEGATIVE;
+            }
+            slice->n_tokens++;
+        }
+        void open( bool dropped_minus ) {
+            if ( dropped_minus ) previous->kind = DROPPED_MINUS;
+            slice->n_tokens++;
+        }
+        void close(void) { slice->n_tokens++; }
+        void operation( char ) { slice->n_tokens++; }
+    } tokens{ nullptr, nullptr, nullptr };
+    Validator validator;
+    std::size_t s{0}, i{0};
+    for ( ;; ) {
+        while ( s < m_n_slices and i >= m_slices[s]->lexemes.size() ) // Over empty slices and glued lexemes.
+            if ( ++s < m_n_slices ) i = m_slices[s]->skip;
+        if ( s == m_n_slices ) {
+            validator.feed( lexemes::Lexeme{ END, end, 0, 0, 0 }, tokens );
+            return validator.result();
+        }
+        tokens.slice = m_slices[s].get();
+        tokens.current = &tokens.slice->lexemes[i];
+        const Lexeme & l = *tokens.current;
+        const Parser::input_int_type value = l.kind == DIGITS ? value_of( e.data() + l.pos, l.len ) : 0;
+        if ( not validator.feed( lexemes::Lexeme{ l.kind, l.pos, e[ l.pos ], l.len, value }, tokens ) )
+            return validator.result();
+        tokens.previous = tokens.current;
+        i++;
+    }
+}
+
+/// Validates and tokenizes an expression with the three passes.
+Parser::ResultType ParallelTokenizer::parse_and_tokenize( const std::string & expr, sc::vector< Token > & tokens ) {
+    m_expr = &expr;
+    std::size_t n = std::min< std::size_t >( m_pool.size() * slices_per_thread, expr.size() / m_min_slice );
+    m_n_slices = std::max< std::size_t >( n, 1 );
+    while ( m_slices.size() < m_n_slices ) {
+        m_slices.emplace_back( new Slice );
+        m_slices.back()->self = this;
+    }
+    for ( std::size_t s{0}; s < m_n_slices; s++ ) {
+        m_slices[s]->first = expr.size() * s / m_n_slices;
+        m_slices[s]->last = expr.size() * ( s + 1 ) / m_n_slices;
+    }
+
+    run_slices( false );
+    Parser::ResultType result = validate();
+    if ( result.type != Parser::ResultType::OK )
+        return result;
+
+    std::size_t total{0};
+    for ( std::size_t s{0}; s < m_n_slices; s++ ) {
+        m_slices[s]->first_token = total;
+        total += m_slices[s]->n_tokens;
+    }
+    tokens.assign( total, Token{} );
+    m_tokens = &tokens;
+    run_slices( true );
+    return result;
+}
@@ -1,4 +1,5 @@
 #include "../include/parser.h"
+#include "../include/symbol_table.h"
 #include "../lib/stack.h"
 
 /// Converts the input character c_ into its corresponding terminal symbol code.
@@ -25,7 +26,10 @@ Parser::terminal_symbol_t  Parser::lexer( char c_ ) const {
         case '8':
         case '9':  return terminal_symbol_t::TS_NON_ZERO_DIGIT;
         case '\0': return terminal_symbol_t::TS_EOS; // end of string: the $ terminal symbol
+        case '_':  return terminal_symbol_t::TS_LETTER;
     }
+    if ( ( c_ >= 'a' and c_ <= 'z' ) or ( c_ >= 'A' and c_ <= 'Z' ) )
+        return terminal_symbol_t::TS_LETTER;
     return terminal_symbol_t::TS_INVALID;
 }
 
@@ -87,121 +91,204 @@ void Parser::skip_ws( void ) {
 
 //=== Non Terminal Symbols (NTS) methods.
 
+namespace {
+    /// Open parentheses the parser holds before its stack has to grow.
+    const std::size_t preallocated_frames = 64;
+}
+
+Parser::Parser() {
+    m_frames.reserve( preallocated_frames );
+}
+
+/// The scratch memory of an expression grows with its tokens, so both limits are one count.
+void Parser::set_limits( const Limits & limits_ ) {
+    m_limits = limits_;
+    m_max_tokens = std::min( m_limits.max_tokens, m_limits.max_memory / Limits::bytes_per_token );
+}
+
+/// Checks the tokens and the evaluation steps produced so far against the limits, at the current column.
+bool Parser::within_limits( void ) {
+    if ( m_tokens <= m_max_tokens and m_steps <= m_limits.max_steps )
+        return true;
+    m_result = ResultType{ ResultType::LIMIT_EXCEEDED, std::distance( m_expr.begin(), m_it_curr_symb ) };
+    return false;
+}
+
 /// Validates (i.e. returns true or false) and consumes an **expression** from the input expression string.
 /*! This method parses a valid expression from the input and, at the same time, it tokenizes its components.
  *
  * Production rule is:
  * ```
- *  <expr> := <term>,{ ("+"|"-"),<term> };
+ *  <expr> := <term>,{ ("+"|"-"|"*"|"/"|"%"|"^"),<term> };
  * ```
- * An expression might be just a term or one or more terms with '+'/'-' between them.
+ * An expression might be just a term or one or more terms with operators between them.
+ *
+ * When a term opens a parenthesis, the nested expression is parsed by this
+ * same loop: a frame is pushed and popped again when the ")" is accepted.
  */
 bool Parser::expression( void ) {
-    if ( not term() ) return false;
-    // Process terms
-    while( m_result.type == ResultType::OK ) {
-        skip_ws();
-        if ( accept( Parser::terminal_symbol_t::TS_MINUS ) ) {
-            // Stores the "-" token in the list.
-            m_tk_list.emplace_back( Token{ "-", Token::token_t::OPERATOR } );
-        }
-        else if ( accept( Parser::terminal_symbol_t::TS_PLUS ) ) {
-            // Stores the "+" token in the list.
-            m_tk_list.emplace_back( Token{ "+", Token::token_t::OPERATOR } );
-        }
-        else if ( accept( Parser::terminal_symbol_t::TS_MULTI ) ) {
-            // Stores the "*" token in the list.
-            m_tk_list.emplace_back( Token{ "*", Token::token_t::OPERATOR } );
-        }
-        else if ( accept( Parser::terminal_symbol_t::TS_DIVISION ) ) {
-            // Stores the "/" token in the list.
-            m_tk_list.emplace_back( Token{ "/", Token::token_t::OPERATOR } );
-        }
-        else if ( accept( Parser::terminal_symbol_t::TS_REST ) ) {
-            // Stores the "%" token in the list.
-            m_tk_list.emplace_back( Token{ "%", Token::token_t::OPERATOR } );
+    m_frames.clear();
+    // Whether the current term comes after an operator (it is not the first of its expression).
+    bool after_operator{ false };
+    for ( ;; ) {
+        // A resource limit ends the parsing at once, whatever is open.
+        if ( not within_limits() )
+            return false;
+        term_t t = term();
+        if ( t == term_t::FAILED )
+            return unwind( after_operator );
+        if ( t == term_t::ABORTED )
+            return false;
+        if ( t == term_t::OPEN ) {
+            if ( m_frames.size() >= m_limits.max_depth ) {
+                m_result = ResultType{ ResultType::LIMIT_EXCEEDED, std::distance( m_expr.begin(), m_it_curr_symb ) };
+                return false;
+            }
+            // A nested expression begins, its first term comes next.
+            m_frames.push( after_operator );
+            after_operator = false;
+            continue;
         }
-        else if ( accept( Parser::terminal_symbol_t::TS_EXPO ) ) {
-            // Stores the "^" token in the list.
-            m_tk_list.emplace_back( Token{ "^", Token::token_t::OPERATOR } );
+
+        // Process operators, or close the nested expressions that end here.
+        for ( ;; ) {
+            if ( not within_limits() )
+                return false;
+            skip_ws();
+            if ( accept( Parser::terminal_symbol_t::TS_MINUS ) ) {
+                // Stores the "-" token in the list.
+                emit( "-", Token::token_t::OPERATOR );
+            }
+            else if ( accept( Parser::terminal_symbol_t::TS_PLUS ) ) {
+                // Stores the "+" token in the list.
+                emit( "+", Token::token_t::OPERATOR );
+            }
+            else if ( accept( Parser::terminal_symbol_t::TS_MULTI ) ) {
+                // Stores the "*" token in the list.
+                emit( "*", Token::token_t::OPERATOR );
+            }
+            else if ( accept( Parser::terminal_symbol_t::TS_DIVISION ) ) {
+                // Stores the "/" token in the list.
+                emit( "/", Token::token_t::OPERATOR );
+            }
+            else if ( accept( Parser::terminal_symbol_t::TS_REST ) ) {
+                // Stores the "%" token in the list.
+                emit( "%", Token::token_t::OPERATOR );
+            }
+            else if ( accept( Parser::terminal_symbol_t::TS_EXPO ) ) {
+                // Stores the "^" token in the list.
+                emit( "^", Token::token_t::OPERATOR );
+            }
+            else if ( m_frames.empty() ) {
+                // The whole expression ends here.
+                return true;
+            }
+            else {
+                // A nested expression ends here: go to the next symbol, store the beginning of the term...
+                skip_ws();
+                begin_token();
+                // ...and check if it closes the parentheses.
+                if ( not accept( Parser::terminal_symbol_t::TS_CLOSE_PARENTHESES ) ) {
+                    // After an expression beginning with "(" we expect a ")" at end.
+                    m_result = ResultType{ ResultType::MISSING_CLOSING, token_location() };
+                    return unwind( m_frames.pop() );
+                }
+                emit( ")", Token::token_t::CLOSE_PARENTHESES );
+                m_frames.pop();
+                // The parenthesized term is done: an operator may follow it.
+                continue;
+            }
+            // After a operator we expect a valid term.
+            after_operator = true;
+            break;
         }
-        else break;
+    }
+}
 
-        // After a operator we expect a valid term, otherwise we have a missing term.
-        if ( not term() and m_result.type == ResultType::ILL_FORMED_INTEGER ) {
+/// Reports a failed term through the expressions that enclose it, as a recursive descent would.
+/*!
+ * A failed term after an operator is a missing term. Then every "(" that is
+ * still open turns the error into an ill formed integer, at the beginning of
+ * the last term tried, which in turn may be a missing term in its own
+ * expression.
+ *
+ * @param after_operator whether the failed term came after an operator.
+ * @return always false.
+ */
+bool Parser::unwind( bool after_operator ) {
+    for ( ;; ) {
+        if ( after_operator and m_result.type == ResultType::ILL_FORMED_INTEGER ) {
             // Make the error more specific.
             m_result.type = ResultType::MISSING_TERM;
         }
+        if ( m_frames.empty() )
+            return false;
+        // After a "(" we expect a valid expression, otherwise we have a missing expression.
+        m_result = ResultType{ ResultType::ILL_FORMED_INTEGER, token_location() };
+        after_operator = m_frames.pop();
     }
-    // Return true if everything ran smoothly.
-    return m_result.type == ResultType::OK;
 }
 
-/// Validates (i.e. returns true or false) and consumes a **term** from the input expression string.
-/*! This method parses and tokenizes a valid term from the input.
+/// Validates and consumes a **term** from the input expression string.
+/*! This method parses and tokenizes a valid integer from the input, or the "("
+ * that begins a nested expression, which is then parsed by expression().
  *
  * Production rule is:
  * ```
- *  <term> := <integer>;
+ *  <term> := "(",<expr>,")" | <integer> | <identifier>;
  * ```
- * A term is made of a single integer.
+ * The identifier is only accepted with a symbol table, and not after a "-":
+ * variables have no unary minus.
  *
- * @return true if a term has been successfuly parsed from the input; false otherwise.
+ * @return what was found: an integer, a variable, a "(", or an error stored in m_result.
  */
-bool Parser::term( void ) {
+Parser::term_t Parser::term( void ) {
     // Guarda o início do termo no input, para possíveis mensagens de erro.
     begin_token();
+    // Uma variável, se houver tabela de símbolos.
+    if ( m_symbols != nullptr and identifier() ) {
+        m_name.assign( m_begin_token, m_it_curr_symb );
+        if ( m_symbols->intern( m_name ) == SymbolTable::npos ) {
+            m_result = ResultType{ ResultType::UNDEFINED_VARIABLE, token_location() };
+            return term_t::ABORTED;
+        }
+        m_tokens++;
+        m_steps++;
+        if ( m_tokenize )
+            m_tk_list.emplace_back( Token{ m_name, Token::token_t::VARIABLE } );
+        return term_t::VARIABLE;
+    }
     // Vamos tokenizar o inteiro, se ele for bem formado.
     if ( integer() ) {
-        // Copiar a substring correspondente para uma variável string.
-        std::string token = complete_token();
-        // Tentar realizar a conversão de string para inteiro (usar stoll()).
-        input_int_type token_value;
-        token_value = stoll( token );
+        // Converter os dígitos em inteiro, sem copiá-los.
+        input_int_type token_value = integer_value();
 
         // Recebemos um inteiro válido, resta saber se está dentro da faixa.
         if ( token_value < std::numeric_limits< required_int_type >::min() or
              token_value > std::numeric_limits< required_int_type >::max() ) {
             // Fora da faixa, reportar erro.
             m_result = ResultType{ ResultType::INTEGER_OUT_OF_RANGE, token_location() };
-                               // std::distance( m_expr.begin(), begin_token ) );
-        }
-        else {
-            // Coloca o novo token na nossa lista de tokens.
-            m_tk_list.emplace_back( Token{ token, Token::token_t::OPERAND } );
+            return term_t::FAILED;
         }
+        // Coloca o novo token na nossa lista de tokens.
+        m_tokens++;
+        m_steps++;
+        if ( m_tokenize )
+            m_tk_list.emplace_back( Token{ complete_token(), Token::token_t::OPERAND } );
+        return term_t::INTEGER;
     }
     // Check if it starts with a "(".
-    else if ( accept( Parser::terminal_symbol_t::TS_OPEN_PARENTHESES ) ) {
+    if ( accept( Parser::terminal_symbol_t::TS_OPEN_PARENTHESES ) ) {
         // Add a "(" to token list.
-        m_tk_list.emplace_back( Token{ "(", Token::token_t::OPEN_PARENTHESES } );
+        emit( "(", Token::token_t::OPEN_PARENTHESES );
         // Go to the next symbol and store the beginning of the term.
         skip_ws();
         begin_token();
-        // Check if it is a expression.
-        if ( expression() ) {
-            // Go to the next symbol and store the beginning of the term.
-            skip_ws();
-            begin_token();
-            // And check if close the parentheses.
-            if ( accept( Parser::terminal_symbol_t::TS_CLOSE_PARENTHESES ) ) {
-                m_tk_list.emplace_back( Token{ ")", Token::token_t::CLOSE_PARENTHESES } );
-            }
-            // After an expression beginning with "(" we expect a ")" at end.
-            else {
-                m_result = ResultType{ ResultType::MISSING_CLOSING, token_location() };
-            }
-        }
-        // After a "(" we expect a valid expression, otherwise we have a missing expression.
-        else {
-            m_result = ResultType{ ResultType::ILL_FORMED_INTEGER, token_location() };
-        }
-    }
-    else {
-        // Create the corresponding error.
-        m_result =  ResultType{ ResultType::ILL_FORMED_INTEGER, std::distance( m_expr.begin(), m_it_curr_symb ) } ;
+        return term_t::OPEN;
     }
-    return m_result.type == ResultType::OK;
+    // Create the corresponding error.
+    m_result =  ResultType{ ResultType::ILL_FORMED_INTEGER, std::distance( m_expr.begin(), m_it_curr_symb ) } ;
+    return term_t::FAILED;
 }
 
 /// Validates (i.e. returns true or false) and consumes an **integer** from the input expression string.
@@ -225,6 +312,22 @@ bool Parser::integer( void ) {
     return  natural_number();
 }
 
+/// Validates (i.e. returns true or false) and consumes an **identifier** from the input expression string.
+/*!
+ * Production rule is:
+ * ```
+ * <identifier> := <letter>,{ <letter> | <digit> };
+ * ```
+ *
+ * @return true if an identifier has been successfuly parsed from the input; false otherwise.
+ */
+bool Parser::identifier( void ) {
+    if ( not accept( terminal_symbol_t::TS_LETTER ) )
+        return false;
+    while ( accept( terminal_symbol_t::TS_LETTER ) or digit() ) /* empty */ ;
+    return true;
+}
+
 /// Validates (i.e. returns true or false) and consumes a **natural number** from the input string.
 /*! This method parses a valid natural number from the input.
  *
@@ -275,7 +378,7 @@ bool Parser::digit( void ) {
 
 /*!
  * This is the parser's  **entry point** method that should be called in the client code.
- * This method tries to (recursivelly) validate an expression.
+ * This method tries to validate an expression.
  * During this process, we also store the tokens into a container.
  *
  * e_ The string with the expression to parse.
@@ -283,14 +386,42 @@ bool Parser::digit( void ) {
  *
  * @see ResultType
  */
-Parser::ResultType Parser::parse_and_tokenize( std::string e_ ) {
-    m_expr = e_; //  Stores the input expression in the private class member.
+Parser::ResultType Parser::parse_and_tokenize( const std::string & e_ ) {
+    m_tokenize = true;
+    return analyze( e_.data(), e_.size() );
+}
+
+/*!
+ * Validates an expression exactly like parse_and_tokenize(), with the same
+ * errors at the same columns and the same limits, but the tokens are only
+ * counted: nothing is stored in the list of tokens, which is left empty.
+ *
+ * e_ The expression to validate.
+ * size_ Its length.
+ * \return The parsing result.
+ */
+Parser::ResultType Parser::validate( const char * e_, std::size_t size_ ) {
+    m_tokenize = false;
+    return analyze( e_, size_ );
+}
+
+/// Parses the expression, storing its tokens only when m_tokenize is set.
+Parser::ResultType Parser::analyze( const char * e_, std::size_t size_ ) {
+    // A line that is too long is not even looked at.
+    if ( size_ > m_limits.max_length ) {
+        m_tk_list.clear();
+        m_result = ResultType{ ResultType::LIMIT_EXCEEDED, static_cast< ResultType::size_type >( m_limits.max_length ) };
+        return m_result;
+    }
+    m_expr = std::string_view{ e_, size_ }; // Parses the caller's characters in place: nothing is copied.
     m_it_curr_symb = m_expr.begin(); // Defines the first char to be processed (consumed).
     m_begin_token = m_it_curr_symb;
     m_result = ResultType{ ResultType::OK }; // Ok, by default,
 
     // We alway clean up the token from (possible) previous processing.
     m_tk_list.clear();
+    m_tokens = 0;
+    m_steps = 0;
 
     // Let us ignore any leading white spaces.
     skip_ws();
@@ -320,21 +451,40 @@ void Parser::begin_token(void) {
 }
 
 std::string Parser::complete_token(void) {
-    std::string token_str;
-    std::copy( m_begin_token, m_it_curr_symb, std::back_inserter( token_str ) );
-    return token_str;
+    return std::string( m_begin_token, m_it_curr_symb );
 }
 
 Parser::ResultType::size_type Parser::token_location(void) {
     return std::distance( m_expr.begin(), m_begin_token );
 }
 
+void Parser::emit( const char * value_, Token::token_t type_ ) {
+    m_tokens++;
+    // Parentheses are not in the postfix expression: only operands and operators are steps.
+    if ( type_ == Token::token_t::OPERATOR ) m_steps++;
+    if ( m_tokenize )
+        m_tk_list.emplace_back( Token{ value_, type_ } );
+}
+
+/// Converts the digits of the current token; once far out of range, the value stops growing.
+Parser::input_int_type Parser::integer_value(void) const {
+    const input_int_type saturated = std::numeric_limits< input_int_type >::max() / 100;
+    std::string_view::const_iterator it = m_begin_token;
+    const bool negative = *it == '-';
+    if ( negative ) ++it;
+    input_int_type value{0};
+    for ( ; it != m_it_curr_symb; ++it )
+        if ( value < saturated )
+            value = 10 * value + ( *it - '0' );
+    return negative ? -value : value;
+}
+
 /*!
  * Return the list of tokens, which is the by-product created during the syntax analysis.
  * This method should be called in the cliente code **after** tha parser has
  * returned successfuly.
  */
-sc::vector< Token >
+const sc::vector< Token > &
 Parser::get_tokens( void ) const {
     return m_tk_list;
 }
@@ -0,0 +1,266 @@
+#include <algorithm> // std::min
+#include <chrono>   // std::chrono::steady_clock
+#include <cerrno>   // errno
+#include <cstring>  // std::strerror
+#include <iomanip>  // std::setw
+#include <string>   // std::string
+
+#ifdef __linux__
+#include <linux/perf_event.h> // struct perf_event_attr
+#include <sys/ioctl.h>        // ioctl()
+#include <sys/syscall.h>      // SYS_perf_event_open
+#include <unistd.h>           // syscall(), read(), close()
+#endif
+
+#include "../include/perf_counters.h"
+#include "../include/bares_manager.h"
+
+namespace {
+    /// The stages of the evaluation pipeline.
+    enum stage_t { PARSE = 0, TO_POSTFIX, CALCULATE, OUTPUT, N_STAGES };
+
+    const char * stage_names[] = { "parse", "infix_to_postfix", "calculate", "output" };
+
+    /// Returns the wall clock time in nanoseconds.
+    std::uint64_t now_ns(void) {
+        return std::chrono::duration_cast< std::chrono::nanoseconds >(
+            std::chrono::steady_clock::now().time_since_epoch() ).count();
+    }
+
+    /// What was spent by a stage or by a class of expressions.
+    struct Totals {
+        std::uint64_t calls = 0;      //!< How many times it happened.
+        std::uint64_t intervals = 0;  //!< How many intervals between reads were added, skipped stages included.
+        PerfCounters::Sample sample;  //!< Accumulated counters.
+    };
+
+    /// Writes a row of the report.
+    void print_row( std::ostream & os, const PerfCounters & pc, const char * name, const Totals & t ) {
+        os << std::left << std::setw(30) << name << std::right
+           << std::setw(10) << t.calls
+           << std::setw(14) << t.sample.nanoseconds;
+        for ( int e{0}; e < PerfCounters::N_EVENTS; e++ ) {
+            if ( pc.counting( PerfCounters::event_t(e) ) )
+                os << std::setw(14) << t.sample.values[e];
+            else
+                os << std::setw(14) << "-";
+        }
+        // Instructions per cycle, when both are available.
+        if ( pc.counting( PerfCounters::CYCLES ) and pc.counting( PerfCounters::INSTRUCTIONS )
+             and t.sample.values[PerfCounters::CYCLES] > 0 ) {
+            os << std::setw(8) << std::fixed << std::setprecision(2)
+               << double( t.sample.values[PerfCounters::INSTRUCTIONS] ) / t.sample.values[PerfCounters::CYCLES];
+        }
+        else
+            os << std::setw(8) << "-";
+        os << "\n";
+    }
+
+    /// Writes the header of a report table.
+    void print_header( std::ostream & os, const char * title ) {
+        os << std::left << std::setw(30) << title << std::right
+           << std::setw(10) << "calls"
+           << std::setw(14) << "ns";
+        for ( int e{0}; e < PerfCounters::N_EVENTS; e++ )
+            os << std::setw(14) << PerfCounters::event_name( PerfCounters::event_t(e) );
+        os << std::setw(8) << "IPC" << "\n";
+    }
+}
+
+#ifdef __linux__
+/// Opens one counter, joining the group of `group_fd` (or creating a group if it is -1).
+static int open_event( std::uint32_t type, std::uint64_t config, int group_fd ) {
+    perf_event_attr attr;
+    std::memset( &attr, 0, sizeof( attr ) );
+    attr.size = sizeof( attr );
+    attr.type = type;
+    attr.config = config;
+    attr.disabled = ( group_fd == -1 ); // The leader starts the whole group.
+    attr.exclude_kernel = 1; // Works with perf_event_paranoid == 2.
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    return static_cast< int >( syscall( SYS_perf_event_open, &attr, 0, -1, group_fd, 0 ) );
+}
+#endif
+
+/// Opens the group of counters, skipping the events the machine does not support.
+bool PerfCounters::open(void) {
+#ifdef __linux__
+    const std::uint64_t cache_read_miss = ( PERF_COUNT_HW_CACHE_OP_READ << 8 ) |
+                                          ( PERF_COUNT_HW_CACHE_RESULT_MISS << 16 );
+    const std::uint32_t types[N_EVENTS] = { PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE,
+                                            PERF_TYPE_HW_CACHE, PERF_TYPE_HW_CACHE };
+    const std::uint64_t configs[N_EVENTS] = { PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+                                              PERF_COUNT_HW_BRANCH_MISSES,
+                                              PERF_COUNT_HW_CACHE_L1D | cache_read_miss,
+                                              PERF_COUNT_HW_CACHE_LL | cache_read_miss };
+    for ( int e{0}; e < N_EVENTS; e++ ) {
+        int fd = open_event( types[e], configs[e], m_leader );
+        if ( fd < 0 ) {
+            // The first failure is the one worth reporting.
+            if ( m_errno == 0 ) m_errno = errno;
+            continue;
+        }
+        if ( m_leader < 0 ) m_leader = fd;
+        m_fds[e] = fd;
+        m_index[e] = m_size++;
+    }
+    if ( m_leader < 0 )
+        return false;
+    m_errno = 0;
+    ioctl( m_leader, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP );
+    ioctl( m_leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP );
+    return true;
+#else
+    m_errno = ENOSYS;
+    return false;
+#endif
+}
+
+/// Closes every counter that was opened.
+PerfCounters::~PerfCounters() {
+#ifdef __linux__
+    for ( int e{0}; e < N_EVENTS; e++ )
+        if ( m_fds[e] >= 0 ) close( m_fds[e] );
+#endif
+}
+
+/// Takes a snapshot of the counters and of the wall clock.
+void PerfCounters::read( Sample & sample ) const {
+#ifdef __linux__
+    if ( m_leader >= 0 ) {
+        // Layout given by PERF_FORMAT_GROUP | TOTAL_TIME_ENABLED | TOTAL_TIME_RUNNING.
+        std::uint64_t buffer[3 + N_EVENTS];
+        if ( ::read( m_leader, buffer, sizeof( buffer ) ) > 0 ) {
+            // Raw counts: add_delta() scales each interval by its own times.
+            sample.enabled = buffer[1];
+            sample.running = buffer[2];
+            for ( int e{0}; e < N_EVENTS; e++ )
+                if ( m_index[e] >= 0 )
+                    sample.values[e] = buffer[3 + m_index[e]];
+        }
+    }
+#endif
+    sample.nanoseconds = now_ns();
+}
+
+/// Checks whether the group was not running for all the time it was enabled.
+bool PerfCounters::multiplexed(void) const {
+#ifdef __linux__
+    std::uint64_t buffer[3 + N_EVENTS];
+    if ( m_leader >= 0 and ::read( m_leader, buffer, sizeof( buffer ) ) > 0 )
+        return buffer[2] < buffer[1];
+#endif
+    return false;
+}
+
+/// Averages the difference between back to back snapshots.
+PerfCounters::Sample PerfCounters::overhead( unsigned reads ) const {
+    Sample total, begin, end;
+    for ( unsigned i{0}; i < reads; i++ ) {
+        read( begin );
+        read( end );
+        total.add_delta( begin, end );
+    }
+    for ( int e{0}; e < N_EVENTS; e++ )
+        total.values[e] /= reads;
+    total.nanoseconds /= reads;
+    return total;
+}
+
+/// Event names, as printed in the report.
+const char * PerfCounters::event_name( event_t event ) {
+    static const char * names[] = { "cycles", "instructions", "branch-misses", "L1D-misses", "LLC-misses" };
+    return names[ event ];
+}
+
+/// Adds `end - begin` to this sample.
+void PerfCounters::Sample::add_delta( const Sample & begin, const Sample & end ) {
+    // When multiplexed, the group only counted for `running` of the `enabled` nanoseconds of the
+    // interval: its counts are extrapolated to the whole interval, as perf(1) does.
+    const std::uint64_t d_enabled = end.enabled > begin.enabled ? end.enabled - begin.enabled : 0;
+    const std::uint64_t d_running = end.running > begin.running ? end.running - begin.running : 0;
+    const double scale = d_running > 0 and d_running < d_enabled ? double( d_enabled ) / d_running : 1.0;
+    for ( int e{0}; e < N_EVENTS; e++ ) {
+        const std::uint64_t delta = end.values[e] > begin.values[e] ? end.values[e] - begin.values[e] : 0;
+        values[e] += scale == 1.0 ? delta : static_cast< std::uint64_t >( delta * scale );
+    }
+    enabled += d_enabled;
+    running += d_running;
+    nanoseconds += end.nanoseconds - begin.nanoseconds;
+}
+
+/// Subtracts `times` copies of `cost`, without going below zero.
+void PerfCounters::Sample::subtract( const Sample & cost, std::uint64_t times ) {
+    for ( int e{0}; e < N_EVENTS; e++ )
+        values[e] -= std::min( values[e], cost.values[e] * times );
+    nanoseconds -= std::min( nanoseconds, cost.nanoseconds * times );
+}
+
+/// Evaluates the input stage by stage, reading the counters between them.
+int perf_counters_mode( std::istream & in, std::ostream & report ) {
+    PerfCounters pc;
+    if ( not pc.open() ) {
+        report << ">>> Hardware counters unavailable (" << std::strerror( pc.error() )
+               << "), reporting wall clock time only.\n";
+    }
+
+    // A read() of the group is a system call, which costs about as much as a short stage:
+    // its mean cost is measured first and taken out of every interval.
+    const PerfCounters::Sample overhead = pc.overhead( 1000 );
+
+    BaresManager bm;
+    Totals stages[N_STAGES];
+    Totals classes[Parser::ResultType::n_codes];
+    PerfCounters::Sample snap[N_STAGES + 1];
+
+    std::string expr;
+    while ( std::getline( in, expr ) ) {
+        pc.read( snap[PARSE] );
+        bool parsed = bm.parse( expr ).type == Parser::ResultType::OK;
+        pc.read( snap[TO_POSTFIX] );
+        if ( parsed ) bm.infix_to_postfix();
+        pc.read( snap[CALCULATE] );
+        if ( parsed ) bm.calculate();
+        pc.read( snap[OUTPUT] );
+        bm.print_result( expr );
+        pc.read( snap[N_STAGES] );
+
+        // The stages that were skipped (after a syntax error) are not counted as calls.
+        for ( int s{0}; s < N_STAGES; s++ ) {
+            if ( parsed or s == PARSE or s == OUTPUT ) stages[s].calls++;
+            stages[s].intervals++;
+            stages[s].sample.add_delta( snap[s], snap[s + 1] );
+        }
+        Totals & cls = classes[ bm.get_status().type ];
+        cls.calls++;
+        cls.intervals += N_STAGES; // One interval per stage, skipped or not.
+        cls.sample.add_delta( snap[PARSE], snap[N_STAGES] );
+    }
+
+    // Every interval, even the one of a skipped stage, holds the cost of a read.
+    for ( auto & stage : stages )
+        stage.sample.subtract( overhead, stage.intervals );
+    for ( auto & cls : classes )
+        cls.sample.subtract( overhead, cls.intervals );
+
+    report << "\n";
+    Totals per_interval;
+    per_interval.calls = 1;
+    per_interval.sample = overhead;
+    print_header( report, "measurement" );
+    print_row( report, pc, "overhead per interval", per_interval );
+    report << "\n";
+    print_header( report, "stage" );
+    for ( int s{0}; s < N_STAGES; s++ )
+        print_row( report, pc, stage_names[s], stages[s] );
+    report << "\n";
+    print_header( report, "expression class" );
+    for ( int c{0}; c < Parser::ResultType::n_codes; c++ )
+        if ( classes[c].calls > 0 )
+            print_row( report, pc, Parser::ResultType::code_name( Parser::ResultType::code_t(c) ), classes[c] );
+    if ( pc.multiplexed() )
+        report << ">>> Warning: the counters were multiplexed by the kernel, values are scaled estimates.\n";
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,380 @@
+#include <algorithm>   // std::min
+#include <atomic>      // std::atomic
+#include <cerrno>      // errno
+#include <chrono>      // std::chrono::steady_clock
+#include <cstdint>     // std::uint64_t
+#include <cstring>     // std::memchr, std::memcpy, std::strerror
+#include <limits>      // std::numeric_limits
+#include <memory>      // std::unique_ptr
+#include <sstream>     // std::ostringstream
+#include <string>      // std::string
+#include <string_view> // std::string_view
+#include <thread>      // std::thread
+#include <vector>      // std::vector
+
+#include <sys/stat.h>  // fstat()
+#include <unistd.h>    // read(), write(), lseek(), ftruncate(), fdatasync()
+
+#include "../include/pipeline.h"
+#include "../include/aggregate.h"
+#include "../include/checkpoint.h"
+#include "../include/bares_manager.h"
+#include "../lib/ring_buffer.h"
+
+namespace {
+    const std::size_t chunk_size = 1 << 18; //!< Bytes read into a batch, at least.
+
+    /// A chunk of the input, split into lines, and the output of those lines.
+    struct Batch {
+        std::uint64_t seq = 0;                   //!< Position of the batch in the input.
+        std::unique_ptr< char[] > data;          //!< The bytes read.
+        std::size_t capacity = 0;                //!< Size of `data`.
+        std::size_t size = 0;                    //!< How many bytes of `data` are used.
+        std::vector< std::string_view > lines;   //!< Lines inside `data`, without the newline.
+        std::size_t consumed = 0;                //!< Bytes of the input taken by the lines, newlines included.
+        std::string output;                      //!< What the lines produced.
+        Aggregate aggregate;                     //!< Their results, when the writer folds them in order.
+
+        /// Makes room for at least `n` bytes, keeping the content.
+        void reserve( std::size_t n ) {
+            if ( n <= capacity ) return;
+            std::unique_ptr< char[] > bigger{ new char[n] };
+            std::memcpy( bigger.get(), data.get(), size );
+            data = std::move( bigger );
+            capacity = n;
+        }
+    };
+
+    /// A stream buffer that appends everything to a string, reusing its storage.
+    class StringBuffer : public std::streambuf {
+        public:
+            /// Where the next characters go.
+            void set_target( std::string * target ) { m_target = target; }
+        protected:
+            int overflow( int c ) override {
+                if ( c != traits_type::eof() ) m_target->push_back( char( c ) );
+                return c;
+            }
+            std::streamsize xsputn( const char * s, std::streamsize n ) override {
+                m_target->append( s, n );
+                return n;
+            }
+        private:
+            std::string * m_target = nullptr;
+    };
+
+    /// The aggregate folded by one evaluator, alone on its cache lines: the evaluators write theirs at every line.
+    struct alignas(64) Partial {
+        Aggregate aggregate;
+    };
+
+    /// Returns the smallest power of two that is not smaller than n.
+    std::size_t power_of_two( std::size_t n ) {
+        std::size_t p{1};
+        while ( p < n ) p <<= 1;
+        return p;
+    }
+
+    /// The state shared by the stages.
+    struct Pipeline {
+        rb::spsc_ring< Batch * > free;  //!< Writer -> reader: batches to be refilled.
+        rb::mpmc_ring< Batch * > work;  //!< Reader -> evaluators: batches to be evaluated.
+        rb::mpmc_ring< Batch * > done;  //!< Evaluators -> writer: batches to be written.
+        std::atomic< std::uint64_t > total{ std::numeric_limits< std::uint64_t >::max() }; //!< Batches read, once known.
+        bool read_failed = false;       //!< Set by the reader, read after it is joined.
+
+        explicit Pipeline( std::size_t ring_capacity )
+            : free{ ring_capacity }, work{ ring_capacity }, done{ ring_capacity } {}
+    };
+
+    /**
+     * @brief Reads the input into batches of whole lines.
+     * @param cap most bytes kept of a line: only the first ones of a longer line are read into
+     *            memory, enough for it to exceed the limit of its length; the rest is skipped.
+     */
+    void reader( Pipeline & p, int in_fd, unsigned evaluators, std::size_t cap ) {
+        std::string carry; // The beginning of a line that continues in the next chunk.
+        std::uint64_t seq{0};
+        bool eof{false};
+
+        while ( not eof ) {
+            Batch * b = p.free.pop();
+            b->lines.clear();
+            b->output.clear();
+            b->aggregate = Aggregate{};
+            b->reserve( carry.size() + chunk_size );
+            std::memcpy( b->data.get(), carry.data(), carry.size() );
+            b->size = carry.size();
+            carry.clear();
+
+            // Read until we have at least one whole line (or the input ends). Until
+            // then, the whole batch is the first line, cut at `cap` bytes.
+            bool skipping{false};
+            std::uint64_t skipped{0}; // Bytes of the first line left out.
+            for (;;) {
+                if ( b->size == b->capacity ) b->reserve( 2 * b->capacity );
+                char * fresh = b->data.get() + b->size;
+                ssize_t n = read( in_fd, fresh, b->capacity - b->size );
+                if ( n < 0 and errno == EINTR ) continue;
+                if ( n <= 0 ) {
+                    p.read_failed = n < 0;
+                    eof = true;
+                    break;
+                }
+                const char * nl = static_cast< const char * >( std::memchr( fresh, '\n', n ) );
+                if ( skipping ) {
+                    const std::size_t skip = nl != nullptr ? nl - fresh : n;
+                    std::memmove( fresh, fresh + skip, n - skip );
+                    skipped += skip;
+                    n -= skip;
+                }
+                b->size += n;
+                if ( nl != nullptr ) break;
+                if ( b->size > cap ) {
+                    skipped += b->size - cap;
+                    b->size = cap;
+                    skipping = true;
+                }
+            }
+
+            // Split the whole lines; the last one, without a newline, waits for the next chunk.
+            std::string_view text{ b->data.get(), b->size };
+            std::size_t begin{0}, end;
+            while ( ( end = text.find( '\n', begin ) ) != std::string_view::npos ) {
+                b->lines.push_back( text.substr( begin, end - begin ) );
+                begin = end + 1;
+            }
+            if ( begin < text.size() ) {
+                // As with std::getline(), a last line without newline is still a line.
+                if ( eof ) b->lines.push_back( text.substr( begin ) );
+                else carry.assign( text.substr( begin ) );
+            }
+            b->consumed = text.size() - carry.size() + skipped;
+            b->seq = seq++;
+            p.work.push( b );
+        }
+        p.total.store( seq, std::memory_order_release );
+        // Tell every evaluator there is nothing else.
+        for ( unsigned i{0}; i < evaluators; i++ )
+            p.work.push( nullptr );
+    }
+
+    /**
+     * @brief Evaluates the lines of the batches, writing their results or folding them.
+     * @param partial when aggregating, the aggregate of this thread.
+     * @param per_batch when aggregating, whether the results go to the aggregate of each batch instead.
+     */
+    void evaluator( Pipeline & p, const Parser::Limits & limits, Aggregate * partial, bool per_batch ) {
+        BaresManager bm; // Reusable parser/evaluator state of this thread.
+        bm.set_limits( limits );
+        StringBuffer buffer;
+        std::ostream os{ &buffer };
+        std::string line;
+        while ( Batch * b = p.work.pop() ) {
+            buffer.set_target( &b->output );
+            Aggregate * into = per_batch ? &b->aggregate : partial;
+            for ( const auto & view : b->lines ) {
+                line.assign( view.data(), view.size() );
+                if ( into != nullptr ) {
+                    const Parser::ResultType result = bm.compute( line ); // Before get_value().
+                    into->add( result, bm.get_value() );
+                }
+                else
+                    bm.parse_and_compute( line, os );
+            }
+            p.done.push( b );
+        }
+    }
+
+    /// Writes a whole buffer. Returns false if the output is gone.
+    bool write_all( int fd, const std::string & text ) {
+        std::size_t written{0};
+        while ( written < text.size() ) {
+            ssize_t n = write( fd, text.data() + written, text.size() - written );
+            if ( n < 0 ) {
+                if ( errno == EINTR ) continue;
+                return false;
+            }
+            written += n;
+        }
+        return true;
+    }
+
+    /**
+     * @brief Prepares the input, the output and the state of a run, going on from the checkpoint when resuming.
+     *
+     * The input is moved to the first line not done (read and dropped, when it
+     * cannot seek), and a regular output file is cut to the size it had at
+     * the checkpoint, dropping what was written after it.
+     *
+     * @param what the parts of the aggregate, 0 when each result is written.
+     * @param state receives where the run starts.
+     * @return whether the run can start.
+     */
+    bool start( int in_fd, int out_fd, unsigned what, const Checkpoint::Options & options, Checkpoint & state ) {
+        state = Checkpoint{};
+        state.what = what;
+        struct stat out_stat;
+        const bool regular = fstat( out_fd, &out_stat ) == 0 and S_ISREG( out_stat.st_mode );
+        if ( not options.resume ) {
+            if ( regular ) state.output = static_cast< std::uint64_t >( out_stat.st_size );
+            return true;
+        }
+
+        if ( not state.load( options.path ) ) {
+            std::cerr << "Cannot read the checkpoint \"" << options.path << "\".\n";
+            return false;
+        }
+        if ( state.what != what ) {
+            std::cerr << "The checkpoint \"" << options.path << "\" is of another mode.\n";
+            return false;
+        }
+        if ( regular ) {
+            // A shorter output was not appended to (">>"): what was written before is lost.
+            if ( static_cast< std::uint64_t >( out_stat.st_size ) < state.output ) {
+                std::cerr << "The output is shorter than at the checkpoint; append to it when resuming.\n";
+                return false;
+            }
+            if ( ftruncate( out_fd, static_cast< off_t >( state.output ) ) != 0 or
+                 lseek( out_fd, 0, SEEK_END ) < 0 ) {
+                std::cerr << "Cannot cut the output: " << std::strerror( errno ) << "\n";
+                return false;
+            }
+        }
+        if ( lseek( in_fd, static_cast< off_t >( state.offset ), SEEK_SET ) < 0 ) {
+            // A pipe: the lines done are read again, but not evaluated.
+            std::unique_ptr< char[] > skipped{ new char[ chunk_size ] };
+            for ( std::uint64_t left{ state.offset }; left > 0; ) {
+                ssize_t n = read( in_fd, skipped.get(), std::min< std::uint64_t >( left, chunk_size ) );
+                if ( n < 0 and errno == EINTR ) continue;
+                if ( n <= 0 ) {
+                    std::cerr << "The input is shorter than at the checkpoint.\n";
+                    return false;
+                }
+                left -= static_cast< std::uint64_t >( n );
+            }
+        }
+        std::cerr << "Resuming at line " << state.lines + 1 << ".\n";
+        return true;
+    }
+
+    /// Records a checkpoint, once the output written so far is on disk.
+    bool record( int out_fd, const Checkpoint & state, const Checkpoint::Options & options ) {
+        // Only a regular file can be synced; for a pipe, written is as far as it goes.
+        if ( fdatasync( out_fd ) != 0 and errno != EINVAL and errno != EROFS ) return false;
+        return state.save( options.path );
+    }
+
+    /**
+     * @brief Runs the reader and the evaluators in their own threads, and the writer in this one.
+     *
+     * The writer advances `state` as it writes the batches, in input order, and
+     * records it as a checkpoint every `options.interval` seconds and at the end.
+     *
+     * @param partials with one aggregate per evaluator, the results are folded into them instead of written;
+     *                 when there are checkpoints, they are folded into `state.aggregate` instead, in order.
+     * @param state where the run starts, and where it stopped once it returns.
+     * @return whether the input was read and the output written.
+     */
+    bool run( int in_fd, int out_fd, unsigned evaluators, const Parser::Limits & limits,
+              std::vector< Partial > * partials, Checkpoint & state, const Checkpoint::Options & options ) {
+        const bool checkpoints = options.path != nullptr;
+        const bool per_batch = partials != nullptr and checkpoints;
+
+        // Enough batches to keep every stage busy; this bounds the memory.
+        const std::size_t n_batches = 4 * evaluators + 2;
+        Pipeline p{ power_of_two( n_batches + evaluators ) };
+        std::vector< std::unique_ptr< Batch > > pool;
+        for ( std::size_t i{0}; i < n_batches; i++ ) {
+            pool.emplace_back( new Batch );
+            p.free.push( pool.back().get() );
+        }
+
+        const std::size_t cap = limits.max_length == Parser::Limits::unlimited ? limits.max_length : limits.max_length + 1;
+        std::thread read_thread{ reader, std::ref( p ), in_fd, evaluators, cap };
+        std::vector< std::thread > eval_threads;
+        for ( unsigned i{0}; i < evaluators; i++ )
+            eval_threads.emplace_back( evaluator, std::ref( p ), std::cref( limits ),
+                                       partials != nullptr ? &( *partials )[i].aggregate : nullptr, per_batch );
+
+        // Writer: puts the batches back in order, by sequence number, and recycles them.
+        std::vector< Batch * > window( n_batches, nullptr );
+        std::uint64_t next{0};
+        bool write_failed{false}, record_failed{false};
+        auto recorded = std::chrono::steady_clock::now();
+        rb::backoff wait;
+        while ( next != p.total.load( std::memory_order_acquire ) ) {
+            Batch * b;
+            if ( not p.done.try_pop( b ) ) {
+                wait.pause();
+                continue;
+            }
+            wait = rb::backoff{};
+            // At most n_batches are in flight, so their slots never collide.
+            window[ b->seq % n_batches ] = b;
+            while ( ( b = window[ next % n_batches ] ) != nullptr ) {
+                if ( not write_failed and not write_all( out_fd, b->output ) ) {
+                    std::cerr << "Cannot write the output: " << std::strerror( errno ) << "\n";
+                    write_failed = true; // Keep draining so the other stages can finish.
+                }
+                // The lines of this batch are done: the state moves past them.
+                state.offset += b->consumed;
+                state.lines += b->lines.size();
+                state.output += b->output.size();
+                if ( per_batch ) state.aggregate.merge( b->aggregate );
+                window[ next % n_batches ] = nullptr;
+                p.free.push( b );
+                next++;
+            }
+            const auto now = std::chrono::steady_clock::now();
+            if ( checkpoints and not write_failed and not record_failed and
+                 now - recorded >= std::chrono::seconds( options.interval ) ) {
+                record_failed = not record( out_fd, state, options );
+                recorded = now;
+            }
+        }
+
+        read_thread.join();
+        for ( auto & t : eval_threads ) t.join();
+        if ( p.read_failed )
+            std::cerr << "Cannot read the input.\n";
+        // The last checkpoint: the whole input is done.
+        if ( checkpoints and not ( write_failed or p.read_failed or record_failed ) )
+            record_failed = not record( out_fd, state, options );
+        if ( record_failed )
+            std::cerr << "Cannot record the checkpoint \"" << options.path << "\": " << std::strerror( errno ) << "\n";
+        return not ( write_failed or p.read_failed or record_failed );
+    }
+}
+
+int pipeline_mode( int in_fd, int out_fd, unsigned evaluators, const Parser::Limits & limits,
+                   const Checkpoint::Options & options ) {
+    if ( evaluators == 0 ) evaluators = 1;
+    Checkpoint state;
+    if ( not start( in_fd, out_fd, 0, options, state ) )
+        return EXIT_FAILURE;
+    return run( in_fd, out_fd, evaluators, limits, nullptr, state, options ) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/// Each evaluator folds its own partial aggregate; they are merged once every line is done.
+int aggregate_mode( int in_fd, int out_fd, unsigned evaluators, unsigned what, const Parser::Limits & limits,
+                    const Checkpoint::Options & options ) {
+    if ( evaluators == 0 ) evaluators = 1;
+    Checkpoint state;
+    if ( not start( in_fd, out_fd, what, options, state ) )
+        return EXIT_FAILURE;
+    std::vector< Partial > partials( evaluators );
+    if ( not run( in_fd, out_fd, evaluators, limits, &partials, state, options ) )
+        return EXIT_FAILURE;
+    // With checkpoints, the writer already folded the batches, from the checkpoint on.
+    Aggregate total = state.aggregate;
+    for ( const auto & partial : partials )
+        total.merge( partial.aggregate );
+    std::ostringstream os;
+    total.print( os, what );
+    if ( not write_all( out_fd, os.str() ) ) {
+        std::cerr << "Cannot write the output: " << std::strerror( errno ) << "\n";
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,61 @@
+#include <cstdlib> // std::atoll
+
+#include "../include/program.h"
+#include "../include/operators.h"
+
+Program::opcode_t Program::opcode( char symbol ) {
+    switch ( symbol ) {
+        case '+': return ADD;
+        case '-': return SUB;
+        case '*': return MUL;
+        case '/': return DIV;
+        case '%': return MOD;
+        default:  return POW;
+    }
+}
+
+char Program::symbol( opcode_t op ) {
+    static const char symbols[] = { 0, '+', '-', '*', '/', '%', '^', 0, 0 };
+    return symbols[ op ];
+}
+
+/// Turns the postfix tokens into instructions.
+void Program::compile( const sc::vector< Token > & postfix, const SymbolTable * symbols ) {
+    code.clear();
+    for ( std::size_t i{0}; i < postfix.size(); i++ ) {
+        const Token & t = postfix[i];
+        if ( t.type == Token::token_t::OPERAND )
+            code.push_back( Instruction{ PUSH, std::atoll( t.value.c_str() ) } );
+        else if ( t.type == Token::token_t::VARIABLE )
+            code.push_back( Instruction{ LOAD, static_cast< Parser::input_int_type >( symbols->find( t.value ) ) } );
+        else
+            code.push_back( Instruction{ opcode( t.value[0] ), 0 } );
+    }
+}
+
+/// Runs the instructions on a stack of operands.
+Parser::ResultType Program::run( Parser::required_int_type & value, sta::stack< Parser::input_int_type > & st,
+                                 const Parser::required_int_type * values ) const {
+    st.clear();
+    for ( const Instruction & ins : code ) {
+        if ( ins.op == PUSH ) {
+            st.push( ins.value );
+            continue;
+        }
+        if ( ins.op == LOAD ) {
+            st.push( values[ ins.value ] );
+            continue;
+        }
+        if ( ins.op == FAIL )
+            return Parser::ResultType{ static_cast< Parser::ResultType::code_t >( ins.value ) };
+        Parser::input_int_type second_operand = st.pop();
+        Parser::input_int_type first_operand = st.pop();
+        Parser::input_int_type result{0};
+        Parser::ResultType::code_t code = apply_operator( symbol( ins.op ), first_operand, second_operand, result );
+        if ( code != Parser::ResultType::OK )
+            return Parser::ResultType{ code };
+        st.push( result );
+    }
+    value = static_cast< Parser::required_int_type >( st.top() );
+    return Parser::ResultType{ Parser::ResultType::OK };
+}
@@ -0,0 +1,193 @@
+/**
+ * @file replay.cpp
+ * @brief Corpus replay runner with golden output verification.
+ *
+ * Streams an input file through an evaluation engine, compares every produced
+ * line (values and error messages alike) with an expected output file and
+ * reports the throughput of the engine. Running it for each engine against the
+ * same golden files shows that an optimization does not change the output.
+ *
+ * Usage: bares_replay [--engine NAME] [--repeat N] [--max-diffs N] input expected
+ */
+
+#include <algorithm> // std::min
+#include <chrono>   // std::chrono::steady_clock
+#include <cstring>  // std::strcmp
+#include <fstream>  // std::ifstream
+#include <sstream>  // std::ostringstream
+#include <string>   // std::string
+#include <thread>   // std::thread::hardware_concurrency
+
+#include "../include/bares_manager.h"
+#include "../include/shape_batch.h"
+#include "../include/streaming_parser.h"
+
+namespace {
+    /// An evaluation engine: computes one line and writes its output exactly like `bares` does.
+    typedef void (*engine_fn)( BaresManager &, const std::string &, std::ostream & );
+
+    /// The engines that can be replayed.
+    struct Engine {
+        const char * name; //!< Name used in the command line.
+        engine_fn run;     //!< The engine itself.
+    };
+
+    /// Fork-join engine with a tiny cutoff, so that every expression goes through the tree.
+    ForkJoinEvaluator & fork_join_engine(void) {
+        static ForkJoinEvaluator engine{ std::thread::hardware_concurrency(), 2 };
+        return engine;
+    }
+
+    /// Parallel tokenizer cutting lines into one-byte slices, so that tokens are split everywhere.
+    ParallelTokenizer & tokenizer_engine(void) {
+        static ParallelTokenizer engine{ 4, 1 };
+        return engine;
+    }
+
+    const Engine engines[] = {
+        { "default", []( BaresManager & bm, const std::string & expr, std::ostream & os ) {
+              bm.parse_and_compute( expr, os );
+          } },
+        { "fork-join", []( BaresManager & bm, const std::string & expr, std::ostream & os ) {
+              bm.use_fork_join( &fork_join_engine(), 0 );
+              bm.parse_and_compute( expr, os );
+          } },
+        { "parallel-tokenizer", []( BaresManager & bm, const std::string & expr, std::ostream & os ) {
+              bm.use_parallel_tokenizer( &tokenizer_engine(), 0 );
+              bm.parse_and_compute( expr, os );
+          } },
+        { "optimizer", []( BaresManager & bm, const std::string & expr, std::ostream & os ) {
+              bm.use_optimizer( true );
+              bm.parse_and_compute( expr, os );
+          } },
+        { "jit", []( BaresManager & bm, const std::string & expr, std::ostream & os ) {
+              static JitProgram jit;
+              bm.use_jit( &jit );
+              bm.parse_and_compute( expr, os );
+          } },
+        { "dag", []( BaresManager & bm, const std::string & expr, std::ostream & os ) {
+              // The whole replay is one batch, so repeated lines are shared too.
+              static ExpressionDag dag;
+              bm.use_dag( &dag );
+              bm.parse_and_compute( expr, os );
+          } },
+        { "shapes", []( BaresManager &, const std::string & expr, std::ostream & os ) {
+              // A batch of one line: the shape and its columns are built and evaluated for each line.
+              static ShapeBatch batch;
+              batch.clear();
+              batch.add( expr );
+              batch.evaluate();
+              batch.print( os );
+          } },
+        { "streaming", []( BaresManager & bm, const std::string & expr, std::ostream & os ) {
+              // Three bytes at a time, so that integers and "-(" are split between chunks.
+              static StreamingParser parser;
+              parser.reset();
+              for ( std::size_t i{0}; i < expr.size(); i += 3 )
+                  parser.feed( expr.data() + i, std::min< std::size_t >( 3, expr.size() - i ) );
+              Parser::required_int_type value{0};
+              Parser::ResultType result = parser.finish( value );
+              if ( result.type == Parser::ResultType::OK )
+                  os << value << '\n';
+              else
+                  bm.print_error_msg( result, expr, os );
+          } },
+    };
+
+    /// Prints how to call the program.
+    void usage( const char * program ) {
+        std::cerr << "Usage: " << program << " [--engine NAME] [--repeat N] [--max-diffs N] input expected\n"
+                  << "  Engines:";
+        for ( const auto & e : engines ) std::cerr << " " << e.name;
+        std::cerr << "\n";
+    }
+}
+
+int main( int argc, char * argv[] ) {
+    const Engine * engine = &engines[0];
+    unsigned long repeat{1}, max_diffs{10};
+    const char * files[2] = { nullptr, nullptr };
+    int n_files{0};
+
+    for ( int i{1}; i < argc; i++ ) {
+        if ( std::strcmp( argv[i], "--engine" ) == 0 and i + 1 < argc ) {
+            engine = nullptr;
+            for ( const auto & e : engines )
+                if ( std::strcmp( e.name, argv[i + 1] ) == 0 ) engine = &e;
+            if ( engine == nullptr ) {
+                std::cerr << "Unknown engine \"" << argv[i + 1] << "\"\n";
+                usage( argv[0] );
+                return EXIT_FAILURE;
+            }
+            i++;
+        }
+        else if ( std::strcmp( argv[i], "--repeat" ) == 0 and i + 1 < argc )
+            repeat = std::stoul( argv[++i] );
+        else if ( std::strcmp( argv[i], "--max-diffs" ) == 0 and i + 1 < argc )
+            max_diffs = std::stoul( argv[++i] );
+        else if ( n_files < 2 )
+            files[n_files++] = argv[i];
+        else {
+            usage( argv[0] );
+            return EXIT_FAILURE;
+        }
+    }
+    if ( n_files != 2 or repeat == 0 ) {
+        usage( argv[0] );
+        return EXIT_FAILURE;
+    }
+
+    BaresManager bm;
+    std::ostringstream produced;
+    unsigned long lines{0}, bytes{0}, diffs{0};
+    std::chrono::steady_clock::duration elapsed{0};
+
+    for ( unsigned long pass{0}; pass < repeat; pass++ ) {
+        std::ifstream input{ files[0] }, expected{ files[1] };
+        if ( not input or not expected ) {
+            std::cerr << "Cannot open \"" << ( input ? files[1] : files[0] ) << "\"\n";
+            return EXIT_FAILURE;
+        }
+        std::string expr, want;
+        unsigned long line{0};
+        while ( std::getline( input, expr ) ) {
+            line++;
+            produced.str( "" );
+            auto start = std::chrono::steady_clock::now();
+            engine->run( bm, expr, produced );
+            elapsed += std::chrono::steady_clock::now() - start;
+            lines++;
+            bytes += expr.size() + 1;
+
+            // Only the first pass is verified, the others just measure.
+            if ( pass > 0 ) continue;
+            std::string got = produced.str();
+            if ( not got.empty() and got.back() == '\n' ) got.pop_back();
+            if ( not std::getline( expected, want ) ) {
+                if ( diffs++ < max_diffs )
+                    std::cerr << "line " << line << ": expected end of output, got \"" << got << "\"\n";
+            }
+            else if ( got != want ) {
+                if ( diffs++ < max_diffs )
+                    std::cerr << "line " << line << ": expected \"" << want << "\", got \"" << got << "\"\n";
+            }
+        }
+        // Any expected line left over was not produced.
+        while ( pass == 0 and std::getline( expected, want ) ) {
+            line++;
+            if ( diffs++ < max_diffs )
+                std::cerr << "line " << line << ": expected \"" << want << "\", got end of output\n";
+        }
+    }
+
+    double seconds = std::chrono::duration< double >( elapsed ).count();
+    std::cout << ">>> Engine \"" << engine->name << "\": " << lines << " lines, " << bytes << " bytes in "
+              << seconds << " s (" << ( seconds > 0 ? lines / seconds : 0 ) << " lines/s, "
+              << ( seconds > 0 ? bytes / seconds / 1e6 : 0 ) << " MB/s).\n";
+    if ( diffs > 0 ) {
+        std::cout << ">>> FAILED: " << diffs << " line(s) differ from \"" << files[1] << "\".\n";
+        return EXIT_FAILURE;
+    }
+    std::cout << ">>> PASSED: output matches \"" << files[1] << "\".\n";
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,449 @@
+#include <algorithm>     // std::min
+#include <cerrno>        // errno
+#include <csignal>       // SIGINT, SIGTERM
+#include <cstdint>       // std::uint64_t
+#include <cstring>       // std::memchr, std::strerror, std::strncpy
+#include <condition_variable>
+#include <deque>         // std::deque
+#include <map>           // std::map
+#include <memory>        // std::unique_ptr
+#include <mutex>         // std::mutex
+#include <sstream>       // std::ostringstream
+#include <string>        // std::string
+#include <thread>        // std::thread
+#include <unordered_map> // std::unordered_map
+#include <vector>        // std::vector
+
+#include <sys/epoll.h>    // epoll_create1(), epoll_ctl(), epoll_wait()
+#include <sys/eventfd.h>  // eventfd()
+#include <sys/signalfd.h> // signalfd()
+#include <sys/socket.h>   // socket(), bind(), listen(), connect(), accept4(), send()
+#include <sys/stat.h>     // stat()
+#include <sys/un.h>       // sockaddr_un
+#include <unistd.h>       // read(), close(), unlink()
+
+#include "../include/server.h"
+#include "../include/bares_manager.h"
+
+namespace {
+    const std::size_t max_batch_lines = 256;         //!< Lines sent to a worker at once.
+    const std::uint64_t max_batches_in_flight = 64;  //!< Per connection, before we stop reading it.
+    const std::size_t max_pending_output = 1 << 20;  //!< Per connection, before we stop reading it.
+    const std::size_t read_chunk = 1 << 16;          //!< Bytes read per read() call.
+    const std::size_t max_line_length = 1 << 24;     //!< Longest line without --max-length.
+
+    //=== epoll identifiers that are not connections.
+    const std::uint64_t LISTENER_ID = 0;
+    const std::uint64_t EVENTFD_ID = 1;
+    const std::uint64_t SIGNALFD_ID = 2;
+
+    /// A group of lines of a connection, evaluated by a worker.
+    struct Job {
+        std::uint64_t conn_id;            //!< The connection the lines came from.
+        std::uint64_t seq;                //!< Order of the batch inside the connection.
+        std::vector< std::string > lines; //!< The expressions.
+    };
+
+    /// The replies to a job.
+    struct Reply {
+        std::uint64_t conn_id; //!< The connection the replies go to.
+        std::uint64_t seq;     //!< Order of the batch inside the connection.
+        std::string text;      //!< One line per expression.
+    };
+
+    /// A blocking queue of jobs, shared by all the workers.
+    class JobQueue {
+        public:
+            /// Adds a job and wakes up a worker.
+            void push( Job && job ) {
+                {
+                    std::lock_guard< std::mutex > lock{ m_mutex };
+                    m_jobs.push_back( std::move( job ) );
+                }
+                m_cond.notify_one();
+            }
+            /// Waits for a job. Returns false when the queue has been closed.
+            bool pop( Job & job ) {
+                std::unique_lock< std::mutex > lock{ m_mutex };
+                m_cond.wait( lock, [this]{ return m_closed or not m_jobs.empty(); } );
+                if ( m_jobs.empty() ) return false;
+                job = std::move( m_jobs.front() );
+                m_jobs.pop_front();
+                return true;
+            }
+            /// Releases all the workers waiting for jobs.
+            void close(void) {
+                {
+                    std::lock_guard< std::mutex > lock{ m_mutex };
+                    m_closed = true;
+                }
+                m_cond.notify_all();
+            }
+        private:
+            std::mutex m_mutex;
+            std::condition_variable m_cond;
+            std::deque< Job > m_jobs;
+            bool m_closed{false};
+    };
+
+    /// Replies produced by the workers, collected by the event loop when the eventfd fires.
+    class ReplyQueue {
+        public:
+            explicit ReplyQueue( int event_fd ) : m_event_fd{ event_fd } {}
+            /// Adds a reply and wakes up the event loop.
+            void push( Reply && reply ) {
+                {
+                    std::lock_guard< std::mutex > lock{ m_mutex };
+                    m_replies.push_back( std::move( reply ) );
+                }
+                std::uint64_t one{1};
+                while ( write( m_event_fd, &one, sizeof( one ) ) < 0 and errno == EINTR ) /* retry */ ;
+            }
+            /// Takes every reply available.
+            void drain( std::vector< Reply > & out ) {
+                std::lock_guard< std::mutex > lock{ m_mutex };
+                out.swap( m_replies );
+            }
+        private:
+            int m_event_fd;
+            std::mutex m_mutex;
+            std::vector< Reply > m_replies;
+    };
+
+    /// The state of a client.
+    struct Connection {
+        int fd;                                       //!< The client socket.
+        std::uint64_t id;                             //!< Identifier used by epoll and by the jobs.
+        std::string in;                               //!< Bytes that do not make up a full line yet (up to the cap).
+        std::string out;                              //!< Replies ready to be written.
+        std::size_t out_pos = 0;                      //!< How much of `out` was already written.
+        std::uint64_t next_batch = 0;                 //!< Sequence number of the next batch dispatched.
+        std::uint64_t next_reply = 0;                 //!< Sequence number of the next batch to be written.
+        std::map< std::uint64_t, std::string > ready; //!< Replies that arrived before earlier ones.
+        bool eof = false;                             //!< The client will not send anything else.
+        bool registered = false;                      //!< Whether the socket was added to epoll.
+        std::uint32_t events = 0;                     //!< Events currently registered in epoll.
+    };
+
+    /// Evaluates jobs until the queue is closed.
+    void worker( JobQueue & jobs, ReplyQueue & replies, const Parser::Limits & limits ) {
+        BaresManager bm; // Reusable parser/evaluator state of this worker.
+        bm.set_limits( limits );
+        std::ostringstream os;
+        Job job;
+        while ( jobs.pop( job ) ) {
+            os.str( "" );
+            for ( const auto & line : job.lines )
+                bm.parse_and_compute( line, os );
+            replies.push( Reply{ job.conn_id, job.seq, os.str() } );
+        }
+    }
+
+    /// The event loop.
+    class Server {
+        public:
+            Server( int epoll_fd, int listen_fd, JobQueue & jobs, ReplyQueue & replies, std::size_t max_length )
+                : m_epoll{ epoll_fd }, m_listen{ listen_fd }, m_jobs{ jobs }, m_replies{ replies },
+                  m_line_cap{ max_length + 1 } {}
+
+            /// Handles one epoll event. Returns false when the server must stop.
+            bool handle( const epoll_event & ev, int event_fd, int signal_fd );
+
+        private:
+            void accept_clients(void);
+            void read_client( Connection & c );
+            void append( Connection & c, const char * from, const char * to );
+            void dispatch( Connection & c, std::vector< std::string > & lines );
+            void collect_replies( int event_fd );
+            void flush( Connection & c );
+            void update_events( Connection & c );
+            void close_client( Connection & c );
+            bool finished( const Connection & c ) const {
+                return c.eof and c.next_reply == c.next_batch and c.out_pos == c.out.size();
+            }
+
+            int m_epoll;
+            int m_listen;
+            JobQueue & m_jobs;
+            ReplyQueue & m_replies;
+            std::uint64_t m_next_id{ SIGNALFD_ID + 1 };
+            std::unordered_map< std::uint64_t, std::unique_ptr< Connection > > m_conns;
+            std::vector< Reply > m_batch; //!< Replies taken from the queue, reused.
+            std::size_t m_line_cap;       //!< Bytes of a line kept: one more than the longest line allowed.
+    };
+
+    bool Server::handle( const epoll_event & ev, int event_fd, int signal_fd ) {
+        switch ( ev.data.u64 ) {
+            case LISTENER_ID: accept_clients(); return true;
+            case EVENTFD_ID: collect_replies( event_fd ); return true;
+            case SIGNALFD_ID: {
+                // SIGINT or SIGTERM: time to stop.
+                signalfd_siginfo info;
+                while ( read( signal_fd, &info, sizeof( info ) ) < 0 and errno == EINTR ) /* retry */ ;
+                return false;
+            }
+        }
+        auto it = m_conns.find( ev.data.u64 );
+        if ( it == m_conns.end() ) return true;
+        Connection & c = *it->second;
+        if ( ev.events & ( EPOLLERR | EPOLLHUP ) ) {
+            close_client( c );
+            return true;
+        }
+        if ( ev.events & EPOLLOUT ) flush( c );
+        if ( m_conns.count( ev.data.u64 ) and ( ev.events & ( EPOLLIN | EPOLLRDHUP ) ) ) read_client( c );
+        return true;
+    }
+
+    /// Accepts every pending client.
+    void Server::accept_clients(void) {
+        int fd;
+        while ( ( fd = accept4( m_listen, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC ) ) >= 0 ) {
+            std::unique_ptr< Connection > c{ new Connection };
+            c->fd = fd;
+            c->id = m_next_id++;
+            Connection & ref = *c;
+            m_conns.emplace( c->id, std::move( c ) );
+            update_events( ref );
+        }
+    }
+
+    /// Reads what the client sent and dispatches the complete lines.
+    void Server::read_client( Connection & c ) {
+        std::vector< std::string > lines;
+        char buffer[read_chunk];
+        ssize_t n = read( c.fd, buffer, sizeof( buffer ) );
+        if ( n < 0 ) {
+            if ( errno != EAGAIN and errno != EWOULDBLOCK and errno != EINTR ) close_client( c );
+            return;
+        }
+        if ( n == 0 ) {
+            // The last line may not end with a newline, as with std::getline().
+            c.eof = true;
+            if ( not c.in.empty() ) {
+                lines.push_back( std::move( c.in ) );
+                c.in.clear();
+            }
+        }
+        else {
+            const char * from = buffer;
+            const char * end = buffer + n;
+            while ( const char * nl = static_cast< const char * >( std::memchr( from, '\n', end - from ) ) ) {
+                append( c, from, nl );
+                lines.push_back( c.in );
+                c.in.clear();
+                from = nl + 1;
+            }
+            append( c, from, end );
+        }
+        dispatch( c, lines );
+        if ( finished( c ) ) close_client( c );
+        else update_events( c );
+    }
+
+    /**
+     * @brief Adds bytes to the line being read, keeping at most m_line_cap of them.
+     *
+     * A line over the limit is evaluated from its first m_line_cap bytes,
+     * which is enough for the LIMIT_EXCEEDED of the whole line; the rest is
+     * dropped as it arrives, so a client that never sends a newline holds at
+     * most m_line_cap bytes.
+     */
+    void Server::append( Connection & c, const char * from, const char * to ) {
+        std::size_t room = m_line_cap - std::min( m_line_cap, c.in.size() );
+        c.in.append( from, std::min< std::size_t >( room, to - from ) );
+    }
+
+    /// Splits the lines into batches and hands them to the workers.
+    void Server::dispatch( Connection & c, std::vector< std::string > & lines ) {
+        for ( std::size_t first{0}; first < lines.size(); first += max_batch_lines ) {
+            Job job{ c.id, c.next_batch++, {} };
+            std::size_t last = std::min( lines.size(), first + max_batch_lines );
+            job.lines.reserve( last - first );
+            for ( std::size_t i{first}; i < last; i++ )
+                job.lines.push_back( std::move( lines[i] ) );
+            m_jobs.push( std::move( job ) );
+        }
+    }
+
+    /// Puts the replies of the workers in order and writes them.
+    void Server::collect_replies( int event_fd ) {
+        std::uint64_t counter;
+        while ( read( event_fd, &counter, sizeof( counter ) ) < 0 and errno == EINTR ) /* retry */ ;
+        m_batch.clear();
+        m_replies.drain( m_batch );
+        for ( auto & reply : m_batch ) {
+            auto it = m_conns.find( reply.conn_id );
+            if ( it == m_conns.end() ) continue; // The client has gone away.
+            Connection & c = *it->second;
+            c.ready.emplace( reply.seq, std::move( reply.text ) );
+            // Append every reply that is now in order.
+            for ( auto r = c.ready.begin(); r != c.ready.end() and r->first == c.next_reply; r = c.ready.erase( r ) ) {
+                c.out += r->second;
+                c.next_reply++;
+            }
+            flush( c );
+        }
+    }
+
+    /// Writes as much of the pending output as the socket accepts.
+    void Server::flush( Connection & c ) {
+        while ( c.out_pos < c.out.size() ) {
+            ssize_t n = send( c.fd, c.out.data() + c.out_pos, c.out.size() - c.out_pos, MSG_NOSIGNAL );
+            if ( n < 0 ) {
+                if ( errno == EINTR ) continue;
+                if ( errno == EAGAIN or errno == EWOULDBLOCK ) break;
+                close_client( c );
+                return;
+            }
+            c.out_pos += n;
+        }
+        if ( c.out_pos == c.out.size() ) {
+            c.out.clear();
+            c.out_pos = 0;
+        }
+        if ( finished( c ) ) close_client( c );
+        else update_events( c );
+    }
+
+    /// Registers the events we want for a client: it is not read while it has too much work in flight.
+    void Server::update_events( Connection & c ) {
+        std::uint32_t events{0};
+        bool busy = c.next_batch - c.next_reply >= max_batches_in_flight or
+                    c.out.size() - c.out_pos >= max_pending_output;
+        if ( not c.eof and not busy ) events |= EPOLLIN | EPOLLRDHUP;
+        if ( c.out_pos < c.out.size() ) events |= EPOLLOUT;
+        if ( c.registered and events == c.events ) return;
+
+        epoll_event ev{};
+        ev.events = events;
+        ev.data.u64 = c.id;
+        if ( epoll_ctl( m_epoll, c.registered ? EPOLL_CTL_MOD : EPOLL_CTL_ADD, c.fd, &ev ) != 0 ) {
+            // A client that cannot be watched would never be served.
+            std::cerr << "Cannot watch a client: " << std::strerror( errno ) << "\n";
+            close_client( c );
+            return;
+        }
+        c.registered = true;
+        c.events = events;
+    }
+
+    /// Forgets a client. Replies still being computed for it are discarded when they arrive.
+    void Server::close_client( Connection & c ) {
+        // Closing the socket removes it from epoll anyway; a failure here is only reported.
+        if ( c.registered and epoll_ctl( m_epoll, EPOLL_CTL_DEL, c.fd, nullptr ) != 0 )
+            std::cerr << "Cannot stop watching a client: " << std::strerror( errno ) << "\n";
+        close( c.fd );
+        m_conns.erase( c.id );
+    }
+
+    /// Adds a file descriptor that is not a connection to epoll.
+    bool watch( int epoll_fd, int fd, std::uint64_t id ) {
+        epoll_event ev{};
+        ev.events = EPOLLIN;
+        ev.data.u64 = id;
+        return epoll_ctl( epoll_fd, EPOLL_CTL_ADD, fd, &ev ) == 0;
+    }
+
+    /// Whether the socket file of `addr` was left by a server that is gone: nothing listens on it.
+    bool stale( const sockaddr_un & addr ) {
+        int fd = socket( AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0 );
+        if ( fd < 0 ) return false;
+        const bool refused = connect( fd, reinterpret_cast< const sockaddr * >( &addr ), sizeof( addr ) ) < 0 and
+                             errno == ECONNREFUSED;
+        close( fd );
+        return refused;
+    }
+
+    /// Creates the listening socket, replacing a stale socket file; fails with EADDRINUSE while a server listens there.
+    int listen_on( const char * path ) {
+        sockaddr_un addr{};
+        if ( std::strlen( path ) >= sizeof( addr.sun_path ) ) {
+            errno = ENAMETOOLONG;
+            return -1;
+        }
+        addr.sun_family = AF_UNIX;
+        std::strncpy( addr.sun_path, path, sizeof( addr.sun_path ) - 1 );
+
+        struct stat st;
+        if ( stat( path, &st ) == 0 and S_ISSOCK( st.st_mode ) ) {
+            if ( not stale( addr ) ) {
+                errno = EADDRINUSE; // A running server, which keeps its path.
+                return -1;
+            }
+            unlink( path );
+        }
+
+        int fd = socket( AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0 );
+        if ( fd < 0 ) return -1;
+        if ( bind( fd, reinterpret_cast< sockaddr * >( &addr ), sizeof( addr ) ) < 0 or listen( fd, SOMAXCONN ) < 0 ) {
+            int saved = errno;
+            close( fd );
+            errno = saved;
+            return -1;
+        }
+        return fd;
+    }
+}
+
+/// Runs the server until it gets SIGINT or SIGTERM.
+int serve_mode( const char * path, unsigned workers, const Parser::Limits & client_limits ) {
+    if ( workers == 0 ) workers = 1;
+    // Clients are not trusted: a line is always limited, so that reading it takes bounded memory.
+    Parser::Limits limits{ client_limits };
+    limits.max_length = std::min( limits.max_length, max_line_length );
+
+    // Signals are handled by the event loop; the workers inherit the mask.
+    sigset_t mask;
+    sigemptyset( &mask );
+    sigaddset( &mask, SIGINT );
+    sigaddset( &mask, SIGTERM );
+    pthread_sigmask( SIG_BLOCK, &mask, nullptr );
+
+    int listen_fd = listen_on( path );
+    if ( listen_fd < 0 ) {
+        std::cerr << "Cannot listen on \"" << path << "\": " << std::strerror( errno ) << "\n";
+        return EXIT_FAILURE;
+    }
+    int epoll_fd = epoll_create1( EPOLL_CLOEXEC );
+    int event_fd = eventfd( 0, EFD_NONBLOCK | EFD_CLOEXEC );
+    int signal_fd = signalfd( -1, &mask, SFD_NONBLOCK | SFD_CLOEXEC );
+    if ( epoll_fd < 0 or event_fd < 0 or signal_fd < 0 or
+         not watch( epoll_fd, listen_fd, LISTENER_ID ) or
+         not watch( epoll_fd, event_fd, EVENTFD_ID ) or
+         not watch( epoll_fd, signal_fd, SIGNALFD_ID ) ) {
+        std::cerr << "Cannot set up the event loop: " << std::strerror( errno ) << "\n";
+        unlink( path );
+        return EXIT_FAILURE;
+    }
+
+    JobQueue jobs;
+    ReplyQueue replies{ event_fd };
+    std::vector< std::thread > pool;
+    for ( unsigned i{0}; i < workers; i++ )
+        pool.emplace_back( worker, std::ref( jobs ), std::ref( replies ), std::cref( limits ) );
+
+    {
+        Server server{ epoll_fd, listen_fd, jobs, replies, limits.max_length };
+        epoll_event events[64];
+        bool running{true};
+        while ( running ) {
+            int n = epoll_wait( epoll_fd, events, 64, -1 );
+            if ( n < 0 and errno != EINTR ) {
+                std::cerr << "epoll_wait: " << std::strerror( errno ) << "\n";
+                break;
+            }
+            for ( int i{0}; i < n and running; i++ )
+                running = server.handle( events[i], event_fd, signal_fd );
+        }
+        jobs.close();
+        for ( auto & t : pool ) t.join();
+    }
+
+    close( signal_fd );
+    close( event_fd );
+    close( epoll_fd );
+    close( listen_fd );
+    unlink( path );
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,95 @@
+#include "../include/shape_batch.h"
+
+/// Parses and compiles a line; its opcodes are its shape, its literals go to the columns of the group.
+void ShapeBatch::add( const std::string & expr ) {
+    m_status.push_back( m_bm.parse( expr ) );
+    m_values.push_back( 0 );
+    if ( m_status.back().type != Parser::ResultType::OK )
+        return;
+    m_bm.infix_to_postfix();
+    m_bm.compile( m_program );
+
+    m_shape.clear();
+    for ( const Program::Instruction & ins : m_program.code )
+        m_shape.push_back( static_cast< char >( ins.op ) );
+    auto found = m_index.emplace( m_shape, m_used );
+    if ( found.second ) {
+        // A new shape: its program loads the j-th literal from the j-th column.
+        if ( m_used == m_groups.size() )
+            m_groups.emplace_back();
+        Group & group = m_groups[ m_used++ ];
+        group.program.code = m_program.code;
+        std::size_t literals{0};
+        for ( Program::Instruction & ins : group.program.code )
+            if ( ins.op == Program::PUSH )
+                ins = Program::Instruction{ Program::LOAD, static_cast< Parser::input_int_type >( literals++ ) };
+        group.columns.resize( literals );
+        for ( auto & column : group.columns )
+            column.clear();
+        group.lines.clear();
+    }
+
+    Group & group = m_groups[ found.first->second ];
+    std::size_t j{0};
+    for ( const Program::Instruction & ins : m_program.code )
+        if ( ins.op == Program::PUSH )
+            group.columns[ j++ ].push_back( static_cast< Parser::required_int_type >( ins.value ) );
+    group.lines.push_back( m_status.size() - 1 );
+}
+
+/// Runs the program of each shape once over its lines, then scatters the results back to the lines.
+void ShapeBatch::evaluate(void) {
+    for ( std::size_t g{0}; g < m_used; g++ ) {
+        const Group & group = m_groups[g];
+        const std::size_t rows = group.lines.size();
+        m_pointers.clear();
+        for ( const auto & column : group.columns )
+            m_pointers.push_back( column.data() );
+        m_results.resize( rows );
+        m_codes.resize( rows );
+
+        m_columnar.compile( group.program );
+        m_columnar.evaluate( m_pointers.data(), rows, m_results.data(), m_codes.data() );
+        for ( std::size_t r{0}; r < rows; r++ ) {
+            const std::size_t line = group.lines[r];
+            m_status[line] = Parser::ResultType{ static_cast< Parser::ResultType::code_t >( m_codes[r] ) };
+            m_values[line] = m_results[r];
+        }
+    }
+}
+
+/// Writes the results in the order of the lines.
+void ShapeBatch::print( std::ostream & os ) {
+    for ( std::size_t line{0}; line < m_status.size(); line++ ) {
+        if ( m_status[line].type == Parser::ResultType::OK )
+            os << m_values[line] << '\n';
+        else
+            m_bm.print_error_msg( m_status[line], "", os );
+    }
+}
+
+/// Forgets the lines and the shapes; the groups keep their storage.
+void ShapeBatch::clear(void) {
+    m_index.clear();
+    m_used = 0;
+    m_status.clear();
+    m_values.clear();
+}
+
+/// Reads the input in batches, evaluating each one shape by shape.
+int shapes_mode( std::istream & is, std::ostream & os, std::size_t batch ) {
+    ShapeBatch lines;
+    std::string expr;
+    while ( std::getline( is, expr ) ) {
+        lines.add( expr );
+        if ( lines.size() == batch ) {
+            lines.evaluate();
+            lines.print( os );
+            lines.clear();
+        }
+    }
+    lines.evaluate();
+    lines.print( os );
+    os.flush();
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,265 @@
+#include <algorithm>  // std::count, std::min
+#include <cerrno>     // errno
+#include <cstdint>    // std::uint64_t
+#include <cstring>    // std::memchr, std::strerror
+#include <fstream>    // std::ifstream
+#include <functional> // std::greater
+#include <memory>     // std::unique_ptr
+#include <queue>      // std::priority_queue
+#include <sstream>    // std::ostringstream
+#include <utility>    // std::pair
+
+#include <sys/stat.h> // fstat
+#include <unistd.h>   // pread
+
+#include "../include/shard.h"
+#include "../include/bares_manager.h"
+
+namespace {
+    const std::size_t read_size = 1 << 20; //!< Bytes read at a time.
+
+    /// Reads up to `size` bytes at `offset`; returns how many, or -1.
+    ssize_t read_at( int fd, char * data, std::size_t size, std::uint64_t offset ) {
+        ssize_t n;
+        do n = pread( fd, data, size, static_cast< off_t >( offset ) );
+        while ( n < 0 and errno == EINTR );
+        return n;
+    }
+
+    /**
+     * @brief Where shard `k` of `count` begins: the first line that begins at or after `k / count` of the file.
+     * @return the offset, or `size` when no line begins there; -1 when the file cannot be read.
+     */
+    std::int64_t cut( int fd, std::uint64_t size, unsigned long k, unsigned long count, char * buffer ) {
+        if ( k == 0 ) return 0;
+        if ( k == count ) return static_cast< std::int64_t >( size );
+        // size * k / count, without overflow.
+        std::uint64_t at = size / count * k + size % count * k / count;
+        if ( at == 0 ) return 0;
+        // A line begins at `at` when the byte before it is a newline.
+        for ( at = at - 1; at < size; ) {
+            ssize_t n = read_at( fd, buffer, read_size, at );
+            if ( n <= 0 ) return -1;
+            if ( const char * nl = static_cast< const char * >( std::memchr( buffer, '\n', n ) ) )
+                return static_cast< std::int64_t >( at + ( nl - buffer ) + 1 );
+            at += n;
+        }
+        return static_cast< std::int64_t >( size );
+    }
+
+    /// What the output of a shard tells of itself.
+    struct Manifest {
+        unsigned long index = 0, count = 0; //!< From its first line, `#shard I/N FIRST`.
+        std::uint64_t first = 0;            //!< Ditto: the number of its first line.
+        std::uint64_t end = 0;              //!< From its last line, `#end END`: one past its last line.
+        bool ended = false;                 //!< Whether the last line was read.
+        std::uint64_t next = 0;             //!< The number the next tagged line must have.
+    };
+
+    /// Reads `#shard I/N FIRST`.
+    bool read_header( const std::string & line, Manifest & m ) {
+        std::istringstream is{ line };
+        std::string tag;
+        char slash{0};
+        return is >> tag >> m.index >> slash >> m.count >> m.first and tag == "#shard" and slash == '/' and
+               m.index < m.count and m.first >= 1 and ( is >> std::ws ).eof();
+    }
+
+    /// Reads `#end END`.
+    bool read_trailer( const std::string & line, Manifest & m ) {
+        std::istringstream is{ line };
+        std::string tag;
+        return is >> tag >> m.end and tag == "#end" and m.end >= m.first and ( is >> std::ws ).eof();
+    }
+}
+
+/// Finds the cuts, counts the lines before the shard, then evaluates its lines one by one.
+int shard_mode( int in_fd, std::ostream & os, unsigned long index, unsigned long count, const Parser::Limits & limits ) {
+    struct stat st;
+    if ( fstat( in_fd, &st ) != 0 or not S_ISREG( st.st_mode ) ) {
+        std::cerr << "A shard needs the input in a regular file.\n";
+        return EXIT_FAILURE;
+    }
+    const std::uint64_t size = static_cast< std::uint64_t >( st.st_size );
+    std::unique_ptr< char[] > buffer{ new char[ read_size ] };
+    const std::int64_t first = cut( in_fd, size, index, count, buffer.get() );
+    const std::int64_t last = cut( in_fd, size, index + 1, count, buffer.get() );
+    if ( first < 0 or last < 0 ) {
+        std::cerr << "Cannot read the input: " << std::strerror( errno ) << "\n";
+        return EXIT_FAILURE;
+    }
+
+    // The number of the first line: one more than the newlines before it, and
+    // one more still past the end of a file whose last line has no newline.
+    std::uint64_t line{1};
+    char before{'\n'};
+    for ( std::uint64_t at{0}; at < static_cast< std::uint64_t >( first ); ) {
+        ssize_t n = read_at( in_fd, buffer.get(), std::min< std::uint64_t >( read_size, first - at ), at );
+        if ( n <= 0 ) {
+            std::cerr << "Cannot read the input: " << std::strerror( errno ) << "\n";
+            return EXIT_FAILURE;
+        }
+        line += static_cast< std::uint64_t >( std::count( buffer.get(), buffer.get() + n, '\n' ) );
+        before = buffer[ n - 1 ];
+        at += n;
+    }
+    if ( before != '\n' ) line++;
+
+    BaresManager bm;
+    bm.set_limits( limits );
+    std::ostringstream out;
+    out << "#shard " << index << '/' << count << ' ' << line << '\n';
+    std::string expr; // The line being read, which may span several reads.
+    auto evaluate = [&]() {
+        out << line++ << '\t';
+        bm.parse_and_compute( expr, out );
+        expr.clear();
+        if ( out.tellp() >= ( 1 << 16 ) ) {
+            os << out.str();
+            out.str( "" );
+        }
+    };
+    for ( std::uint64_t at = first; at < static_cast< std::uint64_t >( last ); ) {
+        ssize_t n = read_at( in_fd, buffer.get(), std::min< std::uint64_t >( read_size, last - at ), at );
+        if ( n <= 0 ) {
+            std::cerr << "Cannot read the input: " << std::strerror( errno ) << "\n";
+            return EXIT_FAILURE;
+        }
+        const char * from = buffer.get();
+        const char * end = buffer.get() + n;
+        while ( const char * nl = static_cast< const char * >( std::memchr( from, '\n', end - from ) ) ) {
+            expr.append( from, nl );
+            evaluate();
+            from = nl + 1;
+        }
+        expr.append( from, end );
+        at += n;
+    }
+    // As with std::getline(), a last line without newline is still a line.
+    if ( not expr.empty() )
+        evaluate();
+    out << "#end " << line << '\n';
+    os << out.str();
+    os.flush();
+    return EXIT_SUCCESS;
+}
+
+/// Checks the first lines, keeps the first unread line of each file in a min-heap, by line number, then checks the last lines.
+int merge_mode( const std::vector< std::string > & paths, std::ostream & os ) {
+    std::vector< std::unique_ptr< std::ifstream > > files;
+    std::vector< Manifest > shards( paths.size() );
+    std::string tagged;
+    for ( std::size_t f{0}; f < paths.size(); f++ ) {
+        files.emplace_back( new std::ifstream{ paths[f] } );
+        if ( not *files.back() ) {
+            std::cerr << "Cannot open \"" << paths[f] << "\"\n";
+            return EXIT_FAILURE;
+        }
+        if ( not std::getline( *files.back(), tagged ) or not read_header( tagged, shards[f] ) ) {
+            std::cerr << "\"" << paths[f] << "\" is not the output of a shard.\n";
+            return EXIT_FAILURE;
+        }
+        shards[f].next = shards[f].first;
+    }
+
+    // Every shard of the same cut, each one once, before anything is written.
+    const unsigned long count = shards[0].count;
+    std::vector< std::size_t > by_index( count, paths.size() );
+    for ( std::size_t f{0}; f < paths.size(); f++ ) {
+        if ( shards[f].count != count ) {
+            std::cerr << "\"" << paths[f] << "\" is a shard of " << shards[f].count << ", not of " << count << ".\n";
+            return EXIT_FAILURE;
+        }
+        if ( by_index[ shards[f].index ] != paths.size() ) {
+            std::cerr << "Shard " << shards[f].index << '/' << count << " is given twice.\n";
+            return EXIT_FAILURE;
+        }
+        by_index[ shards[f].index ] = f;
+    }
+    for ( unsigned long i{0}; i < count; i++ )
+        if ( by_index[i] == paths.size() ) {
+            std::cerr << "Shard " << i << '/' << count << " is missing.\n";
+            return EXIT_FAILURE;
+        }
+
+    // The first unread line of each file: its number, and which file.
+    typedef std::pair< std::uint64_t, std::size_t > head_t;
+    std::priority_queue< head_t, std::vector< head_t >, std::greater< head_t > > heads;
+    std::vector< std::string > results( files.size() );
+    bool malformed{false};
+    // Once a line is malformed, it stays so: a good line of another file does not clear it.
+    auto advance = [&]( std::size_t f ) {
+        if ( not std::getline( *files[f], tagged ) ) return; // Without its last line: reported below.
+        bool bad{false};
+        if ( tagged.compare( 0, 5, "#end " ) == 0 ) {
+            shards[f].ended = read_trailer( tagged, shards[f] );
+            bad = not shards[f].ended;
+        }
+        else {
+            std::size_t tab = tagged.find( '\t' );
+            std::uint64_t number{0};
+            try {
+                std::size_t used{0};
+                number = std::stoull( tagged.substr( 0, tab ), &used );
+                // The lines of a shard are consecutive.
+                bad = tab == std::string::npos or used != tab or number != shards[f].next++;
+            }
+            catch ( const std::exception & ) {
+                bad = true;
+            }
+            if ( not bad ) {
+                results[f].assign( tagged, tab + 1, std::string::npos );
+                heads.emplace( number, f );
+            }
+        }
+        if ( bad )
+            std::cerr << "\"" << paths[f] << "\" is not the output of a shard.\n";
+        malformed = malformed or bad;
+    };
+    for ( std::size_t f{0}; f < files.size(); f++ )
+        advance( f );
+
+    std::uint64_t next{1};
+    std::string out;
+    bool missing{false};
+    while ( not heads.empty() and not malformed ) {
+        const head_t head = heads.top();
+        heads.pop();
+        if ( head.first != next and not missing ) {
+            if ( head.first < next ) std::cerr << "Line " << head.first << " appears twice in the shards.\n";
+            else std::cerr << "Line " << next << " is missing from the shards.\n";
+            missing = true;
+        }
+        next = head.first + 1;
+        out += results[ head.second ];
+        out += '\n';
+        if ( out.size() >= ( 1 << 16 ) ) {
+            os << out;
+            out.clear();
+        }
+        advance( head.second );
+    }
+    os << out;
+    os.flush();
+    if ( missing or malformed )
+        return EXIT_FAILURE;
+
+    // Each shard finished, with all of its lines, where the next one begins; the last one ends the file.
+    for ( unsigned long i{0}; i < count; i++ ) {
+        const Manifest & shard = shards[ by_index[i] ];
+        if ( not shard.ended or shard.next != shard.end ) {
+            std::cerr << "\"" << paths[ by_index[i] ] << "\" is incomplete: shard " << i << '/' << count
+                      << " did not finish.\n";
+            return EXIT_FAILURE;
+        }
+        if ( i == 0 and shard.first != 1 ) {
+            std::cerr << "Shard 0/" << count << " does not begin at line 1.\n";
+            return EXIT_FAILURE;
+        }
+        if ( i + 1 < count and shard.end != shards[ by_index[ i + 1 ] ].first ) {
+            std::cerr << "Shards " << i << " and " << i + 1 << " of " << count << " are not contiguous.\n";
+            return EXIT_FAILURE;
+        }
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,407 @@
+#include <algorithm> // std::min
+#include <cerrno>    // errno
+#include <climits>   // INT_MAX
+#include <csignal>   // SIGINT, SIGTERM, kill()
+#include <cstring>   // std::memcpy, std::strerror
+#include <iostream>  // std::cerr
+#include <new>       // placement new
+#include <thread>    // std::thread
+#include <vector>    // std::vector
+
+#include <fcntl.h>       // O_CREAT, O_EXCL, O_RDWR
+#include <linux/futex.h> // FUTEX_WAIT, FUTEX_WAKE
+#include <sys/mman.h>    // shm_open(), shm_unlink(), mmap(), munmap()
+#include <sys/stat.h>    // fstat()
+#include <sys/syscall.h> // SYS_futex
+#include <unistd.h>      // ftruncate(), close(), syscall()
+
+#include "../include/shm_ring.h"
+#include "../include/streaming_parser.h"
+#include "../lib/ring_buffer.h"
+
+namespace {
+    using namespace shm;
+
+    /// Rounds up to a whole number of cache lines.
+    constexpr std::size_t lines( std::size_t bytes ) { return ( bytes + 63 ) / 64 * 64; }
+
+    /// Returns the smallest power of two that is not smaller than n.
+    std::uint32_t power_of_two( std::uint32_t n ) {
+        std::uint32_t p{1};
+        while ( p < n ) p <<= 1;
+        return p;
+    }
+
+    //=== Futexes shared between processes (no FUTEX_PRIVATE_FLAG).
+    void futex_wait( std::atomic< std::uint32_t > & word, std::uint32_t expected ) {
+        syscall( SYS_futex, reinterpret_cast< std::uint32_t * >( &word ), FUTEX_WAIT, expected, nullptr, nullptr, 0 );
+    }
+    void futex_wake( std::atomic< std::uint32_t > & word, int waiters ) {
+        syscall( SYS_futex, reinterpret_cast< std::uint32_t * >( &word ), FUTEX_WAKE, waiters, nullptr, nullptr, 0 );
+    }
+
+    /// Wakes up whoever sleeps on `word`, if `sleeping` says someone does. Called after a publish.
+    void notify( std::atomic< std::uint32_t > & word, std::atomic< std::uint32_t > & sleeping, int waiters ) {
+        // Pairs with the fence of a sleeper between announcing itself and looking at the ring again.
+        std::atomic_thread_fence( std::memory_order_seq_cst );
+        if ( sleeping.load( std::memory_order_relaxed ) == 0 ) return;
+        word.fetch_add( 1, std::memory_order_release );
+        futex_wake( word, waiters );
+    }
+
+    //=== The Vyukov queue, over cells in place; `at( pos )` finds the cell of a position.
+
+    /// Claims the cell at the write position. Returns nullptr when the ring is full.
+    template < typename Cell, typename At >
+    Cell * claim( std::atomic< std::uint64_t > & write_pos, At at, std::uint64_t & pos ) {
+        pos = write_pos.load( std::memory_order_relaxed );
+        for ( ;; ) {
+            Cell * cell = at( pos );
+            std::int64_t lap = static_cast< std::int64_t >( cell->seq.load( std::memory_order_acquire ) - pos );
+            if ( lap == 0 ) {
+                if ( write_pos.compare_exchange_weak( pos, pos + 1, std::memory_order_relaxed ) ) return cell;
+            }
+            else if ( lap < 0 ) return nullptr;
+            else pos = write_pos.load( std::memory_order_relaxed );
+        }
+    }
+
+    /// Takes the cell at the read position. Returns nullptr when the ring is empty.
+    template < typename Cell, typename At >
+    Cell * take( std::atomic< std::uint64_t > & read_pos, At at, std::uint64_t & pos ) {
+        pos = read_pos.load( std::memory_order_relaxed );
+        for ( ;; ) {
+            Cell * cell = at( pos );
+            std::int64_t lap = static_cast< std::int64_t >( cell->seq.load( std::memory_order_acquire ) - ( pos + 1 ) );
+            if ( lap == 0 ) {
+                if ( read_pos.compare_exchange_weak( pos, pos + 1, std::memory_order_relaxed ) ) return cell;
+            }
+            else if ( lap < 0 ) return nullptr;
+            else pos = read_pos.load( std::memory_order_relaxed );
+        }
+    }
+
+    //=== Where the parts of a region are.
+    char * base( Header * h ) { return reinterpret_cast< char * >( h ); }
+
+    Request * request( Header * h, const Layout & l, std::uint64_t pos ) {
+        return reinterpret_cast< Request * >( base( h ) + lines( sizeof( Header ) ) + ( pos & ( l.slots - 1 ) ) * l.request_cell );
+    }
+
+    ResponseRing * ring( Header * h, const Layout & l, std::uint32_t producer ) {
+        return reinterpret_cast< ResponseRing * >( base( h ) + lines( sizeof( Header ) ) + l.slots * l.request_cell +
+                                                   producer * l.response_ring );
+    }
+
+    Response * response( const Layout & l, ResponseRing * r, std::uint64_t pos ) {
+        return reinterpret_cast< Response * >( reinterpret_cast< char * >( r ) + lines( sizeof( ResponseRing ) ) ) +
+               ( pos & ( l.slots - 1 ) );
+    }
+
+    /// Whether the region with this name was left by a server that is no longer running.
+    bool stale( const char * name ) {
+        int fd = shm_open( name, O_RDONLY, 0 );
+        if ( fd < 0 ) return errno == ENOENT; // Gone meanwhile: the name is free.
+        struct stat st;
+        void * region = MAP_FAILED;
+        if ( fstat( fd, &st ) == 0 and st.st_size >= static_cast< off_t >( sizeof( Header ) ) )
+            region = mmap( nullptr, sizeof( Header ), PROT_READ, MAP_SHARED, fd, 0 );
+        close( fd );
+        if ( region == MAP_FAILED ) return false; // Not a region of ours, or not ready yet: left alone.
+        const pid_t owner = static_cast< const Header * >( region )->owner;
+        munmap( region, sizeof( Header ) );
+        return owner > 0 and kill( owner, 0 ) != 0 and errno == ESRCH;
+    }
+}
+
+shm::Layout::Layout( std::uint32_t producers, std::uint32_t slots, std::uint32_t slot_size )
+    : producers{ producers }, slots{ slots }, slot_size{ slot_size },
+      request_cell{ lines( sizeof( Request ) + slot_size ) },
+      response_ring{ lines( sizeof( ResponseRing ) ) + slots * sizeof( Response ) },
+      total{ lines( sizeof( Header ) ) + slots * request_cell + producers * response_ring } {}
+
+//=== ShmServer.
+
+ShmServer::ShmServer( const std::string & name, std::uint32_t producers, std::uint32_t slots, std::uint32_t slot_size )
+    : m_name{ name }, m_layout{ producers, power_of_two( std::max< std::uint32_t >( slots, 2 ) ), slot_size } {
+    if ( producers == 0 ) {
+        errno = EINVAL;
+        return;
+    }
+    slots = power_of_two( std::max< std::uint32_t >( slots, 2 ) );
+    int fd = shm_open( name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600 );
+    if ( fd < 0 and errno == EEXIST and stale( name.c_str() ) ) {
+        shm_unlink( name.c_str() ); // A region left by a server that did not stop.
+        fd = shm_open( name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600 );
+    }
+    if ( fd < 0 ) return; // EEXIST: a running server uses the name.
+    void * region = MAP_FAILED;
+    if ( ftruncate( fd, static_cast< off_t >( m_layout.total ) ) == 0 )
+        region = mmap( nullptr, m_layout.total, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0 );
+    close( fd );
+    if ( region == MAP_FAILED ) {
+        shm_unlink( name.c_str() );
+        return;
+    }
+
+    // Every cell starts free, in lap 0.
+    Header * h = new ( region ) Header{};
+    h->owner = static_cast< std::int32_t >( getpid() );
+    h->producers = producers;
+    h->slots = slots;
+    h->slot_size = slot_size;
+    for ( std::uint32_t i{0}; i < slots; i++ ) {
+        Request * cell = new ( request( h, m_layout, i ) ) Request{};
+        cell->seq.store( i, std::memory_order_relaxed );
+    }
+    for ( std::uint32_t p{0}; p < producers; p++ ) {
+        ResponseRing * r = new ( ring( h, m_layout, p ) ) ResponseRing{};
+        for ( std::uint32_t i{0}; i < slots; i++ ) {
+            Response * cell = new ( response( m_layout, r, i ) ) Response{};
+            cell->seq.store( i, std::memory_order_relaxed );
+        }
+    }
+    // The producers check the magic number last.
+    h->version = shm::version;
+    std::atomic_thread_fence( std::memory_order_release );
+    h->magic = shm::magic;
+    m_header = h;
+}
+
+ShmServer::~ShmServer() {
+    if ( m_header == nullptr ) return;
+    munmap( m_header, m_layout.total );
+    shm_unlink( m_name.c_str() );
+}
+
+void ShmServer::run( unsigned workers ) {
+    if ( m_header == nullptr ) return;
+    std::vector< std::thread > pool;
+    for ( unsigned i{0}; i < std::max( workers, 1u ); i++ )
+        pool.emplace_back( &ShmServer::work, this );
+    for ( auto & t : pool ) t.join();
+}
+
+void ShmServer::stop(void) {
+    if ( m_header == nullptr ) return;
+    m_header->stop.store( 1, std::memory_order_release );
+    m_header->requests.fetch_add( 1, std::memory_order_release );
+    futex_wake( m_header->requests, INT_MAX );
+    // The producers waiting for responses get none.
+    for ( std::uint32_t p{0}; p < m_layout.producers; p++ ) {
+        ResponseRing * r = ring( m_header, m_layout, p );
+        r->responses.fetch_add( 1, std::memory_order_release );
+        futex_wake( r->responses, INT_MAX );
+    }
+}
+
+/// Takes requests, evaluates them in place, and sends the responses; sleeps when there is nothing to take.
+void ShmServer::work(void) {
+    Header * h = m_header;
+    const Layout & l = m_layout;
+    auto request_at = [h, &l]( std::uint64_t pos ) { return request( h, l, pos ); };
+    StreamingParser parser; // Reentrant: the state of this worker only.
+    unsigned idle{0};
+    for ( ;; ) {
+        std::uint64_t pos;
+        Request * r = take< Request >( h->read_pos, request_at, pos );
+        if ( r == nullptr ) {
+            if ( h->stop.load( std::memory_order_acquire ) ) return;
+            if ( ++idle < 256 ) continue;
+            // Announce the sleep, then look again: a producer that missed the announcement is seen here.
+            h->sleeping.fetch_add( 1, std::memory_order_relaxed );
+            std::atomic_thread_fence( std::memory_order_seq_cst );
+            const std::uint32_t word = h->requests.load( std::memory_order_acquire );
+            r = take< Request >( h->read_pos, request_at, pos );
+            if ( r == nullptr and not h->stop.load( std::memory_order_acquire ) )
+                futex_wait( h->requests, word );
+            h->sleeping.fetch_sub( 1, std::memory_order_relaxed );
+            if ( r == nullptr ) continue;
+        }
+        idle = 0;
+
+        // The expression is read where the producer wrote it.
+        parser.reset();
+        parser.feed( r->text(), std::min< std::uint32_t >( r->length, l.slot_size ) );
+        Parser::required_int_type value{0};
+        const Parser::ResultType result = parser.finish( value );
+        const std::uint64_t tag = r->tag;
+        const std::uint32_t producer = r->producer;
+        r->seq.store( pos + l.slots, std::memory_order_release ); // The cell goes back to the producers.
+        if ( producer >= l.producers ) continue;
+
+        ResponseRing * ring_of = ring( h, l, producer );
+        auto response_at = [&l, ring_of]( std::uint64_t at ) { return response( l, ring_of, at ); };
+        Response * out;
+        rb::backoff wait;
+        // A producer has at most `slots` requests in flight, so there is room unless it misbehaves.
+        while ( ( out = claim< Response >( ring_of->write_pos, response_at, pos ) ) == nullptr ) {
+            if ( h->stop.load( std::memory_order_acquire ) ) return;
+            wait.pause();
+        }
+        out->tag = tag;
+        out->column = result.at_col;
+        out->code = result.type;
+        out->value = value;
+        out->seq.store( pos + 1, std::memory_order_release );
+        notify( ring_of->responses, ring_of->sleeping, 1 );
+    }
+}
+
+//=== ShmClient.
+
+ShmClient::~ShmClient() {
+    detach();
+}
+
+bool ShmClient::attach( const std::string & name ) {
+    detach();
+    int fd = shm_open( name.c_str(), O_RDWR, 0 );
+    if ( fd < 0 ) return false;
+    struct stat st;
+    void * region = MAP_FAILED;
+    if ( fstat( fd, &st ) == 0 and st.st_size >= static_cast< off_t >( sizeof( Header ) ) )
+        region = mmap( nullptr, static_cast< std::size_t >( st.st_size ), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0 );
+    close( fd );
+    if ( region == MAP_FAILED ) return false;
+
+    Header * h = static_cast< Header * >( region );
+    const bool ready = h->magic == shm::magic;
+    std::atomic_thread_fence( std::memory_order_acquire );
+    Layout layout{ h->producers, h->slots, h->slot_size };
+    if ( not ready or h->version != shm::version or layout.total != static_cast< std::size_t >( st.st_size ) ) {
+        munmap( region, static_cast< std::size_t >( st.st_size ) );
+        return false;
+    }
+    m_header = h;
+    m_layout = layout;
+
+    // The first free response ring is ours.
+    for ( std::uint32_t p{0}; p < m_layout.producers; p++ ) {
+        ResponseRing * r = ring( h, m_layout, p );
+        std::uint32_t free{0};
+        if ( r->attached.compare_exchange_strong( free, 1, std::memory_order_acq_rel ) ) {
+            m_ring = r;
+            m_id = p;
+            break;
+        }
+    }
+    if ( m_ring == nullptr ) {
+        detach();
+        return false;
+    }
+    m_in_flight = 0;
+    return true;
+}
+
+void ShmClient::detach(void) {
+    if ( m_header == nullptr ) return;
+    if ( m_ring != nullptr ) {
+        // A claimed cell would stop the request ring: it goes to the workers, for no producer.
+        if ( m_claimed != nullptr ) {
+            m_claimed->tag = 0;
+            m_claimed->producer = m_layout.producers;
+            m_claimed->length = 0;
+            m_claimed->seq.store( m_claimed_pos + 1, std::memory_order_release );
+            notify( m_header->requests, m_header->sleeping, 1 );
+        }
+        // The responses still to come would reach the next producer of the ring.
+        Response dropped;
+        while ( m_in_flight > 0 and receive( dropped ) ) { /* drop */ }
+        m_ring->attached.store( 0, std::memory_order_release );
+    }
+    munmap( m_header, m_layout.total );
+    m_header = nullptr;
+    m_ring = nullptr;
+    m_claimed = nullptr;
+    m_in_flight = 0;
+}
+
+char * ShmClient::reserve(void) {
+    if ( m_claimed != nullptr ) return m_claimed->text();
+    if ( m_in_flight >= m_layout.slots ) return nullptr;
+    Header * h = m_header;
+    const Layout & l = m_layout;
+    auto request_at = [h, &l]( std::uint64_t pos ) { return request( h, l, pos ); };
+    rb::backoff wait;
+    // The ring is full: the workers are behind, wait for them.
+    while ( ( m_claimed = claim< Request >( h->write_pos, request_at, m_claimed_pos ) ) == nullptr ) {
+        if ( h->stop.load( std::memory_order_acquire ) ) return nullptr;
+        wait.pause();
+    }
+    return m_claimed->text();
+}
+
+void ShmClient::commit( std::size_t length, std::uint64_t tag ) {
+    if ( m_claimed == nullptr ) return;
+    m_claimed->tag = tag;
+    m_claimed->producer = m_id;
+    m_claimed->length = static_cast< std::uint32_t >( std::min< std::size_t >( length, m_layout.slot_size ) );
+    m_claimed->seq.store( m_claimed_pos + 1, std::memory_order_release );
+    m_claimed = nullptr;
+    m_in_flight++;
+    notify( m_header->requests, m_header->sleeping, 1 );
+}
+
+bool ShmClient::submit( const char * expr, std::size_t length, std::uint64_t tag ) {
+    if ( length > max_length() ) return false;
+    char * text = reserve();
+    if ( text == nullptr ) return false;
+    std::memcpy( text, expr, length );
+    commit( length, tag );
+    return true;
+}
+
+bool ShmClient::try_receive( Response & out ) {
+    const Layout & l = m_layout;
+    ResponseRing * r = m_ring;
+    auto response_at = [&l, r]( std::uint64_t pos ) { return response( l, r, pos ); };
+    std::uint64_t pos;
+    shm::Response * cell = take< shm::Response >( r->read_pos, response_at, pos );
+    if ( cell == nullptr ) return false;
+    out.tag = cell->tag;
+    out.result = Parser::ResultType{ static_cast< Parser::ResultType::code_t >( cell->code ), cell->column };
+    out.value = cell->value;
+    cell->seq.store( pos + m_layout.slots, std::memory_order_release );
+    if ( m_in_flight > 0 ) m_in_flight--;
+    return true;
+}
+
+bool ShmClient::receive( Response & out ) {
+    for ( unsigned idle{0};; ) {
+        if ( try_receive( out ) ) return true;
+        if ( m_in_flight == 0 or m_header->stop.load( std::memory_order_acquire ) ) return false;
+        if ( ++idle < 256 ) continue;
+        // As the workers do: announce the sleep, then look again.
+        m_ring->sleeping.store( 1, std::memory_order_relaxed );
+        std::atomic_thread_fence( std::memory_order_seq_cst );
+        const std::uint32_t word = m_ring->responses.load( std::memory_order_acquire );
+        bool got = try_receive( out );
+        if ( not got and not m_header->stop.load( std::memory_order_acquire ) )
+            futex_wait( m_ring->responses, word );
+        m_ring->sleeping.store( 0, std::memory_order_relaxed );
+        if ( got ) return true;
+    }
+}
+
+/// Creates the region, serves it with the workers, and waits for a signal to stop.
+int shm_mode( const char * name, unsigned workers, std::uint32_t producers, std::uint32_t slots, std::uint32_t slot_size ) {
+    // Signals are taken by this thread; the workers inherit the mask.
+    sigset_t mask;
+    sigemptyset( &mask );
+    sigaddset( &mask, SIGINT );
+    sigaddset( &mask, SIGTERM );
+    pthread_sigmask( SIG_BLOCK, &mask, nullptr );
+
+    ShmServer server{ name, producers, slots, slot_size };
+    if ( not server.ready() ) {
+        std::cerr << "Cannot create the shared memory \"" << name << "\": " << std::strerror( errno ) << "\n";
+        return EXIT_FAILURE;
+    }
+    std::thread serving{ &ShmServer::run, &server, workers };
+    int received{0};
+    sigwait( &mask, &received );
+    server.stop();
+    serving.join();
+    return EXIT_SUCCESS;
+}
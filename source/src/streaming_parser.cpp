@@ -0,0 +1,158 @@
+#include <algorithm> // std::max
+#include <cstring>   // std::memchr
+#include <memory>    // std::unique_ptr
+
+#include <unistd.h> // read()
+
+#include "../include/streaming_parser.h"
+#include "../include/bares_manager.h"
+#include "../include/operators.h"
+
+using namespace lexemes;
+
+void StreamingParser::reset(void) {
+    m_pos = 0;
+    m_in_digits = false;
+    m_validator.reset();
+    m_eval = Parser::ResultType::OK;
+    m_values.clear();
+    m_ops.clear();
+    m_peak = 0;
+}
+
+/// The lexer: runs of digits, single symbols and invalid characters.
+void StreamingParser::feed( const char * data, std::size_t size ) {
+    std::size_t i{0};
+    for ( ; i < size and not m_validator.done(); i++, m_pos++ ) {
+        const char c = data[i];
+        if ( is_digit( c ) ) {
+            if ( not m_in_digits ) {
+                m_in_digits = true;
+                m_digits = Lexeme{ DIGITS, m_pos, c, 0, 0 };
+            }
+            m_digits.len++;
+            if ( m_digits.value <= saturation )
+                m_digits.value = m_digits.value * 10 + ( c - '0' );
+            continue;
+        }
+        if ( m_in_digits ) {
+            m_in_digits = false;
+            lexeme( m_digits );
+        }
+        if ( is_space( c ) ) continue;
+        lexeme( Lexeme{ kind_of( c ), m_pos, c, 1, 0 } );
+    }
+    // After an error the rest of the line is only counted.
+    m_pos += size - i;
+}
+
+Parser::ResultType StreamingParser::finish( Parser::required_int_type & value ) {
+    if ( m_in_digits ) {
+        m_in_digits = false;
+        lexeme( m_digits );
+    }
+    lexeme( Lexeme{ END, m_pos, 0, 0, 0 } );
+    const Parser::ResultType & result = m_validator.result();
+    if ( result.type != Parser::ResultType::OK )
+        return result;
+    // A valid line: the operators still pending are applied.
+    while ( m_eval == Parser::ResultType::OK and not m_ops.empty() and reduce() ) { /* empty */ }
+    if ( m_eval != Parser::ResultType::OK )
+        return Parser::ResultType{ m_eval };
+    value = static_cast< Parser::required_int_type >( m_values.back() );
+    return result;
+}
+
+/// Validates a lexeme, evaluating the line as it goes.
+void StreamingParser::lexeme( const Lexeme & l ) {
+    struct Evaluation {
+        StreamingParser & self;
+        void integer( const Lexeme & digits, bool negative ) { self.push_value( negative ? -digits.value : digits.value ); }
+        void open( bool ) { self.open_group(); }
+        void close(void) { self.close_group(); }
+        void operation( char op ) { self.push_operator( op ); }
+    } evaluation{ *this };
+    m_validator.feed( l, evaluation );
+}
+
+//=== Evaluation by operator precedence, stopped by the first error.
+
+void StreamingParser::push_value( Parser::input_int_type value ) {
+    if ( m_eval != Parser::ResultType::OK ) return;
+    m_values.push_back( value );
+    m_peak = std::max( m_peak, m_values.size() + m_ops.size() );
+}
+
+void StreamingParser::push_operator( char op ) {
+    if ( m_eval != Parser::ResultType::OK ) return;
+    while ( not m_ops.empty() and m_ops.back() != '(' and prec( op ) <= prec( m_ops.back() ) )
+        if ( not reduce() ) return;
+    m_ops.push_back( op );
+    m_peak = std::max( m_peak, m_values.size() + m_ops.size() );
+}
+
+void StreamingParser::open_group(void) {
+    if ( m_eval != Parser::ResultType::OK ) return;
+    m_ops.push_back( '(' );
+    m_peak = std::max( m_peak, m_values.size() + m_ops.size() );
+}
+
+void StreamingParser::close_group(void) {
+    if ( m_eval != Parser::ResultType::OK ) return;
+    while ( m_ops.back() != '(' )
+        if ( not reduce() ) return;
+    m_ops.pop_back();
+}
+
+/// Pops the last operator and applies it to the two operands on top, stopping at an error.
+bool StreamingParser::reduce(void) {
+    char op = m_ops.back();
+    m_ops.pop_back();
+    Parser::input_int_type second_operand = m_values.back();
+    m_values.pop_back();
+    m_eval = apply_operator( op, m_values.back(), second_operand, m_values.back() );
+    return m_eval == Parser::ResultType::OK;
+}
+
+int streaming_mode( int in_fd, std::ostream & os, std::size_t chunk ) {
+    std::unique_ptr< char[] > buffer{ new char[ chunk ] };
+    StreamingParser parser;
+    BaresManager bm; // Only for its error messages; the line is not kept.
+    const std::string no_line;
+    bool in_line{false};
+    auto end_line = [&] {
+        Parser::required_int_type value{0};
+        Parser::ResultType result = parser.finish( value );
+        if ( result.type == Parser::ResultType::OK )
+            os << value << '\n';
+        else
+            bm.print_error_msg( result, no_line, os );
+        parser.reset();
+        in_line = false;
+    };
+
+    parser.reset();
+    for ( ;; ) {
+        ssize_t n = read( in_fd, buffer.get(), chunk );
+        if ( n < 0 ) {
+            std::cerr << "Cannot read the input\n";
+            return EXIT_FAILURE;
+        }
+        if ( n == 0 ) break;
+        const char * p = buffer.get(), * stop = p + n;
+        while ( p != stop ) {
+            const char * nl = static_cast< const char * >( std::memchr( p, '\n', stop - p ) );
+            const char * piece_end = nl != nullptr ? nl : stop;
+            parser.feed( p, piece_end - p );
+            in_line = true;
+            if ( nl == nullptr ) break;
+            end_line();
+            p = nl + 1;
+        }
+    }
+    // Like std::getline(), a last line without "\n" still counts.
+    if ( in_line and parser.size() > 0 )
+        end_line();
+    os.flush();
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,23 @@
+#include "../include/symbol_table.h"
+
+std::size_t SymbolTable::intern( const std::string & name ) {
+    auto it = m_slots.find( name );
+    if ( it != m_slots.end() )
+        return it->second;
+    if ( m_closed )
+        return npos;
+    m_names.push_back( name );
+    m_slots.emplace( name, m_names.size() - 1 );
+    return m_names.size() - 1;
+}
+
+std::size_t SymbolTable::find( const std::string & name ) const {
+    auto it = m_slots.find( name );
+    return it != m_slots.end() ? it->second : npos;
+}
+
+void SymbolTable::clear(void) {
+    m_slots.clear();
+    m_names.clear();
+    m_closed = false;
+}
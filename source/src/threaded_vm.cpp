@@ -0,0 +1,149 @@
+#include "../include/threaded_vm.h"
+#include "../include/operators.h"
+
+// Labels as values are an extension of GCC and Clang.
+#if defined( __GNUC__ )
+#define BARES_COMPUTED_GOTO 1
+#pragma GCC diagnostic ignored "-Wpedantic"
+#else
+#define BARES_COMPUTED_GOTO 0
+#endif
+
+bool ThreadedProgram::threaded(void) {
+    return BARES_COMPUTED_GOTO;
+}
+
+/// Decodes the instructions, fusing the pairs that have a superinstruction.
+void ThreadedProgram::compile( const Program & program ) {
+    static const void * const * labels = [] {
+        const void * const * table{ nullptr };
+        Parser::required_int_type unused{0};
+        execute( nullptr, nullptr, nullptr, unused, &table );
+        return table;
+    }();
+    const std::vector< Program::Instruction > & code = program.code;
+
+    m_code.clear();
+    m_fused = 0;
+    std::size_t depth{0}, max_depth{0};
+    for ( std::size_t i{0}; i < code.size(); i++ ) {
+        const Program::Instruction & ins = code[i];
+        const bool next_binary = i + 1 < code.size() and code[i + 1].op >= Program::ADD and code[i + 1].op <= Program::POW;
+        Op op{ nullptr, ins.value, PUSH };
+        if ( ins.op == Program::PUSH ) {
+            if ( next_binary ) { // `x k op`: the literal never reaches the stack.
+                op.kind = static_cast< kind_t >( ADD_K + ( code[++i].op - Program::ADD ) );
+                m_fused++;
+            }
+            else if ( ++depth > max_depth )
+                max_depth = depth;
+        }
+        else if ( ins.op == Program::FAIL ) {
+            op.kind = FAIL;
+            depth++; // Stands for the value it replaced, like in the JIT.
+        }
+        else if ( ins.op == Program::LOAD ) {
+            op.kind = LOAD;
+            if ( ++depth > max_depth )
+                max_depth = depth;
+        }
+        else {
+            op.kind = static_cast< kind_t >( ADD + ( ins.op - Program::ADD ) );
+            depth--;
+            const bool feeds_sum = next_binary and ( code[i + 1].op == Program::ADD or code[i + 1].op == Program::SUB );
+            if ( feeds_sum and ( ins.op == Program::MUL or ins.op == Program::DIV or ins.op == Program::MOD ) ) {
+                op.kind = static_cast< kind_t >( MUL_ADD + 2 * ( ins.op - Program::MUL ) + ( code[++i].op - Program::ADD ) );
+                depth--;
+                m_fused++;
+            }
+        }
+        m_code.push_back( op );
+    }
+    m_code.push_back( Op{ nullptr, 0, HALT } );
+    if ( labels != nullptr )
+        for ( Op & op : m_code )
+            op.handler = labels[ op.kind ];
+    // One slot more than needed: the first PUSH saves the (undefined) top of the empty stack.
+    if ( m_stack.size() < max_depth + 1 )
+        m_stack.resize( max_depth + 1 );
+}
+
+Parser::ResultType ThreadedProgram::run( Parser::required_int_type & value, const Parser::required_int_type * values ) {
+    return execute( m_code.data(), m_stack.data(), values, value, nullptr );
+}
+
+/// The interpreter. Called with `labels` set, it only gives the addresses of its instructions.
+Parser::ResultType ThreadedProgram::execute( const Op * ip, Parser::input_int_type * sp,
+                                             const Parser::required_int_type * values, Parser::required_int_type & value,
+                                             const void * const ** labels ) {
+    Parser::input_int_type top{0}; // The top of the stack; `sp` points past the slot below it.
+    Parser::input_int_type a{0}, b{0};
+#if BARES_COMPUTED_GOTO
+    static const void * const table[N_KINDS] = {
+        &&L_PUSH, &&L_ADD, &&L_SUB, &&L_MUL, &&L_DIV, &&L_MOD, &&L_POW, &&L_LOAD,
+        &&L_ADD_K, &&L_SUB_K, &&L_MUL_K, &&L_DIV_K, &&L_MOD_K, &&L_POW_K,
+        &&L_MUL_ADD, &&L_MUL_SUB, &&L_DIV_ADD, &&L_DIV_SUB, &&L_MOD_ADD, &&L_MOD_SUB,
+        &&L_FAIL, &&L_HALT
+    };
+    if ( labels != nullptr ) {
+        *labels = table;
+        return Parser::ResultType{ Parser::ResultType::OK };
+    }
+#define VM_CASE( kind ) L_##kind:
+#define VM_NEXT() goto *( ++ip )->handler
+    goto *ip->handler;
+#else
+    if ( labels != nullptr ) {
+        *labels = nullptr;
+        return Parser::ResultType{ Parser::ResultType::OK };
+    }
+#define VM_CASE( kind ) case kind:
+#define VM_NEXT() ip++; continue
+    for ( ;; ) switch ( ip->kind ) {
+#endif
+
+//=== The pieces of the instructions.
+#define VM_CHECK( r ) if ( not in_required_range( r ) ) goto overflow
+#define VM_NONZERO( b ) if ( ( b ) == 0 ) goto division
+#define VM_POWER( a, b, r ) if ( apply_operator( '^', a, b, r ) != Parser::ResultType::OK ) goto overflow
+
+    VM_CASE( PUSH )    *sp++ = top; top = ip->value; VM_NEXT();
+    VM_CASE( ADD )     top = *--sp + top; VM_CHECK( top ); VM_NEXT();
+    VM_CASE( SUB )     top = *--sp - top; VM_CHECK( top ); VM_NEXT();
+    VM_CASE( MUL )     top = *--sp * top; VM_CHECK( top ); VM_NEXT();
+    VM_CASE( DIV )     VM_NONZERO( top ); top = *--sp / top; VM_CHECK( top ); VM_NEXT();
+    VM_CASE( MOD )     VM_NONZERO( top ); top = *--sp % top; VM_NEXT();
+    VM_CASE( POW )     a = *--sp; VM_POWER( a, top, top ); VM_NEXT();
+    VM_CASE( LOAD )    *sp++ = top; top = values[ ip->value ]; VM_NEXT();
+    VM_CASE( ADD_K )   top += ip->value; VM_CHECK( top ); VM_NEXT();
+    VM_CASE( SUB_K )   top -= ip->value; VM_CHECK( top ); VM_NEXT();
+    VM_CASE( MUL_K )   top *= ip->value; VM_CHECK( top ); VM_NEXT();
+    VM_CASE( DIV_K )   VM_NONZERO( ip->value ); top /= ip->value; VM_CHECK( top ); VM_NEXT();
+    VM_CASE( MOD_K )   VM_NONZERO( ip->value ); top %= ip->value; VM_NEXT();
+    VM_CASE( POW_K )   a = top; VM_POWER( a, ip->value, top ); VM_NEXT();
+    VM_CASE( MUL_ADD ) b = *--sp * top; VM_CHECK( b ); top = *--sp + b; VM_CHECK( top ); VM_NEXT();
+    VM_CASE( MUL_SUB ) b = *--sp * top; VM_CHECK( b ); top = *--sp - b; VM_CHECK( top ); VM_NEXT();
+    VM_CASE( DIV_ADD ) VM_NONZERO( top ); b = *--sp / top; VM_CHECK( b ); top = *--sp + b; VM_CHECK( top ); VM_NEXT();
+    VM_CASE( DIV_SUB ) VM_NONZERO( top ); b = *--sp / top; VM_CHECK( b ); top = *--sp - b; VM_CHECK( top ); VM_NEXT();
+    VM_CASE( MOD_ADD ) VM_NONZERO( top ); b = *--sp % top; top = *--sp + b; VM_CHECK( top ); VM_NEXT();
+    VM_CASE( MOD_SUB ) VM_NONZERO( top ); b = *--sp % top; top = *--sp - b; VM_CHECK( top ); VM_NEXT();
+    VM_CASE( FAIL )    return Parser::ResultType{ static_cast< Parser::ResultType::code_t >( ip->value ) };
+    VM_CASE( HALT )
+        value = static_cast< Parser::required_int_type >( top );
+        return Parser::ResultType{ Parser::ResultType::OK };
+#if not BARES_COMPUTED_GOTO
+        default: break;
+    }
+#endif
+
+overflow:
+    return Parser::ResultType{ Parser::ResultType::OVERFLOW_ERROR };
+division:
+    return Parser::ResultType{ Parser::ResultType::DIVISION_BY_ZERO };
+
+#undef VM_CASE
+#undef VM_NEXT
+#undef VM_CHECK
+#undef VM_NONZERO
+#undef VM_POWER
+}
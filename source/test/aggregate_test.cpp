@@ -0,0 +1,100 @@
+/**
+ * @file aggregate_test.cpp
+ * @brief Differential test of the aggregation mode against folding parse_and_compute() results.
+ *
+ * The lines of the corpus files, mixed with generated lines (values all over
+ * the range of `short`, and errors of several kinds), are folded one by one
+ * into an Aggregate, from the values and statuses of BaresManager. Then
+ * aggregate_mode() must write the same aggregate, whatever the number of
+ * evaluators, and so must partial aggregates merged in any split.
+ *
+ * Usage: bares_aggregate_test [corpus files...]
+ */
+
+#include <random>  // std::mt19937
+#include <sstream> // std::ostringstream
+#include <string>  // std::string
+#include <vector>  // std::vector
+
+#include <unistd.h> // lseek
+
+#include "../include/aggregate.h"
+#include "../include/pipeline.h"
+#include "differential.h"
+
+namespace {
+    differential::Tally tally;
+
+    /// A random line: an expression with a value all over the range of `short`, or with some error.
+    std::string generate( std::mt19937 & rng ) {
+        std::string e = differential::random_chain( rng, 32768, 3, 20 );
+        if ( rng() % 10 == 0 ) e += " )";
+        return e;
+    }
+
+    void expect( const std::string & what, const std::string & got, const std::string & want ) {
+        tally.expect( got == want, [&] { return what + ":\n" + got + "expected:\n" + want; } );
+    }
+}
+
+int main( int argc, char * argv[] ) {
+    // [I] The lists of the command line.
+    unsigned what{0};
+    tally.expect( Aggregate::parse_list( "sum,min,max,count,hist", what ) and
+                      what == ( Aggregate::SUM | Aggregate::MIN | Aggregate::MAX | Aggregate::COUNT | Aggregate::HIST ) and
+                      Aggregate::parse_list( "max", what ) and what == Aggregate::MAX and
+                      not Aggregate::parse_list( "sum,", what ) and not Aggregate::parse_list( "", what ) and
+                      not Aggregate::parse_list( "avg", what ),
+                  [] { return "Lists are not read as expected"; } );
+
+    // [II] The input.
+    std::vector< std::string > lines;
+    if ( not differential::for_each_corpus_line( argc, argv, [&]( const std::string & line ) { lines.push_back( line ); } ) )
+        return EXIT_FAILURE;
+    std::mt19937 rng{ 2047 };
+    for ( int i{0}; i < 60000; i++ )
+        lines.push_back( generate( rng ) );
+
+    // [III] The expected aggregate, folded line by line, and the same from partials.
+    BaresManager bm;
+    Aggregate whole;
+    std::vector< Aggregate > parts( 7 );
+    for ( std::size_t i{0}; i < lines.size(); i++ ) {
+        const Parser::ResultType result = bm.compute( lines[i] );
+        whole.add( result, bm.get_value() );
+        parts[ rng() % parts.size() ].add( result, bm.get_value() );
+    }
+    const unsigned all = Aggregate::SUM | Aggregate::MIN | Aggregate::MAX | Aggregate::COUNT | Aggregate::HIST;
+    std::ostringstream want;
+    whole.print( want, all );
+    Aggregate merged;
+    for ( const auto & part : parts )
+        merged.merge( part );
+    std::ostringstream got;
+    merged.print( got, all );
+    expect( "Merged partials", got.str(), want.str() );
+
+    // [IV] The mode, with one or more evaluators.
+    std::FILE * input = differential::input_file( lines, lines.size() );
+    for ( unsigned evaluators : { 1u, 3u, 8u } ) {
+        for ( unsigned parts_asked : { all, unsigned{ Aggregate::MIN | Aggregate::HIST } } ) {
+            lseek( fileno( input ), 0, SEEK_SET );
+            std::FILE * output = std::tmpfile();
+            aggregate_mode( fileno( input ), fileno( output ), evaluators, parts_asked );
+            std::ostringstream expected;
+            whole.print( expected, parts_asked );
+            expect( std::to_string( evaluators ) + " evaluator(s)", differential::contents( output ), expected.str() );
+            std::fclose( output );
+        }
+    }
+    std::fclose( input );
+
+    // [V] Without any value.
+    Aggregate empty;
+    empty.add( Parser::ResultType{ Parser::ResultType::DIVISION_BY_ZERO }, 0 );
+    std::ostringstream none;
+    empty.print( none, all );
+    expect( "No values", none.str(), "count: 0\nsum: 0\nmin: -\nmax: -\nDIVISION_BY_ZERO: 1\n" );
+
+    return tally.report( "aggregates" );
+}
@@ -0,0 +1,264 @@
+/**
+ * @file alloc_test.cpp
+ * @brief Allocation accounting harness.
+ *
+ * Replaces the global `operator new`/`operator delete` and, on glibc, `malloc`
+ * and friends with counting hooks. A corpus of expressions warms up the
+ * reusable storage of BaresManager; then a different corpus of the same
+ * shape (the same lines with other digits and operators, and random short
+ * lines) is the steady state, where every expression and every stage is
+ * measured against an allocation budget (zero by default). So the budget
+ * holds for lines never seen, not only for the ones that sized the buffers.
+ *
+ * Usage: bares_alloc_test [--max-allocs N] [--max-bytes N] [--verbose] [corpus files...]
+ */
+
+#include <cstdlib>  // std::malloc, std::free
+#include <cstring>  // std::strcmp
+#include <fstream>  // std::ifstream
+#include <iomanip>  // std::setw
+#include <new>      // std::bad_alloc, std::align_val_t
+#include <random>   // std::mt19937
+#include <string>   // std::string
+#include <vector>   // std::vector
+
+#include "../include/bares_manager.h"
+
+//=== Counting hooks.
+namespace {
+    /// Allocations observed while counting is enabled.
+    struct AllocCount {
+        std::size_t allocs = 0; //!< Number of allocations.
+        std::size_t bytes = 0;  //!< Number of bytes requested.
+    };
+
+    AllocCount g_count;     //!< The counters (the harness is single threaded).
+    bool g_counting{false}; //!< Whether the hooks are counting.
+
+    inline void count( std::size_t bytes ) {
+        if ( g_counting ) {
+            g_count.allocs++;
+            g_count.bytes += bytes;
+        }
+    }
+}
+
+#ifdef __GLIBC__
+extern "C" {
+    void * __libc_malloc( std::size_t );
+    void * __libc_calloc( std::size_t, std::size_t );
+    void * __libc_realloc( void *, std::size_t );
+    void * __libc_memalign( std::size_t, std::size_t );
+    void   __libc_free( void * );
+
+    void * malloc( std::size_t size ) { count( size ); return __libc_malloc( size ); }
+    void * calloc( std::size_t n, std::size_t size ) { count( n * size ); return __libc_calloc( n, size ); }
+    void * realloc( void * ptr, std::size_t size ) { count( size ); return __libc_realloc( ptr, size ); }
+    void   free( void * ptr ) { __libc_free( ptr ); }
+}
+/// Raw allocation functions, which do not go through the counting malloc().
+static void * raw_alloc( std::size_t size ) { return __libc_malloc( size ); }
+static void * raw_aligned_alloc( std::size_t align, std::size_t size ) { return __libc_memalign( align, size ); }
+static void   raw_free( void * ptr ) { __libc_free( ptr ); }
+#else
+static void * raw_alloc( std::size_t size ) { return std::malloc( size ); }
+static void * raw_aligned_alloc( std::size_t align, std::size_t size ) {
+    return std::aligned_alloc( align, ( size + align - 1 ) / align * align );
+}
+static void   raw_free( void * ptr ) { std::free( ptr ); }
+#endif
+
+void * operator new( std::size_t size ) {
+    count( size );
+    if ( void * ptr = raw_alloc( size ? size : 1 ) ) return ptr;
+    throw std::bad_alloc();
+}
+void * operator new[]( std::size_t size ) { return operator new( size ); }
+void * operator new( std::size_t size, std::align_val_t align ) {
+    count( size );
+    if ( void * ptr = raw_aligned_alloc( std::size_t( align ), size ? size : 1 ) ) return ptr;
+    throw std::bad_alloc();
+}
+void * operator new[]( std::size_t size, std::align_val_t align ) { return operator new( size, align ); }
+void * operator new( std::size_t size, const std::nothrow_t & ) noexcept {
+    count( size );
+    return raw_alloc( size ? size : 1 );
+}
+void * operator new[]( std::size_t size, const std::nothrow_t & tag ) noexcept { return operator new( size, tag ); }
+void operator delete( void * ptr ) noexcept { raw_free( ptr ); }
+void operator delete[]( void * ptr ) noexcept { raw_free( ptr ); }
+void operator delete( void * ptr, std::size_t ) noexcept { raw_free( ptr ); }
+void operator delete[]( void * ptr, std::size_t ) noexcept { raw_free( ptr ); }
+void operator delete( void * ptr, std::align_val_t ) noexcept { raw_free( ptr ); }
+void operator delete[]( void * ptr, std::align_val_t ) noexcept { raw_free( ptr ); }
+void operator delete( void * ptr, std::size_t, std::align_val_t ) noexcept { raw_free( ptr ); }
+void operator delete[]( void * ptr, std::size_t, std::align_val_t ) noexcept { raw_free( ptr ); }
+
+//=== The harness.
+namespace {
+    /// The stages of the evaluation pipeline.
+    enum stage_t { PARSE = 0, TO_POSTFIX, CALCULATE, OUTPUT, N_STAGES };
+
+    const char * stage_names[] = { "parse", "infix_to_postfix", "calculate", "output" };
+
+    /// A stream buffer that throws away everything, so results are formatted but not written.
+    class NullBuffer : public std::streambuf {
+        protected:
+            int overflow( int c ) override { return c; }
+            std::streamsize xsputn( const char *, std::streamsize n ) override { return n; }
+    };
+
+    /// Expressions that exercise long lines, deep nesting and every error path.
+    std::vector< std::string > builtin_corpus(void) {
+        std::vector< std::string > corpus = {
+            "2 + 3", "(2+3) * 8", "25 / 5 + 4 * 8", "5 % 2 ^4", "-3", "32767 - 32768 + 3",
+            "10000000 - 2", "2+", "3 * d", "(2+3)*/(1-4)", "((2%3) * 8", "3/(1-1)", "20*20000", "       "
+        };
+        std::string sum{ "1" }, nested, closing;
+        for ( int i{0}; i < 500; i++ ) sum += " + 123 * (4 - 2) / 3";
+        for ( int i{0}; i < 200; i++ ) { nested += "( 1 + "; closing += ")"; }
+        corpus.push_back( sum );
+        corpus.push_back( nested + "2" + closing );
+        corpus.push_back( nested + "2" ); // Missing closing, deep inside.
+        corpus.push_back( sum + " + 30000 * 30000" );
+        return corpus;
+    }
+
+    /**
+     * @brief The steady state corpus: lines shaped like the warm-up ones but not the same.
+     *
+     * Each warm-up line comes back with its digits and operators changed (so
+     * the values, and some of the errors, differ, while the number of tokens
+     * and the nesting stay the same), followed by random short lines.
+     */
+    std::vector< std::string > steady_corpus( const std::vector< std::string > & warmup ) {
+        std::vector< std::string > corpus;
+        for ( const auto & expr : warmup ) {
+            std::string variant{ expr };
+            for ( char & c : variant ) {
+                if ( c >= '0' and c <= '9' ) c = static_cast< char >( '0' + ( ( c - '0' ) * 7 + 3 ) % 10 );
+                else if ( c == '+' ) c = '-';
+                else if ( c == '-' ) c = '+';
+                else if ( c == '*' ) c = '%';
+                else if ( c == '/' ) c = '*';
+            }
+            corpus.push_back( variant );
+        }
+        static const std::string alphabet{ "0123456789+-*/%^()  x" };
+        std::mt19937 rng{ 2027 };
+        for ( int i{0}; i < 2000; i++ ) {
+            std::string e;
+            for ( std::size_t len = rng() % 24; e.size() < len; )
+                e += alphabet[ rng() % alphabet.size() ];
+            corpus.push_back( e );
+        }
+        return corpus;
+    }
+
+    /// Evaluates one expression, stage by stage, recording the allocations of each stage.
+    void evaluate( BaresManager & bm, const std::string & expr, AllocCount stages[N_STAGES] ) {
+        AllocCount mark[N_STAGES + 1];
+        g_count = AllocCount{};
+        g_counting = true;
+        mark[PARSE] = g_count;
+        bool parsed = bm.parse( expr ).type == Parser::ResultType::OK;
+        mark[TO_POSTFIX] = g_count;
+        if ( parsed ) bm.infix_to_postfix();
+        mark[CALCULATE] = g_count;
+        if ( parsed ) bm.calculate();
+        mark[OUTPUT] = g_count;
+        bm.print_result( expr );
+        mark[N_STAGES] = g_count;
+        g_counting = false;
+
+        for ( int s{0}; s < N_STAGES; s++ ) {
+            stages[s].allocs = mark[s + 1].allocs - mark[s].allocs;
+            stages[s].bytes = mark[s + 1].bytes - mark[s].bytes;
+        }
+    }
+
+    /// Prints the allocations of each stage.
+    void print_stages( std::ostream & os, const char * title, const AllocCount stages[N_STAGES] ) {
+        os << title << "\n";
+        for ( int s{0}; s < N_STAGES; s++ )
+            os << "    " << std::left << std::setw(20) << stage_names[s] << std::right
+               << std::setw(10) << stages[s].allocs << " allocs"
+               << std::setw(12) << stages[s].bytes << " bytes\n";
+    }
+}
+
+int main( int argc, char * argv[] ) {
+    std::size_t max_allocs{0}, max_bytes{0};
+    bool verbose{false};
+    std::vector< std::string > corpus = builtin_corpus();
+
+    for ( int i{1}; i < argc; i++ ) {
+        if ( std::strcmp( argv[i], "--max-allocs" ) == 0 and i + 1 < argc )
+            max_allocs = std::stoul( argv[++i] );
+        else if ( std::strcmp( argv[i], "--max-bytes" ) == 0 and i + 1 < argc )
+            max_bytes = std::stoul( argv[++i] );
+        else if ( std::strcmp( argv[i], "--verbose" ) == 0 )
+            verbose = true;
+        else {
+            std::ifstream file{ argv[i] };
+            if ( not file ) {
+                std::cerr << "Cannot open corpus \"" << argv[i] << "\"\n";
+                return EXIT_FAILURE;
+            }
+            std::string line;
+            while ( std::getline( file, line ) ) corpus.push_back( line );
+        }
+    }
+
+    // Results are formatted as usual, but thrown away.
+    NullBuffer null_buffer;
+    std::streambuf * original = std::cout.rdbuf( &null_buffer );
+
+    BaresManager bm;
+    AllocCount stages[N_STAGES], warmup[N_STAGES], steady[N_STAGES];
+    // [I] Warm up: the scratch storage grows to fit the largest expression.
+    for ( const auto & expr : corpus ) {
+        evaluate( bm, expr, stages );
+        for ( int s{0}; s < N_STAGES; s++ ) {
+            warmup[s].allocs += stages[s].allocs;
+            warmup[s].bytes += stages[s].bytes;
+        }
+    }
+    // [II] Steady state: every expression of a different corpus must stay within the budget.
+    // (Built before counting: its strings are not part of the measure.)
+    const std::vector< std::string > measured = steady_corpus( corpus );
+    std::size_t failures{0};
+    for ( std::size_t line{0}; line < measured.size(); line++ ) {
+        evaluate( bm, measured[line], stages );
+        AllocCount total;
+        for ( int s{0}; s < N_STAGES; s++ ) {
+            steady[s].allocs += stages[s].allocs;
+            steady[s].bytes += stages[s].bytes;
+            total.allocs += stages[s].allocs;
+            total.bytes += stages[s].bytes;
+        }
+        bool over = total.allocs > max_allocs or total.bytes > max_bytes;
+        if ( over ) failures++;
+        if ( over or verbose ) {
+            std::cerr << ( over ? "OVER BUDGET" : "ok" ) << " expression #" << line + 1
+                      << " (" << measured[line].size() << " chars): "
+                      << total.allocs << " allocs, " << total.bytes << " bytes\n";
+            for ( int s{0}; s < N_STAGES; s++ )
+                if ( stages[s].allocs > 0 )
+                    std::cerr << "    " << stage_names[s] << ": " << stages[s].allocs
+                              << " allocs, " << stages[s].bytes << " bytes\n";
+        }
+    }
+    std::cout.rdbuf( original );
+
+    std::cout << ">>> " << corpus.size() << " warm-up and " << measured.size() << " measured expressions, budget of "
+              << max_allocs << " allocs / " << max_bytes << " bytes per expression.\n";
+    print_stages( std::cout, ">>> Warm-up pass:", warmup );
+    print_stages( std::cout, ">>> Steady state pass:", steady );
+    if ( failures > 0 ) {
+        std::cout << ">>> FAILED: " << failures << " expression(s) over budget.\n";
+        return EXIT_FAILURE;
+    }
+    std::cout << ">>> PASSED.\n";
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,104 @@
+/**
+ * @file barc_test.cpp
+ * @brief Round trip and corruption checks of the `.barc` format.
+ *
+ * The corpus files are compiled (plain and optimized), written, mapped back
+ * and evaluated: the output of every expression must be the one of
+ * BaresManager::parse_and_compute(). Then damaged copies of a file (bad magic,
+ * another version, truncated, a literal index, an operator without operands)
+ * must be rejected by barc::File::open().
+ *
+ * Usage: bares_barc_test scratch_file [corpus files...]
+ */
+
+#include <cstddef> // offsetof
+#include <cstring> // std::memcpy
+#include <fstream> // std::ofstream
+#include <sstream> // std::ostringstream, std::istringstream
+#include <string>  // std::string
+
+#include "../include/barc.h"
+#include "../include/bares_manager.h"
+#include "differential.h"
+
+namespace {
+    differential::Tally tally;
+
+    bool write( const char * path, const std::vector< char > & image, std::size_t size ) {
+        std::ofstream out{ path, std::ios::binary | std::ios::trunc };
+        return bool( out.write( image.data(), size ) );
+    }
+
+    /// The file must be rejected.
+    void expect_rejected( const char * path, std::vector< char > image, const char * what ) {
+        write( path, image, image.size() );
+        barc::File file;
+        std::string error;
+        tally.expect( not file.open( path, error ),
+                      [&] { return std::string{ "A .barc file with " } + what + " was accepted"; } );
+    }
+}
+
+int main( int argc, char * argv[] ) {
+    if ( argc < 2 ) {
+        std::cerr << "Usage: " << argv[0] << " scratch_file [corpus files...]\n";
+        return EXIT_FAILURE;
+    }
+    const char * scratch = argv[1];
+    std::string text;
+    if ( not differential::for_each_corpus_line( argc, argv, [&]( const std::string & line ) { text += line + "\n"; }, 2 ) )
+        return EXIT_FAILURE;
+    text += "2^3 - 7 * (8 / 2)\n1 / (3 - 3)\n(2 + 3\n\n";
+
+    // [I] Round trip.
+    BaresManager bm;
+    for ( bool optimize : { false, true } ) {
+        std::istringstream in{ text };
+        std::vector< char > image = barc::compile( in, optimize );
+        write( scratch, image, image.size() );
+        barc::File file;
+        std::string error;
+        if ( not file.open( scratch, error ) ) {
+            std::cerr << "Cannot load the .barc file: " << error << "\n";
+            return EXIT_FAILURE;
+        }
+        std::istringstream lines{ text };
+        std::string line;
+        std::size_t i{0};
+        for ( ; std::getline( lines, line ); i++ ) {
+            std::ostringstream want, got;
+            bm.parse_and_compute( line, want );
+            Parser::required_int_type value{0};
+            Parser::ResultType result = file.evaluate( i, value );
+            if ( result.type == Parser::ResultType::OK ) got << value << "\n";
+            else bm.print_error_msg( result, line, got );
+            tally.expect( want.str() == got.str() and file.source( i ) == line, [&] {
+                return "\"" + line + "\"" + ( optimize ? " (optimized)" : "" ) + ": expected " + want.str() + "got " +
+                       got.str();
+            } );
+        }
+        tally.expect( i == file.size(), [&] {
+            return "The .barc file has " + std::to_string( file.size() ) + " expressions, expected " + std::to_string( i );
+        } );
+    }
+
+    // [II] Damaged files.
+    std::istringstream in{ "1 + 2 * 3\n(4 - 5\n" };
+    const std::vector< char > good = barc::compile( in, false );
+    barc::Header h;
+    std::memcpy( &h, good.data(), sizeof( h ) );
+    auto patched = [&]( std::size_t offset, std::uint32_t word ) {
+        std::vector< char > bad{ good };
+        std::memcpy( bad.data() + offset, &word, sizeof( word ) );
+        return bad;
+    };
+    expect_rejected( scratch, patched( 0, 0x43524142 ^ 0xFF ), "a bad magic" );
+    expect_rejected( scratch, patched( 4, barc::version + 1 ), "another version" );
+    expect_rejected( scratch, std::vector< char >( good.begin(), good.end() - 1 ), "a missing byte" );
+    expect_rejected( scratch, patched( h.code_offset, Program::PUSH | ( h.n_literals << 8 ) ), "a bad literal index" );
+    expect_rejected( scratch, patched( h.code_offset, Program::ADD ), "an operator without operands" );
+    const std::size_t second_status = h.records_offset + sizeof( barc::Record ) + offsetof( barc::Record, status );
+    expect_rejected( scratch, patched( second_status, Parser::ResultType::OK ), "a syntax error turned into a program" );
+
+    return tally.report( "expressions" );
+}
@@ -0,0 +1,120 @@
+/**
+ * @file check_test.cpp
+ * @brief Test of the validation-only mode against the tokenizing parser.
+ *
+ * mark_invalid_bytes() must agree with a byte-by-byte classification at every
+ * offset and length, so the SIMD blocks and the tail are both exercised.
+ * Then the lines of the corpus files, mixed with generated lines (some with
+ * invalid bytes, some longer than a read), go through check_mode(): each
+ * reported line must have the code and column of parse_and_tokenize(), and
+ * the summary must count the same results, with the lines holding an
+ * invalid byte apart.
+ *
+ * Usage: bares_check_test [corpus files...]
+ */
+
+#include <random>  // std::mt19937
+#include <sstream> // std::ostringstream
+#include <string>  // std::string
+#include <vector>  // std::vector
+
+#include <unistd.h> // lseek
+
+#include "../include/check.h"
+#include "differential.h"
+
+namespace {
+    differential::Tally tally;
+
+    /// The bytes a valid expression may have.
+    bool valid_byte( char c ) {
+        return std::string( "0123456789+-*/%^() \t\n\v\f\r" ).find( c ) != std::string::npos and c != '\0';
+    }
+}
+
+int main( int argc, char * argv[] ) {
+    std::mt19937 rng{ 2046 };
+
+    // [I] The pre-pass, at every alignment.
+    {
+        std::string bytes;
+        for ( int i{0}; i < 1000; i++ )
+            bytes += static_cast< char >( rng() % 4 == 0 ? rng() % 256 : "0123 +-()\t9^"[ rng() % 12 ] );
+        std::vector< std::uint64_t > mask( bytes.size() / 64 + 2 );
+        for ( std::size_t first{0}; first < 70; first++ ) {
+            for ( std::size_t size : { std::size_t{0}, std::size_t{1}, std::size_t{63}, std::size_t{64}, std::size_t{65},
+                                       std::size_t{200}, bytes.size() - first } ) {
+                mark_invalid_bytes( bytes.data() + first, size, mask.data() );
+                for ( std::size_t i{0}; i < size; i++ ) {
+                    bool invalid = ( mask[ i / 64 ] >> ( i % 64 ) ) & 1;
+                    tally.expect( invalid != valid_byte( bytes[ first + i ] ), [&] {
+                        return "Byte " + std::to_string( static_cast< unsigned char >( bytes[ first + i ] ) ) + " at " +
+                               std::to_string( first ) + "+" + std::to_string( i ) + " marked " +
+                               ( invalid ? "invalid" : "valid" );
+                    } );
+                }
+            }
+        }
+    }
+
+    // [II] The input: corpus lines, generated lines and a few long ones, the last without "\n".
+    std::vector< std::string > lines;
+    if ( not differential::for_each_corpus_line( argc, argv, [&]( const std::string & line ) { lines.push_back( line ); } ) )
+        return EXIT_FAILURE;
+    for ( int i{0}; i < 20000; i++ )
+        lines.push_back( differential::random_line_with_strays( rng ) );
+    std::string longest{ "1" };
+    while ( longest.size() < 3000000 ) longest += " + 1";
+    lines.push_back( longest );
+    lines.push_back( longest + " x" );
+    lines.push_back( "(" + longest );
+    lines.push_back( "7 * 6" );
+
+    std::FILE * input = differential::input_file( lines, lines.size(), false );
+
+    // [III] Each line, against parse_and_tokenize().
+    Parser parser;
+    std::vector< Parser::ResultType > want;
+    unsigned long counts[ Parser::ResultType::n_codes ] = {};
+    unsigned long invalid_bytes{0};
+    for ( const auto & line : lines ) {
+        want.push_back( parser.parse_and_tokenize( line ) );
+        bool clean{true};
+        for ( char c : line ) clean = clean and valid_byte( c );
+        if ( clean ) counts[ want.back().type ]++;
+        else invalid_bytes++;
+    }
+
+    lseek( fileno( input ), 0, SEEK_SET );
+    std::ostringstream report;
+    check_mode( fileno( input ), report, false, Parser::Limits{} );
+    std::istringstream got{ report.str() };
+    std::string line;
+    for ( std::size_t i{0}; i < lines.size(); i++ ) {
+        std::string expected = Parser::ResultType::code_name( want[i].type );
+        if ( want[i].type != Parser::ResultType::OK )
+            expected += " " + std::to_string( want[i].at_col + 1 );
+        bool more = static_cast< bool >( std::getline( got, line ) );
+        tally.expect( more and line == expected, [&] {
+            return "Line " + std::to_string( i + 1 ) + " \"" + lines[i].substr( 0, 40 ) + "\": expected \"" + expected +
+                   "\", got \"" + ( more ? line : "<end>" ) + "\"";
+        } );
+    }
+
+    // [IV] The summary.
+    lseek( fileno( input ), 0, SEEK_SET );
+    std::ostringstream summary;
+    check_mode( fileno( input ), summary, true, Parser::Limits{} );
+    std::ostringstream expected;
+    expected << "lines: " << lines.size() << "\n";
+    for ( int code{0}; code < Parser::ResultType::n_codes; code++ )
+        if ( counts[code] > 0 or code == Parser::ResultType::OK )
+            expected << Parser::ResultType::code_name( static_cast< Parser::ResultType::code_t >( code ) ) << ": "
+                     << counts[code] << "\n";
+    expected << "INVALID_BYTES: " << invalid_bytes << "\n";
+    tally.expect( summary.str() == expected.str(),
+                  [&] { return "Summary:\n" + summary.str() + "expected:\n" + expected.str(); } );
+    std::fclose( input );
+
+    return tally.report( "results" );
+}
@@ -0,0 +1,181 @@
+/**
+ * @file checkpoint_test.cpp
+ * @brief Test of checkpoint and resume: a run stopped and resumed writes what a whole run writes.
+ *
+ * A stopped run is simulated by a run over the first lines of the input
+ * only, which records its checkpoint, followed by some output written after
+ * the checkpoint (as a run killed between two checkpoints leaves). Resuming
+ * over the whole input must then leave exactly the output of a run that was
+ * never stopped, for the plain output and for the aggregates, with the input
+ * in a file or in a pipe.
+ *
+ * Usage: bares_checkpoint_test checkpoint_path [corpus files...]
+ */
+
+#include <cstdio>  // std::remove
+#include <fstream> // std::ifstream, std::ofstream
+#include <random>  // std::mt19937
+#include <sstream> // std::ostringstream
+#include <string>  // std::string
+#include <thread>  // std::thread
+#include <vector>  // std::vector
+
+#include <unistd.h> // lseek, write, pipe, close
+
+#include "../include/checkpoint.h"
+#include "../include/pipeline.h"
+#include "differential.h"
+
+namespace {
+    using differential::contents;
+    using differential::input_file;
+
+    differential::Tally tally;
+
+    void expect( const std::string & what, bool ok ) {
+        tally.expect( ok, [&] { return what; } );
+    }
+
+    /**
+     * @brief Runs over the first `cut` lines, then resumes over all of them.
+     * @param what the parts of the aggregate, or 0 for the plain output.
+     * @param through_pipe whether the resumed run reads the input from a pipe.
+     * @return what the resumed run left in the output.
+     */
+    std::string stop_and_resume( const std::vector< std::string > & lines, std::size_t cut, unsigned evaluators,
+                                 unsigned what, bool through_pipe, const std::string & path ) {
+        Checkpoint::Options options;
+        options.path = path.c_str();
+        options.interval = 0;
+        std::FILE * output = std::tmpfile();
+
+        std::FILE * prefix = input_file( lines, cut );
+        if ( what == 0 ) pipeline_mode( fileno( prefix ), fileno( output ), evaluators, Parser::Limits{}, options );
+        else aggregate_mode( fileno( prefix ), fileno( output ), evaluators, what, Parser::Limits{}, options );
+        Checkpoint state;
+        expect( "No checkpoint after " + std::to_string( cut ) + " lines",
+                state.load( path ) and state.lines == cut and state.offset == contents( prefix ).size() );
+        std::fclose( prefix );
+        // Stopped after the checkpoint, in the middle of a line.
+        std::fputs( "Output of lines after the checkpo", output );
+        std::fflush( output );
+
+        options.resume = true;
+        std::FILE * whole = input_file( lines, lines.size() );
+        int fds[2] = { fileno( whole ), -1 };
+        std::thread feeder;
+        if ( through_pipe and pipe( fds ) == 0 )
+            feeder = std::thread{ [&]() {
+                const std::string text = contents( whole );
+                for ( std::size_t done{0}; done < text.size(); ) {
+                    ssize_t n = write( fds[1], text.data() + done, text.size() - done );
+                    if ( n <= 0 ) break;
+                    done += static_cast< std::size_t >( n );
+                }
+                close( fds[1] );
+            } };
+        if ( what == 0 ) pipeline_mode( fds[0], fileno( output ), evaluators, Parser::Limits{}, options );
+        else aggregate_mode( fds[0], fileno( output ), evaluators, what, Parser::Limits{}, options );
+        if ( feeder.joinable() ) {
+            feeder.join();
+            close( fds[0] );
+        }
+        std::fclose( whole );
+        std::string result = contents( output );
+        std::fclose( output );
+        return result;
+    }
+}
+
+int main( int argc, char * argv[] ) {
+    if ( argc < 2 ) {
+        std::cerr << "Usage: " << argv[0] << " checkpoint_path [corpus files...]\n";
+        return EXIT_FAILURE;
+    }
+    const std::string path{ argv[1] };
+
+    // [I] A checkpoint is read back as it was recorded, and a broken one is not read.
+    {
+        Checkpoint saved;
+        saved.offset = 123456789012ull;
+        saved.lines = 4242;
+        saved.output = 99;
+        saved.what = Aggregate::SUM | Aggregate::HIST;
+        saved.aggregate.add( Parser::ResultType{ Parser::ResultType::OK }, -32768 );
+        saved.aggregate.add( Parser::ResultType{ Parser::ResultType::OVERFLOW_ERROR }, 0 );
+        Checkpoint loaded;
+        std::ostringstream a, b;
+        saved.aggregate.print( a, ~0u );
+        bool ok = saved.save( path ) and loaded.load( path );
+        loaded.aggregate.print( b, ~0u );
+        expect( "Checkpoint not read back", ok and loaded.offset == saved.offset and loaded.lines == saved.lines and
+                                                loaded.output == saved.output and loaded.what == saved.what and
+                                                a.str() == b.str() );
+        expect( "Temporary file left behind", not std::ifstream{ path + ".tmp" } );
+        std::ofstream{ path } << "bares-checkpoint 1\n12 3\n";
+        expect( "Broken checkpoint read", not loaded.load( path ) and loaded.offset == saved.offset );
+    }
+
+    // [II] The input.
+    std::vector< std::string > lines;
+    if ( not differential::for_each_corpus_line(
+             argc, argv, [&]( const std::string & line ) { lines.push_back( line ); }, 2 ) )
+        return EXIT_FAILURE;
+    std::mt19937 rng{ 2048 };
+    for ( int i{0}; i < 40000; i++ )
+        lines.push_back( differential::random_chain( rng, 1000, 4, 10 ) );
+
+    // [III] What a run that is never stopped writes.
+    const unsigned all = Aggregate::SUM | Aggregate::MIN | Aggregate::MAX | Aggregate::COUNT | Aggregate::HIST;
+    std::string want_plain, want_aggregate;
+    {
+        std::FILE * whole = input_file( lines, lines.size() );
+        std::FILE * output = std::tmpfile();
+        pipeline_mode( fileno( whole ), fileno( output ), 2 );
+        want_plain = contents( output );
+        std::fclose( output );
+        lseek( fileno( whole ), 0, SEEK_SET );
+        output = std::tmpfile();
+        aggregate_mode( fileno( whole ), fileno( output ), 2, all );
+        want_aggregate = contents( output );
+        std::fclose( output );
+        std::fclose( whole );
+    }
+
+    // [IV] Stopped anywhere, resumed from a file or a pipe.
+    for ( std::size_t cut : { std::size_t{0}, std::size_t{1}, lines.size() / 3, lines.size() - 1, lines.size() } )
+        for ( unsigned evaluators : { 1u, 3u } )
+            for ( bool through_pipe : { false, true } ) {
+                const std::string where = " stopped at line " + std::to_string( cut ) + " with " +
+                                          std::to_string( evaluators ) + " evaluator(s)" +
+                                          ( through_pipe ? ", from a pipe" : "" );
+                expect( "Output" + where, stop_and_resume( lines, cut, evaluators, 0, through_pipe, path ) == want_plain );
+                expect( "Aggregate" + where,
+                        stop_and_resume( lines, cut, evaluators, all, through_pipe, path ) == want_aggregate );
+            }
+
+    // [V] A checkpoint of another mode, or an output that was not appended to, is refused.
+    {
+        Checkpoint::Options options;
+        options.path = path.c_str();
+        options.resume = true;
+        Checkpoint state;
+        state.what = all;
+        state.save( path );
+        std::FILE * whole = input_file( lines, lines.size() );
+        std::FILE * output = std::tmpfile();
+        expect( "Resumed a checkpoint of another mode",
+                pipeline_mode( fileno( whole ), fileno( output ), 1, Parser::Limits{}, options ) == EXIT_FAILURE );
+        state.what = 0;
+        state.output = 10;
+        state.save( path );
+        expect( "Resumed over a truncated output",
+                pipeline_mode( fileno( whole ), fileno( output ), 1, Parser::Limits{}, options ) == EXIT_FAILURE and
+                    contents( output ).empty() );
+        std::fclose( output );
+        std::fclose( whole );
+    }
+    std::remove( path.c_str() );
+
+    return tally.report( "resumes" );
+}
@@ -0,0 +1,110 @@
+/**
+ * @file columnar_test.cpp
+ * @brief Differential test of the columnar evaluation against Program::run().
+ *
+ * Generated templates over the variables `x`, `y` and `z` are compiled once
+ * and evaluated over columns of random rows, with every set of kernels the
+ * processor supports, from the plain and from the optimized program. Each
+ * row must get the code and the value that Program::run() gives for its
+ * bindings. The columns mix small values with the extremes of `short`, so
+ * the overflow masks of every kernel are exercised, and their length is not
+ * a multiple of the block, so the tails are too.
+ *
+ * Usage: bares_columnar_test
+ */
+
+#include <random>  // std::mt19937
+#include <string>  // std::string
+#include <vector>  // std::vector
+
+#include "../include/bares_manager.h"
+#include "../include/columnar.h"
+#include "../include/optimizer.h"
+#include "../include/symbol_table.h"
+#include "differential.h"
+
+namespace {
+    const char * const names[] = { "x", "y", "z" };
+    const char * const isa_names[] = { "SCALAR", "SSE2", "AVX2" };
+
+    /// A term that is not a group: usually a variable, sometimes a small integer.
+    std::string leaf( std::mt19937 & rng ) {
+        return rng() % 3 != 0 ? std::string{ names[ rng() % 3 ] } : differential::random_integer( rng, 5 );
+    }
+
+    /// A random value: usually small, sometimes near the limits of `short`.
+    Parser::required_int_type value( std::mt19937 & rng ) {
+        static const int extremes[] = { -32768, -32767, -256, -181, -1, 0, 1, 181, 255, 256, 32767 };
+        switch ( rng() % 4 ) {
+            case 0: return static_cast< Parser::required_int_type >( extremes[ rng() % 11 ] );
+            case 1: return static_cast< Parser::required_int_type >( static_cast< int >( rng() % 65536 ) - 32768 );
+            default: return static_cast< Parser::required_int_type >( static_cast< int >( rng() % 41 ) - 20 );
+        }
+    }
+
+    differential::Tally tally;
+}
+
+int main(void) {
+    SymbolTable table;
+    for ( const char * name : names ) table.intern( name );
+    table.close();
+    std::vector< Parser::required_int_type > row( table.size() );
+
+    BaresManager bm;
+    bm.use_symbols( &table, row.data() );
+    ColumnarProgram columnar;
+    sta::stack< Parser::input_int_type > st;
+    std::mt19937 rng{ 2044 };
+
+    const std::size_t rows = 3 * ColumnarProgram::block_rows + 77;
+    std::vector< std::vector< Parser::required_int_type > > columns( table.size(), std::vector< Parser::required_int_type >( rows ) );
+    std::vector< const Parser::required_int_type * > pointers;
+    for ( const auto & column : columns ) pointers.push_back( column.data() );
+    std::vector< Parser::required_int_type > values( rows );
+    std::vector< std::uint8_t > status( rows );
+
+    for ( int t{0}; t < 300; t++ ) {
+        const std::string expr = differential::random_template( rng, 1 + rng() % 8, leaf );
+        const bool parsed = bm.parse( expr ).type == Parser::ResultType::OK;
+        tally.expect( parsed, [&] { return "Template \"" + expr + "\" does not parse"; } );
+        if ( not parsed ) continue;
+        bm.infix_to_postfix();
+        for ( auto & column : columns )
+            for ( auto & v : column ) v = value( rng );
+
+        Program program;
+        bm.compile( program );
+        for ( int optimized{0}; optimized < 2; optimized++ ) {
+            if ( optimized ) optimize( program );
+            columnar.compile( program );
+            for ( int isa{0}; isa <= ColumnarProgram::best_isa(); isa++ ) {
+                columnar.use_isa( static_cast< ColumnarProgram::isa_t >( isa ) );
+                std::size_t failed = columnar.evaluate( pointers.data(), rows, values.data(), status.data() );
+                std::size_t expected_failed{0};
+                for ( std::size_t r{0}; r < rows; r++ ) {
+                    for ( std::size_t s{0}; s < row.size(); s++ ) row[s] = columns[s][r];
+                    Parser::required_int_type want{0};
+                    Parser::ResultType result = program.run( want, st, row.data() );
+                    expected_failed += result.type != Parser::ResultType::OK;
+                    tally.expect( status[r] == result.type and ( result.type != Parser::ResultType::OK or values[r] == want ),
+                                  [&] {
+                                      return "\"" + expr + "\"" + ( optimized ? " (optimized)" : "" ) + " on " +
+                                             isa_names[ isa ] + ", x=" + std::to_string( row[0] ) +
+                                             " y=" + std::to_string( row[1] ) + " z=" + std::to_string( row[2] ) +
+                                             ": expected " + Parser::ResultType::code_name( result.type ) + " = " +
+                                             std::to_string( want ) + ", got " +
+                                             Parser::ResultType::code_name( static_cast< Parser::ResultType::code_t >( status[r] ) ) +
+                                             " = " + std::to_string( values[r] );
+                                  } );
+                }
+                tally.expect( failed == expected_failed, [&] {
+                    return "\"" + expr + "\": " + std::to_string( failed ) + " failed rows reported, " +
+                           std::to_string( expected_failed ) + " expected";
+                } );
+            }
+        }
+    }
+
+    return tally.report( "rows" );
+}
@@ -0,0 +1,73 @@
+/**
+ * @file compile_time_test.cpp
+ * @brief Checks of the compile-time evaluation API.
+ *
+ * The static assertions are checked by the compiler. At run time, every line
+ * of the corpus files that fits in the capacity is evaluated by
+ * bares::evaluate() and by BaresManager, and both must agree on the code, the
+ * column and the value. The file also holds the expressions that must NOT
+ * compile, each one selected by a macro (see CMakeLists.txt).
+ *
+ * Usage: bares_compile_time_test [corpus files...]
+ */
+
+#include <string> // std::string
+
+#include "../include/compile_time.h"
+#include "differential.h"
+
+//=== Evaluated by the compiler.
+static_assert( bares::eval( "(2+3)*8" ) == 40, "parentheses" );
+static_assert( bares::eval( "2 ^ 3 ^ 2" ) == 64, "left associative power" );
+static_assert( bares::eval( " 10 - 2 * -3 % 4 " ) == 12, "precedence and unary minus" );
+static_assert( bares::eval( "2 ^ -1" ) == 0, "negative exponent" );
+static_assert( bares::eval( "-(2)" ) == 2, "a minus before ( is skipped, like in Parser" );
+static_assert( bares::eval( "-32768" ) == -32768, "smallest literal" );
+static_assert( bares::evaluate< 16 >( "((2%3) * 8" ).code == Parser::ResultType::MISSING_CLOSING, "missing )" );
+static_assert( bares::evaluate< 16 >( "((2%3) * 8" ).at_col == 10, "missing ) column" );
+static_assert( bares::evaluate< 16 >( "(2+3)*/(1-4)" ).code == Parser::ResultType::MISSING_TERM, "missing term" );
+static_assert( bares::evaluate< 16 >( "1 + 200*200" ).code == Parser::ResultType::OVERFLOW_ERROR, "overflow" );
+static_assert( bares::evaluate< 16 >( "1 / (2 - 2)" ).code == Parser::ResultType::DIVISION_BY_ZERO, "division" );
+static_assert( bares::evaluate< 16 >( "1 / 0 + (2" ).code == Parser::ResultType::MISSING_CLOSING, "syntax errors first" );
+static_assert( bares::evaluate< 4 >( "1 + 2" ).code == Parser::ResultType::LIMIT_EXCEEDED, "longer than N" );
+
+//=== Must not compile: the error names the code.
+#if defined( REJECT_OVERFLOW_ERROR )
+constexpr auto rejected = bares::eval( "32767 + 1" );
+#elif defined( REJECT_DIVISION_BY_ZERO )
+constexpr auto rejected = bares::eval( "10 % (3 - 3)" );
+#elif defined( REJECT_INTEGER_OUT_OF_RANGE )
+constexpr auto rejected = bares::eval( "40000 - 2" );
+#elif defined( REJECT_MISSING_TERM )
+constexpr auto rejected = bares::eval( "2 +" );
+#endif
+
+int main( int argc, char * argv[] ) {
+    const std::size_t capacity = 1024;
+    BaresManager bm;
+    differential::Tally tally;
+
+    // A run-time error thrown by eval() carries the code as well.
+    try {
+        std::string_view expr{ "2 * (3" };
+        volatile bool runtime = true; // Keeps the call out of constant evaluation.
+        if ( runtime ) bares::eval( "2 * (3" );
+        tally.expect( false, [&] { return "eval(\"" + std::string{ expr } + "\") did not throw"; } );
+    }
+    catch ( const bares::eval_error & e ) {
+        tally.expect( e.result().type == Parser::ResultType::MISSING_CLOSING and e.result().at_col == 6, [&] {
+            return std::string{ "eval_error has code " } + e.what() + " at column " + std::to_string( e.result().at_col );
+        } );
+    }
+
+    const bool read = differential::for_each_corpus_line( argc, argv, [&]( const std::string & line ) {
+        if ( line.size() > capacity ) return;
+        const bares::Result got = bares::evaluate< capacity >( line );
+        const differential::Reference want = differential::reference( bm, line );
+        const Parser::ResultType status{ got.code, got.at_col };
+        tally.expect( differential::agrees( want, status, got.value ),
+                      [&] { return "\"" + line + "\": " + differential::difference( want, status, got.value ); } );
+    } );
+    if ( not read ) return EXIT_FAILURE;
+    return tally.report( "expressions" );
+}
@@ -0,0 +1,225 @@
+#ifndef _DIFFERENTIAL_H_
+#define _DIFFERENTIAL_H_
+
+/**
+ * @file differential.h
+ * @brief What the differential tests share: the reference, the random lines and the corpus.
+ *
+ * Every engine is checked against BaresManager (a full parse, then
+ * calculate()) on the lines of the corpus files and on generated lines. The
+ * tests keep here the reference evaluation, the generators, the reading of
+ * the corpus and the count of failures; each one keeps only how its engine
+ * is fed and what else it must guarantee. The tests of the modes that read
+ * a file descriptor also share how the input is written and the output read
+ * back.
+ */
+
+#include <atomic>   // std::atomic
+#include <cstdio>   // std::FILE, std::tmpfile, std::fwrite, std::fputc, std::fflush
+#include <fstream>  // std::ifstream
+#include <iostream> // std::cerr, std::cout
+#include <random>   // std::mt19937
+#include <string>   // std::string
+#include <vector>   // std::vector
+
+#include <unistd.h> // lseek, read
+
+#include "../include/bares_manager.h"
+#include "../include/optimizer.h"
+
+namespace differential {
+    /// How many results were checked, and how many of them were wrong (threads may share it).
+    struct Tally {
+        std::atomic< unsigned long > checked{0}, failures{0};
+
+        /// Counts a result, printing `what()` for the first failures.
+        template < typename What >
+        void expect( bool ok, What what ) {
+            checked++;
+            if ( not ok and failures++ < 10 ) std::cerr << what() << "\n";
+        }
+
+        /// Prints ">>> N `what` checked, F failure(s)." and returns the exit status of the test.
+        int report( const std::string & what ) const {
+            std::cout << ">>> " << checked << " " << what << " checked, " << failures << " failure(s).\n";
+            return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+        }
+    };
+
+    /// What BaresManager makes of a line.
+    struct Reference {
+        bool parsed;                     //!< Whether the line is a valid expression.
+        Parser::ResultType result;       //!< The code and column of the line.
+        Parser::required_int_type value; //!< The value, when the code is OK.
+    };
+
+    /// Parses a line and, if it is valid, calculates it.
+    inline Reference reference( BaresManager & bm, const std::string & line ) {
+        Reference want{ false, bm.parse( line ), 0 };
+        if ( want.result.type == Parser::ResultType::OK ) {
+            want.parsed = true;
+            bm.infix_to_postfix();
+            bm.calculate();
+            want.result = bm.get_status();
+            want.value = bm.get_value();
+        }
+        return want;
+    }
+
+    /// Whether a result is the reference: the same code, the same column (if `columns`) and, if OK, the same value.
+    inline bool agrees( const Reference & want, const Parser::ResultType & got, Parser::required_int_type value,
+                        bool columns = true ) {
+        return got.type == want.result.type and ( not columns or got.at_col == want.result.at_col ) and
+               ( want.result.type != Parser::ResultType::OK or value == want.value );
+    }
+
+    /// "expected CODE at COLUMN = VALUE, got CODE at COLUMN = VALUE".
+    inline std::string difference( const Reference & want, const Parser::ResultType & got,
+                                   Parser::required_int_type value ) {
+        return std::string{ "expected " } + Parser::ResultType::code_name( want.result.type ) + " at " +
+               std::to_string( want.result.at_col ) + " = " + std::to_string( want.value ) + ", got " +
+               Parser::ResultType::code_name( got.type ) + " at " + std::to_string( got.at_col ) + " = " +
+               std::to_string( value );
+    }
+
+    /**
+     * @brief Checks a program engine on a valid line, from the plain and from the optimized program.
+     * @param run compiles a Program and runs it: `Parser::ResultType run( const Program &, Parser::required_int_type & )`.
+     */
+    template < typename Run >
+    void check_program( Tally & tally, BaresManager & bm, const std::string & line, Run run ) {
+        const Reference want = reference( bm, line );
+        if ( not want.parsed ) return;
+        Program program;
+        bm.compile( program );
+        for ( int optimized{0}; optimized < 2; optimized++ ) {
+            if ( optimized ) optimize( program );
+            Parser::required_int_type got{0};
+            const Parser::ResultType status = run( program, got );
+            tally.expect( agrees( want, status, got, false ), [&] {
+                return "\"" + line + "\"" + ( optimized ? " (optimized)" : "" ) + ": " +
+                       difference( want, status, got );
+            } );
+        }
+    }
+
+    /// A random expression of `terms` terms, some of them groups (a few negated), with and without spaces.
+    inline std::string random_expression( std::mt19937 & rng, int terms ) {
+        static const char * ops[] = { " + ", "-", "*", " / ", "%", "^", " - " };
+        std::string e;
+        for ( int i{0}; i < terms; i++ ) {
+            if ( i > 0 ) e += ops[ rng() % 7 ];
+            if ( terms > 1 and rng() % 3 == 0 )
+                e += ( rng() % 5 == 0 ? "-(" : "(" ) + random_expression( rng, 1 + rng() % 4 ) + ")";
+            else
+                e += std::to_string( static_cast< int >( rng() % 41 ) - 20 );
+        }
+        return e;
+    }
+
+    /**
+     * @brief A random expression of `terms` terms, " op " between them, some of them groups of up to `group` terms.
+     * @param leaf writes a term that is not a group: `std::string leaf( std::mt19937 & )`.
+     * @param odds one term in `odds` is a group.
+     */
+    template < typename Leaf >
+    std::string random_template( std::mt19937 & rng, int terms, Leaf leaf, int group = 4, int odds = 4 ) {
+        static const char ops[] = { '+', '-', '*', '/', '%', '^' };
+        std::string e;
+        for ( int i{0}; i < terms; i++ ) {
+            if ( i > 0 ) e += std::string( " " ) + ops[ rng() % 6 ] + " ";
+            if ( terms > 1 and rng() % odds == 0 )
+                e += "(" + random_template( rng, 1 + rng() % group, leaf, group, odds ) + ")";
+            else
+                e += leaf( rng );
+        }
+        return e;
+    }
+
+    /// A random integer of [-`magnitude`, `magnitude`].
+    inline std::string random_integer( std::mt19937 & rng, int magnitude ) {
+        return std::to_string( static_cast< int >( rng() % ( 2 * magnitude + 1 ) ) - magnitude );
+    }
+
+    /// "A op b op c...": up to `ops` operations on a first integer of [-`first`, `first`], with operands of [-`operand`, `operand`].
+    inline std::string random_chain( std::mt19937 & rng, int first, int ops, int operand ) {
+        static const char symbols[] = { '+', '-', '*', '/', '%', '^' };
+        std::string e = random_integer( rng, first );
+        int n = rng() % ( ops + 1 );
+        for ( int i{0}; i < n; i++ )
+            e += std::string( " " ) + symbols[ rng() % 6 ] + " " + random_integer( rng, operand );
+        return e;
+    }
+
+    /// A random line: mostly the alphabet of expressions, so that all the errors appear.
+    inline std::string random_line( std::mt19937 & rng ) {
+        static const std::string alphabet{ "0123456789+-*/%^()  x" };
+        std::string e;
+        std::size_t len = rng() % 24;
+        for ( std::size_t i{0}; i < len; i++ ) {
+            if ( rng() % 3 == 0 )
+                e += std::to_string( static_cast< int >( rng() % 41 ) - 20 );
+            else
+                e += alphabet[ rng() % alphabet.size() ];
+        }
+        return e;
+    }
+
+    /// A random line of pieces of expressions, some of them bytes no expression has ("a", ".", "\r"...).
+    inline std::string random_line_with_strays( std::mt19937 & rng ) {
+        static const std::string pieces[] = { "1", "23", "-4", "0", "32767", "40000", " + ", "-", " * ", "/", "%", "^",
+                                              "(", ")", " ", "\t", "a", ".", "x1", "\r" };
+        std::string e;
+        int n = 1 + rng() % 12;
+        for ( int i{0}; i < n; i++ ) {
+            std::size_t p = rng() % 20;
+            if ( p >= 16 and rng() % 3 != 0 ) p = rng() % 4; // Stray bytes are rarer.
+            e += pieces[p];
+        }
+        return e;
+    }
+
+    /**
+     * @brief Calls `f( line )` for every line of the corpus files named on the command line.
+     * @param first the first argument that names a corpus file.
+     * @return false, after saying so, if a file cannot be opened.
+     */
+    template < typename F >
+    bool for_each_corpus_line( int argc, char * argv[], F f, int first = 1 ) {
+        for ( int i{first}; i < argc; i++ ) {
+            std::ifstream file{ argv[i] };
+            if ( not file ) {
+                std::cerr << "Cannot open corpus \"" << argv[i] << "\"\n";
+                return false;
+            }
+            std::string line;
+            while ( std::getline( file, line ) ) f( line );
+        }
+        return true;
+    }
+
+    /// A temporary file with the first `n` lines, each with its newline (but the last, unless `newline_at_end`), read from its beginning.
+    inline std::FILE * input_file( const std::vector< std::string > & lines, std::size_t n, bool newline_at_end = true ) {
+        std::FILE * file = std::tmpfile();
+        for ( std::size_t i{0}; i < n; i++ ) {
+            std::fwrite( lines[i].data(), 1, lines[i].size(), file );
+            if ( newline_at_end or i + 1 < n ) std::fputc( '\n', file );
+        }
+        std::fflush( file );
+        lseek( fileno( file ), 0, SEEK_SET );
+        return file;
+    }
+
+    /// Everything written to a file, from its beginning.
+    inline std::string contents( std::FILE * file ) {
+        std::string text;
+        char buffer[4096];
+        lseek( fileno( file ), 0, SEEK_SET );
+        ssize_t n;
+        while ( ( n = read( fileno( file ), buffer, sizeof buffer ) ) > 0 )
+            text.append( buffer, static_cast< std::size_t >( n ) );
+        return text;
+    }
+}
+
+#endif
@@ -0,0 +1,89 @@
+/**
+ * @file fork_join_test.cpp
+ * @brief Differential test of ForkJoinEvaluator on long chains against BaresManager::calculate().
+ *
+ * Flat chains of `+` and `-` (tens of thousands of terms, the case that
+ * the left spine alone does not split), with right children of one or a few
+ * tokens, with an overflow or a division by zero at chosen places, and with
+ * other operators and large parenthesized terms in the middle of the spine,
+ * are evaluated with several cutoffs: the result must be the one of the
+ * sequential evaluation, with the same error.
+ *
+ * Usage: bares_fork_join_test [corpus files...]
+ */
+
+#include <random>  // std::mt19937
+#include <string>  // std::string
+#include <vector>  // std::vector
+
+#include "../include/fork_join.h"
+#include "differential.h"
+
+namespace {
+    differential::Tally tally;
+
+    /// The result with the engine must be the one without it.
+    void check( BaresManager & sequential, BaresManager & parallel, const std::string & expr, const std::string & what ) {
+        const differential::Reference want = differential::reference( sequential, expr );
+        const Parser::ResultType got = parallel.compute( expr );
+        const Parser::required_int_type value = parallel.get_value();
+        tally.expect( differential::agrees( want, got, value ),
+                      [&] { return what + ": " + differential::difference( want, got, value ); } );
+    }
+
+    /// A chain of `terms` terms joined by + and -, whose partial sums stay in range.
+    std::string chain( std::mt19937 & rng, std::size_t terms, bool small_terms ) {
+        std::string e{ "1" };
+        long sum{1};
+        for ( std::size_t i{1}; i < terms; i++ ) {
+            long v = static_cast< long >( rng() % 1000 );
+            bool plus = sum + v <= 32767 and ( sum - v < -32768 or rng() % 2 == 0 );
+            sum += plus ? v : -v;
+            e += plus ? " + " : " - ";
+            if ( small_terms or rng() % 4 != 0 ) e += std::to_string( v );
+            else e += "(" + std::to_string( v * 2 ) + " / 2)"; // A right child of a few tokens.
+        }
+        return e;
+    }
+}
+
+int main( int argc, char * argv[] ) {
+    std::vector< std::string > lines;
+    if ( not differential::for_each_corpus_line( argc, argv, [&]( const std::string & line ) { lines.push_back( line ); } ) )
+        return EXIT_FAILURE;
+
+    std::mt19937 rng{ 2031 };
+    const std::size_t terms = 50000;
+    const std::string flat = chain( rng, terms, true );
+    const std::string mixed = chain( rng, terms, false );
+    std::vector< std::pair< std::string, std::string > > cases;
+    for ( const auto & line : lines ) cases.emplace_back( line, "\"" + line.substr( 0, 40 ) + "\"" );
+    cases.emplace_back( flat, "flat chain" );
+    cases.emplace_back( mixed, "chain with small subtrees" );
+    // An overflow at the start, in the middle and at the end of the chain.
+    cases.emplace_back( "32000 + 800 + " + flat, "overflow at the start" );
+    cases.emplace_back( flat.substr( 0, flat.size() / 2 ) + " + 30000 + 30000 - 30000 - 30000 + " +
+                            flat.substr( flat.size() / 2 + 1 ),
+                        "overflow in the middle" );
+    cases.emplace_back( flat + " + 32767 + 32767", "overflow at the end" );
+    // A division by zero in a right child, before and after an overflow.
+    cases.emplace_back( mixed.substr( 0, mixed.size() / 3 ) + " + 1 / 0 + " + mixed.substr( mixed.size() / 3 + 1 ) +
+                            " + 32767 + 32767",
+                        "division by zero before an overflow" );
+    cases.emplace_back( "32767 + 32767 + " + mixed + " + 1 / 0", "overflow before a division by zero" );
+    // Other operators and large terms break the runs of + and -.
+    cases.emplace_back( flat + " * 0 + " + mixed, "multiplication in the spine" );
+    cases.emplace_back( "(" + flat + ") - (" + mixed + ") + " + flat, "large right children" );
+    cases.emplace_back( flat + " / 0 + " + flat, "division by zero in the spine" );
+
+    BaresManager sequential;
+    for ( std::size_t cutoff : { std::size_t{2}, std::size_t{16}, std::size_t{4096} } ) {
+        ForkJoinEvaluator engine{ 4, cutoff };
+        BaresManager parallel;
+        parallel.use_fork_join( &engine, 0 );
+        for ( const auto & c : cases )
+            check( sequential, parallel, c.first, c.second + " with a cutoff of " + std::to_string( cutoff ) );
+    }
+
+    return tally.report( "expressions" );
+}
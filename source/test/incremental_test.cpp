@@ -0,0 +1,114 @@
+/**
+ * @file incremental_test.cpp
+ * @brief Differential test of IncrementalParser against a full parse.
+ *
+ * Random expressions are edited many times, by random characters and by
+ * edits that keep them valid (a literal replaced by another one, a group
+ * wrapped around a term). After each edit, the result of
+ * IncrementalParser::edit() must be the one of BaresManager: the same code,
+ * column and value. The edits inside a deep group of a long expression must
+ * also stay incremental: no full validation, and a small part of the line
+ * lexed and validated.
+ *
+ * Usage: bares_incremental_test [corpus files...]
+ */
+
+#include <random> // std::mt19937
+#include <string> // std::string
+
+#include "../include/incremental_parser.h"
+#include "differential.h"
+
+namespace {
+    differential::Tally tally;
+
+    /// The incremental result must be the one of a full parse.
+    void check( BaresManager & bm, const IncrementalParser & inc, const char * what ) {
+        const std::string & expr = inc.expression();
+        const differential::Reference want = differential::reference( bm, expr );
+        const Parser::ResultType & got = inc.result();
+        tally.expect( differential::agrees( want, got, inc.value() ), [&] {
+            return "\"" + expr + "\" after " + what + ": " + differential::difference( want, got, inc.value() );
+        } );
+    }
+
+    /// Applies a random edit.
+    void random_edit( std::mt19937 & rng, IncrementalParser & inc ) {
+        static const std::string alphabet{ "0123456789+-*/%^() x" };
+        const std::string & e = inc.expression();
+        std::size_t pos = rng() % ( e.size() + 1 );
+        switch ( rng() % 4 ) {
+            case 0: // Types a character.
+                inc.edit( pos, 0, std::string( 1, alphabet[ rng() % alphabet.size() ] ) );
+                break;
+            case 1: // Deletes a few characters.
+                inc.edit( pos, 1 + rng() % 3, "" );
+                break;
+            case 2: { // Replaces a literal by another one.
+                std::size_t d = e.find_first_of( "0123456789", pos );
+                if ( d == std::string::npos ) d = e.find_first_of( "0123456789" );
+                if ( d == std::string::npos ) break;
+                std::size_t len = e.find_first_not_of( "0123456789", d );
+                len = ( len == std::string::npos ? e.size() : len ) - d;
+                inc.edit( d, len, std::to_string( rng() % 30 ) );
+                break;
+            }
+            default: { // Wraps a literal in a group.
+                std::size_t d = e.find_first_of( "123456789", pos );
+                if ( d == std::string::npos ) break;
+                std::size_t end = e.find_first_not_of( "0123456789", d );
+                if ( end == std::string::npos ) end = e.size();
+                std::string inner = e.substr( d, end - d );
+                inc.edit( d, end - d, "(" + inner + " + " + std::to_string( rng() % 5 ) + ")" );
+            }
+        }
+    }
+}
+
+int main( int argc, char * argv[] ) {
+    BaresManager bm;
+    IncrementalParser inc;
+    std::mt19937 rng{ 2024 };
+
+    // [I] Corpus lines, each one edited a few times.
+    bool read = differential::for_each_corpus_line( argc, argv, [&]( const std::string & line ) {
+        inc.parse( line );
+        check( bm, inc, "parse" );
+        for ( int k{0}; k < 5; k++ ) {
+            random_edit( rng, inc );
+            check( bm, inc, "an edit" );
+        }
+    } );
+    if ( not read ) return EXIT_FAILURE;
+
+    // [II] Generated expressions, through long sessions of edits.
+    for ( int i{0}; i < 3000; i++ ) {
+        inc.parse( differential::random_expression( rng, 1 + i % 8 ) );
+        check( bm, inc, "parse" );
+        for ( int k{0}; k < 40; k++ ) {
+            random_edit( rng, inc );
+            check( bm, inc, "an edit" );
+        }
+    }
+
+    // [III] An edit deep inside a long expression stays local.
+    std::string deep{ "1" };
+    for ( int level{0}; level < 50; level++ )
+        deep = "(" + deep + " + 2) * (3 - 1)";
+    std::string line = deep;
+    for ( int i{0}; i < 200; i++ )
+        line += " + " + deep;
+    inc.parse( line );
+    std::size_t one = line.find( '1' );
+    inc.edit( one, 1, "7" );
+    check( bm, inc, "a deep edit" );
+    const IncrementalParser::Stats & stats = inc.stats();
+    tally.expect( not stats.full and stats.relexed <= 2 and stats.validated <= 10 and stats.evaluated <= line.size() / 10,
+                  [&] {
+                      return "A deep edit was not incremental: relexed " + std::to_string( stats.relexed ) +
+                             ", validated " + std::to_string( stats.validated ) + ", evaluated " +
+                             std::to_string( stats.evaluated ) + ( stats.full ? " (full)" : "" );
+                  } );
+
+    return tally.report( "results" );
+}
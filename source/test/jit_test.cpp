@@ -0,0 +1,57 @@
+/**
+ * @file jit_test.cpp
+ * @brief Differential test of the JIT against BaresManager::calculate().
+ *
+ * Every valid line of the corpus files, and a set of generated expressions, is
+ * evaluated by calculate() and by the JIT, from the plain and from the
+ * optimized program (which may hold FAIL instructions). Both must agree on the
+ * code and the value. The generated expressions are nested deeper than the
+ * registers that hold the stack, so the spilled slots are exercised too.
+ *
+ * Usage: bares_jit_test [corpus files...]
+ */
+
+#include <random> // std::mt19937
+#include <string> // std::string
+
+#include "../include/jit.h"
+#include "differential.h"
+
+namespace {
+    /// A random expression with `depth` levels of operations, leaning to the right when `right` is set.
+    std::string generate( std::mt19937 & rng, int depth, bool right ) {
+        static const char ops[] = { '+', '-', '*', '/', '%', '^' };
+        if ( depth == 0 or rng() % 8 == 0 )
+            return std::to_string( static_cast< int >( rng() % 21 ) - 10 );
+        std::string left = right ? std::to_string( static_cast< int >( rng() % 9 ) + 1 ) : generate( rng, depth - 1, right );
+        std::string other = generate( rng, depth - 1, right );
+        return "(" + left + ops[ rng() % 6 ] + other + ")";
+    }
+
+    differential::Tally tally;
+
+    /// Evaluates a line both ways, reporting a difference.
+    void check( BaresManager & bm, JitProgram & jit, const std::string & line ) {
+        differential::check_program( tally, bm, line, [&]( const Program & program, Parser::required_int_type & got ) {
+            if ( JitProgram::available() and not jit.compile( program ) )
+                tally.expect( false, [&] { return "No native code for \"" + line + "\""; } );
+            return jit.run( got );
+        } );
+    }
+}
+
+int main( int argc, char * argv[] ) {
+    BaresManager bm;
+    JitProgram jit;
+
+    if ( not differential::for_each_corpus_line( argc, argv, [&]( const std::string & line ) { check( bm, jit, line ); } ) )
+        return EXIT_FAILURE;
+
+    std::mt19937 rng{ 2024 };
+    for ( int i{0}; i < 20000; i++ )
+        check( bm, jit, generate( rng, 1 + i % 12, i % 3 == 0 ) );
+    for ( int i{0}; i < 50; i++ ) // Right-leaning chains keep the whole stack alive.
+        check( bm, jit, generate( rng, 40 + i, true ) );
+
+    return tally.report( JitProgram::available() ? "programs" : "programs (interpreter)" );
+}
@@ -0,0 +1,162 @@
+/**
+ * @file limits_test.cpp
+ * @brief Test of the per-expression resource limits.
+ *
+ * Each limit must turn the lines that exceed it, and only them, into a
+ * LIMIT_EXCEEDED, at the column where the budget ran out; every other line
+ * keeps the result it has without limits. The steps limit must give the same
+ * result on every engine. Finally, a hostile line of millions of tokens must
+ * be refused after reading no more than its budget.
+ *
+ * Usage: bares_limits_test [corpus files...]
+ */
+
+#include <chrono>  // std::chrono::steady_clock
+#include <sstream> // std::ostringstream
+#include <string>  // std::string
+#include <vector>  // std::vector
+
+#include "../include/bares_manager.h"
+#include "differential.h"
+
+namespace {
+    differential::Tally tally;
+
+    typedef Parser::ResultType RT;
+
+    /// Parses and evaluates a line as parse_and_compute() does, returning its status.
+    RT run( BaresManager & bm, const std::string & expr, std::string * output = nullptr ) {
+        std::ostringstream os;
+        bm.parse_and_compute( expr, os );
+        if ( output != nullptr ) *output = os.str();
+        return bm.get_status();
+    }
+
+    /// Checks one line against the expected code and column.
+    void expect( BaresManager & bm, const std::string & expr, RT::code_t code, RT::size_type col ) {
+        RT got = run( bm, expr );
+        tally.expect( got.type == code and ( code != RT::LIMIT_EXCEEDED or got.at_col == col ), [&] {
+            return "\"" + expr + "\": expected " + RT::code_name( code ) + " at " + std::to_string( col ) + ", got " +
+                   RT::code_name( got.type ) + " at " + std::to_string( got.at_col );
+        } );
+    }
+
+    /// A line with `depth` nested parentheses.
+    std::string nested( std::size_t depth ) {
+        return std::string( depth, '(' ) + "1" + std::string( depth, ')' );
+    }
+}
+
+int main( int argc, char * argv[] ) {
+    // [I] Lines within generous limits keep their results.
+    {
+        BaresManager plain, limited;
+        Parser::Limits limits;
+        limits.max_length = 1 << 20;
+        limits.max_tokens = 1 << 16;
+        limits.max_depth = 1 << 12;
+        limits.max_steps = 1 << 16;
+        limits.max_memory = 1 << 24;
+        limited.set_limits( limits );
+        const bool read = differential::for_each_corpus_line( argc, argv, [&]( const std::string & line ) {
+            std::string want, got;
+            run( plain, line, &want );
+            run( limited, line, &got );
+            tally.expect( want == got, [&] {
+                return "\"" + line + "\" changed within the limits: \"" + want + "\" != \"" + got + "\"";
+            } );
+        } );
+        if ( not read ) return EXIT_FAILURE;
+    }
+
+    // [II] Each limit, exactly at and just past it.
+    {
+        BaresManager bm;
+        Parser::Limits limits;
+        limits.max_length = 10;
+        bm.set_limits( limits );
+        expect( bm, "1 + 2 + 30", RT::OK, 0 );
+        expect( bm, "1 + 2 + 300", RT::LIMIT_EXCEEDED, 10 );
+        expect( bm, "           ", RT::LIMIT_EXCEEDED, 10 );
+
+        limits = Parser::Limits{};
+        limits.max_tokens = 5;
+        bm.set_limits( limits );
+        expect( bm, "1 + 2 + 3", RT::OK, 0 );
+        expect( bm, "(1 + 2)", RT::OK, 0 );
+        expect( bm, "1 + 2 + 3 + 4", RT::LIMIT_EXCEEDED, 11 );
+        expect( bm, "(1 + 2) * 3", RT::LIMIT_EXCEEDED, 9 );
+        expect( bm, "1 + 2 + x", RT::MISSING_TERM, 0 ); // The error comes before the sixth token.
+        expect( bm, "1 + 2 + 3 x", RT::EXTRANEOUS_SYMBOL, 0 );
+
+        limits = Parser::Limits{};
+        limits.max_depth = 3;
+        bm.set_limits( limits );
+        expect( bm, nested( 3 ), RT::OK, 0 );
+        expect( bm, nested( 4 ), RT::LIMIT_EXCEEDED, 4 );
+        expect( bm, "(1) + ((2) * ((3)))", RT::OK, 0 );
+        expect( bm, "(1 + ((( 2", RT::LIMIT_EXCEEDED, 9 );
+
+        limits = Parser::Limits{};
+        limits.max_steps = 5;
+        bm.set_limits( limits );
+        expect( bm, "1 + 2 * 3", RT::OK, 0 );
+        expect( bm, "(1 + 2) * 3", RT::OK, 0 ); // Parentheses are not steps.
+        expect( bm, "1 + 2 * 3 - 4", RT::LIMIT_EXCEEDED, 11 ); // Right after the sixth step.
+        expect( bm, "1 + 2 * 3 - x", RT::LIMIT_EXCEEDED, 11 ); // Before the error it would reach.
+
+        limits = Parser::Limits{};
+        limits.max_memory = 3 * Parser::Limits::bytes_per_token;
+        bm.set_limits( limits );
+        expect( bm, "1 + 2", RT::OK, 0 );
+        expect( bm, "1 + 2 + 3", RT::LIMIT_EXCEEDED, 7 );
+    }
+
+    // [III] The steps limit gives the same result on every engine, even when an
+    //       error comes before the step it would hit.
+    {
+        ForkJoinEvaluator fork_join{ 2, 2 };
+        ExpressionDag dag;
+        JitProgram jit;
+        std::vector< BaresManager > engines( 5 );
+        engines[1].use_fork_join( &fork_join, 0 );
+        engines[2].use_dag( &dag );
+        engines[3].use_optimizer( true );
+        engines[4].use_jit( &jit );
+        Parser::Limits limits;
+        limits.max_steps = 7;
+        for ( auto & bm : engines ) bm.set_limits( limits );
+        for ( const char * expr : { "1 + 2 * 3 - 4", "1 / 0 + 2 + 3 + 4", "2 ^ 20 - 1", "(1 + 2) * (3 + 4) - 5" } ) {
+            std::string want;
+            run( engines[0], expr, &want );
+            for ( std::size_t e{1}; e < engines.size(); e++ ) {
+                std::string got;
+                run( engines[e], expr, &got );
+                tally.expect( got == want, [&] {
+                    return "\"" + std::string{ expr } + "\" on engine " + std::to_string( e ) + ": \"" + got +
+                           "\" != \"" + want + "\"";
+                } );
+            }
+        }
+    }
+
+    // [IV] A hostile line is refused within its budget.
+    {
+        std::string hostile{ "1" };
+        for ( int i{0}; i < 2000000; i++ ) hostile += " + 1";
+        BaresManager bm;
+        Parser::Limits limits;
+        limits.max_tokens = 1000;
+        bm.set_limits( limits );
+        auto start = std::chrono::steady_clock::now();
+        RT result = run( bm, hostile );
+        double ms = std::chrono::duration< double, std::milli >( std::chrono::steady_clock::now() - start ).count();
+        // The copy of the line dominates; without the limit this takes orders of magnitude longer.
+        tally.expect( result.type == RT::LIMIT_EXCEEDED and result.at_col == 4 * 500 + 1 and ms <= 200, [&] {
+            return std::string{ "Hostile line: got " } + RT::code_name( result.type ) + " at " +
+                   std::to_string( result.at_col ) + " in " + std::to_string( ms ) + " ms";
+        } );
+    }
+
+    return tally.report( "results" );
+}
@@ -0,0 +1,91 @@
+/**
+ * @file shapes_test.cpp
+ * @brief Differential test of the shape-batched evaluation against parse_and_compute().
+ *
+ * The lines of the corpus files, mixed with many lines that share a few
+ * generated shapes (with random literals, some at the limits of `short`),
+ * are evaluated by shapes_mode() in batches of several sizes. The output
+ * must be the one of parse_and_compute(), line by line and in order. The
+ * generated lines must also collapse into no more groups than shapes.
+ *
+ * Usage: bares_shapes_test [corpus files...]
+ */
+
+#include <random>  // std::mt19937
+#include <sstream> // std::istringstream, std::ostringstream
+#include <string>  // std::string
+#include <vector>  // std::vector
+
+#include "../include/shape_batch.h"
+#include "differential.h"
+
+namespace {
+    /// A random template of `terms` terms, with `#` where each literal goes.
+    std::string generate( std::mt19937 & rng, int terms ) {
+        return differential::random_template( rng, terms, []( std::mt19937 & ) { return std::string{ "#" }; }, 3 );
+    }
+
+    /// The template with a random literal in each `#`.
+    std::string fill( std::mt19937 & rng, const std::string & shape ) {
+        static const int extremes[] = { -32768, 32767, -1, 0, 1, 181, 256 };
+        std::string e;
+        for ( char c : shape ) {
+            if ( c != '#' ) e += c;
+            else if ( rng() % 5 == 0 ) e += std::to_string( extremes[ rng() % 7 ] );
+            else e += std::to_string( static_cast< int >( rng() % 21 ) - 10 );
+        }
+        return e;
+    }
+}
+
+int main( int argc, char * argv[] ) {
+    differential::Tally tally;
+    std::vector< std::string > lines;
+    if ( not differential::for_each_corpus_line( argc, argv, [&]( const std::string & line ) { lines.push_back( line ); } ) )
+        return EXIT_FAILURE;
+
+    std::mt19937 rng{ 2045 };
+    std::vector< std::string > shapes;
+    for ( int s{0}; s < 20; s++ )
+        shapes.push_back( generate( rng, 1 + rng() % 6 ) );
+    for ( int i{0}; i < 20000; i++ )
+        lines.push_back( fill( rng, shapes[ rng() % shapes.size() ] ) );
+
+    // [I] The expected output, line by line.
+    std::string input;
+    std::ostringstream expected;
+    BaresManager bm;
+    for ( const auto & line : lines ) {
+        input += line + "\n";
+        bm.parse_and_compute( line, expected );
+    }
+
+    // [II] The same output, whatever the size of the batches.
+    for ( std::size_t batch : { std::size_t{1}, std::size_t{7}, std::size_t{4096}, lines.size() } ) {
+        std::istringstream is{ input };
+        std::ostringstream os;
+        shapes_mode( is, os, batch );
+        std::istringstream want{ expected.str() }, got{ os.str() };
+        std::string a, b;
+        for ( std::size_t line{0}; line < lines.size(); line++ ) {
+            std::getline( want, a );
+            bool more = static_cast< bool >( std::getline( got, b ) );
+            tally.expect( more and a == b, [&] {
+                return "\"" + lines[line] + "\" in batches of " + std::to_string( batch ) + ": expected \"" + a +
+                       "\", got \"" + ( more ? b : "<end>" ) + "\"";
+            } );
+        }
+        if ( std::getline( got, b ) )
+            tally.expect( false, [&] { return "Extra output in batches of " + std::to_string( batch ) + ": \"" + b + "\""; } );
+    }
+
+    // [III] Lines that differ only in their literals share one group.
+    ShapeBatch batch;
+    for ( int i{0}; i < 1000; i++ )
+        batch.add( fill( rng, shapes[ i % shapes.size() ] ) );
+    tally.expect( batch.shapes() <= shapes.size(), [&] {
+        return std::to_string( batch.shapes() ) + " groups for " + std::to_string( shapes.size() ) + " shapes";
+    } );
+
+    return tally.report( "lines" );
+}
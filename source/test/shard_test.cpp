@@ -0,0 +1,173 @@
+/**
+ * @file shard_test.cpp
+ * @brief Test of sharding an input file and merging the outputs of the shards.
+ *
+ * Input files with short lines, empty lines, a line longer than a read and no
+ * newline at the end are cut into 1 to 9 shards (more shards than some files
+ * have lines, too). Every line must be evaluated by exactly one shard, with
+ * its number in the whole file, and merging the shard outputs, given in any
+ * order, must write the output of the default mode. A shard left out (the
+ * first or the last one), given twice or cut short must be reported.
+ *
+ * Usage: bares_shard_test output_prefix [corpus files...]
+ */
+
+#include <algorithm> // std::reverse
+#include <cstdio>    // std::tmpfile, std::fwrite, std::fflush, std::remove
+#include <fstream>   // std::ifstream, std::ofstream
+#include <random>    // std::mt19937
+#include <sstream>   // std::ostringstream
+#include <string>    // std::string
+#include <vector>    // std::vector
+
+#include "../include/bares_manager.h"
+#include "../include/shard.h"
+
+namespace {
+    unsigned long checked{0}, failures{0};
+
+    void expect( const std::string & what, bool ok ) {
+        checked++;
+        if ( not ok and failures++ < 10 )
+            std::cerr << what << "\n";
+    }
+
+    /// Shards the text into `count` files and checks them, then their merge.
+    void check( const std::string & text, unsigned long count, const std::string & prefix ) {
+        const std::string where = " of " + std::to_string( count ) + " shards of " + std::to_string( text.size() ) + " bytes";
+        std::FILE * input = std::tmpfile();
+        std::fwrite( text.data(), 1, text.size(), input );
+        std::fflush( input );
+
+        // The expected output, and the lines in the same order.
+        BaresManager bm;
+        std::istringstream lines{ text };
+        std::ostringstream want;
+        std::vector< std::string > results;
+        std::string line;
+        while ( std::getline( lines, line ) ) {
+            std::ostringstream one;
+            bm.parse_and_compute( line, one );
+            want << one.str();
+            results.push_back( one.str() );
+        }
+
+        std::vector< std::string > paths;
+        std::vector< bool > seen( results.size(), false );
+        for ( unsigned long i{0}; i < count; i++ ) {
+            std::ostringstream out;
+            shard_mode( fileno( input ), out, i, count );
+            std::ofstream{ prefix + std::to_string( i ) } << out.str();
+            paths.push_back( prefix + std::to_string( i ) );
+            // Each tagged line is the result of the line with that number, seen once.
+            std::istringstream tagged{ out.str() };
+            std::getline( tagged, line );
+            const std::string header = "#shard " + std::to_string( i ) + "/" + std::to_string( count ) + " ";
+            expect( "First line \"" + line + "\" of shard " + std::to_string( i ) + where, line.compare( 0, header.size(), header ) == 0 );
+            bool ended{false};
+            while ( std::getline( tagged, line ) ) {
+                if ( line.compare( 0, 5, "#end " ) == 0 ) {
+                    ended = true;
+                    continue;
+                }
+                std::size_t number = std::stoul( line.substr( 0, line.find( '\t' ) ) );
+                bool ok = number >= 1 and number <= results.size() and not seen[ number - 1 ] and
+                          line.substr( line.find( '\t' ) + 1 ) + "\n" == results[ number - 1 ];
+                expect( "Line \"" + line.substr( 0, 40 ) + "\" in shard " + std::to_string( i ) + where, ok );
+                if ( ok ) seen[ number - 1 ] = true;
+            }
+            expect( "No last line in shard " + std::to_string( i ) + where, ended );
+        }
+        for ( std::size_t l{0}; l < seen.size(); l++ )
+            if ( not seen[l] ) expect( "Line " + std::to_string( l + 1 ) + " in no shard" + where, false );
+        std::fclose( input );
+
+        // The merge, with the shards in any order.
+        std::reverse( paths.begin(), paths.end() );
+        std::ostringstream merged;
+        expect( "Merge" + where, merge_mode( paths, merged ) == EXIT_SUCCESS and merged.str() == want.str() );
+
+        // A shard given twice, left out (the first or the last one) or cut short.
+        std::ostringstream ignored;
+        std::vector< std::string > twice = paths;
+        twice.push_back( paths.back() );
+        expect( "Shard given twice not reported" + where, merge_mode( twice, ignored ) == EXIT_FAILURE );
+        if ( count > 1 ) {
+            std::vector< std::string > without_first( paths.begin(), paths.end() - 1 );
+            expect( "Missing first shard not reported" + where, merge_mode( without_first, ignored ) == EXIT_FAILURE );
+            std::vector< std::string > without_last( paths.begin() + 1, paths.end() );
+            expect( "Missing last shard not reported" + where, merge_mode( without_last, ignored ) == EXIT_FAILURE );
+        }
+        std::ostringstream last_shard;
+        last_shard << std::ifstream{ paths.front() }.rdbuf();
+        std::string cut_short = last_shard.str();
+        cut_short.erase( cut_short.rfind( "#end " ) );
+        std::ofstream{ prefix + "cut" } << cut_short;
+        std::vector< std::string > with_cut = paths;
+        with_cut.front() = prefix + "cut";
+        expect( "Shard cut short not reported" + where, merge_mode( with_cut, ignored ) == EXIT_FAILURE );
+        std::remove( ( prefix + "cut" ).c_str() );
+
+        // A malformed line in the first file stops the merge, whatever the next files hold.
+        std::string broken = last_shard.str();
+        const std::size_t second = broken.find( '\n' ) + 1;
+        broken.replace( second, broken.find( '\n', second ) - second, "garbage" );
+        std::ofstream{ prefix + "broken" } << broken;
+        std::vector< std::string > with_broken = paths;
+        with_broken.front() = prefix + "broken";
+        std::ostringstream partial;
+        expect( "Malformed line not reported" + where,
+                merge_mode( with_broken, partial ) == EXIT_FAILURE and partial.str().empty() );
+        std::remove( ( prefix + "broken" ).c_str() );
+        for ( const auto & path : paths )
+            std::remove( path.c_str() );
+    }
+}
+
+int main( int argc, char * argv[] ) {
+    if ( argc < 2 ) {
+        std::cerr << "Usage: " << argv[0] << " output_prefix [corpus files...]\n";
+        return EXIT_FAILURE;
+    }
+    const std::string prefix{ argv[1] };
+
+    std::string corpus;
+    for ( int i{2}; i < argc; i++ ) {
+        std::ifstream file{ argv[i] };
+        if ( not file ) {
+            std::cerr << "Cannot open corpus \"" << argv[i] << "\"\n";
+            return EXIT_FAILURE;
+        }
+        std::ostringstream text;
+        text << file.rdbuf();
+        corpus += text.str();
+    }
+
+    std::mt19937 rng{ 2049 };
+    std::string generated;
+    for ( int i{0}; i < 5000; i++ ) {
+        if ( rng() % 50 == 0 ) generated += "\n"; // An empty line.
+        generated += std::to_string( rng() % 1000 ) + " * " + std::to_string( static_cast< int >( rng() % 200 ) - 100 ) + "\n";
+    }
+    std::string longest{ "1" }; // Longer than a read.
+    while ( longest.size() < 1100000 ) longest += " + 1";
+
+    const std::vector< std::string > inputs = {
+        corpus,
+        generated,
+        generated + longest + "\n" + generated,
+        "7 * 6",                    // No newline at the end.
+        "1\n2\n3",                  // Fewer lines than some of the shards.
+        "",
+        "\n\n\n",
+        longest + "\n" + "2 + 2\n" + longest,
+    };
+    for ( const auto & text : inputs )
+        for ( unsigned long count{1}; count <= 9; count++ )
+            // The long line is costly to evaluate: fewer counts for it.
+            if ( text.size() < longest.size() or count % 3 == 1 )
+                check( text, count, prefix );
+
+    std::cout << ">>> " << checked << " shard results checked, " << failures << " failure(s).\n";
+    return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
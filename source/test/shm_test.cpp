@@ -0,0 +1,216 @@
+/**
+ * @file shm_test.cpp
+ * @brief Differential test of the shared memory rings against BaresManager.
+ *
+ * A server with a few workers serves producer threads and a producer in
+ * another process at the same time; the corpus lines and many generated ones
+ * are sent, some copied with submit() and some written in place with
+ * reserve() and commit(), keeping as many requests in flight as the rings
+ * allow. Every response must come back once, to its producer, with the code,
+ * column and value of BaresManager. Attaching more producers than there are
+ * response rings, a request longer than a cell, a producer that detaches with
+ * requests in flight, a producer that overwrites the sizes in the header, a
+ * second server on the same name (refused while the first runs, allowed once
+ * it is gone) and stopping the server while its workers sleep are checked
+ * too.
+ *
+ * Usage: bares_shm_test [corpus files...]
+ */
+
+#include <cerrno>    // errno
+#include <chrono>    // std::chrono::milliseconds
+#include <cstring>   // std::memcpy
+#include <functional> // std::cref
+#include <random>    // std::mt19937
+#include <string>    // std::string
+#include <thread>    // std::thread
+#include <vector>    // std::vector
+
+#include <fcntl.h>    // O_RDWR
+#include <sys/mman.h> // shm_open(), mmap(), munmap()
+#include <sys/wait.h> // waitpid()
+#include <unistd.h>   // fork(), getpid(), _exit()
+
+#include "../include/shm_ring.h"
+#include "differential.h"
+
+namespace {
+    differential::Tally tally;
+
+    void expect( const std::string & what, bool ok ) {
+        tally.expect( ok, [&] { return what; } );
+    }
+
+    /// A line and what BaresManager makes of it.
+    struct Case {
+        std::string line;
+        differential::Reference want;
+    };
+
+    const std::uint32_t producers = 4;
+    const std::uint32_t slots = 64;
+    const std::uint32_t slot_size = 256;
+
+    /**
+     * @brief Sends the cases `first`, `first + step`, ... and checks their responses.
+     * @param in_place whether the lines are written with reserve() and commit() instead of submit().
+     */
+    void produce( const std::string & name, const std::vector< Case > & cases, std::size_t first, std::size_t step,
+                  bool in_place ) {
+        ShmClient client;
+        if ( not client.attach( name ) ) {
+            expect( "Producer " + std::to_string( first ) + " cannot attach", false );
+            return;
+        }
+        std::vector< bool > seen( cases.size(), false );
+        std::size_t next{first}, expected{0};
+        for ( std::size_t i{first}; i < cases.size(); i += step ) expected++;
+        ShmClient::Response response;
+        while ( expected > 0 ) {
+            // As many requests in flight as the rings allow.
+            while ( next < cases.size() ) {
+                const std::string & line = cases[next].line;
+                if ( in_place ) {
+                    char * text = client.reserve();
+                    if ( text == nullptr ) break;
+                    std::memcpy( text, line.data(), line.size() );
+                    client.commit( line.size(), next );
+                }
+                else if ( not client.submit( line.data(), line.size(), next ) ) break;
+                next += step;
+            }
+            if ( not client.receive( response ) ) {
+                expect( "Producer " + std::to_string( first ) + " stopped receiving", false );
+                return;
+            }
+            expected--;
+            const std::uint64_t tag = response.tag;
+            if ( tag >= cases.size() or tag % step != first or seen[tag] ) {
+                expect( "Response with a wrong tag " + std::to_string( tag ), false );
+                continue;
+            }
+            seen[tag] = true;
+            const Case & c = cases[tag];
+            tally.expect( differential::agrees( c.want, response.result, response.value ), [&] {
+                return "\"" + c.line + "\": " + differential::difference( c.want, response.result, response.value );
+            } );
+        }
+        expect( "Requests left in flight", client.in_flight() == 0 );
+    }
+}
+
+int main( int argc, char * argv[] ) {
+    std::vector< std::string > lines;
+    bool read = differential::for_each_corpus_line( argc, argv, [&]( const std::string & line ) {
+        if ( line.size() <= slot_size ) lines.push_back( line );
+    } );
+    if ( not read ) return EXIT_FAILURE;
+    std::mt19937 rng{ 2050 };
+    for ( int i{0}; i < 20000; i++ )
+        lines.push_back( differential::random_line( rng ) );
+    lines.push_back( std::string( slot_size - 5, ' ' ) + "1 + 2" ); // Fills a cell.
+
+    BaresManager bm;
+    std::vector< Case > cases;
+    for ( const auto & line : lines )
+        cases.push_back( Case{ line, differential::reference( bm, line ) } );
+
+    const std::string name = "/bares_shm_test_" + std::to_string( getpid() );
+    ShmServer server{ name, producers, slots, slot_size };
+    if ( not server.ready() ) {
+        std::cerr << "Cannot create the shared memory \"" << name << "\"\n";
+        return EXIT_FAILURE;
+    }
+    std::thread serving{ &ShmServer::run, &server, 3u };
+
+    // [I] Only as many producers as response rings.
+    {
+        std::vector< ShmClient > clients( producers );
+        for ( auto & client : clients )
+            expect( "Cannot attach a producer", client.attach( name ) );
+        ShmClient one_more;
+        expect( "Attached more producers than rings", not one_more.attach( name ) );
+        clients[1].detach();
+        expect( "A detached ring is not free again", one_more.attach( name ) );
+        expect( "A line longer than a cell was sent",
+                not one_more.submit( cases[0].line.data(), one_more.max_length() + 1, 0 ) );
+
+        // Detaching with requests in flight, and a cell reserved: the next producer of the ring gets none of them.
+        for ( std::uint64_t tag{1}; tag < slots; tag++ )
+            one_more.submit( "1 + 1", 5, tag );
+        one_more.reserve();
+        one_more.detach();
+        expect( "Cannot attach again after a detach", one_more.attach( name ) );
+        ShmClient::Response response;
+        expect( "A response to the previous producer of the ring was received",
+                one_more.submit( "2 * 3", 5, 0 ) and one_more.receive( response ) and response.tag == 0 and
+                response.value == 6 and not one_more.try_receive( response ) );
+
+        // A producer that scribbles on the sizes in the header does not move the server's cells.
+        int fd = shm_open( name.c_str(), O_RDWR, 0 );
+        void * mapped = fd < 0 ? MAP_FAILED : mmap( nullptr, sizeof( shm::Header ), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0 );
+        if ( fd >= 0 ) close( fd );
+        expect( "Cannot map the header", mapped != MAP_FAILED );
+        if ( mapped != MAP_FAILED ) {
+            shm::Header * header = static_cast< shm::Header * >( mapped );
+            const std::uint32_t sizes[] = { header->producers, header->slots, header->slot_size };
+            header->producers = 1u << 31;
+            header->slots = 1u << 31;
+            header->slot_size = 1u << 31;
+            expect( "A request was lost after the header was overwritten",
+                    one_more.submit( "7 - 2", 5, 1 ) and one_more.receive( response ) and response.tag == 1 and
+                    response.value == 5 );
+            header->producers = sizes[0];
+            header->slots = sizes[1];
+            header->slot_size = sizes[2];
+            munmap( mapped, sizeof( shm::Header ) );
+        }
+    }
+
+    // [II] A second server on the same name: refused while the first runs, allowed when it is gone.
+    {
+        ShmServer rival{ name, producers, slots, slot_size };
+        expect( "A second server took the name of a running one", not rival.ready() and errno == EEXIST );
+        ShmClient client;
+        expect( "The running server lost its name", client.attach( name ) );
+
+        const std::string left = name + "_left";
+        pid_t gone = fork();
+        if ( gone == 0 ) { // Creates a region and exits without removing it.
+            ShmServer server{ left, 1, slots, slot_size };
+            _exit( server.ready() ? EXIT_SUCCESS : EXIT_FAILURE );
+        }
+        int status{0};
+        expect( "The server that goes away failed",
+                gone > 0 and waitpid( gone, &status, 0 ) == gone and WIFEXITED( status ) and WEXITSTATUS( status ) == 0 );
+        ShmServer replacing{ left, 1, slots, slot_size };
+        expect( "A region left by a server that is gone was not replaced", replacing.ready() );
+    }
+
+    // [III] Producer threads and a producer process, at the same time.
+    const std::size_t step = producers;
+    pid_t child = fork();
+    if ( child == 0 ) {
+        produce( name, cases, 0, step, true );
+        _exit( tally.failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE );
+    }
+    std::vector< std::thread > threads;
+    for ( std::size_t first{1}; first < step; first++ )
+        threads.emplace_back( produce, name, std::cref( cases ), first, step, first % 2 == 0 );
+    for ( auto & t : threads ) t.join();
+    int status{0};
+    expect( "The producer process failed",
+            child > 0 and waitpid( child, &status, 0 ) == child and WIFEXITED( status ) and WEXITSTATUS( status ) == 0 );
+
+    // [IV] Stopping wakes up the sleeping workers; a request left then gets no response.
+    ShmClient waiting;
+    expect( "Cannot attach after the run", waiting.attach( name ) );
+    std::this_thread::sleep_for( std::chrono::milliseconds( 50 ) ); // The workers go to sleep.
+    server.stop();
+    serving.join();
+    waiting.submit( "1", 1, 0 );
+    ShmClient::Response response;
+    expect( "A response came after the stop", not waiting.receive( response ) );
+
+    return tally.report( "shared memory responses" );
+}
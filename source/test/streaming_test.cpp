@@ -0,0 +1,83 @@
+/**
+ * @file streaming_test.cpp
+ * @brief Differential test of StreamingParser against a full parse.
+ *
+ * Every corpus line, and many random ones, is fed in chunks of several sizes
+ * (one byte, a few bytes, the whole line): the result must be the one of
+ * BaresManager, with the same code, column and value. Then a line of tens of
+ * megabytes, generated piece by piece and never held in memory, must be
+ * evaluated with evaluation stacks bounded by its nesting depth.
+ *
+ * Usage: bares_streaming_test [corpus files...]
+ */
+
+#include <algorithm> // std::min
+#include <random>    // std::mt19937
+#include <string>    // std::string
+
+#include "../include/streaming_parser.h"
+#include "differential.h"
+
+namespace {
+    differential::Tally tally;
+
+    /// The streamed result, for every chunk size, must be the one of a full parse.
+    void check( BaresManager & bm, StreamingParser & sp, const std::string & expr ) {
+        const differential::Reference want = differential::reference( bm, expr );
+        for ( std::size_t chunk : { std::size_t{1}, std::size_t{3}, std::size_t{7}, expr.size() + 1 } ) {
+            sp.reset();
+            for ( std::size_t i{0}; i < expr.size(); i += chunk )
+                sp.feed( expr.data() + i, std::min( chunk, expr.size() - i ) );
+            Parser::required_int_type value{0};
+            const Parser::ResultType got = sp.finish( value );
+            tally.expect( differential::agrees( want, got, value ), [&] {
+                return "\"" + expr + "\" in chunks of " + std::to_string( chunk ) + ": " +
+                       differential::difference( want, got, value );
+            } );
+        }
+    }
+}
+
+int main( int argc, char * argv[] ) {
+    BaresManager bm;
+    StreamingParser sp;
+    std::mt19937 rng{ 2024 };
+
+    // [I] Corpus lines.
+    if ( not differential::for_each_corpus_line( argc, argv, [&]( const std::string & line ) { check( bm, sp, line ); } ) )
+        return EXIT_FAILURE;
+
+    // [II] Random lines.
+    for ( int i{0}; i < 50000; i++ )
+        check( bm, sp, differential::random_line( rng ) );
+
+    // [III] A huge line, fed as it is generated: "(1 + 2) * (3 - 1) - (1 + 2) * (3 - 1) + ...".
+    const std::string piece{ "(1 + 2) * (3 - 1) - (1 + 2) * (3 - 1) + " };
+    const std::size_t pieces{ 1 << 20 };
+    sp.reset();
+    for ( std::size_t i{0}; i < pieces; i++ )
+        sp.feed( piece.data(), piece.size() );
+    sp.feed( "0", 1 );
+    Parser::required_int_type value{-1};
+    Parser::ResultType result = sp.finish( value );
+    tally.expect( result.type == Parser::ResultType::OK and value == 0 and sp.peak() <= 8, [&] {
+        return "Huge line of " + std::to_string( sp.size() ) + " bytes: got " +
+               Parser::ResultType::code_name( result.type ) + " = " + std::to_string( value ) + ", with stacks of " +
+               std::to_string( sp.peak() ) + " entries";
+    } );
+
+    // [IV] The same line with an error at its very end: the column is the 64-bit offset.
+    sp.reset();
+    for ( std::size_t i{0}; i < pieces; i++ )
+        sp.feed( piece.data(), piece.size() );
+    sp.feed( "0)", 2 );
+    result = sp.finish( value );
+    Parser::ResultType::size_type col = static_cast< Parser::ResultType::size_type >( piece.size() * pieces + 1 );
+    tally.expect( result.type == Parser::ResultType::EXTRANEOUS_SYMBOL and result.at_col == col, [&] {
+        return std::string{ "Huge line with an extraneous \")\": got " } +
+               Parser::ResultType::code_name( result.type ) + " at " + std::to_string( result.at_col ) +
+               ", expected column " + std::to_string( col );
+    } );
+
+    return tally.report( "results" );
+}
@@ -0,0 +1,48 @@
+/**
+ * @file threaded_vm_test.cpp
+ * @brief Differential test of the threaded interpreter against BaresManager::calculate().
+ *
+ * Every valid line of the corpus files, and a set of generated expressions, is
+ * compiled and run by ThreadedProgram, from the plain and from the optimized
+ * program. The code and the value must be the ones of calculate(). The
+ * generated expressions mix every operator with literals and nested groups,
+ * so every superinstruction is decoded and reaches its errors.
+ *
+ * Usage: bares_threaded_vm_test [corpus files...]
+ */
+
+#include <random> // std::mt19937
+#include <string> // std::string
+
+#include "../include/threaded_vm.h"
+#include "differential.h"
+
+namespace {
+    differential::Tally tally;
+    unsigned long fused{0};
+
+    /// Evaluates a line both ways, reporting a difference.
+    void check( BaresManager & bm, ThreadedProgram & vm, const std::string & line ) {
+        differential::check_program( tally, bm, line, [&]( const Program & program, Parser::required_int_type & got ) {
+            vm.compile( program );
+            fused += vm.fused();
+            return vm.run( got );
+        } );
+    }
+}
+
+int main( int argc, char * argv[] ) {
+    BaresManager bm;
+    ThreadedProgram vm;
+
+    if ( not differential::for_each_corpus_line( argc, argv, [&]( const std::string & line ) { check( bm, vm, line ); } ) )
+        return EXIT_FAILURE;
+
+    std::mt19937 rng{ 2024 };
+    for ( int i{0}; i < 50000; i++ )
+        check( bm, vm, differential::random_expression( rng, 1 + i % 10 ) );
+
+    std::cout << ">>> " << fused << " superinstructions decoded"
+              << ( ThreadedProgram::threaded() ? "" : " (switch dispatch)" ) << ".\n";
+    return tally.report( "programs" );
+}
@@ -0,0 +1,135 @@
+/**
+ * @file variables_test.cpp
+ * @brief Differential test of the variables against textual substitution.
+ *
+ * Generated templates over the variables `x`, `y` and `z` are parsed and
+ * compiled once; then, for many random bindings, the program is run by
+ * Program::run(), by ThreadedProgram and by the JIT, from the plain and from
+ * the optimized program. Each result must be the one of calculate() on the
+ * template with every variable replaced by its value in parentheses. The
+ * errors of the identifiers themselves are checked at the end.
+ *
+ * Usage: bares_variables_test
+ */
+
+#include <random>  // std::mt19937
+#include <sstream> // std::ostringstream
+#include <string>  // std::string
+#include <vector>  // std::vector
+
+#include "../include/bares_manager.h"
+#include "../include/jit.h"
+#include "../include/optimizer.h"
+#include "../include/symbol_table.h"
+#include "../include/threaded_vm.h"
+#include "differential.h"
+
+namespace {
+    const char * const names[] = { "x", "y", "z" };
+
+    /// A term that is not a group: a variable or a small integer.
+    std::string leaf( std::mt19937 & rng ) {
+        return rng() % 2 == 0 ? std::string{ names[ rng() % 3 ] } : differential::random_integer( rng, 5 );
+    }
+
+    /// The template with each variable replaced by its value.
+    std::string substitute( const std::string & expr, const std::vector< Parser::required_int_type > & values ) {
+        std::string e;
+        for ( char c : expr ) {
+            if ( c >= 'x' and c <= 'z' ) e += "(" + std::to_string( values[ c - 'x' ] ) + ")";
+            else e += c;
+        }
+        return e;
+    }
+
+    differential::Tally tally;
+
+    void compare( const std::string & expr, const std::string & engine, const Parser::ResultType & want,
+                  Parser::required_int_type value, const Parser::ResultType & got, Parser::required_int_type result ) {
+        tally.expect( got.type == want.type and ( want.type != Parser::ResultType::OK or result == value ), [&] {
+            return "\"" + expr + "\" on " + engine + ": expected " + Parser::ResultType::code_name( want.type ) + " = " +
+                   std::to_string( value ) + ", got " + Parser::ResultType::code_name( got.type ) + " = " +
+                   std::to_string( result );
+        } );
+    }
+
+    /// Checks one line against the expected code and column.
+    void expect( BaresManager & bm, const std::string & expr, Parser::ResultType::code_t code, Parser::ResultType::size_type col ) {
+        std::ostringstream os;
+        bm.parse_and_compute( expr, os );
+        const Parser::ResultType got = bm.get_status();
+        tally.expect( got.type == code and ( code == Parser::ResultType::OK or got.at_col == col ), [&] {
+            return "\"" + expr + "\": expected " + Parser::ResultType::code_name( code ) + " at " + std::to_string( col ) +
+                   ", got " + Parser::ResultType::code_name( got.type ) + " at " + std::to_string( got.at_col );
+        } );
+    }
+}
+
+int main(void) {
+    SymbolTable table;
+    for ( const char * name : names ) table.intern( name );
+    table.close();
+    std::vector< Parser::required_int_type > values( table.size() );
+
+    BaresManager templates, plain;
+    templates.use_symbols( &table, values.data() );
+    ThreadedProgram vm;
+    sta::stack< Parser::input_int_type > st;
+    JitProgram jit, jit_optimized;
+    std::mt19937 rng{ 2043 };
+
+    for ( int t{0}; t < 2000; t++ ) {
+        const std::string expr = differential::random_template( rng, 1 + rng() % 8, leaf );
+        const bool parsed = templates.parse( expr ).type == Parser::ResultType::OK;
+        tally.expect( parsed, [&] { return "Template \"" + expr + "\" does not parse"; } );
+        if ( not parsed ) continue;
+        // [I] Compiled once per template.
+        templates.infix_to_postfix();
+        Program program, optimized;
+        templates.compile( program );
+        templates.compile( optimized );
+        optimize( optimized );
+        jit.compile( program );
+        jit_optimized.compile( optimized );
+
+        // [II] Evaluated for many bindings.
+        for ( int b{0}; b < 50; b++ ) {
+            for ( auto & v : values ) v = static_cast< Parser::required_int_type >( static_cast< int >( rng() % 21 ) - 10 );
+            if ( b == 0 ) values[0] = 0;
+            const std::string text = substitute( expr, values );
+            plain.parse( text );
+            plain.infix_to_postfix();
+            plain.calculate();
+            const Parser::ResultType want = plain.get_status();
+            const Parser::required_int_type value = plain.get_value();
+
+            Parser::required_int_type got{0};
+            Parser::ResultType status = program.run( got, st, values.data() );
+            compare( expr, "Program::run", want, value, status, got );
+            status = optimized.run( got, st, values.data() );
+            compare( expr, "Program::run (optimized)", want, value, status, got );
+            vm.compile( program );
+            status = vm.run( got, values.data() );
+            compare( expr, "ThreadedProgram", want, value, status, got );
+            vm.compile( optimized );
+            status = vm.run( got, values.data() );
+            compare( expr, "ThreadedProgram (optimized)", want, value, status, got );
+            status = jit.run( got, values.data() );
+            compare( expr, "JitProgram", want, value, status, got );
+            status = jit_optimized.run( got, values.data() );
+            compare( expr, "JitProgram (optimized)", want, value, status, got );
+        }
+    }
+
+    // [III] The errors of the identifiers.
+    {
+        for ( std::size_t slot{0}; slot < values.size(); slot++ ) values[slot] = slot + 1; // Keeps the storage in use.
+        expect( templates, "x + y * z", Parser::ResultType::OK, 0 );
+        expect( templates, "x + w", Parser::ResultType::UNDEFINED_VARIABLE, 4 );
+        expect( templates, "(x + (y + count))", Parser::ResultType::UNDEFINED_VARIABLE, 10 );
+        expect( templates, "-x", Parser::ResultType::ILL_FORMED_INTEGER, 1 ); // No unary minus on a variable.
+        expect( plain, "x + 1", Parser::ResultType::ILL_FORMED_INTEGER, 0 ); // Without a table, as before.
+    }
+
+    return tally.report( "results" );
+}